@@ -9,6 +9,8 @@
 #include "log.h"
 #include "http/http_server.h"
 #include "http/ws_server.h"
+#include "http2/http2_server.h"
+#include "rock/rock_server.h"
 #include "worker.h"
 #include "module.h"
 
@@ -24,6 +26,9 @@ static tao::ConfigVar<std::string>::ptr g_server_pid_file =
             ,std::string("tao.pid")
             , "server pid file");
 
+static tao::ConfigVar<bool>::ptr g_server_config_watch =
+    tao::Config::Lookup("server.config_watch", true, "reload conf files when written");
+
 static tao::ConfigVar<std::vector<TcpServerConf> >::ptr g_servers_conf = 
     tao::Config::Lookup("servers", std::vector<TcpServerConf>(), "http server config");
 
@@ -223,11 +228,15 @@ int Application::run_fiber()
         TcpServer::ptr server;
         if (i.type == "http") {
             server.reset(new tao::http::HttpServer(i.keepalive, process_worker, accept_worker));
+        } else if (i.type == "http2") {
+            server.reset(new tao::http2::Http2Server(i.keepalive, process_worker, accept_worker));
         } else if (i.type == "tcp") {
             server = std::make_shared<TcpServer>(process_worker, accept_worker);
         } else if (i.type == "ws") {
             server.reset(new tao::http::WSServer(process_worker, accept_worker));
             //server = std::make_shared<tao::http::WSServer>(process_worker, accept_worker);
+        } else if (i.type == "rock") {
+            server = std::make_shared<tao::RockServer>(process_worker, accept_worker);
         } else {
             TAO_LOG_ERROR(g_logger) << "invalid server type=" << i.type
             << Lexical_Cast<TcpServerConf, std::string>()(i);
@@ -264,6 +273,10 @@ int Application::run_fiber()
         i->onServerUp();
     }
 
+    if(g_server_config_watch->getValue()) {
+        tao::Config::WatchConfDir(tao::EnvMgr::GetInstance()->getConfigPath()
+                    , tao::IOManager::GetThis());
+    }
     return 0;
 }
 }
\ No newline at end of file
@@ -0,0 +1,247 @@
+#include "buffer_chain.h"
+#include <string.h>
+#include <algorithm>
+
+namespace tao {
+
+//size of the blocks allocated by append and readv
+static const size_t s_block_size = 4096;
+//largest block a single append or readv allocates
+static const size_t s_max_block_size = 64 * 1024;
+
+BufferChain::Slice BufferChain::NewSlice(size_t capacity, size_t offset) {
+    Slice s;
+    s.block.reset(new char[capacity], [](char* ptr) { delete[] ptr;});
+    s.capacity = capacity;
+    s.offset = offset;
+    s.length = 0;
+    return s;
+}
+
+size_t BufferChain::Room(const Slice& s) {
+    //another chain may read the bytes behind this slice
+    if(s.block.use_count() != 1) {
+        return 0;
+    }
+    return s.capacity - s.offset - s.length;
+}
+
+BufferChain::BufferChain(size_t headroom) {
+    if(headroom) {
+        m_slices.push_back(NewSlice(headroom + s_block_size, headroom));
+    }
+}
+
+size_t BufferChain::getSliceCount() const {
+    size_t n = 0;
+    for(auto& i : m_slices) {
+        if(i.length) {
+            ++n;
+        }
+    }
+    return n;
+}
+
+size_t BufferChain::writableIndex() const {
+    size_t i = m_slices.size();
+    while(i > 0 && m_slices[i - 1].length == 0) {
+        --i;
+    }
+    if(i > 0 && Room(m_slices[i - 1])) {
+        return i - 1;
+    }
+    return i;
+}
+
+void BufferChain::trimEmpty() {
+    //a lone empty slice is kept, it may be the headroom
+    while(m_slices.size() > 1 && m_slices.back().length == 0) {
+        m_slices.pop_back();
+    }
+}
+
+void BufferChain::append(const void* data, size_t len) {
+    const char* p = (const char*)data;
+    size_t idx = writableIndex();
+    while(len > 0) {
+        if(idx == m_slices.size()) {
+            m_slices.push_back(NewSlice(std::min(std::max(len, s_block_size), s_max_block_size), 0));
+        }
+        Slice& s = m_slices[idx];
+        size_t n = std::min(Room(s), len);
+        memcpy(s.block.get() + s.offset + s.length, p, n);
+        s.length += n;
+        m_size += n;
+        p += n;
+        len -= n;
+        ++idx;
+    }
+}
+
+void BufferChain::append(const BufferChain& other) {
+    if(&other == this) {
+        BufferChain copy(other);
+        append(copy);
+        return;
+    }
+    trimEmpty();
+    for(auto& i : other.m_slices) {
+        if(i.length) {
+            m_slices.push_back(i);
+            m_size += i.length;
+        }
+    }
+}
+
+void BufferChain::prepend(const void* data, size_t len) {
+    if(len == 0) {
+        return;
+    }
+    if(m_slices.empty() || m_slices.front().offset < len
+            || m_slices.front().block.use_count() != 1) {
+        //data goes at the end of the new block so later prepends find headroom
+        size_t capacity = std::max(len, s_block_size);
+        m_slices.push_front(NewSlice(capacity, capacity));
+    }
+    Slice& s = m_slices.front();
+    s.offset -= len;
+    s.length += len;
+    memcpy(s.block.get() + s.offset, data, len);
+    m_size += len;
+}
+
+BufferChain BufferChain::slice(size_t offset, size_t len) const {
+    BufferChain rt;
+    for(auto& i : m_slices) {
+        if(len == 0) {
+            break;
+        }
+        if(offset >= i.length) {
+            offset -= i.length;
+            continue;
+        }
+        Slice s = i;
+        s.offset += offset;
+        s.length = std::min(i.length - offset, len);
+        offset = 0;
+        len -= s.length;
+        rt.m_size += s.length;
+        rt.m_slices.push_back(std::move(s));
+    }
+    return rt;
+}
+
+void BufferChain::consume(size_t len) {
+    len = std::min(len, m_size);
+    m_size -= len;
+    while(len > 0) {
+        Slice& s = m_slices.front();
+        if(len < s.length) {
+            s.offset += len;
+            s.length -= len;
+            return;
+        }
+        len -= s.length;
+        m_slices.pop_front();
+    }
+}
+
+void BufferChain::trimEnd(size_t len) {
+    len = std::min(len, m_size);
+    m_size -= len;
+    trimEmpty();
+    while(len > 0) {
+        Slice& s = m_slices.back();
+        if(len < s.length) {
+            s.length -= len;
+            return;
+        }
+        len -= s.length;
+        m_slices.pop_back();
+    }
+}
+
+void BufferChain::clear() {
+    m_slices.clear();
+    m_size = 0;
+}
+
+size_t BufferChain::copyTo(void* buf, size_t len, size_t offset) const {
+    char* p = (char*)buf;
+    size_t copied = 0;
+    for(auto& i : m_slices) {
+        if(copied == len) {
+            break;
+        }
+        if(offset >= i.length) {
+            offset -= i.length;
+            continue;
+        }
+        size_t n = std::min(i.length - offset, len - copied);
+        memcpy(p + copied, i.block.get() + i.offset + offset, n);
+        copied += n;
+        offset = 0;
+    }
+    return copied;
+}
+
+std::string BufferChain::toString() const {
+    std::string rt;
+    rt.resize(m_size);
+    if(m_size) {
+        copyTo(&rt[0], m_size);
+    }
+    return rt;
+}
+
+uint64_t BufferChain::getReadableBuffers(std::vector<iovec>& buffers, uint64_t len) const {
+    len = std::min(len, (uint64_t)m_size);
+    uint64_t size = len;
+    for(auto& i : m_slices) {
+        if(len == 0) {
+            break;
+        }
+        if(i.length == 0) {
+            continue;
+        }
+        iovec iov;
+        iov.iov_base = i.block.get() + i.offset;
+        iov.iov_len = std::min((uint64_t)i.length, len);
+        len -= iov.iov_len;
+        buffers.push_back(iov);
+    }
+    return size;
+}
+
+uint64_t BufferChain::getWritableBuffers(std::vector<iovec>& buffers, uint64_t len) {
+    if(len == 0) {
+        return 0;
+    }
+    uint64_t size = len;
+    for(size_t idx = writableIndex(); len > 0; ++idx) {
+        if(idx == m_slices.size()) {
+            m_slices.push_back(NewSlice(std::min(std::max((size_t)len, s_block_size), s_max_block_size), 0));
+        }
+        Slice& s = m_slices[idx];
+        iovec iov;
+        iov.iov_base = s.block.get() + s.offset + s.length;
+        iov.iov_len = std::min((uint64_t)Room(s), len);
+        if(iov.iov_len) {
+            len -= iov.iov_len;
+            buffers.push_back(iov);
+        }
+    }
+    return size;
+}
+
+void BufferChain::commit(size_t len) {
+    for(size_t idx = writableIndex(); len > 0 && idx < m_slices.size(); ++idx) {
+        Slice& s = m_slices[idx];
+        size_t n = std::min(Room(s), len);
+        s.length += n;
+        m_size += n;
+        len -= n;
+    }
+}
+
+}
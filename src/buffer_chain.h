@@ -0,0 +1,93 @@
+#ifndef __TAO_BUFFER_CHAIN_H__
+#define __TAO_BUFFER_CHAIN_H__
+
+#include <memory>
+#include <string>
+#include <deque>
+#include <vector>
+#include <stdint.h>
+#include <sys/uio.h>
+
+namespace tao {
+
+/**
+ * @brief chain of slices over refcounted memory blocks
+ * copying, slicing and appending another chain share the blocks instead of the bytes,
+ * so a request body or a payload can be handed to another component without a copy.
+ * a block is only written while a single chain references it, bytes seen by another
+ * chain never change. not thread safe, a copy may be moved to another thread
+ */
+class BufferChain {
+public:
+    using ptr = std::shared_ptr<BufferChain>;
+
+    /**
+     * @param[in] headroom bytes reserved in front of the first block, prepend uses them without a copy
+     */
+    explicit BufferChain(size_t headroom = 0);
+
+    //readable bytes
+    size_t size() const { return m_size;}
+    bool empty() const { return m_size == 0;}
+    //slices holding data
+    size_t getSliceCount() const;
+
+    //copy data into the chain
+    void append(const void* data, size_t len);
+    void append(const std::string& data) { append(data.c_str(), data.size());}
+    //share the slices of other, no bytes are copied
+    void append(const BufferChain& other);
+    /**
+     * @brief put data in front, into the headroom of the first block when there is enough
+     */
+    void prepend(const void* data, size_t len);
+    void prepend(const std::string& data) { prepend(data.c_str(), data.size());}
+
+    /**
+     * @brief len bytes from offset sharing the blocks of this chain
+     */
+    BufferChain slice(size_t offset, size_t len) const;
+    //drop len bytes from the front
+    void consume(size_t len);
+    //drop len bytes from the back
+    void trimEnd(size_t len);
+    void clear();
+
+    /**
+     * @brief copy up to len bytes starting at offset, returns the bytes copied
+     */
+    size_t copyTo(void* buf, size_t len, size_t offset = 0) const;
+    std::string toString() const;
+
+    //readable slices as iovec for writev
+    uint64_t getReadableBuffers(std::vector<iovec>& buffers, uint64_t len = ~0ull) const;
+    /**
+     * @brief free space after the data, at least len bytes, for readv
+     * the space becomes data with commit
+     */
+    uint64_t getWritableBuffers(std::vector<iovec>& buffers, uint64_t len);
+    //marks len bytes of the writable buffers as data
+    void commit(size_t len);
+private:
+    struct Slice {
+        std::shared_ptr<char> block;
+        size_t capacity;
+        size_t offset;
+        size_t length;
+    };
+
+    static Slice NewSlice(size_t capacity, size_t offset);
+    //free bytes after the slice that this chain may write
+    static size_t Room(const Slice& s);
+    //the slice where written bytes continue
+    size_t writableIndex() const;
+    //remove empty slices at the back but the first one
+    void trimEmpty();
+private:
+    std::deque<Slice> m_slices;
+    size_t m_size = 0;
+};
+
+}
+
+#endif
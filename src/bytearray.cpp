@@ -1,17 +1,129 @@
 #include "bytearray.h"
 #include "endian.h"
 #include "log.h"
+#include "config.h"
+#include <atomic>
 #include <cstring>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iomanip>
 #include <cmath>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
 
 namespace tao {
 
 static tao::Logger::ptr g_logger = TAO_LOG_NAME("system");
 
+static tao::ConfigVar<uint64_t>::ptr g_bytearray_pool_max_bytes =
+    tao::Config::Lookup("bytearray.pool.max_bytes"
+                ,(uint64_t)1024 * 1024, "bytes of free ByteArray nodes cached per thread, 0 disable");
+
+//written by the config listener, read by every thread freeing a node
+static std::atomic<uint64_t> s_bytearray_pool_max_bytes{0};
+
+struct _ByteArrayIniter {
+    _ByteArrayIniter() {
+        s_bytearray_pool_max_bytes.store(g_bytearray_pool_max_bytes->getValue()
+                                        ,std::memory_order_relaxed);
+        g_bytearray_pool_max_bytes->addListener(
+                [](const uint64_t& ov, const uint64_t& nv){
+                s_bytearray_pool_max_bytes.store(nv, std::memory_order_relaxed);
+        });
+    }
+};
+
+static _ByteArrayIniter _init;
+
+//larger nodes are never cached
+static const size_t s_pool_max_node_size = 64 * 1024;
+
+namespace {
+
+//free nodes of one thread, one list per node size. a node released on another
+//thread joins the list of that thread
+struct NodePool {
+    struct FreeList {
+        size_t size = 0;
+        ByteArray::Node* head = nullptr;
+    };
+    ~NodePool();
+
+    FreeList* find(size_t size, bool create) {
+        for(auto& i : lists) {
+            if(i.size == size) {
+                return &i;
+            }
+        }
+        if(create) {
+            for(auto& i : lists) {
+                if(!i.head) {
+                    i.size = size;
+                    return &i;
+                }
+            }
+        }
+        return nullptr;
+    }
+
+    //a thread rarely sees more than a couple of base sizes
+    FreeList lists[4];
+    uint64_t bytes = 0;
+};
+
+static thread_local bool t_pool_dead = false;
+static thread_local NodePool t_pool;
+
+NodePool::~NodePool() {
+    t_pool_dead = true;
+    for(auto& i : lists) {
+        while(i.head) {
+            ByteArray::Node* node = i.head;
+            i.head = node->next;
+            delete node;
+        }
+    }
+}
+
+}
+
+ByteArray::Node* ByteArray::AllocNode(size_t size) {
+    if(size <= s_pool_max_node_size && !t_pool_dead) {
+        NodePool::FreeList* list = t_pool.find(size, false);
+        if(list && list->head) {
+            Node* node = list->head;
+            list->head = node->next;
+            node->next = nullptr;
+            t_pool.bytes -= size;
+            return node;
+        }
+    }
+    return new Node(size);
+}
+
+void ByteArray::FreeNode(Node* node) {
+    if(node->size <= s_pool_max_node_size && !t_pool_dead
+            && t_pool.bytes + node->size <= s_bytearray_pool_max_bytes.load(std::memory_order_relaxed)) {
+        NodePool::FreeList* list = t_pool.find(node->size, true);
+        if(list) {
+            node->next = list->head;
+            list->head = node;
+            t_pool.bytes += node->size;
+            return;
+        }
+    }
+    delete node;
+}
+
+uint64_t ByteArray::GetPooledBytes() {
+    return t_pool_dead ? 0 : t_pool.bytes;
+}
+
 ByteArray::Node::Node(size_t s) 
     :ptr(new char[s])
     ,next(nullptr)
@@ -36,29 +148,126 @@ ByteArray::ByteArray(size_t base_size)
     ,m_capacity(base_size)
     ,m_size(0)
     ,m_endian(TAO_BIG_ENDIAN)
-    ,m_root(new Node(base_size))
+    ,m_root(AllocNode(base_size))
     ,m_cur(m_root)
+    ,m_tail(m_root)
 {
 }
 
 ByteArray::~ByteArray()
 {
+    if (m_mapping) {
+        munmap(m_mapping, m_root->size);
+        m_root->ptr = nullptr;
+        delete m_root;
+        return;
+    }
     Node* tmp = m_root;
     while (tmp) {
         m_cur = tmp;
         tmp = tmp->next;
-        delete m_cur;
+        FreeNode(m_cur);
+    }
+}
+
+//7 bits per byte, low bits first, the high bit set on all but the last byte
+static inline size_t EncodeVarint(uint8_t* p, uint64_t v) {
+    size_t i = 0;
+    while (v >= 0x80) {
+        p[i++] = (uint8_t)v | 0x80;
+        v >>= 7;
+    }
+    p[i++] = (uint8_t)v;
+    return i;
+}
+
+/**
+ * decodes a varint of at most 8 bytes from 8 readable bytes without a branch per byte,
+ * returns the bytes used, 0 for a longer varint
+ */
+static inline size_t DecodeVarint(const uint8_t* p, uint64_t& v) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    uint64_t x;
+    memcpy(&x, p, sizeof(x));
+    //high bit clear marks the last byte
+    uint64_t stop = ~x & 0x8080808080808080ull;
+    if (!stop) {
+        return 0;
+    }
+    int bits = __builtin_ctzll(stop) + 1;
+    if (bits < 64) {
+        x &= (1ull << bits) - 1;
+    }
+    x &= 0x7f7f7f7f7f7f7f7full;
+    //pack the 7 bit groups: 14 bits per 16, 28 per 32, 56 per 64
+    x = ((x & 0x7f007f007f007f00ull) >> 1) | (x & 0x007f007f007f007full);
+    x = ((x & 0x3fff00003fff0000ull) >> 2) | (x & 0x00003fff00003fffull);
+    x = ((x & 0x0fffffff00000000ull) >> 4) | (x & 0x000000000fffffffull);
+    v = x;
+    return bits / 8;
+#else
+    uint64_t res = 0;
+    for (size_t i = 0; i < 8; ++i) {
+        res |= (uint64_t)(p[i] & 0x7f) << (i * 7);
+        if (p[i] < 0x80) {
+            v = res;
+            return i + 1;
+        }
+    }
+    return 0;
+#endif
+}
+
+inline size_t ByteArray::nodeLeft(size_t& npos) const
+{
+    if (!m_cur) {
+        return 0;
+    }
+    npos = m_position % m_baseSize;
+    return m_cur->size - npos;
+}
+
+inline void ByteArray::advance(size_t npos, size_t size)
+{
+    m_position += size;
+    if (npos + size == m_cur->size) {
+        m_cur = m_cur->next;
+    }
+    if (m_position > m_size) {
+        m_size = m_position;
+    }
+}
+
+inline void ByteArray::writeFixed(const void* buf, size_t size)
+{
+    size_t npos;
+    if (nodeLeft(npos) >= size) {
+        memcpy(m_cur->ptr + npos, buf, size);
+        advance(npos, size);
+    } else {
+        write(buf, size);
+    }
+}
+
+inline void ByteArray::readFixed(void* buf, size_t size)
+{
+    size_t npos;
+    if (std::min(nodeLeft(npos), getReadableSize()) >= size) {
+        memcpy(buf, m_cur->ptr + npos, size);
+        advance(npos, size);
+    } else {
+        read(buf, size);
     }
 }
 
 void ByteArray::writeFint8(int8_t value)
 {
-    write(&value, sizeof(value));
+    writeFixed(&value, sizeof(value));
 }
 
 void ByteArray::writeFuint8(uint8_t value)
 {
-    write(&value, sizeof(value));
+    writeFixed(&value, sizeof(value));
 }
 
 void ByteArray::writeFint16(int16_t value)
@@ -66,7 +275,7 @@ void ByteArray::writeFint16(int16_t value)
     if(m_endian != TAO_BYTE_ORDER) {
         value = byteswap(value);
     }
-    write(&value, sizeof(value));
+    writeFixed(&value, sizeof(value));
 }
 
 void ByteArray::writeFuint16(uint16_t value)
@@ -74,7 +283,7 @@ void ByteArray::writeFuint16(uint16_t value)
     if(m_endian != TAO_BYTE_ORDER) {
         value = byteswap(value);
     }
-    write(&value, sizeof(value));
+    writeFixed(&value, sizeof(value));
 }
 
 void ByteArray::writeFint32(int32_t value)
@@ -82,7 +291,7 @@ void ByteArray::writeFint32(int32_t value)
     if(m_endian != TAO_BYTE_ORDER) {
         value = byteswap(value);
     }
-    write(&value, sizeof(value));
+    writeFixed(&value, sizeof(value));
 }
 
 void ByteArray::writeFuint32(uint32_t value)
@@ -90,7 +299,7 @@ void ByteArray::writeFuint32(uint32_t value)
     if(m_endian != TAO_BYTE_ORDER) {
         value = byteswap(value);
     }
-    write(&value, sizeof(value));
+    writeFixed(&value, sizeof(value));
 }
 
 void ByteArray::writeFint64(int64_t value)
@@ -98,7 +307,7 @@ void ByteArray::writeFint64(int64_t value)
     if(m_endian != TAO_BYTE_ORDER) {
         value = byteswap(value);
     }
-    write(&value, sizeof(value));
+    writeFixed(&value, sizeof(value));
 }
 
 void ByteArray::writeFuint64(uint64_t value)
@@ -106,7 +315,7 @@ void ByteArray::writeFuint64(uint64_t value)
     if(m_endian != TAO_BYTE_ORDER) {
         value = byteswap(value);
     }
-    write(&value, sizeof(value));
+    writeFixed(&value, sizeof(value));
 }
 
 //negative number encoded into positive number
@@ -137,14 +346,13 @@ void ByteArray::writeInt32(int32_t value)
 
 void ByteArray::writeUint32(uint32_t value)
 {
-    uint8_t compressed[5];//maximum 5 bytes
-    uint8_t i = 0;
-    while (value >= 0x80) {
-        compressed[i++] = (value & 0x7F) | 0x80;//fetch lowest 7 bits and set the 8th as 1
-        value >>= 7;//shift to get next chunk
+    size_t npos;
+    if (nodeLeft(npos) >= 5) {//encode in place
+        advance(npos, EncodeVarint((uint8_t*)m_cur->ptr + npos, value));
+        return;
     }
-    compressed[i++] = value;
-    write(compressed, i);
+    uint8_t compressed[5];//maximum 5 bytes
+    write(compressed, EncodeVarint(compressed, value));
 }
 
 void ByteArray::writeInt64(int64_t value)
@@ -154,14 +362,13 @@ void ByteArray::writeInt64(int64_t value)
 
 void ByteArray::writeUint64(uint64_t value)
 {
-    uint8_t compressed[10];//maximum 10 bytes
-    uint8_t i = 0;
-    while (value >= 0x80) {
-        compressed[i++] = (value & 0x7F) | 0x80;//fetch lowest 7 bits and set the 8th as 1
-        value >>= 7;//shift to get next chunk
+    size_t npos;
+    if (nodeLeft(npos) >= 10) {//encode in place
+        advance(npos, EncodeVarint((uint8_t*)m_cur->ptr + npos, value));
+        return;
     }
-    compressed[i++] = value;
-    write(compressed, i);
+    uint8_t compressed[10];//maximum 10 bytes
+    write(compressed, EncodeVarint(compressed, value));
 }
 
 void ByteArray::writeFloat(float value)
@@ -210,20 +417,20 @@ void ByteArray::writeStringWithoutLength(const std::string &value)
 int8_t ByteArray::readFint8()
 {
     int8_t v;
-    read(&v, sizeof(v));
+    readFixed(&v, sizeof(v));
     return v;
 }
 
 uint8_t ByteArray::readFuint8()
 {
     uint8_t v;
-    read(&v, sizeof(v));
+    readFixed(&v, sizeof(v));
     return v;
 }
 
 #define XX(type) \
     type v; \
-    read(&v, sizeof(v)); \
+    readFixed(&v, sizeof(v)); \
     if (m_endian == TAO_BYTE_ORDER) { \
         return v; \
     } else { \
@@ -269,6 +476,15 @@ int32_t ByteArray::readInt32()
 
 uint32_t ByteArray::readUint32()
 {
+    size_t npos;
+    if (std::min(nodeLeft(npos), getReadableSize()) >= 8) {//decode in place
+        uint64_t v;
+        size_t n = DecodeVarint((const uint8_t*)m_cur->ptr + npos, v);
+        if (n && n <= 5) {
+            advance(npos, n);
+            return v;
+        }
+    }
     uint32_t res = 0;
     for (int i = 0; i < 32; i += 7) {
         uint8_t b = readFuint8();
@@ -289,14 +505,23 @@ int64_t ByteArray::readInt64()
 
 uint64_t ByteArray::readUint64()
 {
-    uint32_t res = 0;
+    size_t npos;
+    if (std::min(nodeLeft(npos), getReadableSize()) >= 8) {//decode in place
+        uint64_t v;
+        size_t n = DecodeVarint((const uint8_t*)m_cur->ptr + npos, v);
+        if (n) {
+            advance(npos, n);
+            return v;
+        }
+    }
+    uint64_t res = 0;
     for (int i = 0; i < 64; i += 7) {
         uint8_t b = readFuint8();
         if (b < 0x80) {
-            res |= ((uint32_t)b) << i;
+            res |= ((uint64_t)b) << i;
             break;
         } else {
-            res |= (((uint32_t)(b & 0x7f)) << i);
+            res |= (((uint64_t)(b & 0x7f)) << i);
         }
     }
     return res;
@@ -312,7 +537,7 @@ float ByteArray::readFloat()
 
 double ByteArray::readDouble()
 {
-    uint32_t v = readFuint32();
+    uint64_t v = readFuint64();
     double value;
     memcpy(&value, &v, sizeof(v));
     return value;
@@ -356,6 +581,10 @@ std::string ByteArray::readStringVint()
 
 void ByteArray::clear()
 {
+    if (m_mapping) {
+        unmap();
+        return;
+    }
     m_position = m_size = 0;
     m_capacity = m_baseSize;
     //remain root node
@@ -363,12 +592,37 @@ void ByteArray::clear()
     while (tmp) {
         m_cur = tmp;
         tmp = tmp->next;
-        delete m_cur;
+        FreeNode(m_cur);
     }
     m_cur = m_root;
+    m_tail = m_root;
     m_root->next = NULL;
 }
 
+void ByteArray::reset(size_t max_keep)
+{
+    if (m_mapping) {
+        unmap();
+        return;
+    }
+    m_position = m_size = 0;
+    m_cur = m_root;
+    Node* tail = m_root;
+    m_capacity = m_root->size;
+    while (tail->next && m_capacity + tail->next->size <= max_keep) {
+        tail = tail->next;
+        m_capacity += tail->size;
+    }
+    Node* tmp = tail->next;
+    tail->next = NULL;
+    m_tail = tail;
+    while (tmp) {
+        Node* next = tmp->next;
+        FreeNode(tmp);
+        tmp = next;
+    }
+}
+
 void ByteArray::write(const void *buf, size_t size)
 {
     if (size == 0) {
@@ -390,7 +644,7 @@ void ByteArray::write(const void *buf, size_t size)
             bpos += size;
             size = 0;
         } else {//rest capacity is not enough
-            memcpy(m_cur->ptr, (const char*)buf + bpos, ncap);
+            memcpy(m_cur->ptr + npos, (const char*)buf + bpos, ncap);
             m_position += ncap;
             bpos += ncap;
             size -= ncap;
@@ -436,6 +690,38 @@ void ByteArray::read(void *buf, size_t size)
     }
 }
 
+char* ByteArray::writeView(size_t size)
+{
+    if(size == 0) {
+        return nullptr;
+    }
+    addCapacity(size);
+    size_t npos;
+    if(nodeLeft(npos) < size) {
+        return nullptr;
+    }
+    char* rt = m_cur->ptr + npos;
+    advance(npos, size);
+    return rt;
+}
+
+const char* ByteArray::readView(size_t size)
+{
+    if(size > getReadableSize()) {
+        throw std::out_of_range("not enough len");
+    }
+    if(size == 0) {
+        return "";
+    }
+    size_t npos;
+    if(nodeLeft(npos) < size) {
+        return nullptr;
+    }
+    const char* rt = m_cur->ptr + npos;
+    advance(npos, size);
+    return rt;
+}
+
 void ByteArray::read(void *buf, size_t size, size_t position) const
 {
     if(size > (m_size - position)) {
@@ -477,39 +763,59 @@ void ByteArray::setPosition(size_t v)
         m_size = m_position;
     }
     m_cur = m_root;
-    while (v >= m_cur->size) {//Exceeding size of one memory block
+    //m_cur is null when v is exactly the end of the last node
+    while (m_cur && v >= m_cur->size) {//Exceeding size of one memory block
         v -= m_cur->size;
         m_cur  = m_cur->next;
     }
-    if (v == m_cur->size) {//equal to size of one memory block
+    if (m_cur && v == m_cur->size) {//equal to size of one memory block
         m_cur = m_cur->next;
     }
 }
 
-bool ByteArray::writeToFile(const std::string &name) const
+bool ByteArray::writeToFile(const std::string &name, bool append) const
 {
-    std::ofstream ofs;
-    ofs.open(name, std::ios::trunc | std::ios::binary);
-    if (!ofs) {
+    int fd = open(name.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC | (append ? 0 : O_TRUNC), 0644);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st)) {
         TAO_LOG_ERROR(g_logger) << "writeToFile name=" << name
             << " error , errno=" << errno << " errstr=" << strerror(errno);
+        if (fd >= 0) {
+            close(fd);
+        }
         return false;
     }
 
-    int64_t read_size = getReadableSize();
-    int64_t pos = m_position;
-    Node* cur = m_cur;
-
-    while (read_size > 0) {
-        int diff = pos % m_baseSize;
-        int64_t len = (read_size > (int64_t)m_baseSize ? m_baseSize : read_size) - diff;
-        ofs.write(cur->ptr + diff, len);
-        cur = cur->next;
-        pos += len;
-        read_size -= len;
+    off_t offset = append ? st.st_size : 0;
+    std::vector<iovec> iovs;
+    getReadableBuffers(iovs);
+    size_t idx = 0;
+    bool ok = true;
+    while (idx < iovs.size()) {
+        size_t n = std::min(iovs.size() - idx, (size_t)IOV_MAX);
+        ssize_t rt = pwritev(fd, &iovs[idx], n, offset);
+        if (rt < 0 && errno == EINTR) {
+            continue;
+        }
+        if (rt <= 0) {
+            TAO_LOG_ERROR(g_logger) << "writeToFile name=" << name
+                << " pwritev error, errno=" << errno << " errstr=" << strerror(errno);
+            ok = false;
+            break;
+        }
+        offset += rt;
+        //skip what was written, a short write leaves a partial iovec
+        while (idx < iovs.size() && (size_t)rt >= iovs[idx].iov_len) {
+            rt -= iovs[idx].iov_len;
+            ++idx;
+        }
+        if (rt > 0) {
+            iovs[idx].iov_base = (char*)iovs[idx].iov_base + rt;
+            iovs[idx].iov_len -= rt;
+        }
     }
-
-    return true;
+    close(fd);
+    return ok;
 }
 
 bool ByteArray::readFromFile(const std::string &name)
@@ -532,6 +838,62 @@ bool ByteArray::readFromFile(const std::string &name)
     
 }
 
+bool ByteArray::mapFile(const std::string& name, bool sequential)
+{
+    int fd = open(name.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st)) {
+        TAO_LOG_ERROR(g_logger) << "mapFile name=" << name
+            << " error, errno=" << errno << " errstr=" << strerror(errno);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return false;
+    }
+    size_t size = st.st_size;
+    void* addr = nullptr;
+    if (size) {
+        //private and writable, so bytes can be patched in place without touching the file
+        addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (addr == MAP_FAILED) {
+        TAO_LOG_ERROR(g_logger) << "mapFile name=" << name << " size=" << size
+            << " mmap error, errno=" << errno << " errstr=" << strerror(errno);
+        return false;
+    }
+    clear();
+    if (!addr) {
+        return true;
+    }
+    if (sequential) {
+        madvise(addr, size, MADV_SEQUENTIAL);
+    }
+    FreeNode(m_root);
+    m_root = m_cur = m_tail = new Node();
+    m_root->ptr = (char*)addr;
+    m_root->size = size;
+    m_mapping = addr;
+    m_mapBaseSize = m_baseSize;
+    //one node, position % base size stays the offset in the mapping
+    m_baseSize = size;
+    m_capacity = m_size = size;
+    m_position = 0;
+    return true;
+}
+
+void ByteArray::unmap()
+{
+    munmap(m_mapping, m_root->size);
+    m_root->ptr = nullptr;
+    delete m_root;
+    m_mapping = nullptr;
+    m_baseSize = m_mapBaseSize;
+    m_root = m_cur = m_tail = AllocNode(m_baseSize);
+    m_capacity = m_baseSize;
+    m_position = m_size = 0;
+}
+
 bool ByteArray::isLittleEndian() const
 {
     return m_endian == TAO_LITTLE_ENDIAN;
@@ -688,23 +1050,23 @@ void ByteArray::addCapacity(size_t size)
     if (old_cap >= size) {
         return;
     }
+    if (m_mapping) {
+        throw std::logic_error("mapped ByteArray can not grow");
+    }
 
     size = size - old_cap;
     size_t count = std::ceil(1.0 * size / m_baseSize);
-    Node* tmp = m_root;
-    while (tmp->next) {
-        tmp = tmp->next;
-    }
-
+    Node* tmp = m_tail;
     Node* first = NULL;
     for (size_t i = 0; i < count; ++i) {
-        tmp->next = new Node(m_baseSize);
+        tmp->next = AllocNode(m_baseSize);
         if(first == NULL) {
             first = tmp->next;
         }
         tmp = tmp->next;
         m_capacity += m_baseSize;
     }
+    m_tail = tmp;
 
     if (old_cap == 0) {
         m_cur = first;
@@ -95,6 +95,14 @@ public:
     std::string readStringVint();
 
     void clear();
+    /**
+     * @brief empty the array and keep its nodes for the next writes
+     * @param[in] max_keep nodes beyond this many bytes go back to the pool, the first node is always kept
+     */
+    void reset(size_t max_keep = ~(size_t)0);
+
+    //bytes of free nodes cached by the calling thread
+    static uint64_t GetPooledBytes();
 
     /*
     buf: write buffer
@@ -103,12 +111,35 @@ public:
     void write(const void* buf, size_t size);
     void read(void* buf, size_t size);
     void read(void* buf, size_t size, size_t position) const;
+    /**
+     * @brief read size bytes without a copy
+     * @return the bytes inside the current node, nullptr when they cross nodes(position unchanged).
+     *         valid until the array is cleared, reset or destroyed
+     */
+    const char* readView(size_t size);
+    /**
+     * @brief reserve size bytes at the position for the caller to fill, and move past them
+     * @return the bytes inside one node, nullptr when size is 0 or they cross nodes(position unchanged)
+     */
+    char* writeView(size_t size);
     size_t getPosition() {return m_position;}
     void setPosition(size_t v);
 
-    //FILE DEBUG 
-    bool writeToFile(const std::string& name) const;
+    /**
+     * @brief write the readable bytes with pwritev, up to IOV_MAX nodes per call
+     * @param[in] append add to the end of the file instead of replacing it, to stream
+     *            a large file out in batches(fill, writeToFile(name, true), clear)
+     */
+    bool writeToFile(const std::string& name, bool append = false) const;
     bool readFromFile(const std::string& name);
+    /**
+     * @brief replace the content with a private mapping of the file, nothing is copied or read upfront
+     * the whole file is one node, the array can not grow: writes inside the file stay private,
+     * writes past its end throw std::logic_error. clear/reset drop the mapping
+     * @param[in] sequential advise the kernel to read ahead(MADV_SEQUENTIAL)
+     */
+    bool mapFile(const std::string& name, bool sequential = true);
+    bool isMapped() const { return m_mapping != nullptr;}
 
     bool isLittleEndian() const;
     void setIsLittleEndian(bool val);
@@ -125,7 +156,21 @@ public:
     //get writable buffers and store as iovec
     uint64_t getWritableBuffers(std::vector<iovec>& buffers, uint64_t len);
 private:
+    //nodes come from and go back to a per-thread free list shared by all ByteArrays
+    static Node* AllocNode(size_t size);
+    static void FreeNode(Node* node);
+
     void addCapacity(size_t size);
+    /**
+     * fast paths inside the current node, write/read handle node boundaries
+     * nodeLeft is 0 at the end of the last node
+     */
+    size_t nodeLeft(size_t& npos) const;
+    void advance(size_t npos, size_t size);
+    void writeFixed(const void* buf, size_t size);
+    void readFixed(void* buf, size_t size);
+    //back to an empty array of pooled nodes
+    void unmap();
     //get current available memory
     size_t getCapacity() {return m_capacity - m_position;};
 private:
@@ -137,6 +182,10 @@ private:
     
     Node* m_root;       //root memory block
     Node* m_cur;        //current memory block
+    Node* m_tail;       //last memory block
+
+    void* m_mapping = nullptr;  //mapFile address, the only node points into it
+    size_t m_mapBaseSize = 0;   //base size to restore when the mapping is dropped
 };
 
 }
@@ -1,6 +1,9 @@
 #include "config.h"
 #include "env.h"
+#include "iomanager.h"
+#include <sys/inotify.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 //A:
 //  B: 10
@@ -12,6 +15,19 @@ namespace tao {
 
 static tao::Logger::ptr g_logger = TAO_LOG_NAME("system");
 
+ConfigVarBase::ThreadSlot& ConfigVarBase::GetThreadSlot(uint64_t id) {
+    static thread_local std::vector<ThreadSlot> t_slots;
+    if (id >= t_slots.size()) {
+        t_slots.resize(id + 1);
+    }
+    return t_slots[id];
+}
+
+uint64_t ConfigVarBase::NextId() {
+    static std::atomic<uint64_t> s_id(0);
+    return s_id++;
+}
+
 ConfigVarBase::ptr Config::LookupBase(const std::string& name) {
     RWMutexType::ReadLock lock(GetMutex());
     auto it = GetDatas().find(name);
@@ -57,9 +73,103 @@ void Config::LoadFromYaml(const YAML::Node& root){
     }
 }
 
+//key -> yaml text of the keys that have a ConfigVar
+using YamlValues = std::map<std::string, std::pair<std::string, ConfigVarBase::ptr> >;
+
+static void CollectValues(const YAML::Node& root, YamlValues& values) {
+    std::list<std::pair<std::string, const YAML::Node> > all_nodes;
+    ListAllMember("", root, all_nodes);
+
+    for (auto& i : all_nodes) {
+        if (i.first.empty()) {
+            continue;
+        }
+        ConfigVarBase::ptr var = Config::LookupBase(i.first);
+        if (!var) {
+            continue;
+        }
+        if (i.second.IsScalar()) {
+            values[i.first] = std::make_pair(i.second.Scalar(), var);
+        } else {
+            std::stringstream ss;
+            ss << i.second;
+            values[i.first] = std::make_pair(ss.str(), var);
+        }
+    }
+}
+
 static std::map<std::string, uint64_t> s_file2modifytime;
+//file -> key -> yaml text applied from it
+static std::map<std::string, std::map<std::string, std::string> > s_file2values;
+static Config::ReloadStatus s_reload_status;
 static tao::Mutex s_mutex;
 
+//diffs under s_mutex, applies without it: listeners may yield or load config themselves
+static void LoadConfFile(const std::string& file, bool force) {
+    uint64_t start = tao::GetCurrentUS();
+    YamlValues values;
+    try {
+        CollectValues(YAML::LoadFile(file), values);
+    } catch (...) {
+        TAO_LOG_ERROR(g_logger) << "LoadConFile file="
+            << file << " failed";
+        return;
+    }
+
+    //key -> text and var to apply
+    std::map<std::string, std::pair<std::string, ConfigVarBase::ptr> > changes;
+    bool reload = false;
+    {
+        tao::Mutex::Lock lock(s_mutex);
+        reload = !force && s_file2values.count(file);
+        std::map<std::string, std::string>& applied = s_file2values[file];
+        for (auto& i : values) {
+            auto it = applied.find(i.first);
+            if (!force && it != applied.end() && it->second == i.second.first) {
+                continue;
+            }
+            changes[i.first] = i.second;
+        }
+    }
+
+    //keys whose text failed to apply, they are tried again on the next load
+    std::set<std::string> failed;
+    for (auto& i : changes) {
+        //setValue only calls the listeners when the value differs
+        if (!i.second.second->fromString(i.second.first)) {
+            failed.insert(i.first);
+        }
+    }
+
+    {
+        tao::Mutex::Lock lock(s_mutex);
+        //a key removed from the file keeps its value
+        std::map<std::string, std::string> texts;
+        for (auto& i : values) {
+            if (failed.count(i.first)) {
+                continue;
+            }
+            texts[i.first] = i.second.first;
+            if (reload && changes.count(i.first)) {
+                ++s_reload_status.key_changes[i.first];
+            }
+        }
+        s_file2values[file].swap(texts);
+    }
+
+    uint64_t used = tao::GetCurrentUS() - start;
+    if (reload) {
+        tao::Mutex::Lock lock(s_mutex);
+        ++s_reload_status.reloads;
+        s_reload_status.last_us = used;
+        s_reload_status.max_us = std::max(s_reload_status.max_us, used);
+        s_reload_status.total_us += used;
+    }
+    TAO_LOG_INFO(g_logger) << "LoadConfFile file="
+        << file << " ok, changed keys=" << changes.size() - failed.size()
+        << " failed keys=" << failed.size() << " used=" << used << "us";
+}
+
 void Config::LoadFromConfDir(const std::string &path, bool force)
 {
     std::string abs_path = tao::EnvMgr::GetInstance()->getAbsolutePath(path);
@@ -67,25 +177,131 @@ void Config::LoadFromConfDir(const std::string &path, bool force)
     FSUtil::ListAllFile(files, abs_path, ".yml");
 
     for (auto& i : files) {
+        struct stat st;
+        lstat(i.c_str(), &st);
         {
-            struct stat st;
-            lstat(i.c_str(), &st);
             tao::Mutex::Lock lock(s_mutex);
             if (!force && s_file2modifytime[i] == (uint64_t)st.st_mtime) {
                 continue;
             }
             s_file2modifytime[i] = st.st_mtime;
         }
-        try {
-            YAML::Node root = YAML::LoadFile(i);
-            LoadFromYaml(root);
-            TAO_LOG_INFO(g_logger) << "LoadConfFile file=" 
-                << i << " ok";
-        } catch (...) {
-            TAO_LOG_ERROR(g_logger) << "LoadConFile file="
-                << i << " failed";
+        LoadConfFile(i, force);
+    }
+}
+
+Config::ReloadStatus Config::GetReloadStatus() {
+    tao::Mutex::Lock lock(s_mutex);
+    return s_reload_status;
+}
+
+static tao::Mutex s_watch_mutex;
+static int s_watch_fd = -1;
+static IOManager* s_watch_iom = nullptr;
+//watch descriptor -> dir
+static std::map<int, std::string> s_watch_dirs;
+
+static void OnConfDirEvent(int fd) {
+    //every event queued since the last wakeup, a file written twice loads once
+    std::set<std::string> files;
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    while (true) {
+        ssize_t n = ::read(fd, buf, sizeof(buf));
+        if (n <= 0) {
+            break;
+        }
+        tao::Mutex::Lock lock(s_watch_mutex);
+        for (char* p = buf; p < buf + n;) {
+            struct inotify_event* ev = (struct inotify_event*)p;
+            p += sizeof(struct inotify_event) + ev->len;
+            auto it = s_watch_dirs.find(ev->wd);
+            std::string name = ev->len ? ev->name : "";
+            if (it == s_watch_dirs.end() || name.size() <= 4
+                    || name.compare(name.size() - 4, 4, ".yml")) {
+                continue;
+            }
+            files.insert(it->second + "/" + name);
+        }
+    }
+
+    for (auto& i : files) {
+        struct stat st;
+        if (lstat(i.c_str(), &st)) {
+            continue;
+        }
+        //not LoadFromConfDir, mtime has a second resolution and misses quick edits
+        {
+            tao::Mutex::Lock lock(s_mutex);
+            s_file2modifytime[i] = st.st_mtime;
+        }
+        LoadConfFile(i, false);
+    }
+
+    tao::Mutex::Lock lock(s_watch_mutex);
+    if (s_watch_fd != fd) {
+        ::close(fd);
+        return;
+    }
+    s_watch_iom->addEvent(fd, IOManager::READ, std::bind(&OnConfDirEvent, fd));
+}
+
+bool Config::WatchConfDir(const std::string& path, IOManager* iom) {
+    StopWatchConfDir();
+    std::string abs_path = tao::EnvMgr::GetInstance()->getAbsolutePath(path);
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        TAO_LOG_ERROR(g_logger) << "inotify_init1 errno=" << errno
+            << " errstr=" << strerror(errno);
+        return false;
+    }
+    //ListAllFile reads subdirs too, so the dirs holding a .yml are watched
+    std::vector<std::string> files;
+    FSUtil::ListAllFile(files, abs_path, ".yml");
+    std::set<std::string> dirs{abs_path};
+    for (auto& i : files) {
+        dirs.insert(FSUtil::Dirname(i));
+    }
+    std::map<int, std::string> wds;
+    for (auto& i : dirs) {
+        //editors that save by rename show up as IN_MOVED_TO
+        int wd = inotify_add_watch(fd, i.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+        if (wd < 0) {
+            TAO_LOG_ERROR(g_logger) << "inotify_add_watch dir=" << i << " errno=" << errno
+                << " errstr=" << strerror(errno);
+            ::close(fd);
+            return false;
+        }
+        wds[wd] = i;
+    }
+
+    tao::Mutex::Lock lock(s_watch_mutex);
+    s_watch_fd = fd;
+    s_watch_iom = iom;
+    s_watch_dirs.swap(wds);
+    //the event takes the scheduler it is added from
+    iom->schedule([fd, iom]() {
+        tao::Mutex::Lock lock(s_watch_mutex);
+        if (s_watch_fd != fd) {
+            ::close(fd);
+            return;
         }
+        iom->addEvent(fd, IOManager::READ, std::bind(&OnConfDirEvent, fd));
+    });
+    TAO_LOG_INFO(g_logger) << "WatchConfDir path=" << abs_path << " dirs=" << dirs.size();
+    return true;
+}
+
+void Config::StopWatchConfDir() {
+    tao::Mutex::Lock lock(s_watch_mutex);
+    if (s_watch_fd < 0) {
+        return;
     }
+    //the pending callback sees the change and closes the fd
+    int fd = s_watch_fd;
+    s_watch_fd = -1;
+    s_watch_dirs.clear();
+    s_watch_iom->cancelEvent(fd, IOManager::READ);
+    s_watch_iom = nullptr;
 }
 
 void Config::Visit(std::function<void(ConfigVarBase::ptr)> cb) {
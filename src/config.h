@@ -1,11 +1,13 @@
 #ifndef __TAO_CONFIG_H__
 #define __TAO_CONFIG_H__
 
+#include <atomic>
 #include <memory>
 #include <string>
 #include <sstream>
 #include <exception>
 #include <list>
+#include <map>
 #include <set>
 #include <unordered_set>
 #include <unordered_map>
@@ -18,6 +20,7 @@
 
 namespace tao {
 
+class IOManager;
 
 template<class SRC, class DEST>
 class Lexical_Cast {
@@ -224,7 +227,8 @@ public:
      * @param[in] description 配置参数描述
      */
     ConfigVarBase(const std::string& name, const std::string& description = "")
-        :m_name(name)
+        :m_id(NextId())
+        ,m_name(name)
         ,m_description(description) {
         std::transform(m_name.begin(), m_name.end(), m_name.begin(), ::tolower);
     }
@@ -239,6 +243,16 @@ public:
     virtual std::string getTypeName() const = 0;
 
 protected:
+    //the value a thread read last, kept until the version changes
+    struct ThreadSlot {
+        uint64_t version = 0;
+        std::shared_ptr<const void> value;
+    };
+    //slot of the calling thread for the var with id, ids are never reused
+    static ThreadSlot& GetThreadSlot(uint64_t id);
+    static uint64_t NextId();
+protected:
+    uint64_t m_id;
     std::string m_name;
     std::string m_description;
 };
@@ -256,39 +270,57 @@ public:
             ,const T& default_val
             ,const std::string& description = std::string())
         :ConfigVarBase(name, description)
-        ,m_val(default_val){
+        ,m_val(std::make_shared<const T>(default_val))
+        ,m_version(1) {
 
     }
 
     virtual ~ConfigVar() {}
 
     const T getValue() {
-        RWMutexType::ReadLock lock(m_mutex);
-        return m_val;
+        return getValueRef();
+    }
+
+    /**
+     * @brief the value without a lock or a copy
+     * each thread keeps the value it read last and only takes the lock after setValue
+     * changed it. the reference stays valid until the same thread reads this var again
+     */
+    const T& getValueRef() {
+        ThreadSlot& slot = GetThreadSlot(m_id);
+        if (slot.version != m_version.load(std::memory_order_acquire)) {
+            RWMutexType::ReadLock lock(m_mutex);
+            slot.value = m_val;
+            slot.version = m_version.load(std::memory_order_relaxed);
+        }
+        return *static_cast<const T*>(slot.value.get());
     }
 
     void setValue(const T & v) {
         {
             RWMutexType::ReadLock lock(m_mutex);
-            if (v == m_val) {
+            if (v == *m_val) {
             return;
             }
             for (auto& i : m_cbs) {
-                i.second(m_val, v);
+                i.second(*m_val, v);
             }
         }
+        //readers holding the old value keep it alive until they see the new version
+        std::shared_ptr<const T> val = std::make_shared<const T>(v);
         RWMutexType::WriteLock lock(m_mutex);
-        m_val = v;
+        m_val.swap(val);
+        m_version.fetch_add(1, std::memory_order_release);
     }
 
     std::string toString() override {
         try {
             //return boost::lexical_cast<std::string>(m_val);
             RWMutexType::ReadLock lock(m_mutex);
-            return ToStr()(m_val);
+            return ToStr()(*m_val);
         } catch (std::exception& e) {
             TAO_LOG_ERROR(TAO_LOG_ROOT()) << "ConfigVar::toString execption!"
-                << e.what() << " convert: string to " << typeid(m_val).name(); 
+                << e.what() << " convert: string to " << typeid(T).name(); 
         }
         return std::string();
     }
@@ -297,9 +329,10 @@ public:
         try {
             //m_val = boost::lexical_cast<T>(val);
             setValue(FromStr()(val));
+            return true;
         } catch (std::exception& e) {
             TAO_LOG_ERROR(TAO_LOG_ROOT()) << "ConfigVar::fromString exeception"
-                << e.what() << " convert: string to " << typeid(m_val).name();
+                << e.what() << " convert: string to " << typeid(T).name();
         }
         return false;
     }
@@ -327,7 +360,10 @@ public:
     }
 private:
     RWMutexType m_mutex;
-    T m_val;
+    //replaced as a whole by setValue, never modified in place
+    std::shared_ptr<const T> m_val;
+    //bumped after each m_val change, tells readers their copy is stale
+    std::atomic<uint64_t> m_version;
     //change call back. std::function has no operatpr==, so use map to wrap it
     std::map<uint64_t, on_change_cb> m_cbs;
 };
@@ -378,8 +414,31 @@ public:
     static void LoadFromYaml(const YAML::Node& root);
     static ConfigVarBase::ptr LookupBase(const std::string& name);
 
+    /**
+     * @brief loads the changed .yml files under path. a file loaded before only
+     * applies the keys whose yaml changed since, force reloads every file and key
+     */
     static void LoadFromConfDir(const std::string& path, bool force = false);
 
+    /**
+     * @brief reloads a .yml file under path on iom whenever it is written,
+     * only one dir is watched at a time
+     */
+    static bool WatchConfDir(const std::string& path, IOManager* iom);
+    static void StopWatchConfDir();
+
+    struct ReloadStatus {
+        //loads of a file after its first one
+        uint64_t reloads = 0;
+        //parse, diff and apply of a reload
+        uint64_t last_us = 0;
+        uint64_t max_us = 0;
+        uint64_t total_us = 0;
+        //key -> times a reload changed it
+        std::map<std::string, uint64_t> key_changes;
+    };
+    static ReloadStatus GetReloadStatus();
+
     //retrieve and modify all configvar
     static void Visit(std::function<void(ConfigVarBase::ptr)> cb);
 private:
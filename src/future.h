@@ -0,0 +1,189 @@
+#ifndef __TAO_FUTURE_H__
+#define __TAO_FUTURE_H__
+
+#include <memory>
+#include <functional>
+#include <vector>
+#include <list>
+#include <atomic>
+#include "mutex.h"
+#include "fiber.h"
+#include "scheduler.h"
+
+namespace tao {
+
+/**
+ * @brief value shared by a Promise and its Futures, set once.
+ * fibers waiting on it are held and scheduled back when the value is set,
+ * threads outside a scheduler block on a semaphore
+ */
+template<class T>
+class FutureState : Noncopyable {
+public:
+    using ptr = std::shared_ptr<FutureState>;
+    using MutexType = Mutex;
+    using Callback = std::function<void(const T&)>;
+
+    //false if the value was already set
+    bool set(const T& v) {
+        std::list<Waiter> waiters;
+        std::list<Callback> cbs;
+        {
+            MutexType::Lock lock(m_mutex);
+            if(m_ready) {
+                return false;
+            }
+            m_value = v;
+            m_ready = true;
+            waiters.swap(m_waiters);
+            cbs.swap(m_callbacks);
+        }
+        for(auto& i : waiters) {
+            if(i.scheduler) {
+                i.scheduler->schedule(i.fiber);
+            } else {
+                i.sem->notify();
+            }
+        }
+        for(auto& i : cbs) {
+            i(m_value);
+        }
+        return true;
+    }
+
+    bool isReady() {
+        MutexType::Lock lock(m_mutex);
+        return m_ready;
+    }
+
+    const T& wait() {
+        Semaphore sem;
+        Waiter waiter;
+        {
+            MutexType::Lock lock(m_mutex);
+            if(m_ready) {
+                return m_value;
+            }
+            waiter.scheduler = Scheduler::GetThis();
+            if(waiter.scheduler) {
+                waiter.fiber = Fiber::GetThis();
+            } else {
+                waiter.sem = &sem;
+            }
+            m_waiters.push_back(waiter);
+        }
+        if(waiter.scheduler) {
+            Fiber::YieldToHold();
+        } else {
+            sem.wait();
+        }
+        return m_value;
+    }
+
+    //cb runs in the thread setting the value, or right now if already set
+    void onReady(Callback cb) {
+        {
+            MutexType::Lock lock(m_mutex);
+            if(!m_ready) {
+                m_callbacks.push_back(std::move(cb));
+                return;
+            }
+        }
+        cb(m_value);
+    }
+private:
+    struct Waiter {
+        Scheduler* scheduler = nullptr;
+        Fiber::ptr fiber;
+        Semaphore* sem = nullptr;
+    };
+
+    MutexType m_mutex;
+    bool m_ready = false;
+    T m_value;
+    std::list<Waiter> m_waiters;
+    std::list<Callback> m_callbacks;
+};
+
+/**
+ * @brief read side of a Promise, cheap to copy
+ */
+template<class T>
+class Future {
+public:
+    Future() = default;
+    Future(typename FutureState<T>::ptr state)
+        :m_state(state) {
+    }
+
+    bool valid() const { return m_state != nullptr;}
+    bool isReady() const { return m_state->isReady();}
+
+    //wait until the value is set
+    const T& get() const { return m_state->wait();}
+
+    void then(typename FutureState<T>::Callback cb) const { m_state->onReady(std::move(cb));}
+private:
+    typename FutureState<T>::ptr m_state;
+};
+
+template<class T>
+class Promise {
+public:
+    Promise()
+        :m_state(std::make_shared<FutureState<T> >()) {
+    }
+
+    Future<T> getFuture() const { return Future<T>(m_state);}
+
+    //only the first value is kept, later ones return false
+    bool setValue(const T& v) const { return m_state->set(v);}
+    bool isSet() const { return m_state->isReady();}
+private:
+    typename FutureState<T>::ptr m_state;
+};
+
+/**
+ * @brief ready when all futures are, values keep the order of futures
+ */
+template<class T>
+Future<std::vector<T> > WhenAll(const std::vector<Future<T> >& futures) {
+    Promise<std::vector<T> > promise;
+    if(futures.empty()) {
+        promise.setValue(std::vector<T>());
+        return promise.getFuture();
+    }
+    auto values = std::make_shared<std::vector<T> >(futures.size());
+    auto left = std::make_shared<std::atomic<size_t> >(futures.size());
+    for(size_t i = 0; i < futures.size(); ++i) {
+        futures[i].then([promise, values, left, i](const T& v) {
+            (*values)[i] = v;
+            if(--*left == 0) {
+                promise.setValue(*values);
+            }
+        });
+    }
+    return promise.getFuture();
+}
+
+/**
+ * @brief ready with the index of the first ready future, -1 if futures is empty
+ */
+template<class T>
+Future<size_t> WhenAny(const std::vector<Future<T> >& futures) {
+    Promise<size_t> promise;
+    if(futures.empty()) {
+        promise.setValue((size_t)-1);
+        return promise.getFuture();
+    }
+    for(size_t i = 0; i < futures.size(); ++i) {
+        futures[i].then([promise, i](const T&) {
+            promise.setValue(i);
+        });
+    }
+    return promise.getFuture();
+}
+
+}
+
+#endif
@@ -181,11 +181,11 @@ unsigned int sleep(unsigned int seconds) {
 
 int usleep(useconds_t usec) {
     if (!tao::t_hook_enable) {
-        return usleep(usec);
+        return usleep_f(usec);
     }
     tao::Fiber::ptr fiber = tao::Fiber::GetThis();
     tao::IOManager* iom = tao::IOManager::GetThis();
-    iom->addTimer(usec * 1000, std::bind((void(tao::Scheduler::*)
+    iom->addTimer(usec / 1000, std::bind((void(tao::Scheduler::*)
             (tao::Fiber::ptr, int thread))&tao::IOManager::schedule
             ,iom, fiber, -1));
     tao::Fiber::YieldToHold();
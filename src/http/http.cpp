@@ -153,7 +153,7 @@ std::ostream &HttpRequest::dump(std::ostream &os) const
     os << HttpMethodToString(m_method) 
        << " " 
        << m_path
-       << (m_query.empty() ? "" : "#")
+       << (m_query.empty() ? "" : "?")
        << m_query
        << (m_fragment.empty() ? "" : "#")
        << m_fragment
@@ -0,0 +1,409 @@
+#include "http_compress.h"
+#include "http_parser.h"
+#include "../config.h"
+#include "../log.h"
+#include "../mutex.h"
+#include "../util.h"
+#include <algorithm>
+#include <list>
+#include <unordered_map>
+
+namespace tao {
+namespace http {
+
+static tao::Logger::ptr g_logger = TAO_LOG_NAME("system");
+
+static tao::ConfigVar<bool>::ptr g_http_compress_enable =
+    tao::Config::Lookup("http.compress.enable"
+                ,true, "http response compress enable");
+
+static tao::ConfigVar<uint64_t>::ptr g_http_compress_min_size =
+    tao::Config::Lookup("http.compress.min_size"
+                ,(uint64_t)1024, "http response min body size to compress");
+
+static tao::ConfigVar<int32_t>::ptr g_http_compress_level =
+    tao::Config::Lookup("http.compress.level"
+                ,(int32_t)6, "http response compress level, 1-9");
+
+static tao::ConfigVar<uint64_t>::ptr g_http_compress_cache_max_bytes =
+    tao::Config::Lookup("http.compress.cache_max_bytes"
+                ,(uint64_t)0, "bytes of precompressed static responses kept, 0 disable");
+
+static bool s_http_compress_enable = true;
+static uint64_t s_http_compress_min_size = 0;
+static int32_t s_http_compress_level = 0;
+static uint64_t s_http_compress_cache_max_bytes = 0;
+
+struct _CompressIniter {
+    _CompressIniter() {
+        s_http_compress_enable = g_http_compress_enable->getValue();
+        s_http_compress_min_size = g_http_compress_min_size->getValue();
+        s_http_compress_level = g_http_compress_level->getValue();
+        s_http_compress_cache_max_bytes = g_http_compress_cache_max_bytes->getValue();
+
+        g_http_compress_enable->addListener(
+                [](const bool& ov, const bool& nv){
+                s_http_compress_enable = nv;
+        });
+
+        g_http_compress_min_size->addListener(
+                [](const uint64_t& ov, const uint64_t& nv){
+                s_http_compress_min_size = nv;
+        });
+
+        g_http_compress_level->addListener(
+                [](const int32_t& ov, const int32_t& nv){
+                s_http_compress_level = nv;
+        });
+
+        g_http_compress_cache_max_bytes->addListener(
+                [](const uint64_t& ov, const uint64_t& nv){
+                s_http_compress_cache_max_bytes = nv;
+        });
+    }
+};
+
+static _CompressIniter _init;
+
+static const uint32_t s_zlib_buff_size = 16 * 1024;
+
+/**
+ * @brief compressed bodies of static responses(with ETag or Last-Modified)
+ * the original body is kept to verify a hit, keys are only hashes
+ */
+class PrecompressCache {
+public:
+    using MutexType = Mutex;
+
+    bool get(HttpCompress::Encoding e, const std::string& body, std::string& out) {
+        std::string key = makeKey(e, body);
+        MutexType::Lock lock(m_mutex);
+        auto it = m_datas.find(key);
+        if(it == m_datas.end() || it->second->body != body) {
+            return false;
+        }
+        m_lru.splice(m_lru.begin(), m_lru, it->second);
+        out = it->second->compressed;
+        return true;
+    }
+
+    void set(HttpCompress::Encoding e, const std::string& body, const std::string& compressed) {
+        uint64_t max_bytes = s_http_compress_cache_max_bytes;
+        uint64_t size = body.size() + compressed.size();
+        if(size > max_bytes / 4) {
+            return;
+        }
+        std::string key = makeKey(e, body);
+        MutexType::Lock lock(m_mutex);
+        auto it = m_datas.find(key);
+        if(it != m_datas.end()) {
+            m_bytes -= it->second->body.size() + it->second->compressed.size();
+            m_lru.erase(it->second);
+            m_datas.erase(it);
+        }
+        m_lru.push_front(Item{key, body, compressed});
+        m_datas[key] = m_lru.begin();
+        m_bytes += size;
+        while(m_bytes > max_bytes && !m_lru.empty()) {
+            Item& i = m_lru.back();
+            m_bytes -= i.body.size() + i.compressed.size();
+            m_datas.erase(i.key);
+            m_lru.pop_back();
+        }
+    }
+private:
+    static std::string makeKey(HttpCompress::Encoding e, const std::string& body) {
+        return std::to_string((int)e) + ":" + std::to_string(body.size())
+                + ":" + std::to_string(std::hash<std::string>()(body));
+    }
+private:
+    struct Item {
+        std::string key;
+        std::string body;
+        std::string compressed;
+    };
+    MutexType m_mutex;
+    std::list<Item> m_lru;
+    std::unordered_map<std::string, std::list<Item>::iterator> m_datas;
+    uint64_t m_bytes = 0;
+};
+
+static PrecompressCache& GetPrecompressCache() {
+    static PrecompressCache s_cache;
+    return s_cache;
+}
+
+//already compressed media gains nothing but cpu cost
+static bool IsCompressibleType(const std::string& type) {
+    if(type.empty()) {
+        return true;
+    }
+    if(strncasecmp(type.c_str(), "image/", 6) == 0) {
+        return strncasecmp(type.c_str(), "image/svg", 9) == 0;
+    }
+    if(strncasecmp(type.c_str(), "video/", 6) == 0
+            || strncasecmp(type.c_str(), "audio/", 6) == 0) {
+        return false;
+    }
+    std::string lower = type;
+    std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+    return lower.find("zip") == std::string::npos
+        && lower.find("compress") == std::string::npos
+        && lower.find("octet-stream") == std::string::npos;
+}
+
+static void AddVary(HttpResponse::ptr rsp) {
+    std::string vary = rsp->getHeader("vary");
+    if(vary.empty()) {
+        rsp->setHeader("Vary", "Accept-Encoding");
+        return;
+    }
+    std::string lower = vary;
+    std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+    if(lower.find("accept-encoding") != std::string::npos
+            || lower.find('*') != std::string::npos) {
+        return;
+    }
+    rsp->setHeader("Vary", vary + ", Accept-Encoding");
+}
+
+const char* HttpCompress::EncodingToString(Encoding e) {
+    switch(e) {
+        case Encoding::GZIP:
+            return "gzip";
+        case Encoding::DEFLATE:
+            return "deflate";
+        default:
+            return "identity";
+    }
+}
+
+bool HttpCompress::StringToEncoding(const std::string& str, Encoding& e) {
+    if(strcasecmp(str.c_str(), "gzip") == 0
+            || strcasecmp(str.c_str(), "x-gzip") == 0) {
+        e = Encoding::GZIP;
+    } else if(strcasecmp(str.c_str(), "deflate") == 0) {
+        e = Encoding::DEFLATE;
+    } else if(strcasecmp(str.c_str(), "identity") == 0) {
+        e = Encoding::IDENTITY;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+HttpCompress::Encoding HttpCompress::Negotiate(const std::string& accept_encoding) {
+    double gzip = -1;
+    double deflate = -1;
+    double any = -1;
+    size_t pos = 0;
+    while(pos < accept_encoding.size()) {
+        size_t end = accept_encoding.find(',', pos);
+        if(end == std::string::npos) {
+            end = accept_encoding.size();
+        }
+        std::string item = accept_encoding.substr(pos, end - pos);
+        pos = end + 1;
+
+        double q = 1;
+        size_t semi = item.find(';');
+        if(semi != std::string::npos) {
+            std::string param = tao::StringUtil::Trim(item.substr(semi + 1));
+            if(param.size() > 2 && (param[0] == 'q' || param[0] == 'Q') && param[1] == '=') {
+                q = tao::TypeUtil::Atof(param.substr(2));
+            }
+            item.resize(semi);
+        }
+        item = tao::StringUtil::Trim(item);
+        Encoding e;
+        if(item == "*") {
+            any = q;
+        } else if(StringToEncoding(item, e)) {
+            if(e == Encoding::GZIP) {
+                gzip = q;
+            } else if(e == Encoding::DEFLATE) {
+                deflate = q;
+            }
+        }
+    }
+    if(gzip < 0) {
+        gzip = any;
+    }
+    if(deflate < 0) {
+        deflate = any;
+    }
+    if(gzip <= 0 && deflate <= 0) {
+        return Encoding::IDENTITY;
+    }
+    return gzip >= deflate ? Encoding::GZIP : Encoding::DEFLATE;
+}
+
+ZlibStream::ptr HttpCompress::GetStream(Encoding e, bool encode, int level) {
+    //compress runs without yielding, so one stream per thread and kind is enough
+    static thread_local ZlibStream::ptr t_streams[3][2];
+    ZlibStream::ptr& s = t_streams[(int)e][encode];
+    if(s && (!encode || s->getLevel() == level)) {
+        if(s->reset() == Z_OK) {
+            return s;
+        }
+    }
+    //"deflate" content coding is the zlib format(rfc7230 4.2.2)
+    s = ZlibStream::Create(encode, s_zlib_buff_size
+                ,e == Encoding::GZIP ? ZlibStream::GZIP : ZlibStream::ZLIB
+                ,level);
+    return s;
+}
+
+bool HttpCompress::Compress(Encoding e, const std::string& in, std::string& out, int level) {
+    if(e == Encoding::IDENTITY) {
+        out = in;
+        return true;
+    }
+    if(level < 0) {
+        level = s_http_compress_level;
+    }
+    if(level < 1 || level > 9) {
+        level = ZlibStream::DEFAULT_COMPRESSION;
+    }
+    ZlibStream::ptr s = GetStream(e, true, level);
+    if(!s) {
+        return false;
+    }
+    if(s->write(in.c_str(), in.size()) != Z_OK
+            || s->flush() != Z_OK) {
+        s->reset();
+        return false;
+    }
+    out = s->getResult();
+    s->reset();
+    return true;
+}
+
+static int DoDecompress(ZlibStream::ptr s, const std::string& in, std::string& out, uint64_t max_size) {
+    //feed by chunk so a small bomb body can not inflate far beyond max_size
+    static const size_t s_chunk = 4096;
+    for(size_t pos = 0; pos < in.size(); pos += s_chunk) {
+        if(s->write(in.c_str() + pos, std::min(s_chunk, in.size() - pos)) != Z_OK) {
+            return -1;
+        }
+        uint64_t total = 0;
+        for(auto& i : s->getBuffers()) {
+            total += i.iov_len;
+        }
+        if(total > max_size) {
+            return -2;
+        }
+    }
+    if(s->flush() != Z_OK) {
+        return -1;
+    }
+    out = s->getResult();
+    return out.size() <= max_size ? 0 : -2;
+}
+
+int HttpCompress::Decompress(Encoding e, const std::string& in, std::string& out, uint64_t max_size) {
+    if(e == Encoding::IDENTITY) {
+        out = in;
+        return out.size() <= max_size ? 0 : -2;
+    }
+    ZlibStream::ptr s = GetStream(e, false, ZlibStream::DEFAULT_COMPRESSION);
+    if(!s) {
+        return -1;
+    }
+    int rt = DoDecompress(s, in, out, max_size);
+    s->reset();
+    if(rt == -1 && e == Encoding::DEFLATE) {
+        //some clients send raw deflate data without zlib header
+        s = ZlibStream::CreateDeflate(false, s_zlib_buff_size);
+        rt = s ? DoDecompress(s, in, out, max_size) : -1;
+    }
+    return rt;
+}
+
+bool HttpCompress::IsEnabled() {
+    return s_http_compress_enable;
+}
+
+bool HttpCompress::CompressResponse(HttpRequest::ptr req, HttpResponse::ptr rsp) {
+    if(!s_http_compress_enable || rsp->isWebsocket()) {
+        return false;
+    }
+    const std::string& body = rsp->getBody();
+    if(body.size() < s_http_compress_min_size) {
+        return false;
+    }
+    HttpStatus status = rsp->getStatus();
+    if((int)status < 200 || status == HttpStatus::NO_CONTENT
+            || status == HttpStatus::PARTIAL_CONTENT
+            || status == HttpStatus::NOT_MODIFIED) {
+        return false;
+    }
+    if(!rsp->getHeader("content-encoding").empty()
+            || !IsCompressibleType(rsp->getHeader("content-type"))) {
+        return false;
+    }
+    AddVary(rsp);
+
+    Encoding e = Negotiate(req->getHeader("accept-encoding"));
+    if(e == Encoding::IDENTITY) {
+        return false;
+    }
+
+    std::string out;
+    bool cache = s_http_compress_cache_max_bytes > 0
+                && (!rsp->getHeader("etag").empty()
+                    || !rsp->getHeader("last-modified").empty());
+    if(!cache || !GetPrecompressCache().get(e, body, out)) {
+        if(!Compress(e, body, out)) {
+            TAO_LOG_WARN(g_logger) << "compress response fail, encoding="
+                << EncodingToString(e) << " size=" << body.size();
+            return false;
+        }
+        if(cache) {
+            GetPrecompressCache().set(e, body, out);
+        }
+    }
+    if(out.size() >= body.size()) {
+        return false;
+    }
+
+    std::string etag = rsp->getHeader("etag");
+    if(!etag.empty() && etag.compare(0, 2, "W/") != 0) {
+        //body is no longer byte-identical to the strong validator
+        rsp->setHeader("ETag", "W/" + etag);
+    }
+    rsp->setHeader("Content-Encoding", EncodingToString(e));
+    rsp->setBody(out);
+    return true;
+}
+
+bool HttpCompress::DecompressRequest(HttpRequest::ptr req, HttpResponse::ptr rsp) {
+    std::string ce = tao::StringUtil::Trim(req->getHeader("content-encoding"));
+    if(ce.empty()) {
+        return true;
+    }
+    Encoding e;
+    if(!StringToEncoding(ce, e)) {
+        rsp->setStatus(HttpStatus::UNSUPPORTED_MEDIA_TYPE);
+        rsp->setHeader("Accept-Encoding", "gzip, deflate");
+        return false;
+    }
+    std::string out;
+    uint64_t max_size = HttpRequestParser::GetHttpRequestMaxBodySize();
+    int rt = Decompress(e, req->getBody(), out, max_size);
+    if(rt != 0) {
+        TAO_LOG_DEBUG(g_logger) << "decompress request body fail, rt=" << rt
+            << " encoding=" << ce << " size=" << req->getBody().size();
+        rsp->setStatus(rt == -2 ? HttpStatus::PAYLOAD_TOO_LARGE : HttpStatus::BAD_REQUEST);
+        return false;
+    }
+    req->delHeader("content-encoding");
+    if(req->hasHeader("content-length")) {
+        req->setHeader("content-length", std::to_string(out.size()));
+    }
+    req->setBody(out);
+    return true;
+}
+
+}
+}
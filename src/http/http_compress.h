@@ -0,0 +1,66 @@
+#ifndef __TAO_HTTP_COMPRESS_H__
+#define __TAO_HTTP_COMPRESS_H__
+
+#include "http.h"
+#include "../streams/zlib_stream.h"
+
+namespace tao {
+namespace http {
+
+/**
+ * @brief Content-Encoding support of http server
+ * zlib streams are kept per thread and reset between bodies,
+ * since initializing a deflate state costs far more than compressing a small body
+ */
+class HttpCompress {
+public:
+    enum class Encoding {
+        IDENTITY,
+        GZIP,
+        DEFLATE,
+    };
+
+    static const char* EncodingToString(Encoding e);
+    //gzip, x-gzip, deflate, identity; others return false
+    static bool StringToEncoding(const std::string& str, Encoding& e);
+
+    /**
+     * @brief choose encoding from Accept-Encoding by q-values, gzip preferred on ties
+     */
+    static Encoding Negotiate(const std::string& accept_encoding);
+
+    /**
+     * @brief compress data with the thread local stream
+     * @param[in] level compress level, -1 uses http.compress.level
+     */
+    static bool Compress(Encoding e, const std::string& in, std::string& out, int level = -1);
+
+    /**
+     * @brief decompress data with the thread local stream
+     * @param[in] max_size fail when output exceeds this size
+     * @return 0 success, -1 corrupted data, -2 output exceeds max_size
+     */
+    static int Decompress(Encoding e, const std::string& in, std::string& out, uint64_t max_size);
+
+    /**
+     * @brief compress response body according to request Accept-Encoding
+     * @return whether the body was replaced by compressed one
+     */
+    static bool CompressResponse(HttpRequest::ptr req, HttpResponse::ptr rsp);
+
+    /**
+     * @brief decode request body by Content-Encoding
+     * @return false on unsupported or corrupted body, error status is set into rsp
+     */
+    static bool DecompressRequest(HttpRequest::ptr req, HttpResponse::ptr rsp);
+
+    static bool IsEnabled();
+private:
+    //thread local stream of given encoding, reset and ready for use
+    static ZlibStream::ptr GetStream(Encoding e, bool encode, int level);
+};
+
+}
+}
+
+#endif
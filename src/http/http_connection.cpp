@@ -2,12 +2,47 @@
 #include "http_parser.h"
 #include "../log.h"
 #include "../util.h"
+#include "../hook.h"
+#include "../config.h"
+#include "servlets/status_servlet.h"
+#include "../future.h"
+#include <algorithm>
+#include <thread>
+#include <sys/socket.h>
 
 namespace tao {
 namespace http {
 
 static tao::Logger::ptr g_logger = TAO_LOG_NAME("system");
 
+static tao::ConfigVar<uint32_t>::ptr g_pool_max_size =
+    tao::Config::Lookup("http.pool.max_size", (uint32_t)64, "http connection pool max connections per host");
+static tao::ConfigVar<uint32_t>::ptr g_pool_max_alive_time =
+    tao::Config::Lookup("http.pool.max_alive_time", (uint32_t)(120 * 1000), "http connection pool max alive time(ms)");
+static tao::ConfigVar<uint32_t>::ptr g_pool_max_request =
+    tao::Config::Lookup("http.pool.max_request", (uint32_t)1000, "http connection pool max requests per connection");
+static tao::ConfigVar<uint32_t>::ptr g_pool_max_idle_time =
+    tao::Config::Lookup("http.pool.max_idle_time", (uint32_t)(30 * 1000), "http connection pool max idle time(ms)");
+static tao::ConfigVar<uint32_t>::ptr g_pool_max_connecting =
+    tao::Config::Lookup("http.pool.max_connecting", (uint32_t)8, "http connection pool max concurrent connects per host");
+static tao::ConfigVar<uint32_t>::ptr g_pool_wait_timeout =
+    tao::Config::Lookup("http.pool.wait_timeout", (uint32_t)3000, "http connection pool max wait time for a connection(ms)");
+static tao::ConfigVar<uint32_t>::ptr g_pool_max_retries =
+    tao::Config::Lookup("http.pool.max_retries", (uint32_t)0, "http connection pool retries of failed idempotent requests");
+static tao::ConfigVar<double>::ptr g_pool_hedge_percentile =
+    tao::Config::Lookup("http.pool.hedge_percentile", (double)0, "http connection pool latency percentile to send a hedged request, 0 disables");
+static tao::ConfigVar<uint32_t>::ptr g_pool_hedge_min_delay =
+    tao::Config::Lookup("http.pool.hedge_min_delay", (uint32_t)10, "http connection pool min delay before a hedged request(ms)");
+static tao::ConfigVar<double>::ptr g_pool_retry_budget_ratio =
+    tao::Config::Lookup("http.pool.retry_budget_ratio", (double)0.1, "http connection pool retry tokens earned per request");
+static tao::ConfigVar<uint32_t>::ptr g_pool_retry_budget_min =
+    tao::Config::Lookup("http.pool.retry_budget_min_per_sec", (uint32_t)10, "http connection pool retry tokens refilled per second");
+
+//latency samples kept for the hedge percentile
+static const size_t s_latency_samples = 256;
+//fewer samples than this hedge after min delay only
+static const size_t s_latency_min_samples = 20;
+
 std::string HttpResult::toString() const
 {
     std::stringstream ss;
@@ -18,6 +53,59 @@ std::string HttpResult::toString() const
     return ss.str();
 }
 
+void HttpCancelToken::cancel()
+{
+    std::vector<std::weak_ptr<HttpCancelToken> > children;
+    {
+        MutexType::Lock lock(m_mutex);
+        m_cancelled = true;
+        children.swap(m_children);
+        if(m_sock) {
+            //reads and writes fail from now on, the fd stays valid until its owner closes it
+            ::shutdown(m_sock->getSocket(), SHUT_RDWR);
+            if(IOManager::GetThis()) {
+                m_sock->cancelAll();
+            }
+            m_sock = nullptr;
+        }
+    }
+    for(auto& i : children) {
+        auto child = i.lock();
+        if(child) {
+            child->cancel();
+        }
+    }
+}
+
+bool HttpCancelToken::addChild(HttpCancelToken::ptr child)
+{
+    {
+        MutexType::Lock lock(m_mutex);
+        if(!m_cancelled) {
+            m_children.push_back(child);
+            return true;
+        }
+    }
+    child->cancel();
+    return false;
+}
+
+bool HttpCancelToken::bind(Socket::ptr sock)
+{
+    MutexType::Lock lock(m_mutex);
+    if(m_cancelled) {
+        return false;
+    }
+    m_sock = sock;
+    return true;
+}
+
+void HttpCancelToken::unbind()
+{
+    MutexType::Lock lock(m_mutex);
+    m_sock = nullptr;
+}
+
 HttpConnection::HttpConnection(Socket::ptr sock, bool owner)
     :SocketStream(sock, owner) {
 
@@ -87,18 +175,25 @@ HttpResult::ptr HttpConnection::DoRequest(HttpMethod method
                                             , Uri::ptr uri
                                             , uint64_t timeout_ms
                                             , const std::map<std::string, std::string> &headers, const std::string &body)
+{
+    return DoRequest(CreateRequest(method, uri, headers, body), uri, timeout_ms);
+}
+
+HttpRequest::ptr HttpConnection::CreateRequest(HttpMethod method
+                                            , Uri::ptr uri
+                                            , const std::map<std::string, std::string> &headers
+                                            , const std::string &body)
 {
     HttpRequest::ptr req = std::make_shared<HttpRequest>();
     req->setMethod(method);
     req->setPath(uri->getPath());
     req->setQuery(uri->getQuery());
     req->setFragment(uri->getFragment());
+    req->setClose(false);
     bool has_host = false;
     for (auto& i : headers) {
         if (strcasecmp(i.first.c_str(), "connection") == 0) {
-            if (strcasecmp(i.second.c_str(), "keep-alive") == 0) {
-                req->setClose(false);
-            }
+            req->setClose(strcasecmp(i.second.c_str(), "close") == 0);
             continue;
         }
         if (!has_host && strcasecmp(i.first.c_str(), "host") == 0) {
@@ -111,53 +206,83 @@ HttpResult::ptr HttpConnection::DoRequest(HttpMethod method
         req->setHeader("host", uri->getHost());
     }
     req->setBody(body);
-    return DoRequest(req, uri, timeout_ms);
+    return req;
 }
 
 HttpResult::ptr HttpConnection::DoRequest(HttpRequest::ptr req
                                             , Uri::ptr uri
-                                            , uint64_t timeout_ms)
+                                            , uint64_t timeout_ms
+                                            , HttpCancelToken::ptr cancel)
 {
-    //get addr from uri
-    Address::ptr addr = uri->createAddress();
-    if (!addr) {
+    if(uri->getHost().empty()) {
         return std::make_shared<HttpResult>((int)HttpResult::Error::INVALID_HOST
-                , nullptr, "invalid host: " + uri->getHost()); 
+                , nullptr, "invalid host: " + uri->getHost());
     }
-    //create socket
-    Socket::ptr sock = Socket::CreateTCP(addr);
-    if(!sock) {
-        return std::make_shared<HttpResult>((int)HttpResult::Error::CREATE_SOCKET_ERROR
-                , nullptr, "create socket fail: " + addr->toString()
-                        + " errno=" + std::to_string(errno)
-                        + " errstr=" + std::string(strerror(errno)));
-    }
-    //connect
-    if(!sock->connect(addr)) {
-        return std::make_shared<HttpResult>((int)HttpResult::Error::CONNECT_FAIL
-                , nullptr, "connect fail: " + addr->toString());
-    }
-    //send req
-    sock->setRecvTimeout(timeout_ms);
-    HttpConnection::ptr conn = std::make_shared<HttpConnection>(sock);
-    int rt = conn->sendRequest(req);
-    if(rt == 0) {
-        return std::make_shared<HttpResult>((int)HttpResult::Error::SEND_CLOSE_BY_PEER
-                , nullptr, "send request closed by peer: " + addr->toString());
+    //keep-alive connections are shared process wide
+    return HttpConnectionPoolMgr::GetInstance()->get(uri->getHost(), uri->getPort())
+                ->doRequest(req, timeout_ms, cancel);
+}
+
+HttpResult::ptr HttpConnection::DoRequestStream(HttpRequest::ptr req
+                                            , Uri::ptr uri
+                                            , uint64_t timeout_ms)
+{
+    if(uri->getHost().empty()) {
+        return std::make_shared<HttpResult>((int)HttpResult::Error::INVALID_HOST
+                , nullptr, "invalid host: " + uri->getHost());
     }
-    if(rt < 0) {
-        return std::make_shared<HttpResult>((int)HttpResult::Error::SEND_SOCKET_ERROR
-                    , nullptr, "send request socket error errno=" + std::to_string(errno)
-                    + " errstr=" + std::string(strerror(errno)));
+    return HttpConnectionPoolMgr::GetInstance()->get(uri->getHost(), uri->getPort())
+                ->doRequestStream(req, timeout_ms);
+}
+
+bool HttpConnection::IsKeepAlive(HttpResponse::ptr rsp)
+{
+    std::string conn = rsp->getHeader("connection");
+    if(!conn.empty()) {
+        return strcasecmp(conn.c_str(), "keep-alive") == 0;
     }
-    //handle response
-    auto rsp = conn->recvResponse();
-    if(!rsp) {
-        return std::make_shared<HttpResult>((int)HttpResult::Error::TIMEOUT
-                    , nullptr, "recv response timeout: " + addr->toString()
-                    + " timeout_ms:" + std::to_string(timeout_ms));
+    return rsp->getVersion() >= 0x11;
+}
+
+HttpResponse::ptr HttpConnection::recvResponseHeader(std::string& body
+                                            , int64_t& content_length, bool& chunked)
+{
+    HttpResponseParser::ptr parser = std::make_shared<HttpResponseParser>();
+    uint64_t buff_size = HttpRequestParser::GetHttpRequestBufferSize();
+    std::string buffer;
+    buffer.resize(buff_size + 1);
+    char* data = &buffer[0];
+    int offset = 0;
+    do {
+        int len = read(data + offset, buff_size - offset);
+        if(len <= 0) {
+            close();
+            return nullptr;
+        }
+        len += offset;
+        data[len] = '\0';
+        size_t nparse = parser->execute(data, len, false);
+        if(parser->hasError()) {
+            close();
+            return nullptr;
+        }
+        offset = len - nparse;
+        if(offset == (int)buff_size) {
+            close();
+            return nullptr;
+        }
+    } while(!parser->isFinished());
+    body.assign(data, offset);
+    chunked = parser->getParser().chunked;
+    auto rsp = parser->getData();
+    if(chunked) {
+        content_length = 0;
+    } else if(rsp->getHeader("content-length").empty()) {
+        content_length = -1;
+    } else {
+        content_length = parser->getContentLength();
     }
-    return std::make_shared<HttpResult>((int)HttpResult::Error::OK, rsp, "ok");
+    return rsp;
 }
 
 HttpResponse::ptr HttpConnection::recvResponse()
@@ -298,100 +423,616 @@ int HttpConnection::sendRequest(HttpRequest::ptr req)
     //std::cout << ss.str() << std::endl;
     return writeFixSize(data.c_str(), data.size());
 }
-HttpConnectionPool::HttpConnectionPool(const std::string &host, const std::string &vhost, uint32_t port, uint32_t max_size, uint32_t max_alive_time, uint32_t max_request)
+HttpBodyStream::HttpBodyStream(HttpConnection::ptr conn, const std::string& buffered
+                                , int64_t content_length, bool chunked, bool keep_alive)
+    :m_conn(conn)
+    ,m_buf(buffered)
+    ,m_pos(0)
+    ,m_chunked(chunked)
+    ,m_keepAlive(keep_alive && (chunked || content_length >= 0))
+    ,m_state(chunked ? State::SIZE : State::DATA)
+    ,m_left(chunked ? 0 : content_length) {
+    if(!m_chunked && m_left == 0) {
+        finish(m_keepAlive && m_buf.empty());
+    }
+}
+
+HttpBodyStream::~HttpBodyStream()
+{
+    if(m_conn) {
+        //rest of body is still on the wire, the connection can not be reused
+        m_conn->close();
+    }
+}
+
+bool HttpBodyStream::close()
+{
+    if(m_conn) {
+        m_conn->close();
+        m_conn.reset();
+    }
+    m_state = State::DONE;
+    return true;
+}
+
+void HttpBodyStream::finish(bool reuse)
+{
+    m_state = State::DONE;
+    if(!m_conn) {
+        return;
+    }
+    //bytes beyond the body mean a broken peer
+    if(!reuse || m_pos != m_buf.size()) {
+        m_conn->close();
+    }
+    //back to pool
+    m_conn.reset();
+}
+
+int HttpBodyStream::fill()
+{
+    if(!m_conn) {
+        return -1;
+    }
+    m_buf.resize(HttpResponseParser::GetHttpResponseBufferSize());
+    m_pos = 0;
+    int rt = m_conn->read(&m_buf[0], m_buf.size());
+    m_buf.resize(rt > 0 ? rt : 0);
+    return rt;
+}
+
+bool HttpBodyStream::readLine(std::string& line)
+{
+    line.clear();
+    while(true) {
+        if(m_pos >= m_buf.size() && fill() <= 0) {
+            return false;
+        }
+        size_t pos = m_buf.find('\n', m_pos);
+        if(pos == std::string::npos) {
+            line.append(m_buf, m_pos, std::string::npos);
+            m_pos = m_buf.size();
+        } else {
+            line.append(m_buf, m_pos, pos - m_pos);
+            m_pos = pos + 1;
+            break;
+        }
+        if(line.size() > 4096) {
+            return false;
+        }
+    }
+    if(!line.empty() && line.back() == '\r') {
+        line.pop_back();
+    }
+    return true;
+}
+
+int HttpBodyStream::read(void* buffer, size_t length)
+{
+    std::string line;
+    while(true) {
+        switch(m_state) {
+            case State::DONE:
+                return 0;
+            case State::SIZE: {
+                if(!readLine(line)) {
+                    close();
+                    return -1;
+                }
+                char* end = nullptr;
+                uint64_t size = strtoull(line.c_str(), &end, 16);
+                if(end == line.c_str() || (*end && *end != ';' && *end != ' ')) {
+                    TAO_LOG_WARN(g_logger) << "invalid chunk size line: " << line;
+                    close();
+                    return -1;
+                }
+                m_left = size;
+                m_state = size ? State::DATA : State::TRAILER;
+                break;
+            }
+            case State::DATA_END:
+                if(!readLine(line) || !line.empty()) {
+                    close();
+                    return -1;
+                }
+                m_state = State::SIZE;
+                break;
+            case State::TRAILER:
+                if(!readLine(line)) {
+                    close();
+                    return -1;
+                }
+                if(line.empty()) {
+                    finish(m_keepAlive);
+                    return 0;
+                }
+                break;
+            case State::DATA: {
+                if(m_pos >= m_buf.size()) {
+                    int rt = fill();
+                    if(rt == 0 && m_left < 0) {
+                        finish(false);
+                        return 0;
+                    }
+                    if(rt <= 0) {
+                        close();
+                        return -1;
+                    }
+                }
+                size_t n = std::min(length, m_buf.size() - m_pos);
+                if(m_left >= 0) {
+                    n = std::min(n, (size_t)m_left);
+                    m_left -= n;
+                }
+                memcpy(buffer, &m_buf[m_pos], n);
+                m_pos += n;
+                if(m_left == 0) {
+                    if(m_chunked) {
+                        m_state = State::DATA_END;
+                    } else {
+                        finish(m_keepAlive);
+                    }
+                }
+                return n;
+            }
+        }
+    }
+}
+
+int HttpBodyStream::read(ByteArray::ptr ba, size_t length)
+{
+    std::string buf;
+    buf.resize(length);
+    int rt = read(&buf[0], length);
+    if(rt > 0) {
+        ba->write(buf.c_str(), rt);
+    }
+    return rt;
+}
+
+bool HttpBodyStream::readAll(std::string& out, size_t max_size)
+{
+    char buf[16 * 1024];
+    while(true) {
+        int rt = read(buf, sizeof(buf));
+        if(rt == 0) {
+            return true;
+        }
+        if(rt < 0 || out.size() + rt > max_size) {
+            close();
+            return false;
+        }
+        out.append(buf, rt);
+    }
+}
+
+std::string HttpConnectionPool::Stats::toString() const
+{
+    std::stringstream ss;
+    ss << "[Stats total=" << total
+       << " idle=" << idle
+       << " connecting=" << connecting
+       << " waiting=" << waiting
+       << " gets=" << gets
+       << " reuses=" << reuses
+       << " reuse_ratio=" << (gets ? (double)reuses / gets : 0)
+       << " creates=" << creates
+       << " connect_fails=" << connect_fails
+       << " waits=" << waits
+       << " wait_timeouts=" << wait_timeouts
+       << " avg_wait_us=" << (waits ? wait_us / waits : 0)
+       << " evicts=" << evicts
+       << " retries=" << retries
+       << " hedges=" << hedges
+       << " hedge_wins=" << hedge_wins
+       << " budget_exhausted=" << budget_exhausted
+       << " latency_p95=" << latency_p95
+       << "]";
+    return ss.str();
+}
+
+HttpConnectionPool::HttpConnectionPool(const std::string &host, const std::string &vhost, uint32_t port
+                                        , uint32_t max_size, uint32_t max_alive_time, uint32_t max_request
+                                        , uint32_t max_idle_time, uint32_t max_connecting, uint32_t wait_timeout)
     :m_host(host)
     ,m_vhost(vhost)
     ,m_port(port)
     ,m_maxSize(max_size)
     ,m_maxAliveTime(max_alive_time)
-    ,m_maxRequest(max_request) {
+    ,m_maxRequest(max_request)
+    ,m_maxIdleTime(max_idle_time)
+    ,m_maxConnecting(max_connecting ? max_connecting : 1)
+    ,m_waitTimeout(wait_timeout)
+    ,m_retryBudget(std::make_shared<RetryBudget>()) {
+    size_t count = std::min(std::max(std::thread::hardware_concurrency(), 1u), 16u);
+    for(size_t i = 0; i < count; ++i) {
+        m_shards.emplace_back(new Shard);
+    }
 }
-HttpConnection::ptr HttpConnectionPool::createConnection()
+
+HttpConnectionPool::~HttpConnectionPool()
 {
-    HttpConnection* ptr = nullptr;
-    IPAddress::ptr addr = Address::LookupAnyIPAddress(m_host);
-    if (!addr) {
-        TAO_LOG_ERROR(g_logger) << "get addr fail: " << m_host;
-        return nullptr;
+    MutexType::Lock lock(m_mutex);
+    if(m_timer) {
+        m_timer->cancel();
     }
-    addr->setPort(m_port);
-    Socket::ptr sock = Socket::CreateTCP(addr);
-    if (!sock) {
-        TAO_LOG_ERROR(g_logger) << "create sock fail: " << *addr;
-        return nullptr;
+    lock.unlock();
+    for(auto& i : m_shards) {
+        for(auto c : i->conns) {
+            delete c;
+        }
     }
-    if(!sock->connect(addr)) {
-        TAO_LOG_ERROR(g_logger) << "sock connect fail: " << *addr;
-        return nullptr;
-    } 
-    ptr = new HttpConnection(sock);
-    ptr->m_createTime = tao::GetCurrentMS();
-    ++m_total;
-    return HttpConnection::ptr(ptr, std::bind(&HttpConnectionPool::ReleasePtr
-                                    , std::placeholders::_1, this));
 }
-HttpConnection::ptr HttpConnectionPool::getConnection()
+
+void HttpConnectionPool::startEvictTimer()
 {
-    uint64_t now = tao::GetCurrentMS();
-    std::vector<HttpConnection*> invalid_conns;
-    HttpConnection* ptr = nullptr;
+    //one shot, re-armed while idle connections remain so an idle pool keeps no timer
+    if(!m_maxIdleTime || m_timerArmed.exchange(true)) {
+        return;
+    }
+    IOManager* iom = IOManager::GetThis();
+    //a pool not owned by a shared_ptr evicts on getConnection only
+    std::weak_ptr<HttpConnectionPool> weak = weak_from_this();
+    if(!iom || weak.expired()) {
+        m_timerArmed = false;
+        return;
+    }
+    uint64_t interval = std::min(std::max(m_maxIdleTime / 2, 100u), 5000u);
     MutexType::Lock lock(m_mutex);
-    while (!m_conns.empty()) {
-        auto conn = *m_conns.begin();
-        m_conns.pop_front();
-        if (!conn->isConnected()) {
-            invalid_conns.push_back(conn);
-            continue;
+    //the timer may fire while the pool is destroyed on another thread
+    m_timer = iom->addTimer(interval, [weak]() {
+        HttpConnectionPool::ptr self = weak.lock();
+        if(!self) {
+            return;
         }
-        if (conn->m_createTime + m_maxAliveTime > now) {
-            invalid_conns.push_back(conn);
-            continue;
+        self->evictIdle();
+        {
+            //a fired timer may outlive its IOManager, never keep it
+            MutexType::Lock lock(self->m_mutex);
+            self->m_timer.reset();
         }
-        ptr = conn;
-        break;
-    }
-    lock.unlock();
-    for (auto i : invalid_conns) {
-        delete i;
+        self->m_timerArmed = false;
+        if(self->m_idle) {
+            self->startEvictTimer();
+        }
+    });
+}
+
+HttpConnection::ptr HttpConnectionPool::wrap(HttpConnection* conn)
+{
+    return HttpConnection::ptr(conn, std::bind(&HttpConnectionPool::ReleasePtr
+                                    , std::placeholders::_1, this));
+}
+
+bool HttpConnectionPool::tryReserve()
+{
+    uint32_t total = m_total;
+    do {
+        if(total >= m_maxSize) {
+            return false;
+        }
+    } while(!m_total.compare_exchange_weak(total, total + 1));
+    if(m_connecting.fetch_add(1) >= m_maxConnecting) {
+        --m_connecting;
+        --m_total;
+        return false;
     }
-    m_total -= invalid_conns.size();
-    if (!ptr) {//if no connection, create new connection
+    return true;
+}
+
+HttpConnection* HttpConnectionPool::connect(uint64_t timeout_ms)
+{
+    HttpConnection* ptr = nullptr;
+    do {
         IPAddress::ptr addr = Address::LookupAnyIPAddress(m_host);
         if (!addr) {
             TAO_LOG_ERROR(g_logger) << "get addr fail: " << m_host;
-            return nullptr;
+            break;
         }
         addr->setPort(m_port);
         Socket::ptr sock = Socket::CreateTCP(addr);
         if (!sock) {
             TAO_LOG_ERROR(g_logger) << "create sock fail: " << *addr;
-            return nullptr;
+            break;
         }
-        if(!sock->connect(addr)) {
+        if(!sock->connect(addr, timeout_ms)) {
             TAO_LOG_ERROR(g_logger) << "sock connect fail: " << *addr;
-            return nullptr;
-        } 
+            break;
+        }
         ptr = new HttpConnection(sock);
         ptr->m_createTime = tao::GetCurrentMS();
+    } while(false);
+
+    --m_connecting;
+    if(ptr) {
+        ++m_creates;
+    } else {
+        ++m_connectFails;
+        --m_total;
+    }
+    if(m_waiting) {
+        notifyWaiters();
+    }
+    return ptr;
+}
+
+HttpConnection::ptr HttpConnectionPool::createConnection()
+{
+    ++m_total;
+    ++m_connecting;
+    HttpConnection* ptr = connect(m_waitTimeout);
+    return ptr ? wrap(ptr) : nullptr;
+}
+
+bool HttpConnectionPool::isExpired(HttpConnection* conn, uint64_t now) const
+{
+    return !conn->isConnected()
+        || (m_maxAliveTime && conn->m_createTime + m_maxAliveTime <= now)
+        || (m_maxRequest && conn->m_request >= m_maxRequest)
+        || (m_maxIdleTime && conn->m_lastActive + m_maxIdleTime <= now);
+}
+
+//peer closed or sent something unexpected while the connection was idle
+static bool IsBroken(HttpConnection* conn)
+{
+    char c;
+    int rt = recv_f(conn->getSocket()->getSocket(), &c, 1, MSG_PEEK | MSG_DONTWAIT);
+    return rt >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK);
+}
+
+HttpConnection* HttpConnectionPool::popIdle(std::vector<HttpConnection*>& stale)
+{
+    uint64_t now = tao::GetCurrentMS();
+    size_t idx = tao::GetThreadId() % m_shards.size();
+    for(size_t n = 0; n < m_shards.size(); ++n) {
+        Shard& shard = *m_shards[(idx + n) % m_shards.size()];
+        MutexType::Lock lock(shard.mutex);
+        while(!shard.conns.empty()) {
+            //most recently used first, it is least likely closed by peer
+            HttpConnection* conn = shard.conns.back();
+            shard.conns.pop_back();
+            --m_idle;
+            if(isExpired(conn, now)) {
+                stale.push_back(conn);
+                continue;
+            }
+            return conn;
+        }
+    }
+    return nullptr;
+}
+
+void HttpConnectionPool::pushIdle(HttpConnection* conn)
+{
+    Shard& shard = *m_shards[tao::GetThreadId() % m_shards.size()];
+    MutexType::Lock lock(shard.mutex);
+    shard.conns.push_back(conn);
+    ++m_idle;
+    lock.unlock();
+    startEvictTimer();
+}
+
+void HttpConnectionPool::destroy(HttpConnection* conn)
+{
+    delete conn;
+    ++m_evicts;
+    --m_total;
+    if(m_waiting) {
+        notifyWaiters();
+    }
+}
+
+void HttpConnectionPool::notifyWaiters()
+{
+    std::vector<HttpConnection*> stale;
+    {
+        MutexType::Lock lock(m_mutex);
+        while(!m_waiters.empty()) {
+            HttpConnection* conn = popIdle(stale);
+            if(!conn && !tryReserve()) {
+                break;
+            }
+            Waiter::ptr w = m_waiters.front();
+            m_waiters.pop_front();
+            --m_waiting;
+            w->conn = conn;
+            w->permit = !conn;
+            w->done = true;
+            w->scheduler->schedule(w->fiber);
+        }
+    }
+    for(auto i : stale) {
+        destroy(i);
+    }
+}
+
+HttpConnection::ptr HttpConnectionPool::getConnection()
+{
+    return getConnection(m_waitTimeout);
+}
+
+HttpConnection::ptr HttpConnectionPool::getConnection(uint64_t wait_timeout_ms)
+{
+    ++m_gets;
+    uint64_t start = tao::GetCurrentMS();
+    while(true) {
+        bool permit = false;
+        uint64_t used = tao::GetCurrentMS() - start;
+        uint64_t wait = wait_timeout_ms == ~0ull ? ~0ull
+                            : (used < wait_timeout_ms ? wait_timeout_ms - used : 0);
+        HttpConnection* ptr = acquire(wait, permit);
+        if(ptr) {
+            //probed here, outside the shard and waiter locks
+            if(IsBroken(ptr)) {
+                destroy(ptr);
+                continue;
+            }
+            ++m_reuses;
+            return wrap(ptr);
+        }
+        if(!permit) {
+            return nullptr;
+        }
+        //the connect gets what is left of the wait too
+        used = tao::GetCurrentMS() - start;
+        uint64_t connect_timeout = m_waitTimeout;
+        if(wait_timeout_ms != ~0ull) {
+            connect_timeout = std::min<uint64_t>(connect_timeout
+                        , used < wait_timeout_ms ? wait_timeout_ms - used : 1);
+        }
+        ptr = connect(connect_timeout);
+        return ptr ? wrap(ptr) : nullptr;
+    }
+}
+
+HttpConnection* HttpConnectionPool::acquire(uint64_t wait_timeout_ms, bool& permit)
+{
+    std::vector<HttpConnection*> stale;
+    HttpConnection* ptr = popIdle(stale);
+    for(auto i : stale) {
+        destroy(i);
+    }
+    if(ptr) {
+        return ptr;
+    }
+    if(tryReserve()) {
+        permit = true;
+        return nullptr;
+    }
+
+    if(!Scheduler::GetThis()) {
+        //no fiber to park, fall back to a connection beyond the limits
         ++m_total;
+        ++m_connecting;
+        permit = true;
+        return nullptr;
     }
-    return HttpConnection::ptr(ptr, std::bind(&HttpConnectionPool::ReleasePtr
-                                    , std::placeholders::_1, this));
+
+    //queue up, m_waiting is raised before checking again so a release can not be missed
+    uint64_t begin = tao::GetCurrentUS();
+    Waiter::ptr waiter = std::make_shared<Waiter>();
+    stale.clear();
+    {
+        MutexType::Lock lock(m_mutex);
+        ++m_waiting;
+        ptr = popIdle(stale);
+        if(!ptr) {
+            permit = tryReserve();
+        }
+        if(ptr || permit) {
+            --m_waiting;
+        } else {
+            waiter->scheduler = Scheduler::GetThis();
+            waiter->fiber = Fiber::GetThis();
+            m_waiters.push_back(waiter);
+        }
+    }
+    for(auto i : stale) {
+        destroy(i);
+    }
+
+    if(!ptr && !permit) {
+        ++m_waits;
+        Timer::ptr timer;
+        IOManager* iom = IOManager::GetThis();
+        if(iom && wait_timeout_ms != ~0ull) {
+            std::weak_ptr<Waiter> weak(waiter);
+            timer = iom->addTimer(wait_timeout_ms, [this, weak]() {
+                Waiter::ptr w = weak.lock();
+                if(!w) {
+                    return;
+                }
+                MutexType::Lock lock(m_mutex);
+                if(w->done) {
+                    return;
+                }
+                w->done = true;
+                m_waiters.remove(w);
+                --m_waiting;
+                w->scheduler->schedule(w->fiber);
+            });
+        }
+        Fiber::YieldToHold();
+        if(timer) {
+            timer->cancel();
+        }
+        m_waitUs += tao::GetCurrentUS() - begin;
+        ptr = waiter->conn;
+        permit = waiter->permit;
+        if(!ptr && !permit) {
+            ++m_waitTimeouts;
+            TAO_LOG_WARN(g_logger) << "wait connection timeout host=" << m_host
+                << ":" << m_port << " timeout_ms=" << wait_timeout_ms;
+        }
+    }
+    return ptr;
 }
 
 void HttpConnectionPool::ReleasePtr(HttpConnection *ptr, HttpConnectionPool *pool)
 {
     ++ptr->m_request;
-    if (!ptr->isConnected() 
-        || ptr->m_createTime + pool->m_maxAliveTime >= tao::GetCurrentMS()
-        || ptr->m_request >= pool->m_maxRequest) {
-        delete ptr;
-        --pool->m_total;
+    ptr->m_lastActive = tao::GetCurrentMS();
+    if (pool->isExpired(ptr, ptr->m_lastActive)) {
+        pool->destroy(ptr);
         return;
     }
     //if new connection is still valid, push into connection pool
-    MutexType::Lock lock(pool->m_mutex);
-    pool->m_conns.push_back(ptr);
+    pool->pushIdle(ptr);
+    if(pool->m_waiting) {
+        pool->notifyWaiters();
+    }
+}
+
+void HttpConnectionPool::evictIdle()
+{
+    uint64_t now = tao::GetCurrentMS();
+    std::vector<HttpConnection*> stale;
+    for(auto& i : m_shards) {
+        //probed outside the lock, the healthy ones go back behind those pushed meanwhile
+        std::list<HttpConnection*> conns;
+        {
+            MutexType::Lock lock(i->mutex);
+            conns.swap(i->conns);
+            m_idle -= conns.size();
+        }
+        for(auto it = conns.begin(); it != conns.end();) {
+            if(isExpired(*it, now) || IsBroken(*it)) {
+                stale.push_back(*it);
+                it = conns.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        MutexType::Lock lock(i->mutex);
+        m_idle += conns.size();
+        i->conns.splice(i->conns.begin(), conns);
+    }
+    for(auto i : stale) {
+        destroy(i);
+    }
+}
+
+HttpConnectionPool::Stats HttpConnectionPool::getStats() const
+{
+    Stats s;
+    s.gets = m_gets;
+    s.reuses = m_reuses;
+    s.creates = m_creates;
+    s.connect_fails = m_connectFails;
+    s.waits = m_waits;
+    s.wait_timeouts = m_waitTimeouts;
+    s.wait_us = m_waitUs;
+    s.evicts = m_evicts;
+    s.total = m_total;
+    s.idle = m_idle;
+    s.connecting = m_connecting;
+    s.waiting = m_waiting;
+    s.retries = m_retries;
+    s.hedges = m_hedges;
+    s.hedge_wins = m_hedgeWins;
+    s.budget_exhausted = m_budgetExhausted;
+    s.latency_p95 = getLatencyPercentile(0.95);
+    return s;
 }
 
 HttpResult::ptr HttpConnectionPool::doGet(const std::string &url
@@ -483,10 +1124,34 @@ HttpResult::ptr HttpConnectionPool::doRequest(HttpMethod method
        << uri->getFragment();
     return doRequest(method, ss.str(), timeout_ms, headers, body);
 }
-HttpResult::ptr HttpConnectionPool::doRequest(HttpRequest::ptr req
-                                                , uint64_t timeout_ms)
+static HttpResult::ptr Cancelled(const std::string& host, uint32_t port)
+{
+    return std::make_shared<HttpResult>((int)HttpResult::Error::CANCELLED
+            , nullptr, "request cancelled host:" + host + " port:" + std::to_string(port));
+}
+
+static HttpResult::ptr TimedOut(const std::string& host, uint32_t port, uint64_t timeout_ms)
 {
-    auto conn = getConnection();
+    return std::make_shared<HttpResult>((int)HttpResult::Error::TIMEOUT
+            , nullptr, "no time left to send host:" + host + " port:" + std::to_string(port)
+            + " timeout_ms:" + std::to_string(timeout_ms));
+}
+
+HttpResult::ptr HttpConnectionPool::sendRequest(HttpRequest::ptr req
+                                                , uint64_t timeout_ms
+                                                , HttpConnection::ptr& conn
+                                                , HttpCancelToken::ptr cancel)
+{
+    if(cancel && cancel->isCancelled()) {
+        return Cancelled(m_host, m_port);
+    }
+    //timeout_ms covers waiting for a connection and connecting too
+    uint64_t start = tao::GetCurrentMS();
+    auto remaining = [start, timeout_ms]() {
+        uint64_t used = tao::GetCurrentMS() - start;
+        return used < timeout_ms ? timeout_ms - used : 0;
+    };
+    conn = getConnection(std::min<uint64_t>(m_waitTimeout, timeout_ms));
     if(!conn) {
         return std::make_shared<HttpResult>((int)HttpResult::Error::POOL_GET_CONNECTION
                 , nullptr, "pool host:" + m_host + " port:" + std::to_string(m_port));
@@ -496,8 +1161,36 @@ HttpResult::ptr HttpConnectionPool::doRequest(HttpRequest::ptr req
         return std::make_shared<HttpResult>((int)HttpResult::Error::POOL_INVALID_CONNECTION
                 , nullptr, "pool host:" + m_host + " port:" + std::to_string(m_port));
     }
-    sock->setRecvTimeout(timeout_ms);
+    if(cancel && !cancel->bind(sock)) {
+        return Cancelled(m_host, m_port);
+    }
+    if(!remaining()) {
+        return TimedOut(m_host, m_port, timeout_ms);
+    }
+    sock->setRecvTimeout(remaining());
     int rt = conn->sendRequest(req);
+    if(rt <= 0 && conn->m_request > 0 && !(cancel && cancel->isCancelled())) {
+        //idle connection closed by peer after the health check, try once more
+        conn->close();
+        conn = getConnection(std::min<uint64_t>(m_waitTimeout, remaining()));
+        if(!conn) {
+            return std::make_shared<HttpResult>((int)HttpResult::Error::POOL_GET_CONNECTION
+                    , nullptr, "pool host:" + m_host + " port:" + std::to_string(m_port));
+        }
+        sock = conn->getSocket();
+        if(cancel && !cancel->bind(sock)) {
+            return Cancelled(m_host, m_port);
+        }
+        if(!remaining()) {
+            return TimedOut(m_host, m_port, timeout_ms);
+        }
+        sock->setRecvTimeout(remaining());
+        rt = conn->sendRequest(req);
+    }
+    if(rt <= 0 && cancel && cancel->isCancelled()) {
+        conn->close();
+        return Cancelled(m_host, m_port);
+    }
     if(rt == 0) {
         return std::make_shared<HttpResult>((int)HttpResult::Error::SEND_CLOSE_BY_PEER
                 , nullptr, "send request closed by peer: " + sock->getRemoteAddress()->toString());
@@ -507,16 +1200,364 @@ HttpResult::ptr HttpConnectionPool::doRequest(HttpRequest::ptr req
                     , nullptr, "send request socket error errno=" + std::to_string(errno)
                     + " errstr=" + std::string(strerror(errno)));
     }
+    return nullptr;
+}
+
+HttpResult::ptr HttpConnectionPool::doRequestOnce(HttpRequest::ptr req
+                                                , uint64_t timeout_ms
+                                                , HttpCancelToken::ptr cancel)
+{
+    uint64_t start = tao::GetCurrentMS();
+    HttpConnection::ptr conn;
+    auto result = sendRequest(req, timeout_ms, conn, cancel);
+    if(result) {
+        if(cancel) {
+            cancel->unbind();
+        }
+        return result;
+    }
     auto rsp = conn->recvResponse();
+    if(cancel) {
+        cancel->unbind();
+        if(cancel->isCancelled()) {
+            //the socket may be shut down already, never hand it back
+            conn->close();
+            return Cancelled(m_host, m_port);
+        }
+    }
     if(!rsp) {
         return std::make_shared<HttpResult>((int)HttpResult::Error::TIMEOUT
-                    , nullptr, "recv response timeout: " + sock->getRemoteAddress()->toString()
+                    , nullptr, "recv response timeout: " + m_host + ":" + std::to_string(m_port)
                     + " timeout_ms:" + std::to_string(timeout_ms));
     }
+    if(req->isClose() || !HttpConnection::IsKeepAlive(rsp)) {
+        conn->close();
+    }
+    addLatency(tao::GetCurrentMS() - start);
     return std::make_shared<HttpResult>((int)HttpResult::Error::OK, rsp, "ok");
 }
 
+//failures where the request may not have been processed
+static bool IsRetryable(HttpResult::ptr rt)
+{
+    switch((HttpResult::Error)rt->result) {
+        case HttpResult::Error::CONNECT_FAIL:
+        case HttpResult::Error::SEND_CLOSE_BY_PEER:
+        case HttpResult::Error::SEND_SOCKET_ERROR:
+        case HttpResult::Error::TIMEOUT:
+        case HttpResult::Error::POOL_INVALID_CONNECTION:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool HttpConnectionPool::IsIdempotent(HttpRequest::ptr req)
+{
+    switch(req->getMethod()) {
+        case HttpMethod::GET:
+        case HttpMethod::HEAD:
+        case HttpMethod::OPTIONS:
+        case HttpMethod::TRACE:
+        case HttpMethod::PUT:
+        case HttpMethod::DELETE:
+            return true;
+        default:
+            return req->hasHeader("Idempotency-Key");
+    }
+}
+
+HttpResult::ptr HttpConnectionPool::doRequest(HttpRequest::ptr req
+                                                , uint64_t timeout_ms
+                                                , HttpCancelToken::ptr cancel)
+{
+    RetryBudget::ptr budget = m_retryBudget;
+    if(budget) {
+        budget->deposit();
+    }
+    bool idempotent = IsIdempotent(req);
+    //hedging needs a fiber to wait in and a timer to fire
+    bool hedge = idempotent && m_hedgePercentile > 0 && budget && IOManager::GetThis();
+    HttpResult::ptr rt;
+    for(uint32_t i = 0; ; ++i) {
+        if(hedge) {
+            uint64_t delay = std::max(getLatencyPercentile(m_hedgePercentile), m_hedgeMinDelay);
+            rt = doRequestHedged(req, timeout_ms, cancel, delay);
+        } else {
+            rt = doRequestOnce(req, timeout_ms, cancel);
+        }
+        if(i >= m_maxRetries || !idempotent || !IsRetryable(rt)
+                || (cancel && cancel->isCancelled())) {
+            break;
+        }
+        if(!budget || !budget->tryWithdraw()) {
+            ++m_budgetExhausted;
+            break;
+        }
+        ++m_retries;
+    }
+    return rt;
+}
+
+struct HttpConnectionPool::Hedge {
+    MutexType mutex;
+    Promise<HttpResult::ptr> promise;
+    std::vector<HttpCancelToken::ptr> tokens;
+    int running = 0;
+    //caller got its result, no more attempts
+    bool done = false;
+};
+
+void HttpConnectionPool::startAttempt(std::shared_ptr<Hedge> hedge, HttpRequest::ptr req
+                                    , uint64_t timeout_ms, HttpCancelToken::ptr cancel, bool is_hedge)
+{
+    HttpCancelToken::ptr token = std::make_shared<HttpCancelToken>();
+    {
+        MutexType::Lock lock(hedge->mutex);
+        if(hedge->done) {
+            return;
+        }
+        hedge->tokens.push_back(token);
+        ++hedge->running;
+    }
+    if(cancel) {
+        cancel->addChild(token);
+    }
+    HttpConnectionPool::ptr self = shared_from_this();
+    IOManager::GetThis()->schedule([self, hedge, token, req, timeout_ms, is_hedge]() {
+        auto rt = self->doRequestOnce(req, timeout_ms, token);
+        bool finish = true;
+        if(rt->result != 0) {
+            //an error only wins when no other attempt can still succeed
+            MutexType::Lock lock(hedge->mutex);
+            finish = --hedge->running == 0;
+        } else {
+            MutexType::Lock lock(hedge->mutex);
+            --hedge->running;
+        }
+        if(finish && hedge->promise.setValue(rt) && is_hedge && rt->result == 0) {
+            ++self->m_hedgeWins;
+        }
+    });
+}
+
+HttpResult::ptr HttpConnectionPool::doRequestHedged(HttpRequest::ptr req
+                                                , uint64_t timeout_ms
+                                                , HttpCancelToken::ptr cancel
+                                                , uint64_t delay_ms)
+{
+    auto hedge = std::make_shared<Hedge>();
+    startAttempt(hedge, req, timeout_ms, cancel, false);
+
+    HttpConnectionPool::ptr self = shared_from_this();
+    Timer::ptr timer = IOManager::GetThis()->addTimer(delay_ms
+            , [self, hedge, req, timeout_ms, cancel]() {
+        if(hedge->promise.isSet() || (cancel && cancel->isCancelled())) {
+            return;
+        }
+        if(!self->m_retryBudget->tryWithdraw()) {
+            ++self->m_budgetExhausted;
+            return;
+        }
+        ++self->m_hedges;
+        self->startAttempt(hedge, req, timeout_ms, cancel, true);
+    });
+
+    HttpResult::ptr rt = hedge->promise.getFuture().get();
+    timer->cancel();
+    //the slower attempt gives up its connection
+    std::vector<HttpCancelToken::ptr> tokens;
+    {
+        MutexType::Lock lock(hedge->mutex);
+        hedge->done = true;
+        tokens = hedge->tokens;
+    }
+    for(auto& i : tokens) {
+        i->cancel();
+    }
+    return rt;
+}
+
+void HttpConnectionPool::setHedge(double percentile, uint32_t min_delay_ms)
+{
+    m_hedgePercentile = percentile;
+    m_hedgeMinDelay = min_delay_ms;
+}
+
+void HttpConnectionPool::addLatency(uint32_t ms)
+{
+    SpinLock::Lock lock(m_latencyMutex);
+    if(m_latencies.size() < s_latency_samples) {
+        m_latencies.push_back(ms);
+    } else {
+        m_latencies[m_latencyPos] = ms;
+        m_latencyPos = (m_latencyPos + 1) % s_latency_samples;
+    }
+}
 
+uint32_t HttpConnectionPool::getLatencyPercentile(double p) const
+{
+    std::vector<uint32_t> samples;
+    {
+        SpinLock::Lock lock(m_latencyMutex);
+        if(m_latencies.size() < s_latency_min_samples) {
+            return 0;
+        }
+        samples = m_latencies;
+    }
+    size_t n = std::min((size_t)(p * samples.size()), samples.size() - 1);
+    std::nth_element(samples.begin(), samples.begin() + n, samples.end());
+    return samples[n];
+}
+
+RetryBudget::RetryBudget(double ratio, uint32_t min_per_sec, uint32_t max_tokens)
+    :m_ratio(ratio)
+    ,m_minPerSec(min_per_sec)
+    ,m_maxTokens(max_tokens)
+    ,m_tokens(std::min(min_per_sec, max_tokens))
+    ,m_lastRefill(tao::GetCurrentMS()) {
+}
+
+void RetryBudget::refill(uint64_t now)
+{
+    //time based refill is computed lazily, an idle pool needs no timer
+    if(now > m_lastRefill) {
+        m_tokens = std::min((double)m_maxTokens
+                        , m_tokens + (now - m_lastRefill) * m_minPerSec / 1000.0);
+        m_lastRefill = now;
+    }
+}
+
+void RetryBudget::deposit()
+{
+    MutexType::Lock lock(m_mutex);
+    refill(tao::GetCurrentMS());
+    m_tokens = std::min((double)m_maxTokens, m_tokens + m_ratio);
+}
+
+bool RetryBudget::tryWithdraw()
+{
+    MutexType::Lock lock(m_mutex);
+    refill(tao::GetCurrentMS());
+    if(m_tokens < 1) {
+        return false;
+    }
+    m_tokens -= 1;
+    return true;
+}
+
+double RetryBudget::getTokens()
+{
+    MutexType::Lock lock(m_mutex);
+    refill(tao::GetCurrentMS());
+    return m_tokens;
+}
+
+HttpResult::ptr HttpConnectionPool::doRequestStream(HttpRequest::ptr req
+                                                , uint64_t timeout_ms)
+{
+    HttpConnection::ptr conn;
+    auto result = sendRequest(req, timeout_ms, conn);
+    if(result) {
+        return result;
+    }
+    std::string buffered;
+    int64_t content_length = 0;
+    bool chunked = false;
+    auto rsp = conn->recvResponseHeader(buffered, content_length, chunked);
+    if(!rsp) {
+        return std::make_shared<HttpResult>((int)HttpResult::Error::TIMEOUT
+                    , nullptr, "recv response timeout: " + m_host + ":" + std::to_string(m_port)
+                    + " timeout_ms:" + std::to_string(timeout_ms));
+    }
+    uint32_t status = (uint32_t)rsp->getStatus();
+    if(req->getMethod() == HttpMethod::HEAD || status / 100 == 1
+            || status == 204 || status == 304) {
+        content_length = 0;
+        chunked = false;
+    }
+    bool keep_alive = !req->isClose() && HttpConnection::IsKeepAlive(rsp);
+    result = std::make_shared<HttpResult>((int)HttpResult::Error::OK, rsp, "ok");
+    result->body = std::make_shared<HttpBodyStream>(conn, buffered, content_length
+                        , chunked, keep_alive);
+    return result;
+}
+
+HttpConnectionPoolManager::HttpConnectionPoolManager()
+{
+    StatusServlet::AddStatus("http_pool", [this](std::ostream& os) {
+        os << toString();
+    });
+}
+
+HttpConnectionPool::ptr HttpConnectionPoolManager::get(const std::string& host, uint32_t port
+                                                        , const std::string& vhost)
+{
+    std::string key = host + ":" + std::to_string(port);
+    {
+        RWMutexType::ReadLock lock(m_mutex);
+        auto it = m_pools.find(key);
+        if(it != m_pools.end()) {
+            return it->second;
+        }
+    }
+    RWMutexType::WriteLock lock(m_mutex);
+    auto& pool = m_pools[key];
+    if(!pool) {
+        pool = std::make_shared<HttpConnectionPool>(host, vhost, port
+                    , g_pool_max_size->getValue()
+                    , g_pool_max_alive_time->getValue()
+                    , g_pool_max_request->getValue()
+                    , g_pool_max_idle_time->getValue()
+                    , g_pool_max_connecting->getValue()
+                    , g_pool_wait_timeout->getValue());
+        pool->setMaxRetries(g_pool_max_retries->getValue());
+        pool->setHedge(g_pool_hedge_percentile->getValue(), g_pool_hedge_min_delay->getValue());
+        pool->setRetryBudget(std::make_shared<RetryBudget>(g_pool_retry_budget_ratio->getValue()
+                    , g_pool_retry_budget_min->getValue()));
+    }
+    return pool;
+}
+
+HttpResult::ptr HttpConnectionPoolManager::doGet(const std::string& url
+                                                , uint64_t timeout_ms
+                                                , const std::map<std::string, std::string>& headers
+                                                , const std::string& body)
+{
+    return doRequest(HttpMethod::GET, url, timeout_ms, headers, body);
+}
+
+HttpResult::ptr HttpConnectionPoolManager::doPost(const std::string& url
+                                                , uint64_t timeout_ms
+                                                , const std::map<std::string, std::string>& headers
+                                                , const std::string& body)
+{
+    return doRequest(HttpMethod::POST, url, timeout_ms, headers, body);
+}
+
+HttpResult::ptr HttpConnectionPoolManager::doRequest(HttpMethod method
+                                                , const std::string& url
+                                                , uint64_t timeout_ms
+                                                , const std::map<std::string, std::string>& headers
+                                                , const std::string& body)
+{
+    Uri::ptr uri = Uri::Create(url);
+    if(!uri || uri->getHost().empty()) {
+        return std::make_shared<HttpResult>((int)HttpResult::Error::INVALID_URL
+                , nullptr, "invalid url: " + url);
+    }
+    return get(uri->getHost(), uri->getPort())->doRequest(method, uri, timeout_ms, headers, body);
+}
+
+std::string HttpConnectionPoolManager::toString()
+{
+    std::stringstream ss;
+    RWMutexType::ReadLock lock(m_mutex);
+    for(auto& i : m_pools) {
+        ss << i.first << " " << i.second->getStats().toString() << std::endl;
+    }
+    return ss.str();
+}
 
 }
 }
\ No newline at end of file
@@ -4,12 +4,19 @@
 #include "../streams/socket_stream.h"
 #include "uri.h"
 #include "http.h"
+#include "../mutex.h"
+#include "../singleton.h"
+#include "../iomanager.h"
 #include <memory>
 #include <list>
+#include <atomic>
+#include <unordered_map>
 
 namespace tao {
 namespace http {
 
+class HttpBodyStream;
+
 struct HttpResult {
     using ptr = std::shared_ptr<HttpResult>;
 
@@ -41,7 +48,10 @@ struct HttpResult {
         POOL_GET_CONNECTION = 8,
 
         //invalide connection
-        POOL_INVALID_CONNECTION = 9
+        POOL_INVALID_CONNECTION = 9,
+
+        //cancelled by HttpCancelToken
+        CANCELLED = 10
     };
 
     HttpResult(int _res, HttpResponse::ptr _rsp, const std::string& _err) 
@@ -56,6 +66,32 @@ struct HttpResult {
     int result;
     HttpResponse::ptr response;
     std::string error;
+    //body of a streamed response, response itself has headers only
+    std::shared_ptr<HttpBodyStream> body;
+};
+
+/**
+ * @brief cancels a pooled request running in another fiber.
+ * the socket of the request is shut down so its blocking io fails at once
+ */
+class HttpCancelToken {
+public:
+    using ptr = std::shared_ptr<HttpCancelToken>;
+    using MutexType = Mutex;
+
+    void cancel();
+    bool isCancelled() const { return m_cancelled;}
+
+    //socket of the running request, false if already cancelled
+    bool bind(Socket::ptr sock);
+    void unbind();
+    //child is cancelled along with this token, false if already cancelled
+    bool addChild(HttpCancelToken::ptr child);
+private:
+    MutexType m_mutex;
+    Socket::ptr m_sock;
+    std::vector<std::weak_ptr<HttpCancelToken> > m_children;
+    std::atomic<bool> m_cancelled = {false};
 };
 
 class HttpConnectionPool;
@@ -101,42 +137,227 @@ public:
                                         , const std::string& body = std::string());
 
     static HttpResult::ptr DoRequest(HttpRequest::ptr req
+                            , Uri::ptr uri
+                            , uint64_t timeout_ms
+                            , HttpCancelToken::ptr cancel = nullptr);
+
+    //keep-alive request for uri, a "connection" header decides close
+    static HttpRequest::ptr CreateRequest(HttpMethod method
+                            , Uri::ptr uri
+                            , const std::map<std::string, std::string>& headers = {}
+                            , const std::string& body = std::string());
+
+    /**
+     * @brief send request and return once response headers arrive,
+     * the body is pulled from HttpResult::body
+     */
+    static HttpResult::ptr DoRequestStream(HttpRequest::ptr req
                             , Uri::ptr uri
                             , uint64_t timeout_ms);
 
+    //whether the connection may be reused after rsp
+    static bool IsKeepAlive(HttpResponse::ptr rsp);
 
     HttpResponse::ptr recvResponse();
+
+    /**
+     * @brief receive status line and headers only
+     * @param[out] body body bytes read together with the headers
+     * @param[out] content_length -1 if the body ends when peer closes
+     * @param[out] chunked body is chunked
+     */
+    HttpResponse::ptr recvResponseHeader(std::string& body, int64_t& content_length, bool& chunked);
     int sendRequest(HttpRequest::ptr req);
 private:
     uint64_t m_createTime = 0;
+    //last time returned to pool
+    uint64_t m_lastActive = 0;
     uint64_t m_request = 0;
 };
 
-class HttpConnectionPool {
+/**
+ * @brief response body read from a connection, content-length or chunked.
+ * a fully read keep-alive connection goes back to its pool, an unfinished
+ * one is closed
+ */
+class HttpBodyStream : public Stream {
+public:
+    using ptr = std::shared_ptr<HttpBodyStream>;
+
+    /**
+     * @param[in] buffered body bytes already read with the headers
+     * @param[in] content_length -1 reads until peer closes
+     * @param[in] keep_alive connection is reusable after the body
+     */
+    HttpBodyStream(HttpConnection::ptr conn, const std::string& buffered
+                    , int64_t content_length, bool chunked, bool keep_alive);
+    ~HttpBodyStream();
+
+    //return 0 at end of body
+    virtual int read(void* buffer, size_t length) override;
+    virtual int read(ByteArray::ptr ba, size_t length) override;
+    virtual int write(const void* buffer, size_t length) override { return -1;}
+    virtual int write(ByteArray::ptr ba, size_t length) override { return -1;}
+    virtual bool close() override;
+
+    //read the rest of body, false on error or body larger than max_size
+    bool readAll(std::string& out, size_t max_size = ~0ull);
+
+    bool isFinished() const { return m_state == State::DONE;}
+private:
+    enum class State {
+        SIZE,
+        DATA,
+        DATA_END,
+        TRAILER,
+        DONE,
+    };
+    int fill();
+    bool readLine(std::string& line);
+    void finish(bool reuse);
+private:
+    HttpConnection::ptr m_conn;
+    std::string m_buf;
+    size_t m_pos;
+    bool m_chunked;
+    bool m_keepAlive;
+    State m_state;
+    //left bytes of body or current chunk, -1 until close
+    int64_t m_left;
+};
+
+/**
+ * @brief token bucket limiting retries and hedged requests to a fraction of
+ * the traffic, so they cannot amplify an outage
+ */
+class RetryBudget {
+public:
+    using ptr = std::shared_ptr<RetryBudget>;
+    using MutexType = SpinLock;
+
+    /**
+     * @param[in] ratio tokens earned by each request, 0.1 allows 10% extra load
+     * @param[in] min_per_sec tokens refilled per second regardless of traffic
+     * @param[in] max_tokens bucket size
+     */
+    RetryBudget(double ratio = 0.1, uint32_t min_per_sec = 10, uint32_t max_tokens = 100);
+
+    //called once per original request
+    void deposit();
+    //take one token for a retry or hedge
+    bool tryWithdraw();
+    double getTokens();
+private:
+    void refill(uint64_t now);
+private:
+    MutexType m_mutex;
+    double m_ratio;
+    uint32_t m_minPerSec;
+    uint32_t m_maxTokens;
+    double m_tokens;
+    uint64_t m_lastRefill;
+};
+
+class HttpConnectionPool : public std::enable_shared_from_this<HttpConnectionPool> {
 public:
     using ptr = std::shared_ptr<HttpConnectionPool>;
     using MutexType = Mutex;
 
+    struct Stats {
+        //getConnection calls
+        uint64_t gets = 0;
+        //served by an idle connection
+        uint64_t reuses = 0;
+        uint64_t creates = 0;
+        uint64_t connect_fails = 0;
+        //had to queue for a connection
+        uint64_t waits = 0;
+        uint64_t wait_timeouts = 0;
+        uint64_t wait_us = 0;
+        //closed by idle/alive/request limits or health check
+        uint64_t evicts = 0;
+        uint32_t total = 0;
+        uint32_t idle = 0;
+        uint32_t connecting = 0;
+        uint32_t waiting = 0;
+        //extra attempts of failed idempotent requests
+        uint64_t retries = 0;
+        //duplicates sent and how many of them answered first
+        uint64_t hedges = 0;
+        uint64_t hedge_wins = 0;
+        //retries or hedges skipped for lack of budget
+        uint64_t budget_exhausted = 0;
+        uint32_t latency_p95 = 0;
+
+        std::string toString() const;
+    };
+
     /**
      * @brief constructor
      * @param[in] host host to connect
      * @param[in] vhost vhost to connect
      * @param[in] port port to connect
-     * @param[in] max_size max size of connection pool
+     * @param[in] max_size max connections(idle and in use) of the host, beyond it callers wait
      * @param[in] max_alive_time max alive time of each connection
-     * @param[in] max_alive_time max request times of each connection
+     * @param[in] max_request max request times of each connection
+     * @param[in] max_idle_time idle connections older than it are closed by a timer, 0 never
+     * @param[in] max_connecting max concurrent connects
+     * @param[in] wait_timeout max time to wait for a connection (ms)
      */
     HttpConnectionPool(const std::string& host
                         , const std::string& vhost
                         , uint32_t port
                         , uint32_t max_size
                         , uint32_t max_alive_time
-                        , uint32_t max_request);
+                        , uint32_t max_request
+                        , uint32_t max_idle_time = 30000
+                        , uint32_t max_connecting = 8
+                        , uint32_t wait_timeout = 3000);
+    ~HttpConnectionPool();
 
+    //connect a new pooled connection regardless of max_size
     HttpConnection::ptr createConnection();
 
-    //get one connection from connection pool. If no connection in pool, create new connection
+    /**
+     * @brief get an idle connection of this thread, steal one from other threads,
+     * or connect a new one. when max_size or max_connecting is reached, wait in
+     * current fiber until a connection is released
+     * @return nullptr on connect fail or wait timeout
+     */
     HttpConnection::ptr getConnection();
+    HttpConnection::ptr getConnection(uint64_t wait_timeout_ms);
+
+    //close expired idle connections, run by timer
+    void evictIdle();
+
+    Stats getStats() const;
+    /**
+     * @brief retry idempotent requests failed by connection errors or timeouts,
+     * each retry spends a token of the retry budget. a timed out request may
+     * still be processed by a slow server, a retry can deliver it twice
+     * @param[in] v extra attempts per request, 0 disables
+     */
+    void setMaxRetries(uint32_t v) { m_maxRetries = v;}
+
+    /**
+     * @brief when a request is slower than the percentile of recent latencies,
+     * send a duplicate on another connection, take the first response and
+     * cancel the other. hedges spend the retry budget too
+     * @param[in] percentile e.g. 0.95, 0 disables hedging
+     * @param[in] min_delay_ms lower bound of the delay, used alone until enough samples
+     */
+    void setHedge(double percentile, uint32_t min_delay_ms);
+    void setRetryBudget(RetryBudget::ptr v) { m_retryBudget = v;}
+    RetryBudget::ptr getRetryBudget() const { return m_retryBudget;}
+
+    //percentile of recent successful request latencies (ms), 0 with too few samples
+    uint32_t getLatencyPercentile(double p) const;
+
+    //safe to send twice: GET, HEAD, OPTIONS, TRACE, PUT, DELETE or an Idempotency-Key header
+    static bool IsIdempotent(HttpRequest::ptr req);
+
+    const std::string& getHost() const { return m_host;}
+    uint32_t getPort() const { return m_port;}
 
     /**
      * @brief send HTTP GET request
@@ -231,19 +452,73 @@ public:
      * @brief send HTTP request with HttpRequest
      * @param[in] req Http Request
      * @param[in] timeout_ms timeout (ms)
+     * @param[in] cancel aborts the request from another fiber
      * @return return HttpResult
      */
     HttpResult::ptr doRequest(HttpRequest::ptr req
+                            , uint64_t timeout_ms
+                            , HttpCancelToken::ptr cancel = nullptr);
+
+    /**
+     * @brief send request, return with response headers and body stream
+     */
+    HttpResult::ptr doRequestStream(HttpRequest::ptr req
                             , uint64_t timeout_ms);
 
 private:
+    struct Shard {
+        MutexType mutex;
+        std::list<HttpConnection*> conns;
+    };
+
+    struct Waiter {
+        using ptr = std::shared_ptr<Waiter>;
+        Scheduler* scheduler = nullptr;
+        Fiber::ptr fiber;
+        //handed over idle connection
+        HttpConnection* conn = nullptr;
+        //allowed to connect, m_total already counts it
+        bool permit = false;
+        bool done = false;
+    };
+
     /**
      * @brief Manage new created connections. release ptr of HttpConnection when it is invalid, otherwise add into connection pool
      * @param[in] ptr pointer of HttpConnection
      * @param[in] HttpConnectionPool pointer of HttpConnectionPool
-     * @return return HttpResult
      */
     static void ReleasePtr(HttpConnection* ptr, HttpConnectionPool* pool);
+
+    HttpConnection::ptr wrap(HttpConnection* conn);
+    //connect with a slot taken by tryReserve
+    HttpConnection* connect(uint64_t timeout_ms);
+    bool tryReserve();
+    bool isExpired(HttpConnection* conn, uint64_t now) const;
+    //pop a live idle connection, expired ones go to stale
+    HttpConnection* popIdle(std::vector<HttpConnection*>& stale);
+    /**
+     * @brief an idle connection, or permit set when the caller may connect,
+     * waits up to wait_timeout_ms for either
+     */
+    HttpConnection* acquire(uint64_t wait_timeout_ms, bool& permit);
+    void pushIdle(HttpConnection* conn);
+    void destroy(HttpConnection* conn);
+    //hand idle connections or connect permits to waiters
+    void notifyWaiters();
+    void startEvictTimer();
+    struct Hedge;
+
+    HttpResult::ptr doRequestOnce(HttpRequest::ptr req, uint64_t timeout_ms
+                                , HttpCancelToken::ptr cancel);
+    HttpResult::ptr doRequestHedged(HttpRequest::ptr req, uint64_t timeout_ms
+                                , HttpCancelToken::ptr cancel, uint64_t delay_ms);
+    //run one attempt of a hedged request in a new fiber
+    void startAttempt(std::shared_ptr<Hedge> hedge, HttpRequest::ptr req
+                                , uint64_t timeout_ms, HttpCancelToken::ptr cancel, bool is_hedge);
+    void addLatency(uint32_t ms);
+    //get a connection and send req on it, retried once on a stale reused connection
+    HttpResult::ptr sendRequest(HttpRequest::ptr req, uint64_t timeout_ms, HttpConnection::ptr& conn
+                                , HttpCancelToken::ptr cancel = nullptr);
 private: 
     //host name
     std::string m_host;
@@ -251,10 +526,7 @@ private:
     std::string m_vhost;
     uint32_t m_port;
 
-    /*
-    * max number of long connection. 
-    * when number of long connection exceed maxSize, create short connection
-    */
+    //max connections of the host, idle and in use
     uint32_t m_maxSize;
 
     /**
@@ -267,12 +539,86 @@ private:
     */
     uint32_t m_maxRequest;
 
+    uint32_t m_maxIdleTime;
+    uint32_t m_maxConnecting;
+    uint32_t m_waitTimeout;
+
+    //idle connections, sharded by thread id
+    std::vector<std::unique_ptr<Shard> > m_shards;
+
+    //guards m_waiters
     MutexType m_mutex;
-    std::list<HttpConnection*> m_conns;
+    std::list<Waiter::ptr> m_waiters;
+
     //total number of connections
     std::atomic<uint32_t> m_total = {0};
+    std::atomic<uint32_t> m_idle = {0};
+    std::atomic<uint32_t> m_connecting = {0};
+    std::atomic<uint32_t> m_waiting = {0};
+
+    std::atomic<uint64_t> m_gets = {0};
+    std::atomic<uint64_t> m_reuses = {0};
+    std::atomic<uint64_t> m_creates = {0};
+    std::atomic<uint64_t> m_connectFails = {0};
+    std::atomic<uint64_t> m_waits = {0};
+    std::atomic<uint64_t> m_waitTimeouts = {0};
+    std::atomic<uint64_t> m_waitUs = {0};
+    std::atomic<uint64_t> m_evicts = {0};
+    std::atomic<uint64_t> m_retries = {0};
+    std::atomic<uint64_t> m_hedges = {0};
+    std::atomic<uint64_t> m_hedgeWins = {0};
+    std::atomic<uint64_t> m_budgetExhausted = {0};
+
+    uint32_t m_maxRetries = 0;
+    double m_hedgePercentile = 0;
+    uint32_t m_hedgeMinDelay = 0;
+    RetryBudget::ptr m_retryBudget;
+
+    //ring of recent successful latencies (ms)
+    mutable SpinLock m_latencyMutex;
+    std::vector<uint32_t> m_latencies;
+    size_t m_latencyPos = 0;
+
+    std::atomic<bool> m_timerArmed = {false};
+    Timer::ptr m_timer;
+};
+
+/**
+ * @brief connection pools keyed by host:port, created on demand with http.pool.* config
+ */
+class HttpConnectionPoolManager {
+public:
+    using RWMutexType = RWMutex;
+
+    HttpConnectionPoolManager();
+
+    HttpConnectionPool::ptr get(const std::string& host, uint32_t port
+                                , const std::string& vhost = "");
+
+    HttpResult::ptr doGet(const std::string& url
+                          , uint64_t timeout_ms
+                          , const std::map<std::string, std::string>& headers = {}
+                          , const std::string& body = std::string());
+
+    HttpResult::ptr doPost(const std::string& url
+                          , uint64_t timeout_ms
+                          , const std::map<std::string, std::string>& headers = {}
+                          , const std::string& body = std::string());
+
+    HttpResult::ptr doRequest(HttpMethod method
+                            , const std::string& url
+                            , uint64_t timeout_ms
+                            , const std::map<std::string, std::string>& headers = {}
+                            , const std::string& body = std::string());
+
+    //stats of all pools
+    std::string toString();
+private:
+    RWMutexType m_mutex;
+    std::unordered_map<std::string, HttpConnectionPool::ptr> m_pools;
 };
 
+using HttpConnectionPoolMgr = tao::Singleton<HttpConnectionPoolManager>;
 
 }
 }
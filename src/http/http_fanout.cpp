@@ -0,0 +1,154 @@
+#include "http_fanout.h"
+#include "../util.h"
+
+namespace tao {
+namespace http {
+
+static std::string ErrorMessage(HttpResult::Error error)
+{
+    return error == HttpResult::Error::TIMEOUT ? "fanout deadline exceeded" : "fanout cancelled";
+}
+
+void HttpFanout::State::cancel(HttpResult::Error err)
+{
+    std::list<Call::ptr> tmp;
+    {
+        MutexType::Lock lock(mutex);
+        if(done) {
+            return;
+        }
+        done = true;
+        error = err;
+        tmp.swap(calls);
+    }
+    for(auto& i : tmp) {
+        //waiters see the failure at the deadline, the request fiber ends on its own
+        i->promise.setValue(std::make_shared<HttpResult>((int)err, nullptr, ErrorMessage(err)));
+        i->token->cancel();
+    }
+}
+
+HttpFanout::HttpFanout(uint64_t deadline_ms, IOManager* iom)
+    :m_iom(iom)
+    ,m_deadline(tao::GetCurrentMS() + deadline_ms)
+    ,m_state(std::make_shared<State>()) {
+    State::ptr state = m_state;
+    m_timer = m_iom->addTimer(deadline_ms, [state]() {
+        state->cancel(HttpResult::Error::TIMEOUT);
+    });
+}
+
+HttpFanout::~HttpFanout()
+{
+    m_timer->cancel();
+    m_state->cancel(HttpResult::Error::CANCELLED);
+}
+
+HttpFuture HttpFanout::doGet(const std::string& url
+                            , const std::map<std::string, std::string>& headers)
+{
+    return doRequest(HttpMethod::GET, url, headers);
+}
+
+HttpFuture HttpFanout::doPost(const std::string& url
+                            , const std::map<std::string, std::string>& headers
+                            , const std::string& body)
+{
+    return doRequest(HttpMethod::POST, url, headers, body);
+}
+
+HttpFuture HttpFanout::doRequest(HttpMethod method
+                            , const std::string& url
+                            , const std::map<std::string, std::string>& headers
+                            , const std::string& body)
+{
+    Uri::ptr uri = Uri::Create(url);
+    if(!uri) {
+        return fail(HttpResult::Error::INVALID_URL, "invalid url: " + url);
+    }
+    return doRequest(HttpConnection::CreateRequest(method, uri, headers, body), uri);
+}
+
+HttpFuture HttpFanout::doRequest(HttpRequest::ptr req, Uri::ptr uri)
+{
+    if(uri->getHost().empty()) {
+        return fail(HttpResult::Error::INVALID_HOST, "invalid host: " + uri->getHost());
+    }
+    Call::ptr call = std::make_shared<Call>();
+    HttpFuture future = call->promise.getFuture();
+    {
+        MutexType::Lock lock(m_state->mutex);
+        if(m_state->done) {
+            HttpResult::Error error = m_state->error;
+            lock.unlock();
+            return fail(error, ErrorMessage(error));
+        }
+        m_state->calls.push_back(call);
+        m_futures.push_back(future);
+    }
+    State::ptr state = m_state;
+    uint64_t deadline = m_deadline;
+    m_iom->schedule([state, call, req, uri, deadline]() {
+        //each request only gets what is left of the overall budget when it starts,
+        //covering the pool wait and the connect too
+        uint64_t now = tao::GetCurrentMS();
+        HttpResult::ptr rt;
+        if(now >= deadline) {
+            rt = std::make_shared<HttpResult>((int)HttpResult::Error::TIMEOUT
+                        , nullptr, ErrorMessage(HttpResult::Error::TIMEOUT));
+        } else {
+            rt = HttpConnection::DoRequest(req, uri, deadline - now, call->token);
+        }
+        {
+            MutexType::Lock lock(state->mutex);
+            state->calls.remove(call);
+        }
+        call->promise.setValue(rt);
+    });
+    return future;
+}
+
+HttpFuture HttpFanout::fail(HttpResult::Error error, const std::string& msg)
+{
+    Promise<HttpResult::ptr> promise;
+    promise.setValue(std::make_shared<HttpResult>((int)error, nullptr, msg));
+    MutexType::Lock lock(m_state->mutex);
+    m_futures.push_back(promise.getFuture());
+    return promise.getFuture();
+}
+
+Future<std::vector<HttpResult::ptr> > HttpFanout::whenAll()
+{
+    MutexType::Lock lock(m_state->mutex);
+    auto futures = m_futures;
+    lock.unlock();
+    return WhenAll(futures);
+}
+
+Future<size_t> HttpFanout::whenAny()
+{
+    MutexType::Lock lock(m_state->mutex);
+    auto futures = m_futures;
+    lock.unlock();
+    return WhenAny(futures);
+}
+
+void HttpFanout::cancel(HttpResult::Error error)
+{
+    m_state->cancel(error);
+}
+
+uint64_t HttpFanout::getRemaining() const
+{
+    uint64_t now = tao::GetCurrentMS();
+    return now >= m_deadline ? 0 : m_deadline - now;
+}
+
+size_t HttpFanout::getOutstanding()
+{
+    MutexType::Lock lock(m_state->mutex);
+    return m_state->calls.size();
+}
+
+}
+}
@@ -0,0 +1,89 @@
+#ifndef __TAO_HTTP_FANOUT_H__
+#define __TAO_HTTP_FANOUT_H__
+
+#include "http_connection.h"
+#include "../future.h"
+#include "../iomanager.h"
+
+namespace tao {
+namespace http {
+
+using HttpFuture = Future<HttpResult::ptr>;
+
+/**
+ * @brief runs many pooled requests concurrently, each in its own fiber,
+ * under one overall deadline. requests still running at the deadline are
+ * cancelled and their futures get HttpResult::Error::TIMEOUT
+ */
+class HttpFanout {
+public:
+    using ptr = std::shared_ptr<HttpFanout>;
+    using MutexType = Mutex;
+
+    /**
+     * @param[in] deadline_ms budget of all requests from now (ms)
+     * @param[in] iom IOManager running the requests and the deadline timer
+     */
+    HttpFanout(uint64_t deadline_ms, IOManager* iom = IOManager::GetThis());
+    //outstanding requests are cancelled
+    ~HttpFanout();
+
+    HttpFuture doGet(const std::string& url
+                    , const std::map<std::string, std::string>& headers = {});
+
+    HttpFuture doPost(const std::string& url
+                    , const std::map<std::string, std::string>& headers = {}
+                    , const std::string& body = std::string());
+
+    HttpFuture doRequest(HttpMethod method
+                    , const std::string& url
+                    , const std::map<std::string, std::string>& headers = {}
+                    , const std::string& body = std::string());
+
+    HttpFuture doRequest(HttpRequest::ptr req, Uri::ptr uri);
+
+    //all futures added so far, in order
+    Future<std::vector<HttpResult::ptr> > whenAll();
+    //index of the first finished request
+    Future<size_t> whenAny();
+
+    /**
+     * @brief finish all outstanding requests now with error
+     */
+    void cancel(HttpResult::Error error = HttpResult::Error::CANCELLED);
+
+    //ms left before the deadline, 0 once passed
+    uint64_t getRemaining() const;
+    size_t getOutstanding();
+private:
+    struct Call {
+        using ptr = std::shared_ptr<Call>;
+        Promise<HttpResult::ptr> promise;
+        HttpCancelToken::ptr token = std::make_shared<HttpCancelToken>();
+    };
+
+    struct State {
+        using ptr = std::shared_ptr<State>;
+        MutexType mutex;
+        std::list<Call::ptr> calls;
+        //set by deadline or cancel, later requests fail at once
+        bool done = false;
+        HttpResult::Error error = HttpResult::Error::OK;
+
+        void cancel(HttpResult::Error error);
+    };
+
+    HttpFuture fail(HttpResult::Error error, const std::string& msg);
+private:
+    IOManager* m_iom;
+    uint64_t m_deadline;
+    State::ptr m_state;
+    Timer::ptr m_timer;
+    //guarded by m_state->mutex
+    std::vector<HttpFuture> m_futures;
+};
+
+}
+}
+
+#endif
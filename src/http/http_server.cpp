@@ -1,5 +1,6 @@
 #include "http_server.h"
 #include "../log.h"
+#include "http_compress.h"
 #include "src/http/servlets/status_servlet.h"
 
 namespace tao {
@@ -29,11 +30,17 @@ void HttpServer::handleClient(tao::Socket::ptr client)
                 << " cliet:" << *client << " keep_alive=" << m_isKeepalive;
             break;
         }
+        if(handleUpgrade(req, session)) {
+            return;
+        }
 
         HttpResponse::ptr rsp(new HttpResponse(req->getVersion()
                             ,req->isClose() || !m_isKeepalive));
         rsp->setHeader("Server", getName());
-        m_dispatch->handle(req, rsp, session);
+        if(HttpCompress::DecompressRequest(req, rsp)) {
+            m_dispatch->handle(req, rsp, session);
+            HttpCompress::CompressResponse(req, rsp);
+        }
         session->sendResponse(rsp);
 
         if(!m_isKeepalive || req->isClose()) {
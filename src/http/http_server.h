@@ -29,6 +29,12 @@ public:
 protected:
     virtual void handleClient(tao::Socket::ptr client) override;
 
+    /**
+     * @brief take over the connection for an Upgrade request
+     * @return true if the connection was taken, handleClient stops serving it
+     */
+    virtual bool handleUpgrade(HttpRequest::ptr req, HttpSession::ptr session) { return false;}
+
 private:
     bool m_isKeepalive;
     ServletDispatch::ptr m_dispatch;
@@ -0,0 +1,380 @@
+#include "cache_servlet.h"
+#include "status_servlet.h"
+#include "src/config.h"
+#include "src/log.h"
+#include "src/util.h"
+#include <algorithm>
+#include <sstream>
+
+namespace tao {
+namespace http {
+
+static tao::Logger::ptr g_logger = TAO_LOG_NAME("system");
+
+static tao::ConfigVar<uint32_t>::ptr g_cache_shards =
+    tao::Config::Lookup("http.cache.shards"
+                , (uint32_t)16, "http cache shard count");
+
+static tao::ConfigVar<uint64_t>::ptr g_cache_max_bytes =
+    tao::Config::Lookup("http.cache.max_bytes"
+                , (uint64_t)(64 * 1024 * 1024), "http cache max bytes");
+
+static tao::ConfigVar<uint64_t>::ptr g_cache_max_entries =
+    tao::Config::Lookup("http.cache.max_entries"
+                , (uint64_t)(100000), "http cache max entries");
+
+static tao::ConfigVar<uint64_t>::ptr g_cache_ttl =
+    tao::Config::Lookup("http.cache.ttl"
+                , (uint64_t)(1000), "http cache default ttl(ms)");
+
+static tao::ConfigVar<uint64_t>::ptr g_cache_max_item_size =
+    tao::Config::Lookup("http.cache.max_item_size"
+                , (uint64_t)(1024 * 1024), "http cache max body size of single response");
+
+/**
+ * @brief find directive of Cache-Control like header value
+ * @param[out] val value of "name=val", untouched when directive has no value
+ */
+static bool HasDirective(const std::string& header, const char* name, uint64_t* val = nullptr) {
+    size_t len = strlen(name);
+    size_t pos = 0;
+    while(pos < header.size()) {
+        size_t end = header.find(',', pos);
+        if(end == std::string::npos) {
+            end = header.size();
+        }
+        std::string item = tao::StringUtil::Trim(header.substr(pos, end - pos));
+        pos = end + 1;
+        if(item.size() < len || strncasecmp(item.c_str(), name, len) != 0) {
+            continue;
+        }
+        if(item.size() == len) {
+            return true;
+        }
+        if(item[len] != '=') {
+            continue;
+        }
+        if(val) {
+            *val = tao::TypeUtil::Atoi(tao::StringUtil::Trim(item.substr(len + 1), " \t\""));
+        }
+        return true;
+    }
+    return false;
+}
+
+static void SplitHeaderList(const std::string& header, std::vector<std::string>& out) {
+    size_t pos = 0;
+    while(pos < header.size()) {
+        size_t end = header.find(',', pos);
+        if(end == std::string::npos) {
+            end = header.size();
+        }
+        std::string item = tao::StringUtil::Trim(header.substr(pos, end - pos));
+        if(!item.empty()) {
+            std::transform(item.begin(), item.end(), item.begin(), ::tolower);
+            out.push_back(item);
+        }
+        pos = end + 1;
+    }
+}
+
+//statuses cacheable by default (rfc7231 6.1)
+static bool IsCacheableStatus(HttpStatus s) {
+    switch(s) {
+        case HttpStatus::OK:
+        case HttpStatus::NON_AUTHORITATIVE_INFORMATION:
+        case HttpStatus::NO_CONTENT:
+        case HttpStatus::MULTIPLE_CHOICES:
+        case HttpStatus::MOVED_PERMANENTLY:
+        case HttpStatus::NOT_FOUND:
+        case HttpStatus::METHOD_NOT_ALLOWED:
+        case HttpStatus::GONE:
+        case HttpStatus::URI_TOO_LONG:
+        case HttpStatus::NOT_IMPLEMENTED:
+            return true;
+        default:
+            return false;
+    }
+}
+
+std::ostream& CacheServlet::Stats::dump(std::ostream& os) const {
+#define XX(key) \
+    os << std::setw(30) << std::right << #key ": " << key << std::endl
+    XX(hits);
+    XX(misses);
+    XX(coalesced);
+    XX(evictions);
+    XX(expired);
+    XX(bypass);
+    XX(bytes);
+    XX(entries);
+#undef XX
+    return os;
+}
+
+CacheServlet::CacheServlet(Servlet::ptr servlet
+                ,uint64_t ttl_ms
+                ,uint64_t max_bytes
+                ,const std::vector<std::string>& vary)
+    :Servlet("CacheServlet")
+    ,m_servlet(servlet)
+    ,m_ttl(ttl_ms ? ttl_ms : g_cache_ttl->getValue())
+    ,m_shards(std::max(g_cache_shards->getValue(), (uint32_t)1))
+    ,m_stats(std::make_shared<Stats>()) {
+    for(auto& i : vary) {
+        SplitHeaderList(i, m_vary);
+    }
+    uint64_t bytes = max_bytes ? max_bytes : g_cache_max_bytes->getValue();
+    uint64_t entries = g_cache_max_entries->getValue();
+    for(auto& i : m_shards) {
+        i.maxBytes = std::max(bytes / m_shards.size(), (uint64_t)1);
+        i.maxEntries = std::max(entries / m_shards.size(), (uint64_t)1);
+    }
+
+    //stats may outlive this servlet in a status callback copy
+    Stats::ptr stats = m_stats;
+    m_statusId = StatusServlet::AddStatus("cache: " + m_servlet->getName()
+                    ,[stats](std::ostream& os) {
+        stats->dump(os);
+    });
+}
+
+CacheServlet::~CacheServlet() {
+    StatusServlet::DelStatus(m_statusId);
+}
+
+int32_t CacheServlet::handle(tao::http::HttpRequest::ptr request
+                , tao::http::HttpResponse::ptr response
+                , tao::http::HttpSession::ptr session) {
+    HttpMethod method = request->getMethod();
+    if(method != HttpMethod::GET && method != HttpMethod::HEAD) {
+        ++m_stats->bypass;
+        return m_servlet->handle(request, response, session);
+    }
+    std::string req_cc = request->getHeader("cache-control");
+    if(HasDirective(req_cc, "no-store")) {
+        ++m_stats->bypass;
+        return m_servlet->handle(request, response, session);
+    }
+    uint64_t max_age = ~0ull;
+    bool refresh = HasDirective(req_cc, "no-cache")
+                || (HasDirective(req_cc, "max-age", &max_age) && max_age == 0)
+                || HasDirective(request->getHeader("pragma"), "no-cache");
+
+    std::string primary = std::string(HttpMethodToString(method)) + " "
+                    + request->getPath() + "?" + request->getQuery();
+    Shard& shard = getShard(primary);
+    uint64_t now = tao::GetCurrentMS();
+
+    std::string key;
+    Flight::ptr flight;
+    bool leader = false;
+    {
+        MutexType::Lock lock(shard.mutex);
+        auto vit = shard.varys.find(primary);
+        key = makeKey(request, primary, vit == shard.varys.end()
+                        ? m_vary : mergeVary(vit->second));
+        if(!refresh) {
+            CachedResponse::ptr c = lookup(shard, key, now);
+            if(c && (max_age == ~0ull || (now - c->createTime) / 1000 <= max_age)) {
+                lock.unlock();
+                ++m_stats->hits;
+                fill(c, response, now);
+                return 0;
+            }
+        }
+        auto it = shard.flights.find(key);
+        if(it != shard.flights.end()) {
+            flight = it->second;
+            ++flight->waiters;
+        } else {
+            flight = std::make_shared<Flight>();
+            shard.flights[key] = flight;
+            leader = true;
+        }
+    }
+
+    if(!leader) {
+        flight->sem.wait();
+        CachedResponse::ptr c = flight->result;
+        //the response may vary on headers unknown before it was computed
+        if(c && makeKey(request, primary, mergeVary(c->vary)) == flight->key) {
+            ++m_stats->coalesced;
+            fill(c, response, tao::GetCurrentMS());
+            return 0;
+        }
+        ++m_stats->misses;
+        return m_servlet->handle(request, response, session);
+    }
+
+    ++m_stats->misses;
+    int32_t rt = m_servlet->handle(request, response, session);
+    CachedResponse::ptr c;
+    if(rt == 0) {
+        c = makeCached(response, tao::GetCurrentMS());
+    }
+    if(!c) {
+        ++m_stats->bypass;
+    }
+
+    uint32_t waiters = 0;
+    {
+        MutexType::Lock lock(shard.mutex);
+        if(c) {
+            flight->key = makeKey(request, primary, mergeVary(c->vary));
+            shard.varys[primary] = c->vary;
+            store(shard, flight->key, c);
+        }
+        auto it = shard.flights.find(key);
+        if(it != shard.flights.end() && it->second == flight) {
+            shard.flights.erase(it);
+        }
+        flight->result = c;
+        waiters = flight->waiters;
+    }
+    for(uint32_t i = 0; i < waiters; ++i) {
+        flight->sem.notify();
+    }
+    return rt;
+}
+
+void CacheServlet::clear() {
+    for(auto& shard : m_shards) {
+        MutexType::Lock lock(shard.mutex);
+        m_stats->bytes -= shard.bytes;
+        m_stats->entries -= shard.entries.size();
+        shard.lru.clear();
+        shard.entries.clear();
+        shard.varys.clear();
+        shard.bytes = 0;
+    }
+}
+
+CacheServlet::Shard& CacheServlet::getShard(const std::string& primary) {
+    return m_shards[std::hash<std::string>()(primary) % m_shards.size()];
+}
+
+std::string CacheServlet::makeKey(HttpRequest::ptr req, const std::string& primary
+                    ,const std::vector<std::string>& vary) const {
+    if(vary.empty()) {
+        return primary;
+    }
+    std::string key = primary;
+    for(auto& i : vary) {
+        key.append("\n").append(i).append(":").append(req->getHeader(i));
+    }
+    return key;
+}
+
+std::vector<std::string> CacheServlet::mergeVary(const std::vector<std::string>& vary) const {
+    std::vector<std::string> rt = m_vary;
+    for(auto& i : vary) {
+        if(std::find(rt.begin(), rt.end(), i) == rt.end()) {
+            rt.push_back(i);
+        }
+    }
+    return rt;
+}
+
+CacheServlet::CachedResponse::ptr CacheServlet::lookup(Shard& shard
+                    , const std::string& key, uint64_t now) {
+    auto it = shard.entries.find(key);
+    if(it == shard.entries.end()) {
+        return nullptr;
+    }
+    auto lit = it->second;
+    if(lit->rsp->expireTime <= now) {
+        shard.bytes -= lit->rsp->size;
+        m_stats->bytes -= lit->rsp->size;
+        --m_stats->entries;
+        ++m_stats->expired;
+        shard.lru.erase(lit);
+        shard.entries.erase(it);
+        return nullptr;
+    }
+    shard.lru.splice(shard.lru.begin(), shard.lru, lit);
+    return lit->rsp;
+}
+
+void CacheServlet::store(Shard& shard, const std::string& key, CachedResponse::ptr rsp) {
+    auto it = shard.entries.find(key);
+    if(it != shard.entries.end()) {
+        shard.bytes -= it->second->rsp->size;
+        m_stats->bytes -= it->second->rsp->size;
+        --m_stats->entries;
+        shard.lru.erase(it->second);
+        shard.entries.erase(it);
+    }
+    shard.lru.push_front(Entry{key, rsp});
+    shard.entries[key] = shard.lru.begin();
+    shard.bytes += rsp->size;
+    m_stats->bytes += rsp->size;
+    ++m_stats->entries;
+
+    while(shard.lru.size() > 1
+            && (shard.bytes > shard.maxBytes
+                || shard.lru.size() > shard.maxEntries)) {
+        Entry& e = shard.lru.back();
+        shard.bytes -= e.rsp->size;
+        m_stats->bytes -= e.rsp->size;
+        --m_stats->entries;
+        ++m_stats->evictions;
+        shard.entries.erase(e.key);
+        shard.lru.pop_back();
+    }
+}
+
+CacheServlet::CachedResponse::ptr CacheServlet::makeCached(HttpResponse::ptr rsp, uint64_t now) const {
+    if(rsp->isWebsocket() || !IsCacheableStatus(rsp->getStatus())) {
+        return nullptr;
+    }
+    std::string cc = rsp->getHeader("cache-control");
+    if(HasDirective(cc, "no-store")
+            || HasDirective(cc, "no-cache")
+            || HasDirective(cc, "private")
+            || !rsp->getHeader("set-cookie").empty()) {
+        return nullptr;
+    }
+    if(rsp->getBody().size() > g_cache_max_item_size->getValue()) {
+        return nullptr;
+    }
+    std::vector<std::string> vary;
+    SplitHeaderList(rsp->getHeader("vary"), vary);
+    if(std::find(vary.begin(), vary.end(), "*") != vary.end()) {
+        return nullptr;
+    }
+
+    uint64_t ttl = m_ttl;
+    uint64_t age = 0;
+    if(HasDirective(cc, "s-maxage", &age) || HasDirective(cc, "max-age", &age)) {
+        ttl = age * 1000;
+    }
+    if(ttl == 0) {
+        return nullptr;
+    }
+
+    CachedResponse::ptr c = std::make_shared<CachedResponse>();
+    c->status = rsp->getStatus();
+    c->reason = rsp->getReason();
+    c->headers = rsp->getHeaders();
+    c->body = rsp->getBody();
+    c->vary.swap(vary);
+    c->createTime = now;
+    c->expireTime = now + ttl;
+    c->size = sizeof(CachedResponse) + c->body.size();
+    for(auto& i : c->headers) {
+        c->size += i.first.size() + i.second.size();
+    }
+    return c;
+}
+
+void CacheServlet::fill(CachedResponse::ptr c, HttpResponse::ptr rsp, uint64_t now) const {
+    rsp->setStatus(c->status);
+    rsp->setReason(c->reason);
+    rsp->setHeaders(c->headers);
+    rsp->setBody(c->body);
+    rsp->setHeader("Age", std::to_string(now > c->createTime ? (now - c->createTime) / 1000 : 0));
+}
+
+}
+}
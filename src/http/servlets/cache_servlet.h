@@ -0,0 +1,126 @@
+#ifndef __TAO_HTTP_CACHE_SERVLET_H__
+#define __TAO_HTTP_CACHE_SERVLET_H__
+
+#include "../servlet.h"
+#include <list>
+#include <vector>
+#include <atomic>
+
+namespace tao {
+namespace http {
+
+/**
+ * @brief caching wrapper of another servlet
+ * responses are stored in a sharded LRU keyed on method/path/query/Vary headers,
+ * concurrent misses of the same key wait for one in-flight computation
+ */
+class CacheServlet : public Servlet {
+public:
+    using ptr = std::shared_ptr<CacheServlet>;
+    using MutexType = Mutex;
+
+    struct Stats {
+        using ptr = std::shared_ptr<Stats>;
+        std::atomic<uint64_t> hits = {0};
+        std::atomic<uint64_t> misses = {0};
+        //misses served by another fiber's computation
+        std::atomic<uint64_t> coalesced = {0};
+        std::atomic<uint64_t> evictions = {0};
+        std::atomic<uint64_t> expired = {0};
+        //requests or responses not allowed to be cached
+        std::atomic<uint64_t> bypass = {0};
+        std::atomic<uint64_t> bytes = {0};
+        std::atomic<uint64_t> entries = {0};
+
+        std::ostream& dump(std::ostream& os) const;
+    };
+
+    /**
+     * @brief constructor
+     * @param[in] servlet servlet computing the response
+     * @param[in] ttl_ms default time to live when response has no max-age, 0 uses http.cache.ttl
+     * @param[in] max_bytes max bytes of all entries, 0 uses http.cache.max_bytes
+     * @param[in] vary request headers always part of the key
+     */
+    CacheServlet(Servlet::ptr servlet
+                ,uint64_t ttl_ms = 0
+                ,uint64_t max_bytes = 0
+                ,const std::vector<std::string>& vary = {});
+    ~CacheServlet();
+
+    virtual int32_t handle(tao::http::HttpRequest::ptr request
+                    , tao::http::HttpResponse::ptr response
+                    , tao::http::HttpSession::ptr session) override;
+
+    //drop all cached entries
+    void clear();
+
+    Stats::ptr getStats() const { return m_stats;}
+    Servlet::ptr getServlet() const { return m_servlet;}
+private:
+    struct CachedResponse {
+        using ptr = std::shared_ptr<CachedResponse>;
+        HttpStatus status;
+        std::string reason;
+        HttpResponse::MapType headers;
+        std::string body;
+        //request headers named by Vary of this response
+        std::vector<std::string> vary;
+        uint64_t createTime = 0;
+        uint64_t expireTime = 0;
+        uint64_t size = 0;
+    };
+
+    //one in-flight computation, other fibers of the same key wait on it
+    struct Flight {
+        using ptr = std::shared_ptr<Flight>;
+        FiberSemaphore sem;
+        uint32_t waiters = 0;
+        //null when the response is not cacheable
+        CachedResponse::ptr result;
+        //key of result after applying its Vary
+        std::string key;
+    };
+
+    struct Entry {
+        std::string key;
+        CachedResponse::ptr rsp;
+    };
+
+    struct Shard {
+        MutexType mutex;
+        std::list<Entry> lru;   //front is most recently used
+        std::unordered_map<std::string, std::list<Entry>::iterator> entries;
+        //primary key(method/path/query) -> Vary headers learned from response
+        std::unordered_map<std::string, std::vector<std::string> > varys;
+        std::unordered_map<std::string, Flight::ptr> flights;
+        uint64_t bytes = 0;
+        uint64_t maxBytes = 0;
+        uint64_t maxEntries = 0;
+    };
+
+    Shard& getShard(const std::string& primary);
+    std::string makeKey(HttpRequest::ptr req, const std::string& primary
+                        ,const std::vector<std::string>& vary) const;
+    //configured vary headers plus the ones named by response
+    std::vector<std::string> mergeVary(const std::vector<std::string>& vary) const;
+    //called with shard.mutex locked
+    CachedResponse::ptr lookup(Shard& shard, const std::string& key, uint64_t now);
+    //called with shard.mutex locked
+    void store(Shard& shard, const std::string& key, CachedResponse::ptr rsp);
+    CachedResponse::ptr makeCached(HttpResponse::ptr rsp, uint64_t now) const;
+    void fill(CachedResponse::ptr c, HttpResponse::ptr rsp, uint64_t now) const;
+private:
+    Servlet::ptr m_servlet;
+    uint64_t m_ttl;
+    std::vector<std::string> m_vary;
+    std::vector<Shard> m_shards;
+    Stats::ptr m_stats;
+    //id of section registered to StatusServlet
+    uint64_t m_statusId = 0;
+};
+
+}
+}
+
+#endif
@@ -1,7 +1,10 @@
 #include "status_servlet.h"
+#include "src/fiber.h"
+#include "src/config.h"
 #include <iostream>
 #include <string>
 #include <vector>
+#include <unistd.h>
 
 namespace tao {
 namespace http {
@@ -18,11 +21,61 @@ int32_t StatusServlet::handle(tao::http::HttpRequest::ptr request, tao::http::Ht
     ss << std::setw(30) << std::right << key ": "
     std::stringstream ss;
     ss << "===================================================" << std::endl;
-    
+    XX("pid") << getpid() << std::endl;
+    XX("fibers") << tao::Fiber::nFibers() << std::endl;
+
+    tao::Config::ReloadStatus reload = tao::Config::GetReloadStatus();
+    ss << "===================================================" << std::endl;
+    ss << "config" << std::endl;
+    XX("reloads") << reload.reloads << std::endl;
+    XX("last_reload_us") << reload.last_us << std::endl;
+    XX("max_reload_us") << reload.max_us << std::endl;
+    XX("avg_reload_us") << (reload.reloads ? reload.total_us / reload.reloads : 0) << std::endl;
+    for(auto& i : reload.key_changes) {
+        ss << std::setw(30) << std::right << i.first << ": " << i.second << std::endl;
+    }
+
+    std::vector<std::pair<std::string, status_cb> > sections;
+    {
+        RWMutexType::ReadLock lock(GetMutex());
+        for(auto& i : GetDatas()) {
+            sections.push_back(i.second);
+        }
+    }
+    for(auto& i : sections) {
+        ss << "===================================================" << std::endl;
+        ss << i.first << std::endl;
+        i.second(ss);
+    }
+#undef XX
 
     response->setBody(ss.str());
 
     return 0;
 }
+
+uint64_t StatusServlet::AddStatus(const std::string& name, status_cb cb) {
+    static uint64_t s_id = 0;
+    RWMutexType::WriteLock lock(GetMutex());
+    ++s_id;
+    GetDatas()[s_id] = std::make_pair(name, cb);
+    return s_id;
+}
+
+void StatusServlet::DelStatus(uint64_t id) {
+    RWMutexType::WriteLock lock(GetMutex());
+    GetDatas().erase(id);
+}
+
+StatusServlet::RWMutexType& StatusServlet::GetMutex() {
+    static RWMutexType s_mutex;
+    return s_mutex;
+}
+
+std::map<uint64_t, std::pair<std::string, StatusServlet::status_cb> >& StatusServlet::GetDatas() {
+    static std::map<uint64_t, std::pair<std::string, status_cb> > s_datas;
+    return s_datas;
+}
+
+}
 }
-}
\ No newline at end of file
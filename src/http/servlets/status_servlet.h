@@ -2,16 +2,35 @@
 #define __TAO_HTTP_STATUS_SERVLET_H__
 
 #include "../servlet.h"
+#include <map>
+#include <ostream>
 
 namespace tao {
 namespace http {
 
 class StatusServlet : public Servlet {
 public:
+    using RWMutexType = RWMutex;
+    //dump callback of one status section
+    using status_cb = std::function<void(std::ostream& os)>;
+
     StatusServlet();
     virtual int32_t handle(tao::http::HttpRequest::ptr request
                     , tao::http::HttpResponse::ptr response
                     , tao::http::HttpSession::ptr session) override;
+
+    /**
+     * @brief register a section printed by /_/status
+     * @param[in] name section title
+     * @param[in] cb dump callback
+     * @return id used to unregister the section
+     */
+    static uint64_t AddStatus(const std::string& name, status_cb cb);
+    static void DelStatus(uint64_t id);
+private:
+    static RWMutexType& GetMutex();
+    //id -> (name, cb)
+    static std::map<uint64_t, std::pair<std::string, status_cb> >& GetDatas();
 };
 
 
@@ -19,4 +38,4 @@ public:
 
 }
 
-#endif
\ No newline at end of file
+#endif
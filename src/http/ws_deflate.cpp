@@ -0,0 +1,302 @@
+#include "ws_deflate.h"
+#include "src/config.h"
+#include "src/log.h"
+#include "src/util.h"
+#include "src/utils/hash_util.h"
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+namespace tao {
+namespace http {
+
+static tao::Logger::ptr g_logger = TAO_LOG_NAME("system");
+
+static tao::ConfigVar<bool>::ptr g_ws_deflate_enable =
+    tao::Config::Lookup("websocket.deflate.enable"
+                ,true, "websocket permessage-deflate enable");
+
+static tao::ConfigVar<bool>::ptr g_ws_deflate_server_no_context_takeover =
+    tao::Config::Lookup("websocket.deflate.server_no_context_takeover"
+                ,true, "server compressor resets after each message, no deflate state kept while idle");
+
+static tao::ConfigVar<bool>::ptr g_ws_deflate_client_no_context_takeover =
+    tao::Config::Lookup("websocket.deflate.client_no_context_takeover"
+                ,true, "ask clients to reset after each message, no inflate state kept while idle");
+
+static tao::ConfigVar<int32_t>::ptr g_ws_deflate_max_window_bits =
+    tao::Config::Lookup("websocket.deflate.max_window_bits"
+                ,(int32_t)15, "websocket deflate max window bits, 9-15");
+
+static tao::ConfigVar<int32_t>::ptr g_ws_deflate_mem_level =
+    tao::Config::Lookup("websocket.deflate.mem_level"
+                ,(int32_t)8, "websocket deflate memory level, 1-9");
+
+static tao::ConfigVar<int32_t>::ptr g_ws_deflate_level =
+    tao::Config::Lookup("websocket.deflate.level"
+                ,(int32_t)6, "websocket deflate compress level, 1-9");
+
+static tao::ConfigVar<uint32_t>::ptr g_ws_deflate_min_size =
+    tao::Config::Lookup("websocket.deflate.min_size"
+                ,(uint32_t)64, "websocket message min size to compress");
+
+static tao::ConfigVar<uint32_t>::ptr g_ws_deflate_pool_size =
+    tao::Config::Lookup("websocket.deflate.pool_size"
+                ,(uint32_t)32, "idle zlib streams kept per thread for each window size");
+
+static const uint32_t s_zlib_buff_size = 4096;
+//inflate input is fed in pieces so max_size stops a decompression bomb early
+static const size_t s_inflate_chunk = 4096;
+static const char s_flush_tail[4] = {0x00, 0x00, (char)0xff, (char)0xff};
+
+//idle streams, key is window bits and direction
+static thread_local std::unordered_map<int, std::vector<ZlibStream::ptr> > t_pool;
+
+std::string WSDeflate::Params::toString() const {
+    std::stringstream ss;
+    ss << "permessage-deflate";
+    if(server_no_context_takeover) {
+        ss << "; server_no_context_takeover";
+    }
+    if(client_no_context_takeover) {
+        ss << "; client_no_context_takeover";
+    }
+    if(server_max_window_bits < 15) {
+        ss << "; server_max_window_bits=" << server_max_window_bits;
+    }
+    if(client_max_window_bits < 15) {
+        ss << "; client_max_window_bits=" << client_max_window_bits;
+    }
+    return ss.str();
+}
+
+namespace {
+struct Offer {
+    WSDeflate::Params params;
+    bool has_server_bits = false;
+    bool has_client_bits = false;
+};
+}
+
+static bool ParseBits(const std::string& v, int& bits) {
+    if(v.empty() || v.size() > 2
+            || !std::all_of(v.begin(), v.end(), ::isdigit)) {
+        return false;
+    }
+    bits = atoi(v.c_str());
+    return bits >= 8 && bits <= 15;
+}
+
+/**
+ * @brief parse one element of Sec-WebSocket-Extensions
+ * @param[in] response client_max_window_bits needs a value in responses only
+ * @return false when it is not permessage-deflate or has invalid parameters
+ */
+static bool ParseOffer(const std::string& str, bool response, Offer& offer) {
+    auto parts = split(str, ';');
+    if(parts.empty() || StringUtil::Trim(parts[0]) != "permessage-deflate") {
+        return false;
+    }
+    bool server_nct = false;
+    bool client_nct = false;
+    for(size_t i = 1; i < parts.size(); ++i) {
+        std::string key = StringUtil::Trim(parts[i]);
+        std::string value;
+        bool has_value = false;
+        size_t pos = key.find('=');
+        if(pos != std::string::npos) {
+            value = StringUtil::Trim(key.substr(pos + 1), " \t\"");
+            key = StringUtil::Trim(key.substr(0, pos));
+            has_value = true;
+        }
+        if(key == "server_no_context_takeover") {
+            if(has_value || server_nct) {
+                return false;
+            }
+            server_nct = offer.params.server_no_context_takeover = true;
+        } else if(key == "client_no_context_takeover") {
+            if(has_value || client_nct) {
+                return false;
+            }
+            client_nct = offer.params.client_no_context_takeover = true;
+        } else if(key == "server_max_window_bits") {
+            if(offer.has_server_bits
+                    || !ParseBits(value, offer.params.server_max_window_bits)) {
+                return false;
+            }
+            offer.has_server_bits = true;
+        } else if(key == "client_max_window_bits") {
+            if(offer.has_client_bits) {
+                return false;
+            }
+            if((has_value || response)
+                    && !ParseBits(value, offer.params.client_max_window_bits)) {
+                return false;
+            }
+            offer.has_client_bits = true;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+WSDeflate::ptr WSDeflate::Negotiate(const std::string& offers, std::string& response) {
+    if(!g_ws_deflate_enable->getValue()) {
+        return nullptr;
+    }
+    int max_bits = std::max(9, std::min(15, (int)g_ws_deflate_max_window_bits->getValue()));
+    for(auto& i : split(offers, ',')) {
+        Offer offer;
+        if(!ParseOffer(i, false, offer)) {
+            continue;
+        }
+        Params p;
+        p.server_no_context_takeover = offer.params.server_no_context_takeover
+                        || g_ws_deflate_server_no_context_takeover->getValue();
+        p.client_no_context_takeover = offer.params.client_no_context_takeover
+                        || g_ws_deflate_client_no_context_takeover->getValue();
+        p.server_max_window_bits = std::min(max_bits, offer.params.server_max_window_bits);
+        if(p.server_max_window_bits < 9) {
+            //zlib can not compress with a 256 byte window
+            continue;
+        }
+        //without the parameter in the offer the client window can not be limited
+        if(offer.has_client_bits) {
+            p.client_max_window_bits = std::min(max_bits, offer.params.client_max_window_bits);
+        }
+        response = p.toString();
+        return std::make_shared<WSDeflate>(p, false);
+    }
+    return nullptr;
+}
+
+std::string WSDeflate::ClientOffer() {
+    return "permessage-deflate; client_max_window_bits";
+}
+
+WSDeflate::ptr WSDeflate::ClientAccept(const std::string& response) {
+    auto items = split(response, ',');
+    if(items.size() != 1) {
+        return nullptr;
+    }
+    Offer offer;
+    if(!ParseOffer(items[0], true, offer)
+            || offer.params.client_max_window_bits < 9) {
+        TAO_LOG_INFO(g_logger) << "invalid permessage-deflate response: " << response;
+        return nullptr;
+    }
+    return std::make_shared<WSDeflate>(offer.params, true);
+}
+
+WSDeflate::WSDeflate(const Params& params, bool client)
+    :m_params(params)
+    ,m_client(client) {
+}
+
+WSDeflate::~WSDeflate() {
+}
+
+bool WSDeflate::beginFrame(int opcode, size_t size) {
+    //CONTINUE = 0, TEXT_FRAME = 1, BIN_FRAME = 2
+    if(opcode == 1 || opcode == 2) {
+        m_sending = size >= g_ws_deflate_min_size->getValue();
+    } else if(opcode != 0) {
+        return false;
+    }
+    return m_sending;
+}
+
+ZlibStream::ptr WSDeflate::acquire(bool encode) {
+    ZlibStream::ptr& s = encode ? m_deflater : m_inflater;
+    if(s) {
+        return s;
+    }
+    //the compressor of this side, or the one of the peer whose output we inflate
+    bool server_side = encode != m_client;
+    int bits = server_side ? m_params.server_max_window_bits : m_params.client_max_window_bits;
+    auto& pool = t_pool[bits << 1 | (int)encode];
+    if(!pool.empty()) {
+        s = pool.back();
+        pool.pop_back();
+        return s;
+    }
+    int level = g_ws_deflate_level->getValue();
+    if(level < 1 || level > 9) {
+        level = ZlibStream::DEFAULT_COMPRESSION;
+    }
+    int memlevel = std::max(1, std::min(9, (int)g_ws_deflate_mem_level->getValue()));
+    s = ZlibStream::Create(encode, s_zlib_buff_size, ZlibStream::DEFLATE
+                , level, bits, memlevel);
+    return s;
+}
+
+void WSDeflate::release(bool encode) {
+    ZlibStream::ptr& s = encode ? m_deflater : m_inflater;
+    bool server_side = encode != m_client;
+    bool no_takeover = server_side ? m_params.server_no_context_takeover
+                        : m_params.client_no_context_takeover;
+    if(!no_takeover) {
+        s->clearBuffers();
+        return;
+    }
+    int bits = server_side ? m_params.server_max_window_bits : m_params.client_max_window_bits;
+    auto& pool = t_pool[bits << 1 | (int)encode];
+    if(pool.size() < g_ws_deflate_pool_size->getValue() && s->reset() == Z_OK) {
+        pool.push_back(s);
+    }
+    s.reset();
+}
+
+bool WSDeflate::compress(const void* data, size_t size, bool fin, std::string& out) {
+    ZlibStream::ptr s = acquire(true);
+    if(!s) {
+        return false;
+    }
+    if(s->write(data, size) != Z_OK || s->syncFlush() != Z_OK) {
+        m_deflater.reset();
+        return false;
+    }
+    out = s->getResult();
+    if(!fin) {
+        s->clearBuffers();
+        return true;
+    }
+    if(out.size() >= 4 && !memcmp(&out[out.size() - 4], s_flush_tail, 4)) {
+        out.resize(out.size() - 4);
+    }
+    release(true);
+    return true;
+}
+
+int WSDeflate::decompress(std::string& data, uint64_t max_size) {
+    ZlibStream::ptr s = acquire(false);
+    if(!s) {
+        return -1;
+    }
+    data.append(s_flush_tail, sizeof(s_flush_tail));
+    for(size_t pos = 0; pos < data.size(); pos += s_inflate_chunk) {
+        size_t len = std::min(s_inflate_chunk, data.size() - pos);
+        if(s->write(&data[pos], len) != Z_OK) {
+            m_inflater.reset();
+            return -1;
+        }
+        uint64_t total = 0;
+        for(auto& i : s->getBuffers()) {
+            total += i.iov_len;
+        }
+        if(total > max_size) {
+            m_inflater.reset();
+            return -2;
+        }
+    }
+    data.clear();
+    for(auto& i : s->getBuffers()) {
+        data.append((const char*)i.iov_base, i.iov_len);
+    }
+    release(false);
+    return 0;
+}
+
+}
+}
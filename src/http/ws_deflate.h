@@ -0,0 +1,86 @@
+#ifndef __TAO_HTTP_WS_DEFLATE_H__
+#define __TAO_HTTP_WS_DEFLATE_H__
+
+#include "src/streams/zlib_stream.h"
+#include <memory>
+#include <string>
+
+namespace tao {
+namespace http {
+
+/**
+ * @brief permessage-deflate extension(RFC 7692) of one websocket session
+ * a direction without context takeover borrows a zlib stream from a per thread pool
+ * for each message, so idle sessions hold no deflate state at all
+ */
+class WSDeflate {
+public:
+    using ptr = std::shared_ptr<WSDeflate>;
+
+    struct Params {
+        bool server_no_context_takeover = false;
+        bool client_no_context_takeover = false;
+        //LZ77 window of the server and client compressor, 8-15
+        int server_max_window_bits = 15;
+        int client_max_window_bits = 15;
+
+        std::string toString() const;
+    };
+
+    /**
+     * @brief server side, pick the first acceptable offer of Sec-WebSocket-Extensions
+     * @param[out] response value of Sec-WebSocket-Extensions to answer with
+     * @return nullptr when disabled or no offer is acceptable
+     */
+    static WSDeflate::ptr Negotiate(const std::string& offers, std::string& response);
+
+    /**
+     * @brief client side offer for Sec-WebSocket-Extensions
+     */
+    static std::string ClientOffer();
+
+    /**
+     * @brief client side, create from the Sec-WebSocket-Extensions of server response
+     * @return nullptr when the response does not enable permessage-deflate or is invalid
+     */
+    static WSDeflate::ptr ClientAccept(const std::string& response);
+
+    WSDeflate(const Params& params, bool client);
+    ~WSDeflate();
+
+    const Params& getParams() const { return m_params;}
+    bool isClient() const { return m_client;}
+
+    /**
+     * @brief whether a data frame of this opcode is sent compressed(RSV1)
+     * the first frame of a message decides by its size, continuation frames follow it
+     */
+    bool beginFrame(int opcode, size_t size);
+
+    /**
+     * @brief compress one frame of the message being sent
+     * @param[in] fin last frame, the trailing 00 00 ff ff is removed
+     */
+    bool compress(const void* data, size_t size, bool fin, std::string& out);
+
+    /**
+     * @brief inflate a whole received message in place
+     * @return 0 success, -1 corrupted data, -2 output exceeds max_size
+     */
+    int decompress(std::string& data, uint64_t max_size);
+private:
+    ZlibStream::ptr acquire(bool encode);
+    void release(bool encode);
+private:
+    Params m_params;
+    bool m_client;
+    bool m_sending = false;
+    //kept across messages only with context takeover
+    ZlibStream::ptr m_deflater;
+    ZlibStream::ptr m_inflater;
+};
+
+}
+}
+
+#endif
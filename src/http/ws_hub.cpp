@@ -0,0 +1,309 @@
+#include "ws_hub.h"
+#include "src/config.h"
+#include "src/log.h"
+#include <sstream>
+
+namespace tao {
+namespace http {
+
+static tao::Logger::ptr g_logger = TAO_LOG_NAME("system");
+
+static tao::ConfigVar<uint32_t>::ptr g_ws_hub_max_queue =
+    tao::Config::Lookup("websocket.hub.max_queue"
+                ,(uint32_t)1024, "frames queued per websocket session before it is dropped");
+
+static tao::ConfigVar<uint64_t>::ptr g_ws_hub_max_queue_bytes =
+    tao::Config::Lookup("websocket.hub.max_queue_bytes"
+                ,(uint64_t)4 * 1024 * 1024, "bytes queued per websocket session before it is dropped");
+
+//frames written by one writev
+static const size_t s_max_iov = 64;
+
+std::string WSHub::Stats::toString() const {
+    std::stringstream ss;
+    ss << "[WSHub subscribers=" << subscribers
+       << " published=" << published
+       << " delivered=" << delivered
+       << " dropped=" << dropped
+       << "]";
+    return ss.str();
+}
+
+WSHub::Frame WSHub::Message::getFrame(int variant) {
+    MutexType::Lock lock(mutex);
+    auto it = frames.find(variant);
+    if(it != frames.end()) {
+        return it->second;
+    }
+    Frame frame;
+    if(variant) {
+        //no context takeover, so the output is the same for every session of this window
+        WSDeflate::Params params;
+        params.server_no_context_takeover = true;
+        params.server_max_window_bits = variant;
+        WSDeflate deflate(params, false);
+        std::string z;
+        if(deflate.beginFrame(opcode, data.size())
+                && deflate.compress(data.c_str(), data.size(), true, z)) {
+            frame = std::make_shared<const std::string>(
+                        WSEncodeFrame(opcode, z.c_str(), z.size(), true, true));
+        }
+    }
+    if(!frame) {
+        auto pit = frames.find(0);
+        if(pit != frames.end()) {
+            frame = pit->second;
+        } else {
+            frame = std::make_shared<const std::string>(
+                        WSEncodeFrame(opcode, data.c_str(), data.size()));
+            frames[0] = frame;
+        }
+    }
+    frames[variant] = frame;
+    return frame;
+}
+
+WSHub::WSHub(IOManager* worker, uint32_t shards)
+    :m_worker(worker)
+    ,m_shardCount(shards ? shards : 1)
+    ,m_shards(new Shard[m_shardCount]) {
+}
+
+WSHub::Shard& WSHub::getShard(WSSession* session) {
+    return m_shards[((uintptr_t)session >> 6) % m_shardCount];
+}
+
+bool WSHub::subscribe(const std::string& topic, WSSession::ptr session) {
+    if(!session || !session->isConnected()) {
+        return false;
+    }
+    Shard& shard = getShard(session.get());
+    RWMutexType::WriteLock lock(shard.mutex);
+    Subscriber::ptr& sub = shard.subscribers[session.get()];
+    if(!sub) {
+        sub = std::make_shared<Subscriber>();
+        sub->session = session;
+        auto deflate = session->getDeflate();
+        if(deflate && deflate->getParams().server_no_context_takeover) {
+            sub->variant = deflate->getParams().server_max_window_bits;
+        }
+        ++m_subscribers;
+    }
+    if(sub->topics.insert(topic).second) {
+        shard.topics[topic].insert(sub);
+    }
+    return true;
+}
+
+void WSHub::unsubscribe(const std::string& topic, WSSession::ptr session) {
+    Shard& shard = getShard(session.get());
+    RWMutexType::WriteLock lock(shard.mutex);
+    auto it = shard.subscribers.find(session.get());
+    if(it == shard.subscribers.end()) {
+        return;
+    }
+    Subscriber::ptr sub = it->second;
+    if(!sub->topics.erase(topic)) {
+        return;
+    }
+    auto tit = shard.topics.find(topic);
+    if(tit != shard.topics.end()) {
+        tit->second.erase(sub);
+        if(tit->second.empty()) {
+            shard.topics.erase(tit);
+        }
+    }
+    if(sub->topics.empty()) {
+        shard.subscribers.erase(it);
+        --m_subscribers;
+    }
+}
+
+void WSHub::unsubscribeAll(WSSession::ptr session) {
+    Subscriber::ptr sub;
+    {
+        Shard& shard = getShard(session.get());
+        RWMutexType::ReadLock lock(shard.mutex);
+        auto it = shard.subscribers.find(session.get());
+        if(it == shard.subscribers.end()) {
+            return;
+        }
+        sub = it->second;
+    }
+    drop(sub, false);
+}
+
+void WSHub::publish(const std::string& topic, const std::string& data, int opcode) {
+    doPublish(topic, false, data, opcode);
+}
+
+void WSHub::broadcast(const std::string& data, int opcode) {
+    doPublish("", true, data, opcode);
+}
+
+void WSHub::doPublish(const std::string& topic, bool all, const std::string& data, int opcode) {
+    ++m_published;
+    Message::ptr msg = std::make_shared<Message>();
+    msg->data = data;
+    msg->opcode = opcode;
+    for(uint32_t i = 0; i < m_shardCount; ++i) {
+        Shard* shard = &m_shards[i];
+        {
+            MutexType::Lock lock(shard->pendingMutex);
+            shard->pending.push_back(Publish{topic, all, msg});
+            if(shard->delivering) {
+                continue;
+            }
+            shard->delivering = true;
+        }
+        m_worker->schedule(std::bind(&WSHub::deliverPending, shared_from_this(), shard));
+    }
+}
+
+void WSHub::deliverPending(Shard* shard) {
+    while(true) {
+        Publish pub;
+        {
+            MutexType::Lock lock(shard->pendingMutex);
+            if(shard->pending.empty()) {
+                shard->delivering = false;
+                return;
+            }
+            pub = std::move(shard->pending.front());
+            shard->pending.pop_front();
+        }
+        deliver(shard, pub);
+    }
+}
+
+void WSHub::deliver(Shard* shard, const Publish& pub) {
+    std::vector<Subscriber::ptr> subs;
+    {
+        RWMutexType::ReadLock lock(shard->mutex);
+        if(pub.all) {
+            subs.reserve(shard->subscribers.size());
+            for(auto& i : shard->subscribers) {
+                subs.push_back(i.second);
+            }
+        } else {
+            auto it = shard->topics.find(pub.topic);
+            if(it == shard->topics.end()) {
+                return;
+            }
+            subs.assign(it->second.begin(), it->second.end());
+        }
+    }
+    //window bits are at most 15
+    Frame frames[16];
+    for(auto& i : subs) {
+        Frame& frame = frames[i->variant & 15];
+        if(!frame) {
+            frame = pub.msg->getFrame(i->variant);
+        }
+        enqueue(i, frame);
+    }
+}
+
+void WSHub::enqueue(Subscriber::ptr sub, const Frame& frame) {
+    bool start = false;
+    {
+        MutexType::Lock lock(sub->mutex);
+        if(sub->dropped) {
+            return;
+        }
+        //an empty queue takes any frame, so one large message can not drop everyone
+        if(!sub->queue.empty()
+                && (sub->queue.size() >= g_ws_hub_max_queue->getValue()
+                    || sub->bytes + frame->size() > g_ws_hub_max_queue_bytes->getValue())) {
+            lock.unlock();
+            drop(sub, true);
+            return;
+        }
+        sub->queue.push_back(frame);
+        sub->bytes += frame->size();
+        if(!sub->writing) {
+            sub->writing = true;
+            start = true;
+        }
+    }
+    ++m_delivered;
+    if(start) {
+        m_worker->schedule(std::bind(&WSHub::flush, shared_from_this(), sub));
+    }
+}
+
+void WSHub::flush(Subscriber::ptr sub) {
+    std::vector<Frame> frames;
+    iovec iov[s_max_iov];
+    while(true) {
+        frames.clear();
+        {
+            MutexType::Lock lock(sub->mutex);
+            if(sub->dropped || sub->queue.empty()) {
+                sub->writing = false;
+                return;
+            }
+            size_t n = std::min(sub->queue.size(), s_max_iov);
+            for(size_t i = 0; i < n; ++i) {
+                sub->bytes -= sub->queue.front()->size();
+                frames.push_back(std::move(sub->queue.front()));
+                sub->queue.pop_front();
+            }
+        }
+        for(size_t i = 0; i < frames.size(); ++i) {
+            iov[i].iov_base = (void*)frames[i]->c_str();
+            iov[i].iov_len = frames[i]->size();
+        }
+        if(sub->session->writevFixSize(iov, frames.size()) <= 0) {
+            drop(sub, false);
+            return;
+        }
+    }
+}
+
+void WSHub::drop(Subscriber::ptr sub, bool slow) {
+    {
+        MutexType::Lock lock(sub->mutex);
+        if(sub->dropped) {
+            return;
+        }
+        sub->dropped = true;
+        sub->queue.clear();
+        sub->bytes = 0;
+    }
+    Shard& shard = getShard(sub->session.get());
+    {
+        RWMutexType::WriteLock lock(shard.mutex);
+        auto it = shard.subscribers.find(sub->session.get());
+        if(it != shard.subscribers.end() && it->second == sub) {
+            for(auto& t : sub->topics) {
+                auto tit = shard.topics.find(t);
+                if(tit != shard.topics.end()) {
+                    tit->second.erase(sub);
+                    if(tit->second.empty()) {
+                        shard.topics.erase(tit);
+                    }
+                }
+            }
+            shard.subscribers.erase(it);
+            --m_subscribers;
+        }
+    }
+    if(slow) {
+        ++m_dropped;
+        TAO_LOG_INFO(g_logger) << "WSHub drop slow session " << *sub->session->getSocket();
+        sub->session->close();
+    }
+}
+
+WSHub::Stats WSHub::getStats() const {
+    Stats stats;
+    stats.subscribers = m_subscribers;
+    stats.published = m_published;
+    stats.delivered = m_delivered;
+    stats.dropped = m_dropped;
+    return stats;
+}
+
+}
+}
@@ -0,0 +1,131 @@
+#ifndef __TAO_HTTP_WS_HUB_H__
+#define __TAO_HTTP_WS_HUB_H__
+
+#include "ws_session.h"
+#include "../iomanager.h"
+#include "../mutex.h"
+#include <atomic>
+#include <memory>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace tao {
+namespace http {
+
+/**
+ * @brief topic based fan-out of websocket messages
+ * a published message is framed once(plus once per deflate window size for
+ * sessions without server context takeover) and every subscriber queues a reference
+ * to the same buffer. subscribers live in shards, each shard is delivered by its
+ * own task on the worker, a writer fiber per session runs only while its queue is not empty.
+ * a session whose queue exceeds websocket.hub.max_queue frames or
+ * websocket.hub.max_queue_bytes is dropped and closed
+ */
+class WSHub : public std::enable_shared_from_this<WSHub> {
+public:
+    using ptr = std::shared_ptr<WSHub>;
+    using RWMutexType = RWMutex;
+    using MutexType = Mutex;
+    using Frame = std::shared_ptr<const std::string>;
+
+    struct Stats {
+        uint64_t subscribers = 0;
+        uint64_t published = 0;
+        //frames queued to sessions
+        uint64_t delivered = 0;
+        //sessions dropped as slow consumers
+        uint64_t dropped = 0;
+
+        std::string toString() const;
+    };
+
+    /**
+     * @param[in] worker runs deliveries and writer fibers
+     * @param[in] shards number of subscriber shards
+     */
+    WSHub(IOManager* worker = IOManager::GetThis(), uint32_t shards = 16);
+
+    bool subscribe(const std::string& topic, WSSession::ptr session);
+    void unsubscribe(const std::string& topic, WSSession::ptr session);
+    //call from WSServlet::onClose
+    void unsubscribeAll(WSSession::ptr session);
+
+    /**
+     * @brief send data to all sessions of the topic, returns once the frame is built
+     */
+    void publish(const std::string& topic, const std::string& data
+                , int opcode = WSFrameHead::TEXT_FRAME);
+    /**
+     * @brief send data to every subscribed session
+     */
+    void broadcast(const std::string& data, int opcode = WSFrameHead::TEXT_FRAME);
+
+    Stats getStats() const;
+private:
+    struct Subscriber {
+        using ptr = std::shared_ptr<Subscriber>;
+        WSSession::ptr session;
+        //0 plain frame, otherwise the deflate window bits of a shared compressed frame
+        int variant = 0;
+        //guarded by the shard mutex
+        std::unordered_set<std::string> topics;
+
+        MutexType mutex;
+        std::deque<Frame> queue;
+        uint64_t bytes = 0;
+        bool writing = false;
+        bool dropped = false;
+    };
+
+    //a published message and its encodings, built lazily per variant
+    struct Message {
+        using ptr = std::shared_ptr<Message>;
+        std::string data;
+        int opcode;
+        MutexType mutex;
+        std::unordered_map<int, Frame> frames;
+
+        Frame getFrame(int variant);
+    };
+
+    struct Publish {
+        std::string topic;
+        //to every subscriber
+        bool all;
+        Message::ptr msg;
+    };
+
+    struct Shard {
+        RWMutexType mutex;
+        std::unordered_map<WSSession*, Subscriber::ptr> subscribers;
+        std::unordered_map<std::string, std::unordered_set<Subscriber::ptr> > topics;
+
+        //one task at a time drains it, so messages keep their publish order
+        MutexType pendingMutex;
+        std::deque<Publish> pending;
+        bool delivering = false;
+    };
+
+    Shard& getShard(WSSession* session);
+    void deliverPending(Shard* shard);
+    void deliver(Shard* shard, const Publish& pub);
+    void enqueue(Subscriber::ptr sub, const Frame& frame);
+    void flush(Subscriber::ptr sub);
+    //slow is false when the session failed or closed on its own
+    void drop(Subscriber::ptr sub, bool slow);
+    void doPublish(const std::string& topic, bool all, const std::string& data, int opcode);
+private:
+    IOManager* m_worker;
+    uint32_t m_shardCount;
+    std::unique_ptr<Shard[]> m_shards;
+    std::atomic<uint64_t> m_subscribers{0};
+    std::atomic<uint64_t> m_published{0};
+    std::atomic<uint64_t> m_delivered{0};
+    std::atomic<uint64_t> m_dropped{0};
+};
+
+}
+}
+
+#endif
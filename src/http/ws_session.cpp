@@ -2,6 +2,10 @@
 #include "src/log.h"
 #include "src/endian.h"
 #include "src/utils/hash_util.h"
+#include <algorithm>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 
 namespace tao {
@@ -27,7 +31,15 @@ std::string WSFrameHead::toString() const {
 }
 
 WSSession::WSSession(Socket::ptr sock, bool owner)
-    :HttpSession(sock, owner){
+    :HttpSession(sock, owner)
+    ,m_sendSem(1) {
+}
+
+int WSSession::writevFixSize(const iovec* iov, size_t iovcnt) {
+    m_sendSem.wait();
+    int rt = HttpSession::writevFixSize(iov, iovcnt);
+    m_sendSem.notify();
+    return rt;
 }
 
 HttpRequest::ptr WSSession::handleShake() {
@@ -68,6 +80,15 @@ HttpRequest::ptr WSSession::handleShake() {
         rsp->setHeader("Connection", "Upgrade");
         rsp->setHeader("Sec-WebSocket-Accept", v);
 
+        std::string extensions = req->getHeader("Sec-WebSocket-Extensions");
+        if(!extensions.empty()) {
+            std::string accepted;
+            m_deflate = WSDeflate::Negotiate(extensions, accepted);
+            if(m_deflate) {
+                rsp->setHeader("Sec-WebSocket-Extensions", accepted);
+            }
+        }
+
         sendResponse(rsp);
         TAO_LOG_DEBUG(g_logger) << *req;
         TAO_LOG_DEBUG(g_logger) << *rsp;
@@ -85,39 +106,213 @@ WSFrameMessage::WSFrameMessage(int opcode, const std::string& data)
     ,m_data(data) {
 }
 
+//payload buffers kept per thread, large messages stop reallocating
+static const size_t s_buffer_pool_size = 16;
+static const size_t s_buffer_max_capacity = 1024 * 1024;
+static thread_local std::vector<std::string> t_buffers;
+
+static std::string AcquireBuffer() {
+    if(t_buffers.empty()) {
+        return std::string();
+    }
+    std::string buf = std::move(t_buffers.back());
+    t_buffers.pop_back();
+    return buf;
+}
+
+static void ReleaseBuffer(std::string&& buf) {
+    if(buf.capacity() < 64 || buf.capacity() > s_buffer_max_capacity
+            || t_buffers.size() >= s_buffer_pool_size) {
+        return;
+    }
+    buf.clear();
+    t_buffers.push_back(std::move(buf));
+}
+
+WSFrameMessage::WSFrameMessage(int opcode, std::string&& data)
+    :m_opcode(opcode)
+    ,m_data(std::move(data)) {
+}
+
+WSFrameMessage::~WSFrameMessage() {
+    ReleaseBuffer(std::move(m_data));
+}
+
 WSFrameMessage::ptr WSSession::recvMessage() {
-    return WSRecvMessage(this, false);
+    return WSRecvMessage(this, false, m_deflate.get());
 }
 
 int32_t WSSession::sendMessage(WSFrameMessage::ptr msg, bool fin) {
-    return WSSendMessage(this, msg, false, fin);
+    return WSSendMessage(this, msg, false, fin, m_deflate.get());
 }
 
 int32_t WSSession::sendMessage(const std::string& msg, int32_t opcode, bool fin) {
-    return WSSendMessage(this, std::make_shared<WSFrameMessage>(opcode, msg), false, fin);
+    return WSSendMessage(this, std::make_shared<WSFrameMessage>(opcode, msg), false, fin
+                        , m_deflate.get());
 }
 
 int32_t WSSession::ping() {
     return WSPing(this);
 }
 
-WSFrameMessage::ptr WSRecvMessage(Stream* stream, bool client) {
+void WSMask(void* data, size_t length, const char mask[4]) {
+    uint8_t* p = (uint8_t*)data;
+    uint32_t m32 = 0;
+    memcpy(&m32, mask, sizeof(m32));
+    size_t i = 0;
+#ifdef __SSE2__
+    __m128i m128 = _mm_set1_epi32(m32);
+    for(; i + 16 <= length; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(p + i));
+        _mm_storeu_si128((__m128i*)(p + i), _mm_xor_si128(v, m128));
+    }
+#endif
+    uint64_t m64 = ((uint64_t)m32 << 32) | m32;
+    for(; i + 8 <= length; i += 8) {
+        uint64_t v;
+        memcpy(&v, p + i, sizeof(v));
+        v ^= m64;
+        memcpy(p + i, &v, sizeof(v));
+    }
+    //i is a multiple of 4 here
+    for(; i < length; ++i) {
+        p[i] ^= mask[i % 4];
+    }
+}
+
+//2 byte head and extended length, the mask is left to the caller
+static size_t WSEncodeHead(uint8_t* head, int opcode, size_t size
+                        , bool client, bool fin, bool rsv1) {
+    size_t head_len = sizeof(WSFrameHead);
+    WSFrameHead ws_head;
+    memset(&ws_head, 0, sizeof(ws_head));
+    ws_head.fin = fin;
+    ws_head.rsv1 = rsv1;
+    ws_head.opcode = opcode;
+    ws_head.mask = client;
+    if(size < 126) {
+        ws_head.payload = size;
+    } else if(size < 65536) {
+        ws_head.payload = 126;
+        uint16_t len = tao::byteswapOnLittleEndian((uint16_t)size);
+        memcpy(head + head_len, &len, sizeof(len));
+        head_len += sizeof(len);
+    } else {
+        ws_head.payload = 127;
+        uint64_t len = tao::byteswapOnLittleEndian((uint64_t)size);
+        memcpy(head + head_len, &len, sizeof(len));
+        head_len += sizeof(len);
+    }
+    memcpy(head, &ws_head, sizeof(ws_head));
+    return head_len;
+}
+
+std::string WSEncodeFrame(int opcode, const void* data, size_t size, bool fin, bool rsv1) {
+    uint8_t head[14];
+    size_t head_len = WSEncodeHead(head, opcode, size, false, fin, rsv1);
+    std::string frame;
+    frame.reserve(head_len + size);
+    frame.append((const char*)head, head_len);
+    frame.append((const char*)data, size);
+    return frame;
+}
+
+//one frame, header and payload sent by a single writev
+static int32_t WSSendFrame(Stream* stream, int opcode, const void* data, size_t size
+                        , bool client, bool fin, bool rsv1 = false) {
+    uint8_t head[14];
+    size_t head_len = WSEncodeHead(head, opcode, size, client, fin, rsv1);
+
+    //clients mask a copy, the message itself stays untouched
+    std::string masked;
+    if(client) {
+        char mask[4];
+        uint32_t rand_value = rand();
+        memcpy(mask, &rand_value, sizeof(mask));
+        memcpy(head + head_len, mask, sizeof(mask));
+        head_len += sizeof(mask);
+        masked = AcquireBuffer();
+        masked.assign((const char*)data, size);
+        WSMask(&masked[0], size, mask);
+        data = masked.c_str();
+    }
+
+    iovec iov[2];
+    iov[0].iov_base = head;
+    iov[0].iov_len = head_len;
+    iov[1].iov_base = (void*)data;
+    iov[1].iov_len = size;
+    int rt = stream->writevFixSize(iov, size ? 2 : 1);
+    if(client) {
+        ReleaseBuffer(std::move(masked));
+    }
+    if(rt <= 0) {
+        stream->close();
+        return -1;
+    }
+    return head_len + size;
+}
+
+WSFrameMessage::ptr WSRecvMessage(Stream* stream, bool client, WSDeflate* deflate) {
     int opcode = 0;
-    std::string data;
-    int cur_len = 0;
+    bool compressed = false;
+    std::string data = AcquireBuffer();
+    uint64_t cur_len = 0;
     do {
-        WSFrameHead ws_head;
-        if(stream->readFixSize(&ws_head, sizeof(ws_head)) <= 0) {
+        //2 byte head, then extended length and mask in one more read
+        uint8_t head[14];
+        if(stream->readFixSize(head, sizeof(WSFrameHead)) <= 0) {
             break;
         }
+        WSFrameHead ws_head;
+        memcpy(&ws_head, head, sizeof(ws_head));
         TAO_LOG_DEBUG(g_logger) << "WSFrameHead " << ws_head.toString();
 
-        if(ws_head.opcode == WSFrameHead::PING) {
-            TAO_LOG_INFO(g_logger) << "PING";
-            if(WSPong(stream) <= 0) {
+        size_t ext_len = ws_head.payload == 126 ? 2 : (ws_head.payload == 127 ? 8 : 0);
+        size_t extra = ext_len + (ws_head.mask ? 4 : 0);
+        if(extra && stream->readFixSize(head + sizeof(WSFrameHead), extra) <= 0) {
+            break;
+        }
+        uint64_t length = 0;
+        if(ws_head.payload == 126) {
+            uint16_t len = 0;
+            memcpy(&len, head + sizeof(WSFrameHead), sizeof(len));
+            length = tao::byteswapOnLittleEndian(len);
+        } else if(ws_head.payload == 127) {
+            uint64_t len = 0;
+            memcpy(&len, head + sizeof(WSFrameHead), sizeof(len));
+            length = tao::byteswapOnLittleEndian(len);
+        } else {
+            length = ws_head.payload;
+        }
+        const char* mask = (const char*)head + sizeof(WSFrameHead) + ext_len;
+
+        if(ws_head.opcode == WSFrameHead::PING
+                || ws_head.opcode == WSFrameHead::PONG
+                || ws_head.opcode == WSFrameHead::CLOSE) {
+            //control frames are small and may come between fragments
+            if(!ws_head.fin || length > 125) {
+                TAO_LOG_INFO(g_logger) << "invalid control frame " << ws_head.toString();
+                break;
+            }
+            char payload[125];
+            if(length && stream->readFixSize(payload, length) <= 0) {
+                break;
+            }
+            if(ws_head.mask) {
+                WSMask(payload, length, mask);
+            }
+            if(ws_head.opcode == WSFrameHead::PING) {
+                TAO_LOG_INFO(g_logger) << "PING";
+                if(WSSendFrame(stream, WSFrameHead::PONG, payload, length, client, true) <= 0) {
+                    break;
+                }
+            } else if(ws_head.opcode == WSFrameHead::CLOSE) {
+                //echo the status code back and stop
+                WSSendFrame(stream, WSFrameHead::CLOSE, payload, std::min(length, (uint64_t)2)
+                        , client, true);
                 break;
             }
-        } else if(ws_head.opcode == WSFrameHead::PONG) {
         } else if(ws_head.opcode == WSFrameHead::CONTINUE
                 || ws_head.opcode == WSFrameHead::TEXT_FRAME
                 || ws_head.opcode == WSFrameHead::BIN_FRAME) {
@@ -125,114 +320,69 @@ WSFrameMessage::ptr WSRecvMessage(Stream* stream, bool client) {
                 TAO_LOG_INFO(g_logger) << "WSFrameHead mask != 1";
                 break;
             }
-            uint64_t length = 0;
-            if(ws_head.payload == 126) {
-                uint16_t len = 0;
-                if(stream->readFixSize(&len, sizeof(len)) <= 0) {
-                    break;
-                }
-                length = tao::byteswapOnLittleEndian(len);
-            } else if(ws_head.payload == 127) {
-                uint64_t len = 0;
-                if(stream->readFixSize(&len, sizeof(len)) <= 0) {
-                    break;
-                }
-                length = tao::byteswapOnLittleEndian(len);
-            } else {
-                length = ws_head.payload;
+            //RSV1 marks a compressed message, only on its first frame
+            if(ws_head.rsv1 && (!deflate || ws_head.opcode == WSFrameHead::CONTINUE)) {
+                TAO_LOG_INFO(g_logger) << "unexpected rsv1 " << ws_head.toString();
+                break;
             }
-
             if((cur_len + length) >= g_websocket_message_max_size->getValue()) {
                 TAO_LOG_WARN(g_logger) << "WSFrameMessage length > "
                     << g_websocket_message_max_size->getValue()
                     << " (" << (cur_len + length) << ")";
                 break;
             }
-
-            char mask[4] = {0};
-            if(ws_head.mask) {
-                if(stream->readFixSize(mask, sizeof(mask)) <= 0) {
-                    break;
-                }
-            }
+            //payload is read straight into the message buffer and unmasked in place
             data.resize(cur_len + length);
-            if(stream->readFixSize(&data[cur_len], length) <= 0) {
+            if(length && stream->readFixSize(&data[cur_len], length) <= 0) {
                 break;
             }
             if(ws_head.mask) {
-                for(int i = 0; i < (int)length; ++i) {
-                    data[cur_len + i] ^= mask[i % 4];
-                }
+                WSMask(&data[cur_len], length, mask);
             }
             cur_len += length;
 
             if(!opcode && ws_head.opcode != WSFrameHead::CONTINUE) {
                 opcode = ws_head.opcode;
+                compressed = ws_head.rsv1;
             }
 
             if(ws_head.fin) {
-                TAO_LOG_DEBUG(g_logger) << data;
-                return WSFrameMessage::ptr(new WSFrameMessage(opcode, std::move(data)));
+                if(compressed) {
+                    int rt = deflate->decompress(data, g_websocket_message_max_size->getValue());
+                    if(rt) {
+                        TAO_LOG_WARN(g_logger) << "permessage-deflate decompress error rt=" << rt;
+                        break;
+                    }
+                }
+                return std::make_shared<WSFrameMessage>(opcode, std::move(data));
             }
         } else {
             TAO_LOG_DEBUG(g_logger) << "invalid opcode=" << ws_head.opcode;
+            break;
         }
     } while(true);
+    ReleaseBuffer(std::move(data));
     stream->close();
     return nullptr;
 }
 
-int32_t WSSendMessage(Stream* stream, WSFrameMessage::ptr msg, bool client, bool fin) {
-    do {
-        WSFrameHead ws_head;
-        memset(&ws_head, 0, sizeof(ws_head));
-        ws_head.fin = fin;
-        ws_head.opcode = msg->getOpcode();
-        ws_head.mask = client;
-        uint64_t size = msg->getData().size();
-        if(size < 126) {
-            ws_head.payload = size;
-        } else if(size < 65536) {
-            ws_head.payload = 126;
-        } else {
-            ws_head.payload = 127;
-        }
-        
-        if(stream->writeFixSize(&ws_head, sizeof(ws_head)) <= 0) {
-            break;
-        }
-        if(ws_head.payload == 126) {
-            uint16_t len = size;
-            len = tao::byteswapOnLittleEndian(len);
-            if(stream->writeFixSize(&len, sizeof(len)) <= 0) {
-                break;
-            }
-        } else if(ws_head.payload == 127) {
-            uint64_t len = tao::byteswapOnLittleEndian(size);
-            if(stream->writeFixSize(&len, sizeof(len)) <= 0) {
-                break;
-            }
-        }
-        if(client) {
-            char mask[4];
-            uint32_t rand_value = rand();
-            memcpy(mask, &rand_value, sizeof(mask));
-            std::string& data = msg->getData();
-            for(size_t i = 0; i < data.size(); ++i) {
-                data[i] ^= mask[i % 4];
-            }
-
-            if(stream->writeFixSize(mask, sizeof(mask)) <= 0) {
-                break;
-            }
-        }
-        if(stream->writeFixSize(msg->getData().c_str(), size) <= 0) {
-            break;
-        }
-        return size + sizeof(ws_head);
-    } while(0);
-    stream->close();
-    return -1;
+int32_t WSSendMessage(Stream* stream, WSFrameMessage::ptr msg, bool client, bool fin
+                    , WSDeflate* deflate) {
+    const std::string& data = msg->getData();
+    if(!deflate || !deflate->beginFrame(msg->getOpcode(), data.size())) {
+        return WSSendFrame(stream, msg->getOpcode(), data.c_str(), data.size(), client, fin);
+    }
+    std::string out = AcquireBuffer();
+    if(!deflate->compress(data.c_str(), data.size(), fin, out)) {
+        TAO_LOG_WARN(g_logger) << "permessage-deflate compress error";
+        ReleaseBuffer(std::move(out));
+        stream->close();
+        return -1;
+    }
+    int32_t rt = WSSendFrame(stream, msg->getOpcode(), out.c_str(), out.size(), client, fin
+                        , msg->getOpcode() != WSFrameHead::CONTINUE);
+    ReleaseBuffer(std::move(out));
+    return rt;
 }
 
 int32_t WSSession::pong() {
@@ -240,28 +390,12 @@ int32_t WSSession::pong() {
 }
 
 int32_t WSPing(Stream* stream) {
-    WSFrameHead ws_head;
-    memset(&ws_head, 0, sizeof(ws_head));
-    ws_head.fin = 1;
-    ws_head.opcode = WSFrameHead::PING;
-    int32_t v = stream->writeFixSize(&ws_head, sizeof(ws_head));
-    if(v <= 0) {
-        stream->close();
-    }
-    return v;
+    return WSSendFrame(stream, WSFrameHead::PING, nullptr, 0, false, true);
 }
 
 int32_t WSPong(Stream* stream) {
-    WSFrameHead ws_head;
-    memset(&ws_head, 0, sizeof(ws_head));
-    ws_head.fin = 1;
-    ws_head.opcode = WSFrameHead::PONG;
-    int32_t v = stream->writeFixSize(&ws_head, sizeof(ws_head));
-    if(v <= 0) {
-        stream->close();
-    }
-    return v;
+    return WSSendFrame(stream, WSFrameHead::PONG, nullptr, 0, false, true);
 }
 
 }
-}
\ No newline at end of file
+}
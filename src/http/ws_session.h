@@ -3,6 +3,8 @@
 
 #include "src/config.h"
 #include "src/http/http_session.h"
+#include "src/http/ws_deflate.h"
+#include "src/mutex.h"
 #include "src/config.h"
 #include <stdint.h>
 
@@ -40,6 +42,9 @@ class WSFrameMessage {
 public:
     typedef std::shared_ptr<WSFrameMessage> ptr;
     WSFrameMessage(int opcode = 0, const std::string& data = "");
+    WSFrameMessage(int opcode, std::string&& data);
+    //payload buffer goes back to the per thread pool
+    ~WSFrameMessage();
 
     int getOpcode() const { return m_opcode;}
     void setOpcode(int v) { m_opcode = v;}
@@ -64,18 +69,41 @@ public:
     int32_t sendMessage(const std::string& msg, int32_t opcode = WSFrameHead::TEXT_FRAME, bool fin = true);
     int32_t ping();
     int32_t pong();
+
+    //permessage-deflate state, nullptr when not negotiated
+    WSDeflate::ptr getDeflate() const { return m_deflate;}
+
+    /**
+     * @brief frames are written one at a time, so WSHub deliveries and
+     * the session's own messages never interleave on the socket
+     */
+    virtual int writevFixSize(const iovec* iov, size_t iovcnt) override;
 private:
     bool handleServerShake();
     bool handleClientShake();
+private:
+    WSDeflate::ptr m_deflate;
+    FiberSemaphore m_sendSem;
 
 };
 
 extern tao::ConfigVar<uint32_t>::ptr g_websocket_message_max_size;
-WSFrameMessage::ptr WSRecvMessage(Stream* stream, bool client);
-int32_t WSSendMessage(Stream* stream, WSFrameMessage::ptr msg, bool client, bool fin);
+WSFrameMessage::ptr WSRecvMessage(Stream* stream, bool client, WSDeflate* deflate = nullptr);
+int32_t WSSendMessage(Stream* stream, WSFrameMessage::ptr msg, bool client, bool fin
+                    , WSDeflate* deflate = nullptr);
 int32_t WSPing(Stream* stream);
 int32_t WSPong(Stream* stream);
 
+/**
+ * @brief encode an unmasked(server side) frame, header and payload in one buffer
+ */
+std::string WSEncodeFrame(int opcode, const void* data, size_t size, bool fin = true, bool rsv1 = false);
+
+/**
+ * @brief xor data with the 4 byte websocket mask, 16 or 8 bytes at a time
+ */
+void WSMask(void* data, size_t length, const char mask[4]);
+
 }
 
 }
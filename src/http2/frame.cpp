@@ -0,0 +1,350 @@
+#include "frame.h"
+#include "src/log.h"
+#include <sstream>
+
+namespace tao {
+namespace http2 {
+
+static tao::Logger::ptr g_logger = TAO_LOG_NAME("system");
+
+const char* Http2ErrorToString(Http2Error e) {
+    switch(e) {
+#define XX(code, name) \
+        case Http2Error::name: \
+            return #name;
+        HTTP2_ERROR_MAP(XX)
+#undef XX
+        default:
+            return "UNKNOWN";
+    }
+}
+
+static const char* s_frame_types[] = {
+    "DATA",
+    "HEADERS",
+    "PRIORITY",
+    "RST_STREAM",
+    "SETTINGS",
+    "PUSH_PROMISE",
+    "PING",
+    "GOAWAY",
+    "WINDOW_UPDATE",
+    "CONTINUATION",
+};
+
+const char* FrameTypeToString(FrameType t) {
+    uint8_t idx = (uint8_t)t;
+    if(idx >= sizeof(s_frame_types) / sizeof(s_frame_types[0])) {
+        return "UNKNOWN";
+    }
+    return s_frame_types[idx];
+}
+
+bool FrameHeader::writeTo(ByteArray::ptr ba) const {
+    ba->writeFuint8((uint8_t)(length >> 16));
+    ba->writeFuint16((uint16_t)length);
+    ba->writeFuint8((uint8_t)type);
+    ba->writeFuint8(flags);
+    ba->writeFuint32(stream_id & 0x7fffffff);
+    return true;
+}
+
+bool FrameHeader::readFrom(ByteArray::ptr ba) {
+    if(ba->getReadableSize() < FRAME_HEADER_SIZE) {
+        return false;
+    }
+    length = (uint32_t)ba->readFuint8() << 16;
+    length |= ba->readFuint16();
+    type = (FrameType)ba->readFuint8();
+    flags = ba->readFuint8();
+    //reserved bit is ignored on receipt
+    stream_id = ba->readFuint32() & 0x7fffffff;
+    return true;
+}
+
+std::string FrameHeader::toString() const {
+    std::stringstream ss;
+    ss << "[FrameHeader type=" << FrameTypeToString(type)
+       << " length=" << length
+       << " flags=0x" << std::hex << (uint32_t)flags << std::dec
+       << " stream_id=" << stream_id << "]";
+    return ss.str();
+}
+
+Http2Error Settings::set(uint16_t id, uint32_t value) {
+    switch((SettingsId)id) {
+        case SettingsId::HEADER_TABLE_SIZE:
+            header_table_size = value;
+            break;
+        case SettingsId::ENABLE_PUSH:
+            if(value > 1) {
+                return Http2Error::PROTOCOL_ERROR;
+            }
+            enable_push = value;
+            break;
+        case SettingsId::MAX_CONCURRENT_STREAMS:
+            max_concurrent_streams = value;
+            break;
+        case SettingsId::INITIAL_WINDOW_SIZE:
+            if(value > MAX_WINDOW_SIZE) {
+                return Http2Error::FLOW_CONTROL_ERROR;
+            }
+            initial_window_size = value;
+            break;
+        case SettingsId::MAX_FRAME_SIZE:
+            if(value < DEFAULT_MAX_FRAME_SIZE || value > 0xffffff) {
+                return Http2Error::PROTOCOL_ERROR;
+            }
+            max_frame_size = value;
+            break;
+        case SettingsId::MAX_HEADER_LIST_SIZE:
+            max_header_list_size = value;
+            break;
+        default:
+            //unknown settings must be ignored
+            break;
+    }
+    return Http2Error::NO_ERROR;
+}
+
+std::string Settings::toString() const {
+    std::stringstream ss;
+    ss << "[Settings header_table_size=" << header_table_size
+       << " enable_push=" << enable_push
+       << " max_concurrent_streams=" << max_concurrent_streams
+       << " initial_window_size=" << initial_window_size
+       << " max_frame_size=" << max_frame_size
+       << " max_header_list_size=" << max_header_list_size
+       << "]";
+    return ss.str();
+}
+
+std::string Frame::toString() const {
+    std::stringstream ss;
+    ss << header.toString() << " payload_size=" << payload.size();
+    return ss.str();
+}
+
+bool Frame::getData(std::string& data) const {
+    size_t begin = 0;
+    size_t end = payload.size();
+    if(header.hasFlag(FrameFlag::PADDED)) {
+        if(payload.empty()) {
+            return false;
+        }
+        uint8_t pad = payload[0];
+        begin = 1;
+        if(pad > end - begin) {
+            return false;
+        }
+        end -= pad;
+    }
+    if(header.type == FrameType::HEADERS && header.hasFlag(FrameFlag::PRIORITY)) {
+        //stream dependency(4) + weight(1)
+        if(end - begin < 5) {
+            return false;
+        }
+        begin += 5;
+    }
+    data.assign(payload, begin, end - begin);
+    return true;
+}
+
+Frame::ptr Frame::CreateData(uint32_t stream_id, const char* data, size_t len, bool end_stream) {
+    Frame::ptr frame = std::make_shared<Frame>();
+    frame->header.type = FrameType::DATA;
+    frame->header.stream_id = stream_id;
+    frame->header.flags = end_stream ? FrameFlag::END_STREAM : 0;
+    frame->payload.assign(data, len);
+    frame->header.length = len;
+    return frame;
+}
+
+Frame::ptr Frame::CreateHeaders(uint32_t stream_id, const std::string& block
+                                ,bool end_stream, bool end_headers) {
+    Frame::ptr frame = std::make_shared<Frame>();
+    frame->header.type = FrameType::HEADERS;
+    frame->header.stream_id = stream_id;
+    frame->header.flags = (end_stream ? FrameFlag::END_STREAM : 0)
+                        | (end_headers ? FrameFlag::END_HEADERS : 0);
+    frame->payload = block;
+    frame->header.length = block.size();
+    return frame;
+}
+
+Frame::ptr Frame::CreateContinuation(uint32_t stream_id, const std::string& block, bool end_headers) {
+    Frame::ptr frame = std::make_shared<Frame>();
+    frame->header.type = FrameType::CONTINUATION;
+    frame->header.stream_id = stream_id;
+    frame->header.flags = end_headers ? FrameFlag::END_HEADERS : 0;
+    frame->payload = block;
+    frame->header.length = block.size();
+    return frame;
+}
+
+static void AppendUint32(std::string& out, uint32_t v) {
+    out.push_back((char)(v >> 24));
+    out.push_back((char)(v >> 16));
+    out.push_back((char)(v >> 8));
+    out.push_back((char)v);
+}
+
+static uint32_t GetUint32(const std::string& in, size_t pos) {
+    const uint8_t* p = (const uint8_t*)in.c_str() + pos;
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16)
+         | ((uint32_t)p[2] << 8) | p[3];
+}
+
+Frame::ptr Frame::CreateRstStream(uint32_t stream_id, Http2Error error) {
+    Frame::ptr frame = std::make_shared<Frame>();
+    frame->header.type = FrameType::RST_STREAM;
+    frame->header.stream_id = stream_id;
+    AppendUint32(frame->payload, (uint32_t)error);
+    frame->header.length = frame->payload.size();
+    return frame;
+}
+
+Frame::ptr Frame::CreateSettings(const std::vector<std::pair<uint16_t, uint32_t> >& params, bool ack) {
+    Frame::ptr frame = std::make_shared<Frame>();
+    frame->header.type = FrameType::SETTINGS;
+    frame->header.flags = ack ? FrameFlag::ACK : 0;
+    if(!ack) {
+        for(auto& i : params) {
+            frame->payload.push_back((char)(i.first >> 8));
+            frame->payload.push_back((char)i.first);
+            AppendUint32(frame->payload, i.second);
+        }
+    }
+    frame->header.length = frame->payload.size();
+    return frame;
+}
+
+Frame::ptr Frame::CreatePing(uint64_t data, bool ack) {
+    Frame::ptr frame = std::make_shared<Frame>();
+    frame->header.type = FrameType::PING;
+    frame->header.flags = ack ? FrameFlag::ACK : 0;
+    AppendUint32(frame->payload, (uint32_t)(data >> 32));
+    AppendUint32(frame->payload, (uint32_t)data);
+    frame->header.length = frame->payload.size();
+    return frame;
+}
+
+Frame::ptr Frame::CreateGoAway(uint32_t last_stream_id, Http2Error error, const std::string& debug) {
+    Frame::ptr frame = std::make_shared<Frame>();
+    frame->header.type = FrameType::GOAWAY;
+    AppendUint32(frame->payload, last_stream_id & 0x7fffffff);
+    AppendUint32(frame->payload, (uint32_t)error);
+    frame->payload.append(debug);
+    frame->header.length = frame->payload.size();
+    return frame;
+}
+
+Frame::ptr Frame::CreateWindowUpdate(uint32_t stream_id, uint32_t increment) {
+    Frame::ptr frame = std::make_shared<Frame>();
+    frame->header.type = FrameType::WINDOW_UPDATE;
+    frame->header.stream_id = stream_id;
+    AppendUint32(frame->payload, increment & 0x7fffffff);
+    frame->header.length = frame->payload.size();
+    return frame;
+}
+
+bool Frame::ParseSettings(const std::string& payload, std::vector<std::pair<uint16_t, uint32_t> >& params) {
+    if(payload.size() % 6) {
+        return false;
+    }
+    for(size_t i = 0; i < payload.size(); i += 6) {
+        uint16_t id = ((uint16_t)(uint8_t)payload[i] << 8) | (uint8_t)payload[i + 1];
+        params.emplace_back(id, GetUint32(payload, i + 2));
+    }
+    return true;
+}
+
+bool Frame::ParseWindowUpdate(const std::string& payload, uint32_t& increment) {
+    if(payload.size() != 4) {
+        return false;
+    }
+    increment = GetUint32(payload, 0) & 0x7fffffff;
+    return true;
+}
+
+bool Frame::ParseRstStream(const std::string& payload, Http2Error& error) {
+    if(payload.size() != 4) {
+        return false;
+    }
+    error = (Http2Error)GetUint32(payload, 0);
+    return true;
+}
+
+bool Frame::ParseGoAway(const std::string& payload, uint32_t& last_stream_id, Http2Error& error) {
+    if(payload.size() < 8) {
+        return false;
+    }
+    last_stream_id = GetUint32(payload, 0) & 0x7fffffff;
+    error = (Http2Error)GetUint32(payload, 4);
+    return true;
+}
+
+Frame::ptr FrameCodec::ParseFrom(ByteArray::ptr ba, uint32_t max_frame_size) {
+    size_t pos = ba->getPosition();
+    Frame::ptr frame = std::make_shared<Frame>();
+    if(!frame->header.readFrom(ba)) {
+        return nullptr;
+    }
+    if(frame->header.length > max_frame_size
+            || ba->getReadableSize() < frame->header.length) {
+        ba->setPosition(pos);
+        return nullptr;
+    }
+    frame->payload.resize(frame->header.length);
+    if(frame->header.length) {
+        ba->read(&frame->payload[0], frame->header.length);
+    }
+    return frame;
+}
+
+bool FrameCodec::SerializeTo(ByteArray::ptr ba, Frame::ptr frame) {
+    frame->header.length = frame->payload.size();
+    frame->header.writeTo(ba);
+    if(!frame->payload.empty()) {
+        ba->write(frame->payload.c_str(), frame->payload.size());
+    }
+    return true;
+}
+
+Frame::ptr FrameCodec::RecvFrame(Stream::ptr stream, uint32_t max_frame_size, Http2Error* error) {
+    char buf[FRAME_HEADER_SIZE];
+    if(stream->readFixSize(buf, sizeof(buf)) <= 0) {
+        return nullptr;
+    }
+    ByteArray::ptr ba = std::make_shared<ByteArray>(FRAME_HEADER_SIZE);
+    ba->write(buf, sizeof(buf));
+    ba->setPosition(0);
+
+    Frame::ptr frame = std::make_shared<Frame>();
+    frame->header.readFrom(ba);
+    if(frame->header.length > max_frame_size) {
+        TAO_LOG_DEBUG(g_logger) << "recv frame too large " << frame->header.toString()
+            << " max_frame_size=" << max_frame_size;
+        if(error) {
+            *error = Http2Error::FRAME_SIZE_ERROR;
+        }
+        return nullptr;
+    }
+    if(frame->header.length) {
+        frame->payload.resize(frame->header.length);
+        if(stream->readFixSize(&frame->payload[0], frame->header.length) <= 0) {
+            return nullptr;
+        }
+    }
+    return frame;
+}
+
+int FrameCodec::SendFrame(Stream::ptr stream, Frame::ptr frame) {
+    ByteArray::ptr ba = std::make_shared<ByteArray>();
+    SerializeTo(ba, frame);
+    ba->setPosition(0);
+    return stream->writeFixSize(ba, ba->getSize());
+}
+
+}
+}
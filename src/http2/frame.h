@@ -0,0 +1,163 @@
+#ifndef __TAO_HTTP2_FRAME_H__
+#define __TAO_HTTP2_FRAME_H__
+
+#include "src/bytearray.h"
+#include "src/stream.h"
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace tao {
+namespace http2 {
+
+//client connection preface(rfc7540 3.5)
+static const char* const CLIENT_PREFACE = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+static const size_t CLIENT_PREFACE_SIZE = 24;
+
+static const uint32_t FRAME_HEADER_SIZE = 9;
+static const uint32_t DEFAULT_MAX_FRAME_SIZE = 16384;
+static const uint32_t DEFAULT_WINDOW_SIZE = 65535;
+static const uint32_t MAX_WINDOW_SIZE = 0x7fffffff;
+
+enum class FrameType : uint8_t {
+    DATA            = 0x0,
+    HEADERS         = 0x1,
+    PRIORITY        = 0x2,
+    RST_STREAM      = 0x3,
+    SETTINGS        = 0x4,
+    PUSH_PROMISE    = 0x5,
+    PING            = 0x6,
+    GOAWAY          = 0x7,
+    WINDOW_UPDATE   = 0x8,
+    CONTINUATION    = 0x9,
+};
+
+enum FrameFlag {
+    END_STREAM      = 0x1,
+    ACK             = 0x1,
+    END_HEADERS     = 0x4,
+    PADDED          = 0x8,
+    PRIORITY        = 0x20,
+};
+
+#define HTTP2_ERROR_MAP(XX) \
+    XX(0x0, NO_ERROR) \
+    XX(0x1, PROTOCOL_ERROR) \
+    XX(0x2, INTERNAL_ERROR) \
+    XX(0x3, FLOW_CONTROL_ERROR) \
+    XX(0x4, SETTINGS_TIMEOUT) \
+    XX(0x5, STREAM_CLOSED) \
+    XX(0x6, FRAME_SIZE_ERROR) \
+    XX(0x7, REFUSED_STREAM) \
+    XX(0x8, CANCEL) \
+    XX(0x9, COMPRESSION_ERROR) \
+    XX(0xa, CONNECT_ERROR) \
+    XX(0xb, ENHANCE_YOUR_CALM) \
+    XX(0xc, INADEQUATE_SECURITY) \
+    XX(0xd, HTTP_1_1_REQUIRED)
+
+enum class Http2Error : uint32_t {
+#define XX(code, name) name = code,
+    HTTP2_ERROR_MAP(XX)
+#undef XX
+};
+
+const char* Http2ErrorToString(Http2Error e);
+const char* FrameTypeToString(FrameType t);
+
+enum class SettingsId : uint16_t {
+    HEADER_TABLE_SIZE       = 0x1,
+    ENABLE_PUSH             = 0x2,
+    MAX_CONCURRENT_STREAMS  = 0x3,
+    INITIAL_WINDOW_SIZE     = 0x4,
+    MAX_FRAME_SIZE          = 0x5,
+    MAX_HEADER_LIST_SIZE    = 0x6,
+};
+
+struct FrameHeader {
+    uint32_t length = 0;        //24 bits
+    FrameType type = FrameType::DATA;
+    uint8_t flags = 0;
+    uint32_t stream_id = 0;     //31 bits
+
+    bool hasFlag(uint8_t f) const { return flags & f;}
+    bool writeTo(ByteArray::ptr ba) const;
+    bool readFrom(ByteArray::ptr ba);
+    std::string toString() const;
+};
+
+struct Settings {
+    uint32_t header_table_size = 4096;
+    uint32_t enable_push = 1;
+    uint32_t max_concurrent_streams = ~0u;
+    uint32_t initial_window_size = DEFAULT_WINDOW_SIZE;
+    uint32_t max_frame_size = DEFAULT_MAX_FRAME_SIZE;
+    uint32_t max_header_list_size = ~0u;
+
+    /**
+     * @brief apply one parameter
+     * @return NO_ERROR or the connection error of an invalid value
+     */
+    Http2Error set(uint16_t id, uint32_t value);
+    std::string toString() const;
+};
+
+class Frame {
+public:
+    using ptr = std::shared_ptr<Frame>;
+
+    FrameHeader header;
+    //raw payload, padding and priority fields included
+    std::string payload;
+
+    std::string toString() const;
+
+    /**
+     * @brief payload of DATA/HEADERS without padding and priority fields
+     * @return false on invalid padding
+     */
+    bool getData(std::string& data) const;
+
+    static Frame::ptr CreateData(uint32_t stream_id, const char* data, size_t len, bool end_stream);
+    static Frame::ptr CreateHeaders(uint32_t stream_id, const std::string& block
+                                    ,bool end_stream, bool end_headers);
+    static Frame::ptr CreateContinuation(uint32_t stream_id, const std::string& block, bool end_headers);
+    static Frame::ptr CreateRstStream(uint32_t stream_id, Http2Error error);
+    static Frame::ptr CreateSettings(const std::vector<std::pair<uint16_t, uint32_t> >& params, bool ack = false);
+    static Frame::ptr CreatePing(uint64_t data, bool ack = false);
+    static Frame::ptr CreateGoAway(uint32_t last_stream_id, Http2Error error, const std::string& debug = "");
+    static Frame::ptr CreateWindowUpdate(uint32_t stream_id, uint32_t increment);
+
+    static bool ParseSettings(const std::string& payload, std::vector<std::pair<uint16_t, uint32_t> >& params);
+    static bool ParseWindowUpdate(const std::string& payload, uint32_t& increment);
+    static bool ParseRstStream(const std::string& payload, Http2Error& error);
+    static bool ParseGoAway(const std::string& payload, uint32_t& last_stream_id, Http2Error& error);
+};
+
+/**
+ * @brief frame (de)serialization over ByteArray and Stream
+ */
+class FrameCodec {
+public:
+    using ptr = std::shared_ptr<FrameCodec>;
+
+    /**
+     * @brief parse one frame from readable part of ba
+     * @return nullptr when data is incomplete or exceeds max_frame_size
+     */
+    static Frame::ptr ParseFrom(ByteArray::ptr ba, uint32_t max_frame_size = DEFAULT_MAX_FRAME_SIZE);
+    static bool SerializeTo(ByteArray::ptr ba, Frame::ptr frame);
+
+    /**
+     * @brief read one frame from stream
+     * @param[out] error FRAME_SIZE_ERROR when the frame is larger than max_frame_size
+     */
+    static Frame::ptr RecvFrame(Stream::ptr stream, uint32_t max_frame_size, Http2Error* error = nullptr);
+    static int SendFrame(Stream::ptr stream, Frame::ptr frame);
+};
+
+}
+}
+
+#endif
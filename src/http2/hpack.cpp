@@ -0,0 +1,400 @@
+#include "hpack.h"
+#include "huffman.h"
+#include "src/log.h"
+#include <algorithm>
+#include <sstream>
+#include <unordered_map>
+#include <string.h>
+
+namespace tao {
+namespace http2 {
+
+static tao::Logger::ptr g_logger = TAO_LOG_NAME("system");
+
+//rfc7541 appendix A
+static const std::pair<const char*, const char*> s_static_table[] = {
+    {":authority", ""},
+    {":method", "GET"},
+    {":method", "POST"},
+    {":path", "/"},
+    {":path", "/index.html"},
+    {":scheme", "http"},
+    {":scheme", "https"},
+    {":status", "200"},
+    {":status", "204"},
+    {":status", "206"},
+    {":status", "304"},
+    {":status", "400"},
+    {":status", "404"},
+    {":status", "500"},
+    {"accept-charset", ""},
+    {"accept-encoding", "gzip, deflate"},
+    {"accept-language", ""},
+    {"accept-ranges", ""},
+    {"accept", ""},
+    {"access-control-allow-origin", ""},
+    {"age", ""},
+    {"allow", ""},
+    {"authorization", ""},
+    {"cache-control", ""},
+    {"content-disposition", ""},
+    {"content-encoding", ""},
+    {"content-language", ""},
+    {"content-length", ""},
+    {"content-location", ""},
+    {"content-range", ""},
+    {"content-type", ""},
+    {"cookie", ""},
+    {"date", ""},
+    {"etag", ""},
+    {"expect", ""},
+    {"expires", ""},
+    {"from", ""},
+    {"host", ""},
+    {"if-match", ""},
+    {"if-modified-since", ""},
+    {"if-none-match", ""},
+    {"if-range", ""},
+    {"if-unmodified-since", ""},
+    {"last-modified", ""},
+    {"link", ""},
+    {"location", ""},
+    {"max-forwards", ""},
+    {"proxy-authenticate", ""},
+    {"proxy-authorization", ""},
+    {"range", ""},
+    {"referer", ""},
+    {"refresh", ""},
+    {"retry-after", ""},
+    {"server", ""},
+    {"set-cookie", ""},
+    {"strict-transport-security", ""},
+    {"transfer-encoding", ""},
+    {"user-agent", ""},
+    {"vary", ""},
+    {"via", ""},
+    {"www-authenticate", ""},
+};
+
+static const uint32_t s_static_count = sizeof(s_static_table) / sizeof(s_static_table[0]);
+
+//32 bytes overhead of each entry(rfc7541 4.1)
+static const uint32_t s_entry_overhead = 32;
+
+struct StaticIndex {
+    StaticIndex() {
+        for(uint32_t i = s_static_count; i > 0; --i) {
+            const auto& e = s_static_table[i - 1];
+            names[e.first] = i;
+            if(e.second[0]) {
+                fulls[std::string(e.first) + '\0' + e.second] = i;
+            }
+        }
+    }
+    std::unordered_map<std::string, uint32_t> names;
+    std::unordered_map<std::string, uint32_t> fulls;
+};
+
+static const StaticIndex& GetStaticIndex() {
+    static StaticIndex s_index;
+    return s_index;
+}
+
+DynamicTable::DynamicTable(uint32_t max_size)
+    :m_size(0)
+    ,m_maxSize(max_size) {
+}
+
+uint32_t DynamicTable::GetStaticCount() {
+    return s_static_count;
+}
+
+void DynamicTable::add(const std::string& name, const std::string& value) {
+    uint32_t size = name.size() + value.size() + s_entry_overhead;
+    if(size > m_maxSize) {
+        //an entry larger than the table empties it(rfc7541 4.4)
+        m_datas.clear();
+        m_size = 0;
+        return;
+    }
+    evict(m_maxSize - size);
+    m_datas.emplace_front(name, value);
+    m_size += size;
+}
+
+bool DynamicTable::get(uint32_t idx, std::string& name, std::string& value) const {
+    if(idx == 0) {
+        return false;
+    }
+    if(idx <= s_static_count) {
+        name = s_static_table[idx - 1].first;
+        value = s_static_table[idx - 1].second;
+        return true;
+    }
+    idx -= s_static_count + 1;
+    if(idx >= m_datas.size()) {
+        return false;
+    }
+    name = m_datas[idx].first;
+    value = m_datas[idx].second;
+    return true;
+}
+
+uint32_t DynamicTable::find(const std::string& name, const std::string& value, bool& full) const {
+    const StaticIndex& si = GetStaticIndex();
+    auto it = si.fulls.find(name + '\0' + value);
+    if(it != si.fulls.end()) {
+        full = true;
+        return it->second;
+    }
+    uint32_t name_idx = 0;
+    for(size_t i = 0; i < m_datas.size(); ++i) {
+        if(m_datas[i].first == name) {
+            if(m_datas[i].second == value) {
+                full = true;
+                return s_static_count + 1 + i;
+            }
+            if(!name_idx) {
+                name_idx = s_static_count + 1 + i;
+            }
+        }
+    }
+    full = false;
+    auto nit = si.names.find(name);
+    if(nit != si.names.end()) {
+        return nit->second;
+    }
+    return name_idx;
+}
+
+void DynamicTable::setMaxSize(uint32_t v) {
+    m_maxSize = v;
+    evict(v);
+}
+
+void DynamicTable::evict(uint32_t max_size) {
+    while(m_size > max_size && !m_datas.empty()) {
+        auto& e = m_datas.back();
+        m_size -= e.first.size() + e.second.size() + s_entry_overhead;
+        m_datas.pop_back();
+    }
+}
+
+std::string DynamicTable::toString() const {
+    std::stringstream ss;
+    ss << "[DynamicTable size=" << m_size << " max_size=" << m_maxSize
+       << " count=" << m_datas.size() << "]";
+    for(size_t i = 0; i < m_datas.size(); ++i) {
+        ss << std::endl << (s_static_count + 1 + i) << ": "
+           << m_datas[i].first << ": " << m_datas[i].second;
+    }
+    return ss.str();
+}
+
+void HPackEncodeInteger(std::string& out, uint8_t prefix_bits, uint8_t flags, uint64_t value) {
+    uint64_t max_prefix = (1u << prefix_bits) - 1;
+    if(value < max_prefix) {
+        out.push_back((char)(flags | value));
+        return;
+    }
+    out.push_back((char)(flags | max_prefix));
+    value -= max_prefix;
+    while(value >= 0x80) {
+        out.push_back((char)((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back((char)value);
+}
+
+size_t HPackDecodeInteger(const char* data, size_t len, uint8_t prefix_bits, uint64_t& value) {
+    if(len == 0) {
+        return 0;
+    }
+    uint64_t max_prefix = (1u << prefix_bits) - 1;
+    value = (uint8_t)data[0] & max_prefix;
+    if(value < max_prefix) {
+        return 1;
+    }
+    uint32_t shift = 0;
+    for(size_t i = 1; i < len; ++i) {
+        uint8_t b = data[i];
+        //larger than 2^63 is never a sane length or index
+        if(shift > 56) {
+            return 0;
+        }
+        value += (uint64_t)(b & 0x7f) << shift;
+        shift += 7;
+        if(!(b & 0x80)) {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+static void EncodeString(std::string& out, const std::string& str) {
+    size_t hlen = Huffman::EncodedLength(str);
+    if(hlen < str.size()) {
+        HPackEncodeInteger(out, 7, 0x80, hlen);
+        Huffman::Encode(str, out);
+    } else {
+        HPackEncodeInteger(out, 7, 0, str.size());
+        out.append(str);
+    }
+}
+
+static size_t DecodeString(const char* data, size_t len, std::string& str) {
+    if(len == 0) {
+        return 0;
+    }
+    bool huffman = (uint8_t)data[0] & 0x80;
+    uint64_t slen = 0;
+    size_t n = HPackDecodeInteger(data, len, 7, slen);
+    if(n == 0 || slen > len - n) {
+        return 0;
+    }
+    str.clear();
+    if(huffman) {
+        if(!Huffman::Decode(data + n, slen, str)) {
+            return 0;
+        }
+    } else {
+        str.assign(data + n, slen);
+    }
+    return n + slen;
+}
+
+HPackDecoder::HPackDecoder(uint32_t max_table_size)
+    :m_table(max_table_size)
+    ,m_maxTableSize(max_table_size) {
+}
+
+int HPackDecoder::decode(const std::string& block, HeaderList& headers) {
+    const char* data = block.c_str();
+    size_t len = block.size();
+    size_t pos = 0;
+    bool header_seen = false;
+    while(pos < len) {
+        uint8_t b = data[pos];
+        uint64_t idx = 0;
+        size_t n = 0;
+        std::string name;
+        std::string value;
+        if(b & 0x80) {
+            //indexed header field
+            n = HPackDecodeInteger(data + pos, len - pos, 7, idx);
+            if(n == 0 || !m_table.get(idx, name, value)) {
+                TAO_LOG_DEBUG(g_logger) << "hpack invalid index=" << idx;
+                return -1;
+            }
+            pos += n;
+            headers.emplace_back(name, value);
+            header_seen = true;
+            continue;
+        }
+        if((b & 0xe0) == 0x20) {
+            //dynamic table size update, only at the beginning of a block
+            n = HPackDecodeInteger(data + pos, len - pos, 5, idx);
+            if(n == 0 || header_seen || idx > m_maxTableSize) {
+                TAO_LOG_DEBUG(g_logger) << "hpack invalid table size update=" << idx;
+                return -2;
+            }
+            m_table.setMaxSize(idx);
+            pos += n;
+            continue;
+        }
+        bool incremental = (b & 0xc0) == 0x40;
+        n = HPackDecodeInteger(data + pos, len - pos, incremental ? 6 : 4, idx);
+        if(n == 0) {
+            return -3;
+        }
+        pos += n;
+        if(idx) {
+            if(!m_table.get(idx, name, value)) {
+                TAO_LOG_DEBUG(g_logger) << "hpack invalid name index=" << idx;
+                return -4;
+            }
+        } else {
+            n = DecodeString(data + pos, len - pos, name);
+            if(n == 0) {
+                return -5;
+            }
+            pos += n;
+        }
+        n = DecodeString(data + pos, len - pos, value);
+        if(n == 0) {
+            return -6;
+        }
+        pos += n;
+        if(incremental) {
+            m_table.add(name, value);
+        }
+        headers.emplace_back(name, value);
+        header_seen = true;
+    }
+    return 0;
+}
+
+HPackEncoder::HPackEncoder(uint32_t max_table_size)
+    :m_table(max_table_size)
+    ,m_pendingSize(~0u) {
+}
+
+void HPackEncoder::setMaxTableSize(uint32_t v) {
+    //never grow beyond the default, a smaller table costs only ratio
+    v = std::min(v, (uint32_t)4096);
+    if(v != m_table.getMaxSize()) {
+        m_pendingSize = v;
+    }
+}
+
+//values changing on almost every message only pollute the table
+static bool IsNoIndexName(const std::string& name) {
+    static const char* s_names[] = {
+        ":path", "content-length", "date", "etag", "age",
+        "if-modified-since", "if-none-match", "last-modified",
+        "location", "content-range", "range", "expires"
+    };
+    for(auto i : s_names) {
+        if(name == i) {
+            return true;
+        }
+    }
+    return false;
+}
+
+//never stored by intermediaries either(rfc7541 7.1.3)
+static bool IsSensitiveName(const std::string& name) {
+    return name == "authorization" || name == "proxy-authorization"
+        || name == "set-cookie" || name == "cookie";
+}
+
+void HPackEncoder::encode(const HeaderList& headers, std::string& out) {
+    if(m_pendingSize != ~0u) {
+        m_table.setMaxSize(m_pendingSize);
+        HPackEncodeInteger(out, 5, 0x20, m_pendingSize);
+        m_pendingSize = ~0u;
+    }
+    for(auto& i : headers) {
+        bool full = false;
+        uint32_t idx = m_table.find(i.first, i.second, full);
+        if(full) {
+            HPackEncodeInteger(out, 7, 0x80, idx);
+            continue;
+        }
+        if(IsSensitiveName(i.first)) {
+            HPackEncodeInteger(out, 4, 0x10, idx);
+        } else if(IsNoIndexName(i.first)) {
+            HPackEncodeInteger(out, 4, 0x00, idx);
+        } else {
+            HPackEncodeInteger(out, 6, 0x40, idx);
+            m_table.add(i.first, i.second);
+        }
+        if(!idx) {
+            EncodeString(out, i.first);
+        }
+        EncodeString(out, i.second);
+    }
+}
+
+}
+}
@@ -0,0 +1,103 @@
+#ifndef __TAO_HTTP2_HPACK_H__
+#define __TAO_HTTP2_HPACK_H__
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <deque>
+#include <stdint.h>
+
+namespace tao {
+namespace http2 {
+
+using HeaderList = std::vector<std::pair<std::string, std::string> >;
+
+/**
+ * @brief hpack index space(rfc7541 2.3), static table followed by dynamic table
+ */
+class DynamicTable {
+public:
+    DynamicTable(uint32_t max_size = 4096);
+
+    void add(const std::string& name, const std::string& value);
+    /**
+     * @brief get header by 1-based index over static and dynamic table
+     */
+    bool get(uint32_t idx, std::string& name, std::string& value) const;
+    /**
+     * @brief find header
+     * @param[out] full whether the value matches too
+     * @return index, 0 not found
+     */
+    uint32_t find(const std::string& name, const std::string& value, bool& full) const;
+
+    void setMaxSize(uint32_t v);
+    uint32_t getMaxSize() const { return m_maxSize;}
+    uint32_t getSize() const { return m_size;}
+    size_t getCount() const { return m_datas.size();}
+
+    static uint32_t GetStaticCount();
+    std::string toString() const;
+private:
+    void evict(uint32_t max_size);
+private:
+    //front is the newest entry
+    std::deque<std::pair<std::string, std::string> > m_datas;
+    uint32_t m_size;
+    uint32_t m_maxSize;
+};
+
+class HPackDecoder {
+public:
+    using ptr = std::shared_ptr<HPackDecoder>;
+
+    /**
+     * @param[in] max_table_size local SETTINGS_HEADER_TABLE_SIZE
+     */
+    HPackDecoder(uint32_t max_table_size = 4096);
+
+    /**
+     * @brief decode one complete header block
+     * @return 0 success, <0 compression error
+     */
+    int decode(const std::string& block, HeaderList& headers);
+
+    void setMaxTableSize(uint32_t v) { m_maxTableSize = v;}
+    const DynamicTable& getTable() const { return m_table;}
+private:
+    DynamicTable m_table;
+    uint32_t m_maxTableSize;
+};
+
+class HPackEncoder {
+public:
+    using ptr = std::shared_ptr<HPackEncoder>;
+
+    HPackEncoder(uint32_t max_table_size = 4096);
+
+    void encode(const HeaderList& headers, std::string& out);
+
+    /**
+     * @brief peer SETTINGS_HEADER_TABLE_SIZE changed, size update is sent with next block
+     */
+    void setMaxTableSize(uint32_t v);
+    const DynamicTable& getTable() const { return m_table;}
+private:
+    DynamicTable m_table;
+    //pending table size update, ~0u none
+    uint32_t m_pendingSize;
+};
+
+/**
+ * @brief integer representation with N-bit prefix(rfc7541 5.1)
+ */
+void HPackEncodeInteger(std::string& out, uint8_t prefix_bits, uint8_t flags, uint64_t value);
+/**
+ * @return bytes consumed, 0 on error
+ */
+size_t HPackDecodeInteger(const char* data, size_t len, uint8_t prefix_bits, uint64_t& value);
+
+}
+}
+
+#endif
@@ -0,0 +1,88 @@
+#include "http2_connection.h"
+#include "src/log.h"
+
+namespace tao {
+namespace http2 {
+
+static tao::Logger::ptr g_logger = TAO_LOG_NAME("system");
+
+Http2Connection::Http2Connection(Socket::ptr sock, const std::string& authority)
+    :Http2Session(sock, true)
+    ,m_authority(authority) {
+}
+
+Http2Connection::ptr Http2Connection::Connect(const std::string& url, uint64_t timeout_ms) {
+    Uri::ptr uri = Uri::Create(url);
+    if(!uri) {
+        TAO_LOG_ERROR(g_logger) << "invalid url: " << url;
+        return nullptr;
+    }
+    return Connect(uri, timeout_ms);
+}
+
+Http2Connection::ptr Http2Connection::Connect(Uri::ptr uri, uint64_t timeout_ms) {
+    Address::ptr addr = uri->createAddress();
+    if(!addr) {
+        TAO_LOG_ERROR(g_logger) << "invalid host: " << uri->getHost();
+        return nullptr;
+    }
+    Socket::ptr sock = Socket::CreateTCP(addr);
+    if(!sock) {
+        TAO_LOG_ERROR(g_logger) << "create socket fail: " << addr->toString()
+            << " errno=" << errno << " errstr=" << strerror(errno);
+        return nullptr;
+    }
+    if(!sock->connect(addr, timeout_ms)) {
+        TAO_LOG_ERROR(g_logger) << "connect fail: " << addr->toString();
+        return nullptr;
+    }
+    std::string authority = uri->getHost();
+    if(uri->getPort() != 80) {
+        authority += ":" + std::to_string(uri->getPort());
+    }
+    //no recv timeout, the reader fiber waits for frames of all streams
+    Http2Connection::ptr conn = std::make_shared<Http2Connection>(sock, authority);
+    if(!conn->start()) {
+        TAO_LOG_ERROR(g_logger) << "send http2 preface fail: " << addr->toString();
+        return nullptr;
+    }
+    return conn;
+}
+
+http::HttpResult::ptr Http2Connection::doGet(const std::string& path
+                        , uint64_t timeout_ms
+                        , const std::map<std::string, std::string>& headers) {
+    return doRequest(http::HttpMethod::GET, path, timeout_ms, headers);
+}
+
+http::HttpResult::ptr Http2Connection::doPost(const std::string& path
+                        , uint64_t timeout_ms
+                        , const std::map<std::string, std::string>& headers
+                        , const std::string& body) {
+    return doRequest(http::HttpMethod::POST, path, timeout_ms, headers, body);
+}
+
+http::HttpResult::ptr Http2Connection::doRequest(http::HttpMethod method
+                        , const std::string& path
+                        , uint64_t timeout_ms
+                        , const std::map<std::string, std::string>& headers
+                        , const std::string& body) {
+    http::HttpRequest::ptr req = std::make_shared<http::HttpRequest>(0x20, false);
+    req->setMethod(method);
+    size_t pos = path.find('?');
+    if(pos == std::string::npos) {
+        req->setPath(path.empty() ? "/" : path);
+    } else {
+        req->setPath(path.substr(0, pos));
+        req->setQuery(path.substr(pos + 1));
+    }
+    req->setHeader("host", m_authority);
+    for(auto& i : headers) {
+        req->setHeader(i.first, i.second);
+    }
+    req->setBody(body);
+    return request(req, timeout_ms);
+}
+
+}
+}
@@ -0,0 +1,54 @@
+#ifndef __TAO_HTTP2_CONNECTION_H__
+#define __TAO_HTTP2_CONNECTION_H__
+
+#include "http2_session.h"
+#include "src/http/uri.h"
+#include <map>
+
+namespace tao {
+namespace http2 {
+
+/**
+ * @brief http2 client connection(prior knowledge, no TLS)
+ * requests from many fibers are multiplexed as streams of one socket
+ */
+class Http2Connection : public Http2Session {
+public:
+    using ptr = std::shared_ptr<Http2Connection>;
+
+    Http2Connection(Socket::ptr sock, const std::string& authority);
+
+    /**
+     * @brief connect and send preface, must be called in an IOManager
+     * @return nullptr on fail
+     */
+    static Http2Connection::ptr Connect(Uri::ptr uri, uint64_t timeout_ms);
+    static Http2Connection::ptr Connect(const std::string& url, uint64_t timeout_ms);
+
+    http::HttpResult::ptr doGet(const std::string& path
+                        , uint64_t timeout_ms
+                        , const std::map<std::string, std::string>& headers = {});
+
+    http::HttpResult::ptr doPost(const std::string& path
+                        , uint64_t timeout_ms
+                        , const std::map<std::string, std::string>& headers = {}
+                        , const std::string& body = std::string());
+
+    /**
+     * @param[in] path may contain query
+     */
+    http::HttpResult::ptr doRequest(http::HttpMethod method
+                        , const std::string& path
+                        , uint64_t timeout_ms
+                        , const std::map<std::string, std::string>& headers = {}
+                        , const std::string& body = std::string());
+
+    const std::string& getAuthority() const { return m_authority;}
+private:
+    std::string m_authority;
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,104 @@
+#include "http2_server.h"
+#include "src/utils/hash_util.h"
+#include "src/log.h"
+#include <unistd.h>
+
+namespace tao {
+namespace http2 {
+
+static tao::Logger::ptr g_logger = TAO_LOG_NAME("system");
+
+Http2Server::Http2Server(bool keepalive, tao::IOManager* worker, tao::IOManager* accept_worker)
+    :http::HttpServer(keepalive, worker, accept_worker) {
+    m_type = "http2";
+}
+
+//0: http/1.x, 1: http2 preface, -1: closed
+static int PeekPreface(tao::Socket::ptr client) {
+    char buf[CLIENT_PREFACE_SIZE];
+    //the preface may arrive in pieces, wait a little for the rest
+    for(int i = 0; i < 100; ++i) {
+        int rt = client->recv(buf, sizeof(buf), MSG_PEEK);
+        if(rt <= 0) {
+            return -1;
+        }
+        if(memcmp(buf, CLIENT_PREFACE, rt) != 0) {
+            return 0;
+        }
+        if(rt == (int)CLIENT_PREFACE_SIZE) {
+            return 1;
+        }
+        usleep(1000);
+    }
+    return 0;
+}
+
+void Http2Server::handleClient(tao::Socket::ptr client) {
+    int rt = PeekPreface(client);
+    if(rt < 0) {
+        client->close();
+        return;
+    }
+    if(rt == 0) {
+        http::HttpServer::handleClient(client);
+        return;
+    }
+    TAO_LOG_DEBUG(g_logger) << "http2 prior knowledge " << *client;
+    Http2Session::ptr session = std::make_shared<Http2Session>(client, false);
+    session->setDispatch(getServletDispatch(), m_worker);
+    if(session->start()) {
+        session->run();
+    }
+}
+
+//HTTP2-Settings is base64url without padding(rfc7540 3.2.1)
+static std::string DecodeBase64Url(std::string v) {
+    for(auto& c : v) {
+        if(c == '-') {
+            c = '+';
+        } else if(c == '_') {
+            c = '/';
+        }
+    }
+    while(v.size() % 4) {
+        v.push_back('=');
+    }
+    return tao::base64decode(v);
+}
+
+bool Http2Server::handleUpgrade(http::HttpRequest::ptr req, http::HttpSession::ptr session) {
+    if(strcasecmp(req->getHeader("Upgrade").c_str(), "h2c")) {
+        return false;
+    }
+    std::string settings;
+    if(!req->hasHeader("HTTP2-Settings", &settings)) {
+        return false;
+    }
+    //a request body would have to be read as http/1.1 before switching
+    if(!req->getBody().empty()) {
+        return false;
+    }
+    static const char s_switching[] = "HTTP/1.1 101 Switching Protocols\r\n"
+                                      "Connection: Upgrade\r\n"
+                                      "Upgrade: h2c\r\n\r\n";
+    if(session->writeFixSize(s_switching, sizeof(s_switching) - 1) <= 0) {
+        return true;
+    }
+    TAO_LOG_DEBUG(g_logger) << "http2 upgrade " << *session->getSocket();
+    req->setVersion(0x20);
+    req->delHeader("Upgrade");
+    req->delHeader("HTTP2-Settings");
+    req->delHeader("Connection");
+
+    Http2Session::ptr h2 = std::make_shared<Http2Session>(session->getSocket(), false);
+    h2->setDispatch(getServletDispatch(), m_worker);
+    if(h2->upgrade(req, DecodeBase64Url(settings))) {
+        h2->run();
+    } else {
+        h2->goAway(Http2Error::PROTOCOL_ERROR, "invalid HTTP2-Settings");
+    }
+    return true;
+}
+
+}
+}
@@ -0,0 +1,31 @@
+#ifndef __TAO_HTTP2_SERVER_H__
+#define __TAO_HTTP2_SERVER_H__
+
+#include "src/http/http_server.h"
+#include "http2_session.h"
+
+namespace tao {
+namespace http2 {
+
+/**
+ * @brief http server that also speaks cleartext http2
+ * prior knowledge connections are detected by the client preface,
+ * http/1.1 connections can switch with "Upgrade: h2c"
+ */
+class Http2Server : public http::HttpServer {
+public:
+    using ptr = std::shared_ptr<Http2Server>;
+
+    Http2Server(bool keepalive = false
+                ,tao::IOManager* worker = tao::IOManager::GetThis()
+                ,tao::IOManager* accept_worker = tao::IOManager::GetThis());
+
+protected:
+    virtual void handleClient(tao::Socket::ptr client) override;
+    virtual bool handleUpgrade(http::HttpRequest::ptr req, http::HttpSession::ptr session) override;
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,847 @@
+#include "http2_session.h"
+#include "src/http/http_compress.h"
+#include "src/http/http_parser.h"
+#include "src/config.h"
+#include "src/log.h"
+#include <algorithm>
+
+namespace tao {
+namespace http2 {
+
+static tao::Logger::ptr g_logger = TAO_LOG_NAME("system");
+
+static tao::ConfigVar<uint32_t>::ptr g_http2_max_concurrent_streams =
+    tao::Config::Lookup("http2.max_concurrent_streams"
+                ,(uint32_t)128, "http2 max concurrent streams of one connection");
+
+static tao::ConfigVar<uint32_t>::ptr g_http2_initial_window_size =
+    tao::Config::Lookup("http2.initial_window_size"
+                ,(uint32_t)(1024 * 1024), "http2 stream receive window size");
+
+static tao::ConfigVar<uint32_t>::ptr g_http2_connection_window_size =
+    tao::Config::Lookup("http2.connection_window_size"
+                ,(uint32_t)(16 * 1024 * 1024), "http2 connection receive window size");
+
+static tao::ConfigVar<uint32_t>::ptr g_http2_max_frame_size =
+    tao::Config::Lookup("http2.max_frame_size"
+                ,(uint32_t)DEFAULT_MAX_FRAME_SIZE, "http2 max receive frame size");
+
+static tao::ConfigVar<uint32_t>::ptr g_http2_max_header_list_size =
+    tao::Config::Lookup("http2.max_header_list_size"
+                ,(uint32_t)(64 * 1024), "http2 max size of one header block");
+
+static const size_t s_read_buffer_size = 64 * 1024;
+
+Http2Session::Http2Session(Socket::ptr sock, bool is_client)
+    :SocketStream(sock, true)
+    ,m_isClient(is_client)
+    ,m_closed(false)
+    ,m_goaway(false)
+    ,m_nextStreamId(is_client ? 1 : 2)
+    ,m_lastPeerStreamId(0)
+    ,m_sendWindow(DEFAULT_WINDOW_SIZE)
+    ,m_recvWindow(DEFAULT_WINDOW_SIZE)
+    ,m_recvWindowSize(DEFAULT_WINDOW_SIZE)
+    ,m_writerRunning(false)
+    ,m_writerStop(false)
+    ,m_continuationId(0)
+    ,m_continuationFlags(0)
+    ,m_readPos(0)
+    ,m_worker(nullptr) {
+    m_localSettings.max_concurrent_streams = g_http2_max_concurrent_streams->getValue();
+    m_localSettings.initial_window_size = std::min(g_http2_initial_window_size->getValue(), MAX_WINDOW_SIZE);
+    m_localSettings.max_frame_size = std::max(std::min(g_http2_max_frame_size->getValue(), (uint32_t)0xffffff)
+                                        ,DEFAULT_MAX_FRAME_SIZE);
+    m_localSettings.max_header_list_size = g_http2_max_header_list_size->getValue();
+    m_localSettings.enable_push = 0;
+    m_decoder.setMaxTableSize(m_localSettings.header_table_size);
+}
+
+Http2Session::~Http2Session() {
+    TAO_LOG_DEBUG(g_logger) << "Http2Session::~Http2Session";
+}
+
+void Http2Session::setDispatch(http::ServletDispatch::ptr dispatch, IOManager* worker) {
+    m_dispatch = dispatch;
+    m_worker = worker;
+}
+
+size_t Http2Session::getStreamCount() {
+    MutexType::Lock lock(m_mutex);
+    return m_streams.size();
+}
+
+int Http2Session::read(void* buffer, size_t length) {
+    if(m_readPos >= m_readBuf.size()) {
+        m_readBuf.resize(s_read_buffer_size);
+        m_readPos = 0;
+        int rt = SocketStream::read(&m_readBuf[0], m_readBuf.size());
+        if(rt <= 0) {
+            m_readBuf.clear();
+            return rt;
+        }
+        m_readBuf.resize(rt);
+    }
+    size_t n = std::min(length, m_readBuf.size() - m_readPos);
+    memcpy(buffer, &m_readBuf[m_readPos], n);
+    m_readPos += n;
+    return n;
+}
+
+bool Http2Session::close() {
+    goAway(Http2Error::NO_ERROR);
+    return true;
+}
+
+bool Http2Session::start() {
+    if(m_isClient) {
+        if(writeFixSize(CLIENT_PREFACE, CLIENT_PREFACE_SIZE) <= 0) {
+            return false;
+        }
+    }
+    std::vector<std::pair<uint16_t, uint32_t> > params = {
+        {(uint16_t)SettingsId::MAX_CONCURRENT_STREAMS, m_localSettings.max_concurrent_streams},
+        {(uint16_t)SettingsId::INITIAL_WINDOW_SIZE, m_localSettings.initial_window_size},
+        {(uint16_t)SettingsId::MAX_FRAME_SIZE, m_localSettings.max_frame_size},
+        {(uint16_t)SettingsId::MAX_HEADER_LIST_SIZE, m_localSettings.max_header_list_size},
+    };
+    if(m_isClient) {
+        params.push_back({(uint16_t)SettingsId::ENABLE_PUSH, 0});
+    }
+
+    Http2Session::ptr self = shared_from_this();
+    {
+        MutexType::Lock lock(m_mutex);
+        enqueue(Frame::CreateSettings(params));
+        uint32_t conn_window = std::min(g_http2_connection_window_size->getValue(), MAX_WINDOW_SIZE);
+        if(conn_window > DEFAULT_WINDOW_SIZE) {
+            enqueue(Frame::CreateWindowUpdate(0, conn_window - DEFAULT_WINDOW_SIZE));
+            m_recvWindow = m_recvWindowSize = conn_window;
+        }
+        m_writerRunning = true;
+    }
+    IOManager::GetThis()->schedule(std::bind(&Http2Session::writerLoop, self));
+    if(m_isClient) {
+        IOManager::GetThis()->schedule(std::bind(&Http2Session::run, self));
+    }
+    return true;
+}
+
+bool Http2Session::upgrade(http::HttpRequest::ptr req, const std::string& settings) {
+    std::vector<std::pair<uint16_t, uint32_t> > params;
+    if(!Frame::ParseSettings(settings, params)) {
+        return false;
+    }
+    for(auto& i : params) {
+        if(m_peerSettings.set(i.first, i.second) != Http2Error::NO_ERROR) {
+            return false;
+        }
+    }
+    m_encoder.setMaxTableSize(m_peerSettings.header_table_size);
+    if(!start()) {
+        return false;
+    }
+    Http2Stream::ptr stream = std::make_shared<Http2Stream>(1
+                    ,m_peerSettings.initial_window_size
+                    ,m_localSettings.initial_window_size);
+    {
+        MutexType::Lock lock(m_mutex);
+        stream->m_state = Http2Stream::State::HALF_CLOSED_REMOTE;
+        m_streams[1] = stream;
+        m_lastPeerStreamId = 1;
+    }
+    handleRequest(stream, req);
+    return true;
+}
+
+void Http2Session::run() {
+    Http2Session::ptr self = shared_from_this();
+    if(!m_isClient) {
+        char preface[CLIENT_PREFACE_SIZE];
+        if(readFixSize(preface, sizeof(preface)) <= 0
+                || memcmp(preface, CLIENT_PREFACE, CLIENT_PREFACE_SIZE) != 0) {
+            TAO_LOG_DEBUG(g_logger) << "invalid http2 client preface";
+            goAway(Http2Error::PROTOCOL_ERROR, "invalid preface");
+            onClosed();
+            return;
+        }
+    }
+    while(true) {
+        Http2Error error = Http2Error::NO_ERROR;
+        Frame::ptr frame = FrameCodec::RecvFrame(self, m_localSettings.max_frame_size, &error);
+        if(!frame) {
+            //also said to a peer gone idle past the recv timeout
+            goAway(error);
+            break;
+        }
+        TAO_LOG_DEBUG(g_logger) << "recv " << frame->toString();
+        error = handleFrame(frame);
+        if(error != Http2Error::NO_ERROR) {
+            TAO_LOG_INFO(g_logger) << "http2 connection error=" << Http2ErrorToString(error)
+                << " frame=" << frame->toString();
+            goAway(error);
+            break;
+        }
+    }
+    onClosed();
+}
+
+void Http2Session::onClosed() {
+    std::unordered_map<uint32_t, Http2Stream::ptr> streams;
+    {
+        MutexType::Lock lock(m_mutex);
+        m_closed = true;
+        m_writerStop = true;
+        m_sendSem.notify();
+        streams.swap(m_streams);
+        for(auto& i : streams) {
+            i.second->m_reset = true;
+            i.second->m_error = Http2Error::CANCEL;
+        }
+        wakeWindowWaiters();
+    }
+    for(auto& i : streams) {
+        i.second->notify();
+    }
+}
+
+void Http2Session::goAway(Http2Error error, const std::string& debug) {
+    MutexType::Lock lock(m_mutex);
+    if(m_writerStop) {
+        if(!m_writerRunning) {
+            SocketStream::close();
+        }
+        return;
+    }
+    m_goaway = true;
+    enqueue(Frame::CreateGoAway(m_lastPeerStreamId, error, debug));
+    m_writerStop = true;
+    if(!m_writerRunning) {
+        SocketStream::close();
+    }
+}
+
+void Http2Session::enqueue(Frame::ptr frame) {
+    m_sendQueue.push_back(frame);
+    m_sendSem.notify();
+}
+
+void Http2Session::enqueueHeaders(uint32_t stream_id, const HeaderList& headers, bool end_stream) {
+    std::string block;
+    m_encoder.encode(headers, block);
+    size_t max_size = m_peerSettings.max_frame_size;
+    if(block.size() <= max_size) {
+        enqueue(Frame::CreateHeaders(stream_id, block, end_stream, true));
+        return;
+    }
+    enqueue(Frame::CreateHeaders(stream_id, block.substr(0, max_size), end_stream, false));
+    for(size_t pos = max_size; pos < block.size(); pos += max_size) {
+        bool end = pos + max_size >= block.size();
+        enqueue(Frame::CreateContinuation(stream_id, block.substr(pos, max_size), end));
+    }
+}
+
+void Http2Session::writerLoop() {
+    while(true) {
+        m_sendSem.wait();
+        std::list<Frame::ptr> frames;
+        bool stop = false;
+        {
+            MutexType::Lock lock(m_mutex);
+            frames.swap(m_sendQueue);
+            stop = m_writerStop;
+        }
+        if(!frames.empty()) {
+            //all pending frames go out with one write
+            ByteArray::ptr ba = std::make_shared<ByteArray>();
+            for(auto& i : frames) {
+                TAO_LOG_DEBUG(g_logger) << "send " << i->toString();
+                FrameCodec::SerializeTo(ba, i);
+            }
+            ba->setPosition(0);
+            if(writeFixSize(ba, ba->getSize()) <= 0) {
+                stop = true;
+            }
+        }
+        if(stop) {
+            break;
+        }
+    }
+    {
+        MutexType::Lock lock(m_mutex);
+        m_writerRunning = false;
+        m_writerStop = true;
+        m_sendQueue.clear();
+    }
+    //wakes the reader blocked in recv
+    SocketStream::close();
+}
+
+int64_t Http2Session::acquireWindow(Http2Stream::ptr stream, int64_t want) {
+    while(true) {
+        {
+            MutexType::Lock lock(m_mutex);
+            if(m_closed || stream->m_reset) {
+                return -1;
+            }
+            int64_t avail = std::min(want, (int64_t)m_peerSettings.max_frame_size);
+            avail = std::min(avail, std::min(m_sendWindow, stream->m_sendWindow));
+            if(avail > 0) {
+                m_sendWindow -= avail;
+                stream->m_sendWindow -= avail;
+                return avail;
+            }
+            m_windowWaiters.push_back(std::make_pair(Scheduler::GetThis(), Fiber::GetThis()));
+        }
+        Fiber::YieldToHold();
+    }
+}
+
+void Http2Session::wakeWindowWaiters() {
+    for(auto& i : m_windowWaiters) {
+        i.first->schedule(i.second);
+    }
+    m_windowWaiters.clear();
+}
+
+int Http2Session::sendData(Http2Stream::ptr stream, const std::string& data, bool end_stream) {
+    size_t pos = 0;
+    do {
+        int64_t n = 0;
+        if(!data.empty()) {
+            n = acquireWindow(stream, data.size() - pos);
+            if(n <= 0) {
+                return -1;
+            }
+        }
+        bool end = end_stream && pos + n == data.size();
+        {
+            MutexType::Lock lock(m_mutex);
+            if(m_closed || stream->m_reset) {
+                return -1;
+            }
+            enqueue(Frame::CreateData(stream->m_id, data.c_str() + pos, n, end));
+            if(end) {
+                stream->onLocalEnd();
+                if(stream->m_state == Http2Stream::State::CLOSED) {
+                    delStream(stream->m_id);
+                }
+            }
+        }
+        pos += n;
+    } while(pos < data.size());
+    return pos;
+}
+
+//connection specific headers are not allowed(rfc7540 8.1.2.2)
+static bool IsConnectionHeader(const std::string& name) {
+    return name == "connection" || name == "keep-alive"
+        || name == "proxy-connection" || name == "transfer-encoding"
+        || name == "upgrade" || name == "host" || name == "content-length"
+        || name == "http2-settings";
+}
+
+static HeaderList ToHeaderList(const http::HttpRequest::MapType& headers) {
+    HeaderList rt;
+    for(auto& i : headers) {
+        std::string name = i.first;
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        if(!IsConnectionHeader(name)) {
+            rt.emplace_back(name, i.second);
+        }
+    }
+    return rt;
+}
+
+void Http2Session::sendResponse(Http2Stream::ptr stream, http::HttpResponse::ptr rsp) {
+    HeaderList headers;
+    headers.emplace_back(":status", std::to_string((uint32_t)rsp->getStatus()));
+    HeaderList others = ToHeaderList(rsp->getHeaders());
+    headers.insert(headers.end(), others.begin(), others.end());
+    const std::string& body = rsp->getBody();
+    if(rsp->getStatus() != http::HttpStatus::NO_CONTENT
+            && rsp->getStatus() != http::HttpStatus::NOT_MODIFIED) {
+        headers.emplace_back("content-length", std::to_string(body.size()));
+    }
+    {
+        MutexType::Lock lock(m_mutex);
+        if(m_closed || stream->m_reset) {
+            return;
+        }
+        enqueueHeaders(stream->m_id, headers, body.empty());
+        if(body.empty()) {
+            stream->onLocalEnd();
+            if(stream->m_state == Http2Stream::State::CLOSED) {
+                delStream(stream->m_id);
+            }
+            return;
+        }
+    }
+    sendData(stream, body, true);
+}
+
+void Http2Session::resetStream(uint32_t id, Http2Error error) {
+    Http2Stream::ptr stream;
+    {
+        MutexType::Lock lock(m_mutex);
+        if(m_closed) {
+            return;
+        }
+        enqueue(Frame::CreateRstStream(id, error));
+        auto it = m_streams.find(id);
+        if(it != m_streams.end()) {
+            stream = it->second;
+            stream->m_reset = true;
+            stream->m_error = error;
+            stream->m_state = Http2Stream::State::CLOSED;
+            m_streams.erase(it);
+            wakeWindowWaiters();
+        }
+    }
+    if(stream) {
+        stream->notify();
+    }
+}
+
+Http2Stream::ptr Http2Session::getStream(uint32_t id) {
+    MutexType::Lock lock(m_mutex);
+    auto it = m_streams.find(id);
+    return it == m_streams.end() ? nullptr : it->second;
+}
+
+void Http2Session::delStream(uint32_t id) {
+    m_streams.erase(id);
+}
+
+Http2Error Http2Session::handleFrame(Frame::ptr frame) {
+    const FrameHeader& header = frame->header;
+    if(m_continuationId && header.type != FrameType::CONTINUATION) {
+        return Http2Error::PROTOCOL_ERROR;
+    }
+    switch(header.type) {
+        case FrameType::DATA:
+            return handleData(frame);
+        case FrameType::HEADERS: {
+            if(header.stream_id == 0) {
+                return Http2Error::PROTOCOL_ERROR;
+            }
+            std::string block;
+            if(!frame->getData(block)) {
+                return Http2Error::PROTOCOL_ERROR;
+            }
+            if(header.hasFlag(FrameFlag::END_HEADERS)) {
+                return handleHeaderBlock(header.stream_id, header.flags, block);
+            }
+            m_continuationId = header.stream_id;
+            m_continuationFlags = header.flags;
+            m_headerBlock.swap(block);
+            return Http2Error::NO_ERROR;
+        }
+        case FrameType::CONTINUATION: {
+            if(header.stream_id == 0 || header.stream_id != m_continuationId) {
+                return Http2Error::PROTOCOL_ERROR;
+            }
+            m_headerBlock.append(frame->payload);
+            if(m_headerBlock.size() > m_localSettings.max_header_list_size) {
+                return Http2Error::ENHANCE_YOUR_CALM;
+            }
+            if(!header.hasFlag(FrameFlag::END_HEADERS)) {
+                return Http2Error::NO_ERROR;
+            }
+            std::string block;
+            block.swap(m_headerBlock);
+            m_continuationId = 0;
+            return handleHeaderBlock(header.stream_id, m_continuationFlags, block);
+        }
+        case FrameType::PRIORITY:
+            //priority is advisory, streams are served as they come
+            return Http2Error::NO_ERROR;
+        case FrameType::RST_STREAM:
+            return handleRstStream(frame);
+        case FrameType::SETTINGS:
+            return handleSettings(frame);
+        case FrameType::PUSH_PROMISE:
+            //push is disabled by client and never sent to server
+            return Http2Error::PROTOCOL_ERROR;
+        case FrameType::PING: {
+            if(header.stream_id != 0) {
+                return Http2Error::PROTOCOL_ERROR;
+            }
+            if(frame->payload.size() != 8) {
+                return Http2Error::FRAME_SIZE_ERROR;
+            }
+            if(!header.hasFlag(FrameFlag::ACK)) {
+                Frame::ptr ack = std::make_shared<Frame>(*frame);
+                ack->header.flags = FrameFlag::ACK;
+                MutexType::Lock lock(m_mutex);
+                enqueue(ack);
+            }
+            return Http2Error::NO_ERROR;
+        }
+        case FrameType::GOAWAY:
+            return handleGoAway(frame);
+        case FrameType::WINDOW_UPDATE:
+            return handleWindowUpdate(frame);
+        default:
+            //unknown frame types must be ignored
+            return Http2Error::NO_ERROR;
+    }
+}
+
+Http2Error Http2Session::handleHeaderBlock(uint32_t id, uint8_t flags, const std::string& block) {
+    //decoded even for refused streams to keep the dynamic table in sync
+    HeaderList headers;
+    if(m_decoder.decode(block, headers) != 0) {
+        return Http2Error::COMPRESSION_ERROR;
+    }
+    bool end = flags & FrameFlag::END_STREAM;
+
+    if(m_isClient) {
+        Http2Stream::ptr stream;
+        {
+            MutexType::Lock lock(m_mutex);
+            auto it = m_streams.find(id);
+            if(it == m_streams.end()) {
+                return Http2Error::NO_ERROR;
+            }
+            stream = it->second;
+            //interim 1xx response is dropped
+            if(!end && !headers.empty() && headers[0].first == ":status"
+                    && headers[0].second.size() == 3 && headers[0].second[0] == '1') {
+                return Http2Error::NO_ERROR;
+            }
+            stream->addHeaders(headers);
+            if(end) {
+                stream->onRemoteEnd();
+                if(stream->m_state == Http2Stream::State::CLOSED) {
+                    delStream(id);
+                }
+            }
+        }
+        if(end) {
+            stream->notify();
+        }
+        return Http2Error::NO_ERROR;
+    }
+
+    if(id % 2 == 0) {
+        return Http2Error::PROTOCOL_ERROR;
+    }
+    Http2Stream::ptr stream;
+    {
+        MutexType::Lock lock(m_mutex);
+        auto it = m_streams.find(id);
+        if(it != m_streams.end()) {
+            //trailers
+            stream = it->second;
+            if(!end || stream->m_state != Http2Stream::State::OPEN) {
+                return Http2Error::PROTOCOL_ERROR;
+            }
+            stream->addHeaders(headers);
+            stream->onRemoteEnd();
+        } else if(id <= m_lastPeerStreamId) {
+            lock.unlock();
+            resetStream(id, Http2Error::STREAM_CLOSED);
+            return Http2Error::NO_ERROR;
+        } else {
+            m_lastPeerStreamId = id;
+            if(m_goaway) {
+                return Http2Error::NO_ERROR;
+            }
+            if(m_streams.size() >= m_localSettings.max_concurrent_streams) {
+                lock.unlock();
+                resetStream(id, Http2Error::REFUSED_STREAM);
+                return Http2Error::NO_ERROR;
+            }
+            stream = std::make_shared<Http2Stream>(id
+                        ,m_peerSettings.initial_window_size
+                        ,m_localSettings.initial_window_size);
+            stream->addHeaders(headers);
+            m_streams[id] = stream;
+            if(end) {
+                stream->onRemoteEnd();
+            }
+        }
+    }
+    if(end) {
+        handleRequest(stream, stream->toRequest());
+    }
+    return Http2Error::NO_ERROR;
+}
+
+Http2Error Http2Session::handleData(Frame::ptr frame) {
+    uint32_t id = frame->header.stream_id;
+    if(id == 0) {
+        return Http2Error::PROTOCOL_ERROR;
+    }
+    //padding counts in flow control too
+    int64_t len = frame->header.length;
+    bool end = frame->header.hasFlag(FrameFlag::END_STREAM);
+    Http2Stream::ptr stream;
+    Http2Error stream_error = Http2Error::NO_ERROR;
+    {
+        MutexType::Lock lock(m_mutex);
+        if(len > m_recvWindow) {
+            return Http2Error::FLOW_CONTROL_ERROR;
+        }
+        m_recvWindow -= len;
+        if(m_recvWindow < m_recvWindowSize / 2) {
+            enqueue(Frame::CreateWindowUpdate(0, m_recvWindowSize - m_recvWindow));
+            m_recvWindow = m_recvWindowSize;
+        }
+
+        auto it = m_streams.find(id);
+        if(it == m_streams.end()
+                || it->second->m_state == Http2Stream::State::HALF_CLOSED_REMOTE
+                || it->second->m_state == Http2Stream::State::CLOSED) {
+            stream_error = Http2Error::STREAM_CLOSED;
+        } else {
+            stream = it->second;
+            std::string data;
+            if(!frame->getData(data)) {
+                return Http2Error::PROTOCOL_ERROR;
+            }
+            if(len > stream->m_recvWindow) {
+                stream_error = Http2Error::FLOW_CONTROL_ERROR;
+            } else if(!m_isClient && stream->m_body.size() + data.size()
+                        > http::HttpRequestParser::GetHttpRequestMaxBodySize()) {
+                stream_error = Http2Error::CANCEL;
+            } else {
+                stream->m_recvWindow -= len;
+                stream->appendData(data);
+                int64_t size = m_localSettings.initial_window_size;
+                if(!end && stream->m_recvWindow < size / 2) {
+                    enqueue(Frame::CreateWindowUpdate(id, size - stream->m_recvWindow));
+                    stream->m_recvWindow = size;
+                }
+                if(end) {
+                    stream->onRemoteEnd();
+                    if(stream->m_state == Http2Stream::State::CLOSED) {
+                        delStream(id);
+                    }
+                }
+            }
+        }
+    }
+    if(stream_error != Http2Error::NO_ERROR) {
+        resetStream(id, stream_error);
+        return Http2Error::NO_ERROR;
+    }
+    if(end) {
+        if(m_isClient) {
+            stream->notify();
+        } else {
+            handleRequest(stream, stream->toRequest());
+        }
+    }
+    return Http2Error::NO_ERROR;
+}
+
+Http2Error Http2Session::handleSettings(Frame::ptr frame) {
+    if(frame->header.stream_id != 0) {
+        return Http2Error::PROTOCOL_ERROR;
+    }
+    if(frame->header.hasFlag(FrameFlag::ACK)) {
+        return frame->payload.empty() ? Http2Error::NO_ERROR : Http2Error::FRAME_SIZE_ERROR;
+    }
+    std::vector<std::pair<uint16_t, uint32_t> > params;
+    if(!Frame::ParseSettings(frame->payload, params)) {
+        return Http2Error::FRAME_SIZE_ERROR;
+    }
+    MutexType::Lock lock(m_mutex);
+    for(auto& i : params) {
+        uint32_t old_window = m_peerSettings.initial_window_size;
+        Http2Error error = m_peerSettings.set(i.first, i.second);
+        if(error != Http2Error::NO_ERROR) {
+            return error;
+        }
+        if(i.first == (uint16_t)SettingsId::INITIAL_WINDOW_SIZE) {
+            int64_t delta = (int64_t)i.second - old_window;
+            for(auto& s : m_streams) {
+                s.second->m_sendWindow += delta;
+                if(s.second->m_sendWindow > MAX_WINDOW_SIZE) {
+                    return Http2Error::FLOW_CONTROL_ERROR;
+                }
+            }
+        } else if(i.first == (uint16_t)SettingsId::HEADER_TABLE_SIZE) {
+            m_encoder.setMaxTableSize(i.second);
+        }
+    }
+    enqueue(Frame::CreateSettings({}, true));
+    wakeWindowWaiters();
+    return Http2Error::NO_ERROR;
+}
+
+Http2Error Http2Session::handleWindowUpdate(Frame::ptr frame) {
+    uint32_t increment = 0;
+    if(!Frame::ParseWindowUpdate(frame->payload, increment)) {
+        return Http2Error::FRAME_SIZE_ERROR;
+    }
+    uint32_t id = frame->header.stream_id;
+    if(increment == 0) {
+        if(id == 0) {
+            return Http2Error::PROTOCOL_ERROR;
+        }
+        resetStream(id, Http2Error::PROTOCOL_ERROR);
+        return Http2Error::NO_ERROR;
+    }
+    MutexType::Lock lock(m_mutex);
+    if(id == 0) {
+        m_sendWindow += increment;
+        if(m_sendWindow > MAX_WINDOW_SIZE) {
+            return Http2Error::FLOW_CONTROL_ERROR;
+        }
+    } else {
+        auto it = m_streams.find(id);
+        if(it == m_streams.end()) {
+            return Http2Error::NO_ERROR;
+        }
+        it->second->m_sendWindow += increment;
+        if(it->second->m_sendWindow > MAX_WINDOW_SIZE) {
+            lock.unlock();
+            resetStream(id, Http2Error::FLOW_CONTROL_ERROR);
+            return Http2Error::NO_ERROR;
+        }
+    }
+    wakeWindowWaiters();
+    return Http2Error::NO_ERROR;
+}
+
+Http2Error Http2Session::handleRstStream(Frame::ptr frame) {
+    Http2Error error;
+    if(!Frame::ParseRstStream(frame->payload, error)) {
+        return Http2Error::FRAME_SIZE_ERROR;
+    }
+    if(frame->header.stream_id == 0) {
+        return Http2Error::PROTOCOL_ERROR;
+    }
+    Http2Stream::ptr stream;
+    {
+        MutexType::Lock lock(m_mutex);
+        auto it = m_streams.find(frame->header.stream_id);
+        if(it == m_streams.end()) {
+            return Http2Error::NO_ERROR;
+        }
+        stream = it->second;
+        stream->m_reset = true;
+        stream->m_error = error;
+        stream->m_state = Http2Stream::State::CLOSED;
+        m_streams.erase(it);
+        wakeWindowWaiters();
+    }
+    stream->notify();
+    return Http2Error::NO_ERROR;
+}
+
+Http2Error Http2Session::handleGoAway(Frame::ptr frame) {
+    uint32_t last_id = 0;
+    Http2Error error;
+    if(!Frame::ParseGoAway(frame->payload, last_id, error)) {
+        return Http2Error::FRAME_SIZE_ERROR;
+    }
+    if(error != Http2Error::NO_ERROR) {
+        TAO_LOG_INFO(g_logger) << "recv http2 GOAWAY error=" << Http2ErrorToString(error)
+            << " last_stream_id=" << last_id
+            << " debug=" << frame->payload.substr(8);
+    }
+    std::vector<Http2Stream::ptr> refused;
+    {
+        MutexType::Lock lock(m_mutex);
+        m_goaway = true;
+        if(m_isClient) {
+            //streams above last_id were never processed
+            for(auto it = m_streams.begin(); it != m_streams.end();) {
+                if(it->first > last_id) {
+                    it->second->m_reset = true;
+                    it->second->m_error = Http2Error::REFUSED_STREAM;
+                    refused.push_back(it->second);
+                    it = m_streams.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+            wakeWindowWaiters();
+        }
+    }
+    for(auto& i : refused) {
+        i->notify();
+    }
+    return Http2Error::NO_ERROR;
+}
+
+void Http2Session::handleRequest(Http2Stream::ptr stream, http::HttpRequest::ptr req) {
+    if(!req) {
+        resetStream(stream->getId(), Http2Error::PROTOCOL_ERROR);
+        return;
+    }
+    if(!m_dispatch) {
+        resetStream(stream->getId(), Http2Error::REFUSED_STREAM);
+        return;
+    }
+    Http2Session::ptr self = shared_from_this();
+    IOManager* worker = m_worker ? m_worker : IOManager::GetThis();
+    worker->schedule([self, stream, req]() {
+        http::HttpResponse::ptr rsp = std::make_shared<http::HttpResponse>(0x20, false);
+        //servlets get no HttpSession, the connection is shared by streams
+        self->m_dispatch->handle(req, rsp, nullptr);
+        http::HttpCompress::CompressResponse(req, rsp);
+        self->sendResponse(stream, rsp);
+    });
+}
+
+http::HttpResult::ptr Http2Session::request(http::HttpRequest::ptr req, uint64_t timeout_ms) {
+    HeaderList headers;
+    headers.emplace_back(":method", http::HttpMethodToString(req->getMethod()));
+    headers.emplace_back(":scheme", "http");
+    std::string authority = req->getHeader("host");
+    if(authority.empty() && getSocket() && getSocket()->getRemoteAddress()) {
+        authority = getSocket()->getRemoteAddress()->toString();
+    }
+    headers.emplace_back(":authority", authority);
+    headers.emplace_back(":path", req->getPath()
+                + (req->getQuery().empty() ? "" : "?" + req->getQuery()));
+    HeaderList others = ToHeaderList(req->getHeaders());
+    headers.insert(headers.end(), others.begin(), others.end());
+    const std::string& body = req->getBody();
+    if(!body.empty()) {
+        headers.emplace_back("content-length", std::to_string(body.size()));
+    }
+
+    Http2Stream::ptr stream;
+    {
+        MutexType::Lock lock(m_mutex);
+        if(m_closed || m_goaway) {
+            return std::make_shared<http::HttpResult>((int)http::HttpResult::Error::SEND_CLOSE_BY_PEER
+                        , nullptr, "http2 session closed");
+        }
+        uint32_t id = m_nextStreamId;
+        m_nextStreamId += 2;
+        stream = std::make_shared<Http2Stream>(id
+                    ,m_peerSettings.initial_window_size
+                    ,m_localSettings.initial_window_size);
+        stream->m_state = Http2Stream::State::OPEN;
+        m_streams[id] = stream;
+        enqueueHeaders(id, headers, body.empty());
+        if(body.empty()) {
+            stream->onLocalEnd();
+        }
+    }
+    if(!body.empty() && sendData(stream, body, true) < 0) {
+        return std::make_shared<http::HttpResult>((int)http::HttpResult::Error::SEND_SOCKET_ERROR
+                    , nullptr, "send request body fail");
+    }
+    if(!stream->wait(timeout_ms)) {
+        resetStream(stream->getId(), Http2Error::CANCEL);
+        return std::make_shared<http::HttpResult>((int)http::HttpResult::Error::TIMEOUT
+                    , nullptr, "recv response timeout: " + std::to_string(timeout_ms));
+    }
+    if(stream->isReset()) {
+        return std::make_shared<http::HttpResult>((int)http::HttpResult::Error::SEND_CLOSE_BY_PEER
+                    , nullptr, std::string("stream reset: ") + Http2ErrorToString(stream->getError()));
+    }
+    return std::make_shared<http::HttpResult>((int)http::HttpResult::Error::OK
+                , stream->toResponse(), "ok");
+}
+
+}
+}
@@ -0,0 +1,143 @@
+#ifndef __TAO_HTTP2_SESSION_H__
+#define __TAO_HTTP2_SESSION_H__
+
+#include "http2_stream.h"
+#include "src/streams/socket_stream.h"
+#include "src/http/servlet.h"
+#include "src/http/http_connection.h"
+#include "src/iomanager.h"
+#include <unordered_map>
+#include <list>
+
+namespace tao {
+namespace http2 {
+
+/**
+ * @brief one http2 connection, used by both server and client
+ * run() reads frames in the calling fiber, a writer fiber sends queued frames,
+ * server streams are dispatched to ServletDispatch each in its own fiber
+ */
+class Http2Session : public SocketStream
+                    , public std::enable_shared_from_this<Http2Session> {
+public:
+    using ptr = std::shared_ptr<Http2Session>;
+    using MutexType = Mutex;
+
+    Http2Session(Socket::ptr sock, bool is_client);
+    ~Http2Session();
+
+    /**
+     * @brief server side, serve streams with dispatch
+     * @param[in] worker scheduler of stream fibers
+     */
+    void setDispatch(http::ServletDispatch::ptr dispatch, IOManager* worker);
+
+    /**
+     * @brief server side h2c upgrade, req becomes stream 1(rfc7540 3.2)
+     * @param[in] settings decoded HTTP2-Settings header
+     */
+    bool upgrade(http::HttpRequest::ptr req, const std::string& settings);
+
+    /**
+     * @brief send preface and SETTINGS, client also starts reading in a new fiber
+     */
+    bool start();
+
+    /**
+     * @brief read and handle frames until connection closed
+     */
+    void run();
+
+    /**
+     * @brief client side request, wait for the whole response
+     */
+    http::HttpResult::ptr request(http::HttpRequest::ptr req, uint64_t timeout_ms);
+
+    /**
+     * @brief send GOAWAY and close after pending frames are written
+     */
+    void goAway(Http2Error error, const std::string& debug = "");
+
+    bool isClient() const { return m_isClient;}
+    bool isClosed() const { return m_closed;}
+    const Settings& getPeerSettings() const { return m_peerSettings;}
+    const Settings& getLocalSettings() const { return m_localSettings;}
+    size_t getStreamCount();
+
+    //served from a read buffer, frame headers are small
+    virtual int read(void* buffer, size_t length) override;
+    virtual bool close() override;
+private:
+    //called with m_mutex locked
+    void enqueue(Frame::ptr frame);
+    //called with m_mutex locked
+    void enqueueHeaders(uint32_t stream_id, const HeaderList& headers, bool end_stream);
+    void writerLoop();
+
+    //take up to want bytes of send window, blocks current fiber when empty
+    int64_t acquireWindow(Http2Stream::ptr stream, int64_t want);
+    //called with m_mutex locked
+    void wakeWindowWaiters();
+
+    int sendData(Http2Stream::ptr stream, const std::string& data, bool end_stream);
+    void sendResponse(Http2Stream::ptr stream, http::HttpResponse::ptr rsp);
+    void resetStream(uint32_t id, Http2Error error);
+
+    Http2Error handleFrame(Frame::ptr frame);
+    Http2Error handleHeaderBlock(uint32_t id, uint8_t flags, const std::string& block);
+    Http2Error handleData(Frame::ptr frame);
+    Http2Error handleSettings(Frame::ptr frame);
+    Http2Error handleWindowUpdate(Frame::ptr frame);
+    Http2Error handleRstStream(Frame::ptr frame);
+    Http2Error handleGoAway(Frame::ptr frame);
+    //dispatch req in a worker fiber and send the response on stream
+    void handleRequest(Http2Stream::ptr stream, http::HttpRequest::ptr req);
+
+    Http2Stream::ptr getStream(uint32_t id);
+    //called with m_mutex locked
+    void delStream(uint32_t id);
+    void onClosed();
+private:
+    bool m_isClient;
+    bool m_closed;
+    //GOAWAY sent or received, no new streams
+    bool m_goaway;
+
+    MutexType m_mutex;
+    std::unordered_map<uint32_t, Http2Stream::ptr> m_streams;
+    //next local stream id, odd for client
+    uint32_t m_nextStreamId;
+    //largest stream id opened by peer
+    uint32_t m_lastPeerStreamId;
+
+    Settings m_localSettings;
+    Settings m_peerSettings;
+    HPackEncoder m_encoder;
+    HPackDecoder m_decoder;
+
+    int64_t m_sendWindow;
+    int64_t m_recvWindow;
+    int64_t m_recvWindowSize;
+    std::list<std::pair<Scheduler*, Fiber::ptr> > m_windowWaiters;
+
+    std::list<Frame::ptr> m_sendQueue;
+    FiberSemaphore m_sendSem;
+    bool m_writerRunning;
+    bool m_writerStop;
+
+    //header block of HEADERS waiting for CONTINUATION
+    uint32_t m_continuationId;
+    uint8_t m_continuationFlags;
+    std::string m_headerBlock;
+
+    std::string m_readBuf;
+    size_t m_readPos;
+
+    http::ServletDispatch::ptr m_dispatch;
+    IOManager* m_worker;
+};
+
+}
+}
+
+#endif
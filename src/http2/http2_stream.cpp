@@ -0,0 +1,181 @@
+#include "http2_stream.h"
+#include "src/iomanager.h"
+#include "src/log.h"
+
+namespace tao {
+namespace http2 {
+
+static tao::Logger::ptr g_logger = TAO_LOG_NAME("system");
+
+const char* Http2Stream::StateToString(State s) {
+    switch(s) {
+#define XX(name) \
+        case State::name: \
+            return #name;
+        XX(IDLE);
+        XX(OPEN);
+        XX(HALF_CLOSED_LOCAL);
+        XX(HALF_CLOSED_REMOTE);
+        XX(CLOSED);
+#undef XX
+        default:
+            return "UNKNOWN";
+    }
+}
+
+Http2Stream::Http2Stream(uint32_t id, int64_t send_window, int64_t recv_window)
+    :m_id(id)
+    ,m_state(State::IDLE)
+    ,m_reset(false)
+    ,m_error(Http2Error::NO_ERROR)
+    ,m_sendWindow(send_window)
+    ,m_recvWindow(recv_window)
+    ,m_done(false)
+    ,m_scheduler(nullptr) {
+}
+
+void Http2Stream::addHeaders(const HeaderList& headers) {
+    m_headers.insert(m_headers.end(), headers.begin(), headers.end());
+    if(m_state == State::IDLE) {
+        m_state = State::OPEN;
+    }
+}
+
+void Http2Stream::onRemoteEnd() {
+    if(m_state == State::HALF_CLOSED_LOCAL) {
+        m_state = State::CLOSED;
+    } else {
+        m_state = State::HALF_CLOSED_REMOTE;
+    }
+}
+
+void Http2Stream::onLocalEnd() {
+    if(m_state == State::HALF_CLOSED_REMOTE) {
+        m_state = State::CLOSED;
+    } else {
+        m_state = State::HALF_CLOSED_LOCAL;
+    }
+}
+
+http::HttpRequest::ptr Http2Stream::toRequest() const {
+    http::HttpRequest::ptr req = std::make_shared<http::HttpRequest>(0x20, false);
+    bool has_method = false;
+    bool has_path = false;
+    std::string cookie;
+    for(auto& i : m_headers) {
+        if(i.first.empty()) {
+            return nullptr;
+        }
+        if(i.first[0] != ':') {
+            if(i.first == "cookie") {
+                //split cookie fields are joined again(rfc7540 8.1.2.5)
+                cookie += (cookie.empty() ? "" : "; ") + i.second;
+            } else {
+                req->setHeader(i.first, i.second);
+            }
+            continue;
+        }
+        if(i.first == ":method") {
+            http::HttpMethod m = http::StringToHttpMethod(i.second);
+            if(m == http::HttpMethod::INVALID_METHOD) {
+                return nullptr;
+            }
+            req->setMethod(m);
+            has_method = true;
+        } else if(i.first == ":path") {
+            std::string path = i.second;
+            size_t pos = path.find('#');
+            if(pos != std::string::npos) {
+                req->setFragment(path.substr(pos + 1));
+                path.resize(pos);
+            }
+            pos = path.find('?');
+            if(pos != std::string::npos) {
+                req->setQuery(path.substr(pos + 1));
+                path.resize(pos);
+            }
+            if(path.empty()) {
+                return nullptr;
+            }
+            req->setPath(path);
+            has_path = true;
+        } else if(i.first == ":authority") {
+            req->setHeader("host", i.second);
+        } else if(i.first != ":scheme") {
+            return nullptr;
+        }
+    }
+    if(!has_method || !has_path) {
+        return nullptr;
+    }
+    if(!cookie.empty()) {
+        req->setHeader("cookie", cookie);
+    }
+    req->setBody(m_body);
+    return req;
+}
+
+http::HttpResponse::ptr Http2Stream::toResponse() const {
+    http::HttpResponse::ptr rsp = std::make_shared<http::HttpResponse>(0x20, false);
+    for(auto& i : m_headers) {
+        if(i.first == ":status") {
+            rsp->setStatus((http::HttpStatus)atoi(i.second.c_str()));
+        } else if(!i.first.empty() && i.first[0] != ':') {
+            rsp->setHeader(i.first, i.second);
+        }
+    }
+    rsp->setBody(m_body);
+    return rsp;
+}
+
+bool Http2Stream::wait(uint64_t timeout_ms) {
+    {
+        MutexType::Lock lock(m_mutex);
+        if(m_done) {
+            return true;
+        }
+        m_scheduler = Scheduler::GetThis();
+        m_waiter = Fiber::GetThis();
+    }
+    Timer::ptr timer;
+    if(timeout_ms != ~0ull) {
+        std::weak_ptr<Http2Stream> weak(shared_from_this());
+        timer = IOManager::GetThis()->addTimer(timeout_ms, [weak](){
+            auto self = weak.lock();
+            if(self) {
+                self->wake(false);
+            }
+        });
+    }
+    Fiber::YieldToHold();
+    if(timer) {
+        timer->cancel();
+    }
+    MutexType::Lock lock(m_mutex);
+    return m_done;
+}
+
+void Http2Stream::notify() {
+    wake(true);
+}
+
+void Http2Stream::wake(bool done) {
+    Scheduler* scheduler = nullptr;
+    Fiber::ptr fiber;
+    {
+        MutexType::Lock lock(m_mutex);
+        if(done) {
+            m_done = true;
+        }
+        if(!m_waiter) {
+            return;
+        }
+        scheduler = m_scheduler;
+        fiber.swap(m_waiter);
+        m_scheduler = nullptr;
+    }
+    scheduler->schedule(fiber);
+}
+
+}
+}
@@ -0,0 +1,84 @@
+#ifndef __TAO_HTTP2_STREAM_H__
+#define __TAO_HTTP2_STREAM_H__
+
+#include "frame.h"
+#include "hpack.h"
+#include "src/http/http.h"
+#include "src/mutex.h"
+#include "src/fiber.h"
+#include "src/scheduler.h"
+
+namespace tao {
+namespace http2 {
+
+/**
+ * @brief one http2 stream(rfc7540 5.1), owned by Http2Session
+ * its counters are guarded by the session mutex
+ */
+class Http2Stream : public std::enable_shared_from_this<Http2Stream> {
+friend class Http2Session;
+public:
+    using ptr = std::shared_ptr<Http2Stream>;
+    using MutexType = Mutex;
+
+    enum class State {
+        IDLE,
+        OPEN,
+        HALF_CLOSED_LOCAL,
+        HALF_CLOSED_REMOTE,
+        CLOSED,
+    };
+
+    Http2Stream(uint32_t id, int64_t send_window, int64_t recv_window);
+
+    uint32_t getId() const { return m_id;}
+    State getState() const { return m_state;}
+    Http2Error getError() const { return m_error;}
+    bool isReset() const { return m_reset;}
+
+    const HeaderList& getHeaders() const { return m_headers;}
+    const std::string& getBody() const { return m_body;}
+
+    //request of server side stream, nullptr on malformed pseudo headers
+    http::HttpRequest::ptr toRequest() const;
+    //response of client side stream
+    http::HttpResponse::ptr toResponse() const;
+
+    /**
+     * @brief wait in current fiber until remote side finished or stream reset
+     * @return false on timeout
+     */
+    bool wait(uint64_t timeout_ms);
+    //mark finished and wake the fiber in wait(), safe to call more than once
+    void notify();
+
+    static const char* StateToString(State s);
+private:
+    void addHeaders(const HeaderList& headers);
+    void appendData(const std::string& data) { m_body.append(data);}
+    //remote sent END_STREAM
+    void onRemoteEnd();
+    //local sent END_STREAM
+    void onLocalEnd();
+    void wake(bool done);
+private:
+    uint32_t m_id;
+    State m_state;
+    bool m_reset;
+    Http2Error m_error;
+    //may become negative after a SETTINGS_INITIAL_WINDOW_SIZE decrease
+    int64_t m_sendWindow;
+    int64_t m_recvWindow;
+    HeaderList m_headers;
+    std::string m_body;
+
+    MutexType m_mutex;
+    bool m_done;
+    Scheduler* m_scheduler;
+    Fiber::ptr m_waiter;
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef __TAO_HTTP2_HUFFMAN_H__
+#define __TAO_HTTP2_HUFFMAN_H__
+
+#include <string>
+#include <stdint.h>
+
+namespace tao {
+namespace http2 {
+
+/**
+ * @brief static huffman code of hpack(rfc7541 5.2)
+ */
+class Huffman {
+public:
+    static size_t EncodedLength(const std::string& str);
+    static void Encode(const std::string& str, std::string& out);
+    /**
+     * @brief decode huffman string, false on invalid code or padding
+     */
+    static bool Decode(const char* data, size_t len, std::string& out);
+};
+
+}
+}
+
+#endif
@@ -270,6 +270,11 @@ void IOManager::idle() {
                             << " idle stopping exit";
             break; 
         }
+        if (TAO_UNLIKELY(retiring())) {
+            TAO_LOG_INFO(g_logger) << "name = " << getName()
+                            << " idle retire exit";
+            break;
+        }
         //TAO_LOG_DEBUG(g_logger) << "==========";
         int rt = 0;
         do {
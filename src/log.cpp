@@ -6,6 +6,16 @@
 #include <functional>
 #include "env.h"
 #include "util.h"
+#include <charconv>
+#include <fcntl.h>
+#include <sched.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <algorithm>
+#include "streams/zlib_stream.h"
 
 
 namespace tao {
@@ -195,6 +205,83 @@ LogEvent::LogEvent(std::shared_ptr<Logger> logger, LogLevel::Level level
     ,m_level(level) {
 }
 
+//content buffers above this are not kept by a pooled event
+static const size_t s_log_event_keep_size = 64 * 1024;
+
+static thread_local LogEvent::ptr t_log_event;
+
+LogEvent::ptr LogEvent::Create(const std::shared_ptr<Logger>& logger, LogLevel::Level level
+            ,const char* file, int32_t line, uint32_t elapse
+            ,uint32_t thread_id, uint32_t fiber_id, uint64_t time
+            ,const std::string& thread_name) {
+    //still referenced when a fiber logs while another record of this thread is being built
+    if(!t_log_event || t_log_event.use_count() != 1) {
+        auto event = std::make_shared<LogEvent>(logger, level, file, line
+                        ,elapse, thread_id, fiber_id, time, thread_name);
+        if(!t_log_event) {
+            t_log_event = event;
+        }
+        return event;
+    }
+    LogEvent* e = t_log_event.get();
+    e->m_file = file;
+    e->m_line = line;
+    e->m_elapse = elapse;
+    e->m_threadId = thread_id;
+    e->m_fiberId = fiber_id;
+    e->m_time = time;
+    e->m_threadName = thread_name;
+    e->m_logger = logger;
+    e->m_level = level;
+    e->m_buf.reset(s_log_event_keep_size);
+    e->m_fmt = nullptr;
+    e->m_types = nullptr;
+    e->m_rendered = false;
+    if(e->m_args.capacity() > s_log_event_keep_size) {
+        std::string().swap(e->m_args);
+    }
+    e->m_args.clear();
+    e->m_ss.clear();
+    e->m_ss.flags(std::ios_base::skipws | std::ios_base::dec);
+    e->m_ss.precision(6);
+    e->m_ss.width(0);
+    e->m_ss.fill(' ');
+    return t_log_event;
+}
+
+void LogEvent::render() const {
+    if(!m_fmt || m_rendered) {
+        return;
+    }
+    m_rendered = true;
+    static thread_local std::string t_buf;
+    t_buf.clear();
+    if(!LogArgs::Render(t_buf, m_fmt, m_types, m_args.data(), m_args.size())) {
+        t_buf.append("<<bad_args>>");
+    }
+    m_buf.sputn(t_buf.data(), t_buf.size());
+}
+
+void LogStreamBuf::reset(size_t max_keep) {
+    if(m_data.size() > max_keep) {
+        std::string().swap(m_data);
+    }
+    char* p = m_data.empty() ? nullptr : &m_data[0];
+    setp(p, p + m_data.size());
+}
+
+LogStreamBuf::int_type LogStreamBuf::overflow(int_type c) {
+    size_t used = size();
+    m_data.resize(std::max(used * 2, (size_t)256));
+    setp(&m_data[0], &m_data[0] + m_data.size());
+    pbump(used);
+    if(!traits_type::eq_int_type(c, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+    }
+    return traits_type::not_eof(c);
+}
+
  void LogAppender::setFormatter(LogFormatter::ptr val) {
     m_formatter = val;
     if (m_formatter) {
@@ -240,7 +327,7 @@ void Logger::clearAppenders() {
 }
 
 void Logger::log(LogLevel::Level level, LogEvent::ptr event){
-    if (level >= m_level) {
+    if (level >= getLevel()) {
         auto self = shared_from_this();
         MutexType::Lock lock(m_mutex);
         if (!m_appenders.empty()) {
@@ -273,8 +360,9 @@ std::string Logger::toYamlString() {
     MutexType::Lock lock(m_mutex);
     YAML::Node node;
     node["name"] = m_name;
-    if (m_level != LogLevel::UNKNOW) {
-        node["level"] = LogLevel::ToString(m_level);
+    LogLevel::Level level = getLevel();
+    if (level != LogLevel::UNKNOW) {
+        node["level"] = LogLevel::ToString(level);
     }
     if (m_formatter) {
         node["formatter"] = m_formatter->getPattern();
@@ -322,36 +410,366 @@ LogFormatter::ptr Logger::getFormatter() {
     return m_formatter;
 }
 
-FileLogAppender::FileLogAppender(const std::string& filename)
-    :m_filename(filename){
+//cleared per-thread output buffer of the appenders
+static std::string& GetFormatBuffer() {
+    static thread_local std::string t_buf;
+    if (t_buf.capacity() > s_log_event_keep_size) {
+        std::string().swap(t_buf);
+    }
+    t_buf.clear();
+    return t_buf;
+}
+
+static int OpenLogFile(const std::string& filename) {
+    int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if(fd < 0) {
+        FSUtil::Mkdir(FSUtil::Dirname(filename));
+        fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    }
+    return fd;
+}
+
+static bool WriteFully(int fd, const char* data, size_t size) {
+    size_t offset = 0;
+    while(fd >= 0 && offset < size) {
+        ssize_t rt = ::write(fd, data + offset, size - offset);
+        if(rt < 0 && errno == EINTR) {
+            continue;
+        }
+        if(rt <= 0) {
+            return false;
+        }
+        offset += rt;
+    }
+    return fd >= 0;
+}
+
+//next multiple of interval seconds in local time, 86400 is the next midnight
+static uint64_t NextRotateTime(uint64_t now, uint32_t interval) {
+    if(!interval) {
+        return 0;
+    }
+    time_t t = now;
+    struct tm tm;
+    localtime_r(&t, &tm);
+    int64_t local = (int64_t)now + tm.tm_gmtoff;
+    return (local / interval + 1) * interval - tm.tm_gmtoff;
+}
+
+//filename.YYYYmmdd-HHMMSS, .1 .2 ... when rotated more than once a second.
+//seq keeps counting within a second so a pruned name is never reused
+static std::string SegmentName(const std::string& filename, uint64_t now
+                                ,std::string& last_stamp, uint32_t& seq) {
+    time_t t = now;
+    struct tm tm;
+    localtime_r(&t, &tm);
+    char buf[32];
+    strftime(buf, sizeof(buf), ".%Y%m%d-%H%M%S", &tm);
+    if(last_stamp != buf) {
+        last_stamp = buf;
+        seq = 0;
+    }
+    std::string name;
+    struct stat st;
+    do {
+        name = filename + buf;
+        if(seq) {
+            name += "." + std::to_string(seq);
+        }
+        ++seq;
+    } while(stat(name.c_str(), &st) == 0 || stat((name + ".gz").c_str(), &st) == 0);
+    return name;
+}
+
+//gzip from into to, from is removed on success
+static bool CompressSegment(const std::string& from, const std::string& to) {
+    int in = open(from.c_str(), O_RDONLY | O_CLOEXEC);
+    if(in < 0) {
+        return false;
+    }
+    std::string tmp = to + ".tmp";
+    int out = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if(out < 0) {
+        close(in);
+        return false;
+    }
+    ZlibStream::ptr zs = ZlibStream::CreateGzip(true, 64 * 1024);
+    std::string buf(64 * 1024, '\0');
+    //compressed output is written and released after every input chunk
+    auto drain = [&zs, out]() {
+        for(auto& i : zs->getBuffers()) {
+            if(!WriteFully(out, (const char*)i.iov_base, i.iov_len)) {
+                return false;
+            }
+        }
+        zs->clearBuffers();
+        return true;
+    };
+    bool ok = zs != nullptr;
+    while(ok) {
+        ssize_t n = read(in, &buf[0], buf.size());
+        if(n < 0 && errno == EINTR) {
+            continue;
+        }
+        if(n < 0) {
+            ok = false;
+        } else if(n == 0) {
+            ok = zs->flush() == Z_OK && drain();
+            break;
+        } else {
+            ok = zs->write(buf.c_str(), n) == Z_OK && drain();
+        }
+    }
+    close(in);
+    ok = fsync(out) == 0 && ok;
+    close(out);
+    if(!ok || rename(tmp.c_str(), to.c_str())) {
+        unlink(tmp.c_str());
+        return false;
+    }
+    unlink(from.c_str());
+    return true;
+}
+
+//removes the oldest filename.YYYYmmdd-HHMMSS[.N][.gz] beyond max_files
+static void PruneSegments(const std::string& filename, uint32_t max_files) {
+    std::string dir = FSUtil::Dirname(filename);
+    std::string prefix = FSUtil::Basename(filename) + ".";
+    DIR* d = opendir(dir.c_str());
+    if(!d) {
+        return;
+    }
+    //ordered by stamp, then by the sequence number after it
+    std::vector<std::pair<std::pair<std::string, uint64_t>, std::string> > segments;
+    while(struct dirent* dp = readdir(d)) {
+        std::string name = dp->d_name;
+        if(name.size() >= prefix.size() + 15
+                && name.compare(0, prefix.size(), prefix) == 0
+                && isdigit((unsigned char)name[prefix.size()])
+                && name[prefix.size() + 8] == '-'
+                && (name.size() < 4 || name.compare(name.size() - 4, 4, ".tmp") != 0)) {
+            size_t pos = prefix.size() + 15;
+            uint64_t seq = 0;
+            if(pos + 1 < name.size() && name[pos] == '.' && isdigit((unsigned char)name[pos + 1])) {
+                seq = strtoull(name.c_str() + pos + 1, nullptr, 10);
+            }
+            segments.push_back(std::make_pair(std::make_pair(name.substr(prefix.size(), 15), seq), name));
+        }
+    }
+    closedir(d);
+    if(segments.size() <= max_files) {
+        return;
+    }
+    std::sort(segments.begin(), segments.end());
+    for(size_t i = 0; i < segments.size() - max_files; ++i) {
+        FSUtil::Unlink(dir + "/" + segments[i].second);
+    }
+}
+
+/**
+ * @brief the thread behind every FileLogAppender
+ * wakes up once a second or when a writer asks for a rotation, never destroyed
+ * so appenders released by static destructors can still unregister
+ */
+class LogRotator {
+public:
+    static LogRotator* GetInstance() {
+        static LogRotator* s_instance = new LogRotator;
+        return s_instance;
+    }
+
+    void add(FileLogAppender* appender) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_appenders.insert(appender);
+        start();
+    }
+
+    //waits for a running maintain of the appender
+    void del(FileLogAppender* appender) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_appenders.erase(appender);
+    }
+
+    void notify() {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_notified = true;
+            start();
+        }
+        m_cond.notify_one();
+    }
+private:
+    struct Segment {
+        std::string path;
+        std::string filename;
+        uint32_t max_files;
+        bool compress;
+    };
+
+    LogRotator() {
+        pthread_atfork([]() { GetInstance()->m_mutex.lock();}
+                      ,[]() { GetInstance()->m_mutex.unlock();}
+                      ,[]() {
+                          //the thread is gone in the child, it is started again on demand
+                          LogRotator* self = GetInstance();
+                          new Thread::ptr(std::move(self->m_thread));
+                          self->m_mutex.unlock();
+                      });
+    }
+
+    //m_mutex held
+    void start() {
+        if(!m_thread) {
+            m_thread = std::make_shared<Thread>(std::bind(&LogRotator::run, this), "log_rotate");
+        }
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        std::vector<Segment> segments;
+        while(true) {
+            m_cond.wait_for(lock, std::chrono::seconds(1), [this]() { return m_notified;});
+            m_notified = false;
+            uint64_t now = time(0);
+            for(auto i : m_appenders) {
+                std::string path = i->maintain(now);
+                if(!path.empty()) {
+                    segments.push_back(Segment{path, i->m_filename, i->m_maxFiles, i->m_compress});
+                }
+            }
+            if(segments.empty()) {
+                continue;
+            }
+            lock.unlock();
+            for(auto& i : segments) {
+                if(i.compress && !CompressSegment(i.path, i.path + ".gz")) {
+                    std::cout << "log compress " << i.path << " failed errno=" << errno
+                              << " errstr=" << strerror(errno) << std::endl;
+                }
+                if(i.max_files) {
+                    PruneSegments(i.filename, i.max_files);
+                }
+            }
+            segments.clear();
+            lock.lock();
+        }
+    }
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::set<FileLogAppender*> m_appenders;
+    bool m_notified = false;
+    Thread::ptr m_thread;
+};
+
+FileLogAppender::FileLogAppender(const std::string& filename, uint64_t max_size
+                                ,uint32_t rotate_interval, uint32_t max_files
+                                ,bool compress)
+    :m_filename(filename)
+    ,m_maxSize(max_size)
+    ,m_rotateInterval(rotate_interval)
+    ,m_maxFiles(max_files)
+    ,m_compress(compress) {
     reopen();
+    m_lastCheck = time(0);
+    m_nextRotate = NextRotateTime(m_lastCheck, m_rotateInterval);
+    LogRotator::GetInstance()->add(this);
+}
+
+FileLogAppender::~FileLogAppender() {
+    LogRotator::GetInstance()->del(this);
+    if(m_fd >= 0) {
+        close(m_fd);
+    }
 }
 
 void FileLogAppender::log(std::shared_ptr<Logger>logger, LogLevel::Level level, LogEvent::ptr event) {
     if (level >= m_level) {
-        uint64_t now = event->getTime();
-        if (now >= (m_lastTime + 3)) {
-            reopen();
-            m_lastTime = now;
+        std::string& buf = GetFormatBuffer();
+        m_formatter->format(buf, logger, level, event);
+        bool rotate = false;
+        {
+            MutexType::Lock lock(m_mutex);
+            if(!WriteFully(m_fd, buf.c_str(), buf.size())) {
+                std::cout << "error" << std::endl;
+            }
+            m_size += buf.size();
+            if(!m_rotateRequested
+                    && ((m_maxSize && m_size >= m_maxSize)
+                        || (m_nextRotate && event->getTime() >= m_nextRotate))) {
+                m_rotateRequested = rotate = true;
+            }
         }
-        MutexType::Lock lock(m_mutex);
-        // if (!m_filestream.is_open()) std::cerr << "Failed to open file." << std::endl;
-        // if (m_filestream.bad()) std::cerr << "I/O error while reading/writing to file." << std::endl;
-        // if (m_filestream.fail()) std::cerr << "Logical error on I/O operation." << std::endl;
-        // if (m_filestream.eof()) std::cerr << "End of file reached unexpectedly." << std::endl;
-
-        if (!m_formatter->format(m_filestream, logger, level, event)) {
-            std::cout << "error" << std::endl;
+        if(rotate) {
+            LogRotator::GetInstance()->notify();
         }
     }
 }
 
 bool FileLogAppender::reopen(){
-    MutexType::Lock lock(m_mutex);
-    if (m_filestream) {
-        m_filestream.close();
+    int fd = OpenLogFile(m_filename);
+    if(fd < 0) {
+        return false;
+    }
+    struct stat st;
+    uint64_t size = fstat(fd, &st) == 0 ? st.st_size : 0;
+    int old = -1;
+    {
+        MutexType::Lock lock(m_mutex);
+        old = m_fd;
+        m_fd = fd;
+        m_size = size;
+    }
+    if(old >= 0) {
+        close(old);
+    }
+    return true;
+}
+
+void FileLogAppender::rotate() {
+    {
+        MutexType::Lock lock(m_mutex);
+        m_rotateRequested = true;
+    }
+    LogRotator::GetInstance()->notify();
+}
+
+std::string FileLogAppender::maintain(uint64_t now) {
+    bool due = false;
+    bool empty = false;
+    int fd = -1;
+    {
+        MutexType::Lock lock(m_mutex);
+        due = m_rotateRequested || (m_nextRotate && now >= m_nextRotate);
+        empty = m_size == 0;
+        fd = m_fd;
+    }
+    std::string segment;
+    if(due && !empty) {
+        //writers keep appending to the renamed file until the new one is swapped in
+        segment = SegmentName(m_filename, now, m_lastStamp, m_stampSeq);
+        if(rename(m_filename.c_str(), segment.c_str()) == 0) {
+            ++m_rotated;
+        } else {
+            segment.clear();
+        }
+        reopen();
+        m_lastCheck = now;
+    } else if(now >= m_lastCheck + 3) {
+        m_lastCheck = now;
+        struct stat path_st;
+        struct stat fd_st;
+        if(fd < 0 || stat(m_filename.c_str(), &path_st) || fstat(fd, &fd_st)
+                || path_st.st_ino != fd_st.st_ino || path_st.st_dev != fd_st.st_dev) {
+            reopen();
+        }
     }
-    return FSUtil::OpenForWrite(m_filestream, m_filename, std::ios::app);
+    if(due) {
+        MutexType::Lock lock(m_mutex);
+        m_rotateRequested = false;
+        m_nextRotate = NextRotateTime(now, m_rotateInterval);
+    }
+    return segment;
 }
 
 std::string FileLogAppender::toYamlString() {
@@ -359,6 +777,18 @@ std::string FileLogAppender::toYamlString() {
     YAML::Node node;
     node["type"] = "FileLogAppender";
     node["file"] = m_filename;
+    if(m_maxSize) {
+        node["max_size"] = m_maxSize;
+    }
+    if(m_rotateInterval) {
+        node["rotate_interval"] = m_rotateInterval;
+    }
+    if(m_maxFiles) {
+        node["max_files"] = m_maxFiles;
+    }
+    if(m_compress) {
+        node["compress"] = m_compress;
+    }
     if(m_level != LogLevel::UNKNOW) {
         node["level"] = LogLevel::ToString(m_level);
     }
@@ -373,7 +803,9 @@ std::string FileLogAppender::toYamlString() {
 void StdoutLogAppender::log(std::shared_ptr<Logger>logger, LogLevel::Level level, LogEvent::ptr event) {
     if (level >= m_level) {
         MutexType::Lock lock(m_mutex);
-        std::cout << m_formatter->format(logger, level, event) << std::endl;
+        std::string& buf = GetFormatBuffer();
+        m_formatter->format(buf, logger, level, event);
+        std::cout.write(buf.c_str(), buf.size()) << std::endl;
     }
 }
 
@@ -392,6 +824,686 @@ std::string StdoutLogAppender::toYamlString() {
     return ss.str();
 }
 
+//bytes of all rings alive
+static std::atomic<uint64_t> s_ring_bytes{0};
+
+//single producer(the owner thread) single consumer(the writer thread) byte ring
+//a record is a 4 byte length and the text, padded to 8 bytes
+class AsyncLogAppender::Ring {
+public:
+    using ptr = std::shared_ptr<Ring>;
+    static const uint32_t WRAP = 0xFFFFFFFF;
+
+    Ring(uint32_t capacity, std::weak_ptr<void> owner)
+        :m_capacity(capacity)
+        ,m_buffer(new char[capacity])
+        ,m_owner(owner) {
+        s_ring_bytes += m_capacity;
+    }
+
+    ~Ring() {
+        s_ring_bytes -= m_capacity;
+    }
+
+    uint32_t getCapacity() const { return m_capacity;}
+    //the producer thread exited
+    bool isOrphan() const { return m_owner.expired();}
+
+    uint64_t used() const {
+        return m_head.load(std::memory_order_relaxed) - m_tail.load(std::memory_order_acquire);
+    }
+
+    bool empty() const {
+        return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+    }
+
+    bool push(const char* data, uint32_t len) {
+        uint64_t need = align(sizeof(uint32_t) + len);
+        uint64_t head = m_head.load(std::memory_order_relaxed);
+        uint64_t tail = m_tail.load(std::memory_order_acquire);
+        uint64_t pos = head & (m_capacity - 1);
+        uint64_t contiguous = m_capacity - pos;
+        uint64_t total = contiguous < need ? contiguous + need : need;
+        if(m_capacity - (head - tail) < total) {
+            return false;
+        }
+        if(contiguous < need) {
+            //rest of the buffer is skipped, positions stay 8 byte aligned
+            memcpy(m_buffer.get() + pos, &WRAP, sizeof(WRAP));
+            head += contiguous;
+            pos = 0;
+        }
+        memcpy(m_buffer.get() + pos, &len, sizeof(len));
+        memcpy(m_buffer.get() + pos + sizeof(len), data, len);
+        m_head.store(head + need, std::memory_order_release);
+        return true;
+    }
+
+    //append records to out until it reaches max, returns records consumed
+    uint64_t pop(std::string& out, size_t max) {
+        uint64_t tail = m_tail.load(std::memory_order_relaxed);
+        uint64_t head = m_head.load(std::memory_order_acquire);
+        uint64_t count = 0;
+        while(tail < head && out.size() < max) {
+            uint64_t pos = tail & (m_capacity - 1);
+            uint32_t len = 0;
+            memcpy(&len, m_buffer.get() + pos, sizeof(len));
+            if(len == WRAP) {
+                tail += m_capacity - pos;
+                continue;
+            }
+            out.append(m_buffer.get() + pos + sizeof(len), len);
+            tail += align(sizeof(uint32_t) + len);
+            ++count;
+        }
+        m_tail.store(tail, std::memory_order_release);
+        return count;
+    }
+private:
+    static uint64_t align(uint64_t v) {
+        return (v + 7) & ~7ull;
+    }
+private:
+    uint32_t m_capacity;
+    std::unique_ptr<char[]> m_buffer;
+    //alive as long as the producer thread
+    std::weak_ptr<void> m_owner;
+    alignas(64) std::atomic<uint64_t> m_head{0};
+    alignas(64) std::atomic<uint64_t> m_tail{0};
+};
+
+//bytes written by one write call
+static const size_t s_async_batch_size = 256 * 1024;
+//writer wakes up at least this often(ms)
+static const uint32_t s_async_interval = 10;
+static std::atomic<uint64_t> s_async_appender_id{0};
+
+const char* AsyncLogAppender::OverflowToString(Overflow v) {
+    switch(v) {
+        case Overflow::DROP:
+            return "drop";
+        case Overflow::DROP_DEBUG:
+            return "drop_debug";
+        case Overflow::BLOCK:
+        default:
+            return "block";
+    }
+}
+
+AsyncLogAppender::Overflow AsyncLogAppender::OverflowFromString(const std::string& str) {
+    if(strcasecmp(str.c_str(), "drop") == 0) {
+        return Overflow::DROP;
+    }
+    if(strcasecmp(str.c_str(), "drop_debug") == 0) {
+        return Overflow::DROP_DEBUG;
+    }
+    return Overflow::BLOCK;
+}
+
+AsyncLogAppender::AsyncLogAppender(const std::string& filename, Overflow overflow
+                                ,uint32_t buffer_size)
+    :m_filename(filename)
+    ,m_overflow(overflow)
+    ,m_bufferSize(4096)
+    ,m_id(++s_async_appender_id) {
+    while(m_bufferSize < buffer_size && m_bufferSize < (1u << 30)) {
+        m_bufferSize <<= 1;
+    }
+    if(m_filename.empty()) {
+        m_fd = STDOUT_FILENO;
+    } else {
+        reopen();
+    }
+    m_thread.reset(new Thread(std::bind(&AsyncLogAppender::run, this), "async_log"));
+}
+
+AsyncLogAppender::~AsyncLogAppender() {
+    {
+        std::unique_lock<std::mutex> lock(m_waitMutex);
+        m_stop = true;
+    }
+    m_cond.notify_one();
+    m_thread->join();
+    if(m_fd > STDERR_FILENO) {
+        close(m_fd);
+    }
+}
+
+AsyncLogAppender::Ring::ptr AsyncLogAppender::getRing() {
+    //the appender owns the rings, a destroyed appender frees them.
+    //keyed by appender id, a new appender never reuses the ring of a destroyed one
+    static thread_local std::unordered_map<uint64_t, std::weak_ptr<Ring> > t_rings;
+    static thread_local std::shared_ptr<bool> t_alive = std::make_shared<bool>(true);
+    auto it = t_rings.find(m_id);
+    if(it != t_rings.end()) {
+        Ring::ptr ring = it->second.lock();
+        if(ring) {
+            return ring;
+        }
+    }
+    //entries of destroyed appenders
+    for(auto i = t_rings.begin(); i != t_rings.end();) {
+        if(i->second.expired()) {
+            i = t_rings.erase(i);
+        } else {
+            ++i;
+        }
+    }
+    Ring::ptr ring = std::make_shared<Ring>(m_bufferSize, t_alive);
+    t_rings[m_id] = ring;
+    Mutex::Lock lock(m_ringMutex);
+    m_rings.push_back(ring);
+    return ring;
+}
+
+uint64_t AsyncLogAppender::GetRingBytes() {
+    return s_ring_bytes;
+}
+
+void AsyncLogAppender::log(std::shared_ptr<Logger>logger, LogLevel::Level level, LogEvent::ptr event) {
+    if(level < m_level) {
+        return;
+    }
+    LogFormatter::ptr formatter;
+    {
+        MutexType::Lock lock(m_mutex);
+        formatter = m_formatter;
+    }
+    std::string& str = GetFormatBuffer();
+    formatter->format(str, logger, level, event);
+    Ring::ptr ring = getRing();
+    //a record never takes more than a quarter of the ring, a longer one is cut and counted
+    uint32_t max_len = ring->getCapacity() / 4 - 8;
+    if(str.size() > max_len) {
+        static const char s_truncated[] = " ...(truncated)\n";
+        str.replace(max_len - (sizeof(s_truncated) - 1), std::string::npos, s_truncated);
+        ++m_truncated;
+    }
+    uint32_t len = str.size();
+    bool low = level <= LogLevel::INFO;
+    if(m_overflow == Overflow::DROP_DEBUG && low
+            && ring->used() + len > ring->getCapacity() / 4 * 3) {
+        ++m_dropped;
+        return;
+    }
+    while(!ring->push(str.c_str(), len)) {
+        if(m_overflow == Overflow::DROP
+                || (m_overflow == Overflow::DROP_DEBUG && low)) {
+            ++m_dropped;
+            return;
+        }
+        //a hooked sleep would switch fibers while Logger holds its lock, so only yield the cpu
+        m_cond.notify_one();
+        sched_yield();
+    }
+    if(ring->used() > ring->getCapacity() / 2) {
+        m_cond.notify_one();
+    }
+}
+
+void AsyncLogAppender::flush() {
+    std::unique_lock<std::mutex> lock(m_waitMutex);
+    uint64_t req = ++m_flushRequest;
+    m_cond.notify_one();
+    m_flushCond.wait(lock, [this, req]() { return m_flushDone >= req || m_stop;});
+}
+
+void AsyncLogAppender::run() {
+    std::string batch;
+    batch.reserve(s_async_batch_size + 4096);
+    std::vector<Ring::ptr> rings;
+    time_t last_open = time(0);
+    while(true) {
+        uint64_t req = 0;
+        bool stop = false;
+        {
+            std::unique_lock<std::mutex> lock(m_waitMutex);
+            req = m_flushRequest;
+            stop = m_stop;
+        }
+        {
+            Mutex::Lock lock(m_ringMutex);
+            rings = m_rings;
+        }
+        uint64_t count = 0;
+        //one batch per ring and pass, a busy thread can not starve the others
+        for(auto& i : rings) {
+            count += i->pop(batch, s_async_batch_size);
+            if(batch.size() >= s_async_batch_size) {
+                write(batch);
+            }
+        }
+        write(batch);
+        m_written += count;
+        rings.clear();
+        {
+            //rings of exited threads
+            Mutex::Lock lock(m_ringMutex);
+            for(auto it = m_rings.begin(); it != m_rings.end();) {
+                if((*it)->isOrphan() && (*it)->empty()) {
+                    it = m_rings.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+        //reopen like FileLogAppender, so a rotated file is picked up
+        time_t now = time(0);
+        if(!m_filename.empty() && now >= last_open + 3) {
+            reopen();
+            last_open = now;
+        }
+
+        std::unique_lock<std::mutex> lock(m_waitMutex);
+        if(!count) {
+            //a pass that found nothing left, everything queued before req is written
+            m_flushDone = req;
+            m_flushCond.notify_all();
+            if(stop) {
+                break;
+            }
+        }
+        if(!count && !m_stop && m_flushRequest == req) {
+            m_cond.wait_for(lock, std::chrono::milliseconds(s_async_interval));
+        }
+    }
+}
+
+void AsyncLogAppender::write(std::string& batch) {
+    WriteFully(m_fd, batch.c_str(), batch.size());
+    batch.clear();
+}
+
+void AsyncLogAppender::reopen() {
+    int fd = OpenLogFile(m_filename);
+    if(fd < 0) {
+        return;
+    }
+    if(m_fd >= 0) {
+        close(m_fd);
+    }
+    m_fd = fd;
+}
+
+std::string AsyncLogAppender::toYamlString() {
+    MutexType::Lock lock(m_mutex);
+    YAML::Node node;
+    node["type"] = "AsyncLogAppender";
+    if(!m_filename.empty()) {
+        node["file"] = m_filename;
+    }
+    node["overflow"] = OverflowToString(m_overflow);
+    node["buffer_size"] = m_bufferSize;
+    if(m_level != LogLevel::UNKNOW) {
+        node["level"] = LogLevel::ToString(m_level);
+    }
+    if(m_hasFormatter && m_formatter) {
+        node["formatter"] = m_formatter->getPattern();
+    }
+    std::stringstream ss;
+    ss << node;
+    return ss.str();
+}
+
+const char* BinaryLogAppender::MAGIC = "TAOBLOG1";
+static const size_t s_binlog_magic_size = 8;
+
+static std::string BinaryLogRotatedName(const std::string& filename, uint32_t index) {
+    return filename + "." + std::to_string(index);
+}
+
+//string arguments interned per file
+static const size_t s_binlog_max_strings = 4096;
+static const size_t s_binlog_max_string_size = 64;
+
+BinaryLogAppender::BinaryLogAppender(const std::string& filename, uint64_t max_size)
+    :m_filename(filename)
+    ,m_maxSize(std::max(max_size, (uint64_t)4096)) {
+    while(access(BinaryLogRotatedName(m_filename, m_index + 1).c_str(), F_OK) == 0) {
+        ++m_index;
+    }
+    //keep what an earlier process wrote
+    struct stat st;
+    if(stat(m_filename.c_str(), &st) == 0 && st.st_size > 0) {
+        ++m_index;
+        rename(m_filename.c_str(), BinaryLogRotatedName(m_filename, m_index).c_str());
+    }
+    open();
+}
+
+BinaryLogAppender::~BinaryLogAppender() {
+    MutexType::Lock lock(m_mutex);
+    close();
+}
+
+bool BinaryLogAppender::open() {
+    m_fd = ::open(m_filename.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if(m_fd < 0) {
+        FSUtil::Mkdir(FSUtil::Dirname(m_filename));
+        m_fd = ::open(m_filename.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    }
+    if(m_fd < 0) {
+        std::cout << "BinaryLogAppender open " << m_filename << " fail errno=" << errno << std::endl;
+        return false;
+    }
+    //the tail stays zero(END) until written, so a crashed process leaves a readable file
+    void* data = MAP_FAILED;
+    if(ftruncate(m_fd, m_maxSize) == 0) {
+        data = mmap(nullptr, m_maxSize, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    }
+    if(data == MAP_FAILED) {
+        std::cout << "BinaryLogAppender map " << m_filename << " fail errno=" << errno << std::endl;
+        ::close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+    m_data = (char*)data;
+    memcpy(m_data, MAGIC, s_binlog_magic_size);
+    m_offset = s_binlog_magic_size;
+    resetDictionaries();
+    return true;
+}
+
+void BinaryLogAppender::resetDictionaries() {
+    m_lastTime = 0;
+    m_sites.clear();
+    m_contexts.clear();
+    m_contextCount = 0;
+    m_strings.clear();
+    m_stringData.clear();
+}
+
+void BinaryLogAppender::close() {
+    if(m_data) {
+        munmap(m_data, m_maxSize);
+        m_data = nullptr;
+    }
+    if(m_fd >= 0) {
+        if(ftruncate(m_fd, m_offset) != 0) {
+            std::cout << "BinaryLogAppender truncate " << m_filename << " fail errno=" << errno << std::endl;
+        }
+        ::close(m_fd);
+        m_fd = -1;
+    }
+}
+
+bool BinaryLogAppender::rotate() {
+    MutexType::Lock lock(m_mutex);
+    return doRotate();
+}
+
+bool BinaryLogAppender::doRotate() {
+    close();
+    ++m_index;
+    rename(m_filename.c_str(), BinaryLogRotatedName(m_filename, m_index).c_str());
+    return open();
+}
+
+uint64_t BinaryLogAppender::getSite(const LogEvent::ptr& event, LogLevel::Level level) {
+    const char* fmt = event->getFmt();
+    SiteKey key{event->getFile(), event->getLine(), fmt, event->getArgTypes(), level};
+    auto it = m_sites.find(key);
+    if(it != m_sites.end()) {
+        return it->second;
+    }
+    uint64_t id = m_sites.size();
+    m_sites.emplace(key, id);
+    m_record.push_back(SITE);
+    LogArgs::PutVarint(m_record, id);
+    LogArgs::PutString(m_record, key.file);
+    LogArgs::PutVarint(m_record, key.line);
+    LogArgs::PutVarint(m_record, level);
+    LogArgs::PutVarint(m_record, fmt ? 1 : 0);
+    LogArgs::PutString(m_record, fmt ? fmt : "");
+    LogArgs::PutString(m_record, key.types ? key.types : "");
+    return id;
+}
+
+uint64_t BinaryLogAppender::getContext(const std::shared_ptr<Logger>& logger, const LogEvent::ptr& event) {
+    ContextKey key{event->getThreadId(), logger.get()};
+    auto it = m_contexts.find(key);
+    //a renamed thread, or another logger at the address of a freed one
+    if(it != m_contexts.end() && it->second.thread_name == event->getThreadName()
+            && it->second.logger_name == logger->getName()) {
+        return it->second.id;
+    }
+    Context& ctx = m_contexts[key];
+    ctx.id = m_contextCount++;
+    ctx.thread_name = event->getThreadName();
+    ctx.logger_name = logger->getName();
+    m_record.push_back(CONTEXT);
+    LogArgs::PutVarint(m_record, ctx.id);
+    LogArgs::PutVarint(m_record, key.thread_id);
+    LogArgs::PutString(m_record, ctx.thread_name);
+    LogArgs::PutString(m_record, ctx.logger_name);
+    return ctx.id;
+}
+
+bool BinaryLogAppender::encodeArgs(const LogEvent::ptr& event) {
+    m_payload.clear();
+    const std::string& args = event->getArgs();
+    const char* p = args.data();
+    const char* end = p + args.size();
+    for(const char* t = event->getArgTypes(); *t; ++t) {
+        const char* begin = p;
+        uint64_t v = 0;
+        if(*t == LogArgs::DOUBLE) {
+            if(end - p < (ptrdiff_t)sizeof(double)) {
+                return false;
+            }
+            p += sizeof(double);
+        } else if(!LogArgs::GetVarint(p, end, v)) {
+            return false;
+        }
+        if(*t != LogArgs::STRING) {
+            m_payload.append(begin, p - begin);
+            continue;
+        }
+        if(v > (uint64_t)(end - p)) {
+            return false;
+        }
+        //strings are a length << 1, or an id << 1 | 1 of a STRING entry
+        std::string_view str(p, v);
+        p += v;
+        if(str.size() <= s_binlog_max_string_size) {
+            auto it = m_strings.find(str);
+            if(it != m_strings.end()) {
+                LogArgs::PutVarint(m_payload, it->second << 1 | 1);
+                continue;
+            }
+            if(m_strings.size() < s_binlog_max_strings) {
+                uint64_t id = m_strings.size();
+                m_stringData.emplace_back(str);
+                m_strings.emplace(m_stringData.back(), id);
+                m_record.push_back(STRING);
+                LogArgs::PutVarint(m_record, id);
+                LogArgs::PutString(m_record, str);
+                LogArgs::PutVarint(m_payload, id << 1 | 1);
+                continue;
+            }
+        }
+        LogArgs::PutVarint(m_payload, str.size() << 1);
+        m_payload.append(str.data(), str.size());
+    }
+    return p == end;
+}
+
+void BinaryLogAppender::encode(const std::shared_ptr<Logger>& logger, LogLevel::Level level, const LogEvent::ptr& event) {
+    m_record.clear();
+    uint64_t site = getSite(event, level);
+    uint64_t ctx = getContext(logger, event);
+    if(event->getFmt()) {
+        if(!encodeArgs(event)) {
+            m_payload.clear();
+        }
+    } else {
+        m_payload.assign(event->getContentData(), event->getContentSize());
+    }
+
+    int64_t delta = (int64_t)event->getTime() - m_lastTime;
+    m_lastTime = event->getTime();
+    m_record.push_back(RECORD);
+    LogArgs::PutVarint(m_record, site);
+    LogArgs::PutVarint(m_record, ctx);
+    LogArgs::PutVarint(m_record, ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63));
+    LogArgs::PutVarint(m_record, event->getFiberId());
+    LogArgs::PutVarint(m_record, event->getElapse());
+    LogArgs::PutString(m_record, m_payload);
+}
+
+void BinaryLogAppender::log(std::shared_ptr<Logger>logger, LogLevel::Level level, LogEvent::ptr event) {
+    if(level < m_level) {
+        return;
+    }
+    MutexType::Lock lock(m_mutex);
+    if(!m_data) {
+        return;
+    }
+    encode(logger, level, event);
+    if(m_offset + m_record.size() > m_maxSize) {
+        //the new file starts with empty dictionaries
+        if(!doRotate()) {
+            return;
+        }
+        encode(logger, level, event);
+        if(m_offset + m_record.size() > m_maxSize) {
+            //nothing of it was written
+            resetDictionaries();
+            return;
+        }
+    }
+    memcpy(m_data + m_offset, m_record.data(), m_record.size());
+    m_offset += m_record.size();
+}
+
+std::string BinaryLogAppender::toYamlString() {
+    MutexType::Lock lock(m_mutex);
+    YAML::Node node;
+    node["type"] = "BinaryLogAppender";
+    node["file"] = m_filename;
+    node["max_size"] = m_maxSize;
+    if(m_level != LogLevel::UNKNOW) {
+        node["level"] = LogLevel::ToString(m_level);
+    }
+    std::stringstream ss;
+    ss << node;
+    return ss.str();
+}
+
+BinaryLogReader::BinaryLogReader(const std::string& filename) {
+    if(!m_ba.mapFile(filename)) {
+        return;
+    }
+    if(m_ba.getReadableSize() < s_binlog_magic_size) {
+        return;
+    }
+    char magic[s_binlog_magic_size];
+    m_ba.read(magic, sizeof(magic));
+    m_valid = memcmp(magic, BinaryLogAppender::MAGIC, sizeof(magic)) == 0;
+}
+
+bool BinaryLogReader::decodeArgs(const Site& site, const std::string& payload, std::string& args) {
+    const char* p = payload.data();
+    const char* end = p + payload.size();
+    for(char t : site.types) {
+        const char* begin = p;
+        uint64_t v = 0;
+        if(t == LogArgs::DOUBLE) {
+            if(end - p < (ptrdiff_t)sizeof(double)) {
+                return false;
+            }
+            p += sizeof(double);
+        } else if(!LogArgs::GetVarint(p, end, v)) {
+            return false;
+        }
+        if(t != LogArgs::STRING) {
+            args.append(begin, p - begin);
+        } else if(v & 1) {
+            auto it = m_strings.find(v >> 1);
+            if(it == m_strings.end()) {
+                return false;
+            }
+            LogArgs::PutString(args, it->second);
+        } else {
+            v >>= 1;
+            if(v > (uint64_t)(end - p)) {
+                return false;
+            }
+            LogArgs::PutString(args, std::string_view(p, v));
+            p += v;
+        }
+    }
+    return p == end;
+}
+
+bool BinaryLogReader::next(std::shared_ptr<Logger>& logger, LogEvent::ptr& event) {
+    if(!m_valid) {
+        return false;
+    }
+    try {
+        while(m_ba.getReadableSize() > 0) {
+            uint8_t type = m_ba.readFuint8();
+            if(type == BinaryLogAppender::SITE) {
+                uint64_t id = m_ba.readUint64();
+                Site& site = m_sites[id];
+                site.file = m_ba.readStringVint();
+                site.line = m_ba.readUint64();
+                site.level = (LogLevel::Level)m_ba.readUint64();
+                site.has_fmt = m_ba.readUint64();
+                site.fmt = m_ba.readStringVint();
+                site.types = m_ba.readStringVint();
+            } else if(type == BinaryLogAppender::CONTEXT) {
+                uint64_t id = m_ba.readUint64();
+                Context& ctx = m_contexts[id];
+                ctx.thread_id = m_ba.readUint64();
+                ctx.thread_name = m_ba.readStringVint();
+                std::string name = m_ba.readStringVint();
+                auto& lg = m_loggers[name];
+                if(!lg) {
+                    lg = std::make_shared<Logger>(name);
+                }
+                ctx.logger = lg;
+            } else if(type == BinaryLogAppender::STRING) {
+                uint64_t id = m_ba.readUint64();
+                m_strings[id] = m_ba.readStringVint();
+            } else if(type == BinaryLogAppender::RECORD) {
+                auto sit = m_sites.find(m_ba.readUint64());
+                auto cit = m_contexts.find(m_ba.readUint64());
+                if(sit == m_sites.end() || cit == m_contexts.end()) {
+                    break;
+                }
+                Site& site = sit->second;
+                Context& ctx = cit->second;
+                m_lastTime += m_ba.readInt64();
+                uint32_t fiber_id = m_ba.readUint64();
+                uint32_t elapse = m_ba.readUint64();
+                std::string payload = m_ba.readStringVint();
+
+                logger = ctx.logger;
+                event = std::make_shared<LogEvent>(logger, site.level, site.file.c_str(), site.line
+                            ,elapse, ctx.thread_id, fiber_id, m_lastTime, ctx.thread_name);
+                if(site.has_fmt) {
+                    std::string args;
+                    if(!decodeArgs(site, payload, args)) {
+                        //renders as <<bad_args>>
+                        args.clear();
+                    }
+                    event->setRawArgs(site.fmt.c_str(), site.types.c_str(), args.data(), args.size());
+                } else {
+                    event->getSS().write(payload.data(), payload.size());
+                }
+                return true;
+            } else {
+                //END, or a record cut by a crash
+                break;
+            }
+        }
+    } catch(std::exception& e) {
+    }
+    m_valid = false;
+    return false;
+}
+
 LogFormatter::LogFormatter(const std::string& pattern)
     :m_pattern(pattern){
     init();
@@ -411,6 +1523,152 @@ std::ostream& LogFormatter::format(std::ostream& ofs, std::shared_ptr<Logger> lo
     return ofs;
 }
 
+template<class T>
+static void AppendInt(std::string& out, T v) {
+    char buf[24];
+    auto rt = std::to_chars(buf, buf + sizeof(buf), v);
+    out.append(buf, rt.ptr - buf);
+}
+
+bool LogArgs::GetVarint(const char*& p, const char* end, uint64_t& v) {
+    v = 0;
+    for(int i = 0; i < 64 && p < end; i += 7) {
+        uint8_t b = *p++;
+        v |= (uint64_t)(b & 0x7f) << i;
+        if(b < 0x80) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool AppendArg(std::string& out, char type, const char*& p, const char* end) {
+    uint64_t v = 0;
+    switch(type) {
+        case LogArgs::INT:
+            if(!LogArgs::GetVarint(p, end, v)) {
+                return false;
+            }
+            AppendInt(out, (int64_t)((v >> 1) ^ -(v & 1)));
+            return true;
+        case LogArgs::UINT:
+            if(!LogArgs::GetVarint(p, end, v)) {
+                return false;
+            }
+            AppendInt(out, v);
+            return true;
+        case LogArgs::DOUBLE: {
+            double d;
+            if(end - p < (ptrdiff_t)sizeof(d)) {
+                return false;
+            }
+            memcpy(&d, p, sizeof(d));
+            p += sizeof(d);
+            //same as the default ostream output
+            char buf[32];
+            int n = snprintf(buf, sizeof(buf), "%g", d);
+            out.append(buf, n);
+            return true;
+        }
+        case LogArgs::STRING:
+            if(!LogArgs::GetVarint(p, end, v) || v > (uint64_t)(end - p)) {
+                return false;
+            }
+            out.append(p, v);
+            p += v;
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool LogArgs::Render(std::string& out, const char* fmt, const char* types
+                    ,const char* data, size_t size) {
+    const char* p = data;
+    const char* end = data + size;
+    for(const char* f = fmt; *f; ++f) {
+        if(f[0] == '{' && f[1] == '}') {
+            ++f;
+            if(!*types) {
+                out.append("{}");
+            } else if(!AppendArg(out, *types++, p, end)) {
+                return false;
+            }
+        } else {
+            out.push_back(*f);
+        }
+    }
+    //more arguments than {}
+    while(*types) {
+        out.push_back(' ');
+        if(!AppendArg(out, *types++, p, end)) {
+            return false;
+        }
+    }
+    return p == end;
+}
+
+void LogFormatter::format(std::string& out, const std::shared_ptr<Logger>& logger, LogLevel::Level level, const LogEvent::ptr& event) {
+    //last formatted second of this thread, most processes use one time format
+    static thread_local time_t t_date_time = -1;
+    static thread_local std::string t_date_format;
+    static thread_local char t_date_buf[64];
+    static thread_local size_t t_date_len = 0;
+
+    for (auto& i : m_ops) {
+        switch (i.type) {
+            case Op::STRING:
+                out.append(i.str);
+                break;
+            case Op::MESSAGE:
+                out.append(event->getContentData(), event->getContentSize());
+                break;
+            case Op::LEVEL:
+                out.append(LogLevel::ToString(level));
+                break;
+            case Op::ELAPSE:
+                AppendInt(out, event->getElapse());
+                break;
+            case Op::LOGGER:
+                out.append(logger->getName());
+                break;
+            case Op::THREAD_ID:
+                AppendInt(out, event->getThreadId());
+                break;
+            case Op::NEWLINE:
+                out.push_back('\n');
+                break;
+            case Op::DATETIME: {
+                time_t time = event->getTime();
+                if (time != t_date_time || i.str != t_date_format) {
+                    struct tm tm;
+                    localtime_r(&time, &tm);
+                    t_date_len = strftime(t_date_buf, sizeof(t_date_buf), i.str.c_str(), &tm);
+                    t_date_time = time;
+                    t_date_format = i.str;
+                }
+                out.append(t_date_buf, t_date_len);
+                break;
+            }
+            case Op::FILENAME:
+                out.append(event->getFile());
+                break;
+            case Op::LINE:
+                AppendInt(out, event->getLine());
+                break;
+            case Op::TAB:
+                out.push_back('\t');
+                break;
+            case Op::FIBER_ID:
+                AppendInt(out, event->getFiberId());
+                break;
+            case Op::THREAD_NAME:
+                out.append(event->getThreadName());
+                break;
+        }
+    }
+}
+
 //%xxx %xxx(xxx) %%
 void LogFormatter::init(){
     //str, format, type
@@ -482,35 +1740,43 @@ void LogFormatter::init(){
     if (!nstr.empty()) {
         vec.push_back(std::make_tuple(nstr, "", 0));
     }
-    static std::map<std::string, std::function<FormatItem::ptr(const std::string & str)>> s_format_items = {
-    #define XX(str, C) \
-        {#str, [](const std::string& fmt) { return FormatItem::ptr(new C(fmt));}}
+    static std::map<std::string, std::pair<Op::Type, std::function<FormatItem::ptr(const std::string & str)> > > s_format_items = {
+    #define XX(str, C, T) \
+        {#str, {Op::T, [](const std::string& fmt) { return FormatItem::ptr(new C(fmt));}}}
         //%d{%Y-%m-%d %H:%M:%S}%T%t%T%N%T%F%T[%p]%T[%c]%T%f:%l%T%m%n
-        XX(m, MessageFormatItem),           //m: message
-        XX(p, LevelFormatItem),             //p: log level
-        XX(r, ElapseFormatItem),            //r: counter(ms)
-        XX(c, LoggerFormatItem),            //c: loger name
-        XX(t, ThreadIdFormatItem),          //t:thread id
-        XX(n, NewLineFormatItem),           //n:new line
-        XX(d, DateTimeFormatItem),          //d:date time
-        XX(f, FilenameFormatItem),          //f:file name
-        XX(l, LineFormatItem),              //l:line number
-        XX(T, TabFormatItem),               //T:Tab
-        XX(F, FiberIdFormatItem),           //F:coroutine id
-        XX(N, ThreadNameFormatItem),        //N:thread name
+        XX(m, MessageFormatItem, MESSAGE),          //m: message
+        XX(p, LevelFormatItem, LEVEL),              //p: log level
+        XX(r, ElapseFormatItem, ELAPSE),            //r: counter(ms)
+        XX(c, LoggerFormatItem, LOGGER),            //c: loger name
+        XX(t, ThreadIdFormatItem, THREAD_ID),       //t:thread id
+        XX(n, NewLineFormatItem, NEWLINE),          //n:new line
+        XX(d, DateTimeFormatItem, DATETIME),        //d:date time
+        XX(f, FilenameFormatItem, FILENAME),        //f:file name
+        XX(l, LineFormatItem, LINE),                //l:line number
+        XX(T, TabFormatItem, TAB),                  //T:Tab
+        XX(F, FiberIdFormatItem, FIBER_ID),         //F:coroutine id
+        XX(N, ThreadNameFormatItem, THREAD_NAME),   //N:thread name
     #undef XX
     };
 
     for (auto& i : vec) {
         if (std::get<2>(i) == 0) {
             m_items.push_back(FormatItem::ptr(new StringFormatItem(std::get<0>(i))));
+            m_ops.push_back(Op{Op::STRING, std::get<0>(i)});
         } else {
             auto it = s_format_items.find(std::get<0>(i));
             if (it == s_format_items.end()) {
-                m_items.push_back(FormatItem::ptr(new StringFormatItem("<<error_format %" + std::get<0>(i) + ">>")));
+                std::string err = "<<error_format %" + std::get<0>(i) + ">>";
+                m_items.push_back(FormatItem::ptr(new StringFormatItem(err)));
+                m_ops.push_back(Op{Op::STRING, err});
                 m_error = true;
             } else {
-                m_items.push_back(it->second(std::get<1>(i)));
+                m_items.push_back(it->second.second(std::get<1>(i)));
+                std::string arg;
+                if (it->second.first == Op::DATETIME) {
+                    arg = std::get<1>(i).empty() ? "%Y-%m-%d %H:%M:%S" : std::get<1>(i);
+                }
+                m_ops.push_back(Op{it->second.first, arg});
             }
         }
 
@@ -552,16 +1818,31 @@ Logger::ptr LoggerManager::getLogger(const std::string& name) {
 }
 
 struct LogAppenderDefine {
-    int type = 0; //1 File, 2 stdout
+    int type = 0; //1 File, 2 stdout, 3 async, 4 binary
     LogLevel::Level level = LogLevel::UNKNOW;
     std::string formatter;
     std::string file;
+    //async only
+    std::string overflow;
+    uint32_t buffer_size = 0;
+    //file and binary
+    uint64_t max_size = 0;
+    //file only
+    uint32_t rotate_interval = 0;
+    uint32_t max_files = 0;
+    bool compress = false;
 
     bool operator==(const LogAppenderDefine& oth) const {
         return type == oth.type
             && level == oth.level
             && formatter == oth.formatter
-            && file == oth.file;
+            && file == oth.file
+            && overflow == oth.overflow
+            && buffer_size == oth.buffer_size
+            && max_size == oth.max_size
+            && rotate_interval == oth.rotate_interval
+            && max_files == oth.max_files
+            && compress == oth.compress;
     }
 };
 
@@ -625,6 +1906,18 @@ public:
                         continue;
                     }
                     lad.file = a["file"].as<std::string>();
+                    if(a["max_size"].IsDefined()) {
+                        lad.max_size = a["max_size"].as<uint64_t>();
+                    }
+                    if(a["rotate_interval"].IsDefined()) {
+                        lad.rotate_interval = a["rotate_interval"].as<uint32_t>();
+                    }
+                    if(a["max_files"].IsDefined()) {
+                        lad.max_files = a["max_files"].as<uint32_t>();
+                    }
+                    if(a["compress"].IsDefined()) {
+                        lad.compress = a["compress"].as<bool>();
+                    }
                     if(a["formatter"].IsDefined()) {
                         lad.formatter = a["formatter"].as<std::string>();
                     }
@@ -633,6 +1926,31 @@ public:
                     if(a["formatter"].IsDefined()) {
                         lad.formatter = a["formatter"].as<std::string>();
                     }
+                } else if(type == "AsyncLogAppender") {
+                    lad.type = 3;
+                    if(a["file"].IsDefined()) {
+                        lad.file = a["file"].as<std::string>();
+                    }
+                    if(a["overflow"].IsDefined()) {
+                        lad.overflow = a["overflow"].as<std::string>();
+                    }
+                    if(a["buffer_size"].IsDefined()) {
+                        lad.buffer_size = a["buffer_size"].as<uint32_t>();
+                    }
+                    if(a["formatter"].IsDefined()) {
+                        lad.formatter = a["formatter"].as<std::string>();
+                    }
+                } else if(type == "BinaryLogAppender") {
+                    lad.type = 4;
+                    if(!a["file"].IsDefined()) {
+                        std::cout << "log config error: binary appender file is null, " << a
+                              << std::endl;
+                        continue;
+                    }
+                    lad.file = a["file"].as<std::string>();
+                    if(a["max_size"].IsDefined()) {
+                        lad.max_size = a["max_size"].as<uint64_t>();
+                    }
                 } else {
                     std::cout << "log config error: appender type is invalid, " << a
                               << std::endl;
@@ -664,8 +1982,37 @@ public:
             if(a.type == 1) {
                 na["type"] = "FileLogAppender";
                 na["file"] = a.file;
+                if(a.max_size) {
+                    na["max_size"] = a.max_size;
+                }
+                if(a.rotate_interval) {
+                    na["rotate_interval"] = a.rotate_interval;
+                }
+                if(a.max_files) {
+                    na["max_files"] = a.max_files;
+                }
+                if(a.compress) {
+                    na["compress"] = a.compress;
+                }
             } else if(a.type == 2) {
                 na["type"] = "StdoutLogAppender";
+            } else if(a.type == 3) {
+                na["type"] = "AsyncLogAppender";
+                if(!a.file.empty()) {
+                    na["file"] = a.file;
+                }
+                if(!a.overflow.empty()) {
+                    na["overflow"] = a.overflow;
+                }
+                if(a.buffer_size) {
+                    na["buffer_size"] = a.buffer_size;
+                }
+            } else if(a.type == 4) {
+                na["type"] = "BinaryLogAppender";
+                na["file"] = a.file;
+                if(a.max_size) {
+                    na["max_size"] = a.max_size;
+                }
             }
             if(a.level != LogLevel::UNKNOW) {
                 na["level"] = LogLevel::ToString(a.level);
@@ -715,13 +2062,21 @@ struct LogIniter {
                 for(auto& a : i.appenders) {
                     tao::LogAppender::ptr ap;
                     if(a.type == 1) {
-                        ap.reset(new FileLogAppender(a.file));
+                        ap.reset(new FileLogAppender(a.file, a.max_size, a.rotate_interval
+                                    ,a.max_files, a.compress));
                     } else if(a.type == 2) {
                         //if(!tao::EnvMgr::GetInstance()->has("d")) {
                             ap.reset(new StdoutLogAppender);
                         // } else {
                         //     continue;
                         // }
+                    } else if(a.type == 3) {
+                        ap.reset(new AsyncLogAppender(a.file
+                                    ,AsyncLogAppender::OverflowFromString(a.overflow)
+                                    ,a.buffer_size ? a.buffer_size : 1024 * 1024));
+                    } else if(a.type == 4) {
+                        ap.reset(a.max_size ? new BinaryLogAppender(a.file, a.max_size)
+                                    : new BinaryLogAppender(a.file));
                     }
                     ap->setLevel(a.level);
                     if(!a.formatter.empty()) {
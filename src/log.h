@@ -11,17 +11,32 @@
 #include <sstream>
 #include <vector>
 #include <map>
+#include <deque>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string_view>
+#include <type_traits>
 #include "util.h"
+#include "bytearray.h"
 #include "singleton.h"
 #include "mutex.h"
 #include "thread.h"
 
+/**
+ * statements below this level are compiled out, e.g. -DTAO_LOG_MIN_LEVEL=2 drops TAO_LOG_DEBUG
+ * the rest check the logger level(a relaxed atomic load) before any LogEvent is built
+ */
+#ifndef TAO_LOG_MIN_LEVEL
+#define TAO_LOG_MIN_LEVEL 1
+#endif
+
 //when exit if, LogEventWrap will deconstruct 
 #define TAO_LOG_LEVEL(logger, level) \
-    if(logger->getLevel() <= level) \
-        tao::LogEventWrap(tao::LogEvent::ptr(new tao::LogEvent(logger, level, \
+    if((level) >= TAO_LOG_MIN_LEVEL && (logger)->getLevel() <= (level)) \
+        tao::LogEventWrap(tao::LogEvent::Create(logger, level, \
                         __FILE__, __LINE__, 0, tao::GetThreadId(),\
-                tao::GetFiberId(), time(0), tao::Thread::GetName()))).getSS()
+                tao::GetFiberId(), time(0), tao::Thread::GetName())).getSS()
 
 #define TAO_LOG_DEBUG(logger) TAO_LOG_LEVEL(logger, tao::LogLevel::DEBUG)
 
@@ -33,6 +48,27 @@
 
 #define TAO_LOG_FATAL(logger) TAO_LOG_LEVEL(logger, tao::LogLevel::FATAL)
 
+/**
+ * records with a literal format string and raw arguments, each {} takes the next argument
+ * TAO_LOG_FMT_INFO(g_logger, "{} {} {} {}us", method, path, status, used);
+ * BinaryLogAppender stores the arguments as they are, text appenders render them
+ */
+#define TAO_LOG_FMT_LEVEL(logger, level, fmt, ...) \
+    if((level) >= TAO_LOG_MIN_LEVEL && (logger)->getLevel() <= (level)) \
+        tao::LogEventWrap(tao::LogEvent::Create(logger, level, \
+                        __FILE__, __LINE__, 0, tao::GetThreadId(),\
+                tao::GetFiberId(), time(0), tao::Thread::GetName())).getEvent()->setArgs(fmt, ##__VA_ARGS__)
+
+#define TAO_LOG_FMT_DEBUG(logger, fmt, ...) TAO_LOG_FMT_LEVEL(logger, tao::LogLevel::DEBUG, fmt, ##__VA_ARGS__)
+
+#define TAO_LOG_FMT_INFO(logger, fmt, ...) TAO_LOG_FMT_LEVEL(logger, tao::LogLevel::INFO, fmt, ##__VA_ARGS__)
+
+#define TAO_LOG_FMT_WARN(logger, fmt, ...) TAO_LOG_FMT_LEVEL(logger, tao::LogLevel::WARN, fmt, ##__VA_ARGS__)
+
+#define TAO_LOG_FMT_ERROR(logger, fmt, ...) TAO_LOG_FMT_LEVEL(logger, tao::LogLevel::ERROR, fmt, ##__VA_ARGS__)
+
+#define TAO_LOG_FMT_FATAL(logger, fmt, ...) TAO_LOG_FMT_LEVEL(logger, tao::LogLevel::FATAL, fmt, ##__VA_ARGS__)
+
 #define TAO_LOG_ROOT() tao::LoggerMgr::GetInstance()->getRoot()
 
 #define TAO_LOG_NAME(name) tao::LoggerMgr::GetInstance()->getLogger(name)
@@ -56,6 +92,105 @@ public:
     static LogLevel::Level FromString(const std::string& str);
 };
 
+/**
+ * @brief raw arguments of TAO_LOG_FMT_* records
+ * the argument types of a call site are a static string of Type, the values follow
+ * each other untagged: INT zigzag varint, UINT varint, DOUBLE 8 byte little endian,
+ * STRING varint length and bytes. the varints are the ByteArray writeInt64/writeUint64 encoding
+ */
+class LogArgs {
+public:
+    enum Type {
+        INT = 'i',
+        UINT = 'u',
+        DOUBLE = 'd',
+        STRING = 's'
+    };
+
+    template<class T>
+    static constexpr char TypeOf() {
+        if constexpr(std::is_same<T, bool>::value) {
+            return UINT;
+        } else if constexpr(std::is_same<T, char>::value) {
+            return STRING;
+        } else if constexpr(std::is_enum<T>::value) {
+            return TypeOf<typename std::underlying_type<T>::type>();
+        } else if constexpr(std::is_integral<T>::value && std::is_signed<T>::value) {
+            return INT;
+        } else if constexpr(std::is_integral<T>::value) {
+            return UINT;
+        } else if constexpr(std::is_floating_point<T>::value) {
+            return DOUBLE;
+        } else {
+            return STRING;
+        }
+    }
+
+    template<class T>
+    static void Encode(std::string& out, const T& v) {
+        if constexpr(std::is_same<T, bool>::value) {
+            PutVarint(out, v);
+        } else if constexpr(std::is_same<T, char>::value) {
+            PutVarint(out, 1);
+            out.push_back(v);
+        } else if constexpr(std::is_enum<T>::value) {
+            Encode(out, (typename std::underlying_type<T>::type)v);
+        } else if constexpr(std::is_integral<T>::value && std::is_signed<T>::value) {
+            int64_t x = v;
+            PutVarint(out, ((uint64_t)x << 1) ^ (uint64_t)(x >> 63));
+        } else if constexpr(std::is_integral<T>::value) {
+            PutVarint(out, v);
+        } else if constexpr(std::is_floating_point<T>::value) {
+            double d = v;
+            out.append((const char*)&d, sizeof(d));
+        } else if constexpr(std::is_same<T, const char*>::value || std::is_same<T, char*>::value) {
+            PutString(out, v ? std::string_view(v) : std::string_view("(null)"));
+        } else if constexpr(std::is_convertible<const T&, std::string_view>::value) {
+            PutString(out, std::string_view(v));
+        } else {
+            std::ostringstream ss;
+            ss << v;
+            PutString(out, ss.str());
+        }
+    }
+
+    /**
+     * @brief append fmt with each {} replaced by the next argument
+     * @return false when data does not match types
+     */
+    static bool Render(std::string& out, const char* fmt, const char* types
+                    ,const char* data, size_t size);
+
+    static void PutVarint(std::string& out, uint64_t v) {
+        while(v >= 0x80) {
+            out.push_back((char)(v | 0x80));
+            v >>= 7;
+        }
+        out.push_back((char)v);
+    }
+
+    static void PutString(std::string& out, std::string_view v) {
+        PutVarint(out, v.size());
+        out.append(v.data(), v.size());
+    }
+
+    static bool GetVarint(const char*& p, const char* end, uint64_t& v);
+};
+
+//streambuf writing into a growable buffer, kept across records by a pooled LogEvent
+class LogStreamBuf : public std::streambuf {
+public:
+    const char* data() const { return pbase();}
+    size_t size() const { return pptr() - pbase();}
+    std::string str() const { return std::string(data(), size());}
+    //drop the content, buffers larger than max_keep are released
+    void reset(size_t max_keep);
+protected:
+    int_type overflow(int_type c) override;
+private:
+    std::string m_data;
+};
+
 class LogEvent{
 public:
     using ptr = std::shared_ptr<LogEvent>;
@@ -64,6 +199,15 @@ public:
             ,uint32_t thread_id, uint32_t fiber_id, uint64_t time
             ,const std::string& thread_name);
 
+    /**
+     * @brief reuses the calling thread's event when nobody else holds it
+     * so a record costs no shared_ptr, stream or buffer allocation
+     */
+    static LogEvent::ptr Create(const std::shared_ptr<Logger>& logger, LogLevel::Level level
+            ,const char* file, int32_t line, uint32_t elapse
+            ,uint32_t thread_id, uint32_t fiber_id, uint64_t time
+            ,const std::string& thread_name);
+
     const char* getFile() const { return m_file;}
 
     int32_t getLine() const { return m_line;}
@@ -71,18 +215,46 @@ public:
     uint32_t getThreadId() const { return m_threadId;}
     uint32_t getFiberId() const { return m_fiberId;}
     uint64_t getTime() const { return m_time;}
-    std::string getContent() const { return m_ss.str();}
-    std::stringstream& getSS() { return m_ss;}
+    std::string getContent() const { render(); return m_buf.str();}
+    //content without a copy
+    const char* getContentData() const { render(); return m_buf.data();}
+    size_t getContentSize() const { render(); return m_buf.size();}
+    std::ostream& getSS() { return m_ss;}
     LogLevel::Level getLevel() const { return m_level;}
-    std::string getThreadName() const { return m_threadName;}
-    std::shared_ptr<Logger> getLogger() const { return m_logger;}
+    const std::string& getThreadName() const { return m_threadName;}
+    const std::shared_ptr<Logger>& getLogger() const { return m_logger;}
 
     template<typename... Args>
     void format(const char* fmt, Args&&... args) {
         formatting(fmt, std::forward<Args>(args)...);
     }
 
+    /**
+     * @brief keep the arguments raw, the content is rendered on first use
+     * @param[in] fmt must outlive the event, a string literal for TAO_LOG_FMT_*
+     */
+    template<typename... Args>
+    void setArgs(const char* fmt, const Args&... args) {
+        static constexpr char s_types[] = {LogArgs::TypeOf<Args>()..., 0};
+        m_fmt = fmt;
+        m_types = s_types;
+        m_args.clear();
+        (LogArgs::Encode(m_args, args), ...);
+    }
+    //arguments already in LogArgs encoding, fmt and types must outlive the event
+    void setRawArgs(const char* fmt, const char* types, const char* data, size_t size) {
+        m_fmt = fmt;
+        m_types = types;
+        m_args.assign(data, size);
+    }
+    //nullptr for stream records
+    const char* getFmt() const { return m_fmt;}
+    const char* getArgTypes() const { return m_types;}
+    const std::string& getArgs() const { return m_args;}
+
 private:
+    void render() const;
+
     template<typename... Args>
     void formatting(const char* fmt, Args&&... args) {
         int size = snprintf(nullptr, 0, fmt, args...) + 1;//+1 for '\0'
@@ -91,7 +263,7 @@ private:
         }
         std::unique_ptr<char[]> buf(new char[size]);
         snprintf(buf.get(), size, fmt, args...);
-        m_ss << std::string(buf.get(), buf.get() + size - 1);
+        m_ss.write(buf.get(), size - 1);
     }
 private:
     const char* m_file = nullptr;       //filename
@@ -104,7 +276,13 @@ private:
     //Logger::ptr m_logger;               //logger
     std::shared_ptr<Logger> m_logger;
     LogLevel::Level m_level;            //log level
-    std::stringstream m_ss;             //log stream         
+    //log content, TAO_LOG_FMT_* records render into it on first use
+    mutable LogStreamBuf m_buf;
+    std::ostream m_ss{&m_buf};          //log stream
+    const char* m_fmt = nullptr;        //format of TAO_LOG_FMT_*
+    const char* m_types = nullptr;      //LogArgs::Type of each argument
+    std::string m_args;                 //raw arguments
+    mutable bool m_rendered = false;
 };
 
 class LogEventWrap {
@@ -113,7 +291,7 @@ public:
     ~LogEventWrap();
 
     LogEvent::ptr getEvent() const { return m_event; }
-    std::stringstream & getSS() {return m_event->getSS(); };
+    std::ostream& getSS() {return m_event->getSS(); };
 private:
     LogEvent::ptr m_event;
 };
@@ -124,6 +302,12 @@ public:
     LogFormatter(const std::string& pattern);
     std::string format(std::shared_ptr<Logger>logger, LogLevel::Level level, LogEvent::ptr event);
     std::ostream& format(std::ostream& ofs, std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event);
+    /**
+     * @brief append the record to out
+     * runs the pattern compiled to a flat op list, integers are written with to_chars
+     * and %d is formatted once per second per thread
+     */
+    void format(std::string& out, const std::shared_ptr<Logger>& logger, LogLevel::Level level, const LogEvent::ptr& event);
 public:
     class FormatItem {
     public:
@@ -135,9 +319,32 @@ public:
     void init();
     const std::string getPattern() const { return m_pattern; };
     bool isError() {return m_error; }
+private:
+    //pattern item of the string fast path
+    struct Op {
+        enum Type {
+            STRING,
+            MESSAGE,
+            LEVEL,
+            ELAPSE,
+            LOGGER,
+            THREAD_ID,
+            NEWLINE,
+            DATETIME,
+            FILENAME,
+            LINE,
+            TAB,
+            FIBER_ID,
+            THREAD_NAME
+        };
+        Type type;
+        //text of STRING, time format of DATETIME
+        std::string str;
+    };
 private:
     std::string m_pattern;
     std::vector<FormatItem::ptr> m_items;
+    std::vector<Op> m_ops;
     bool m_error = false;
 };
 
@@ -160,7 +367,7 @@ public:
 
     LogLevel::Level getLevel() const {return m_level; }
 protected:
-    LogLevel::Level m_level;
+    LogLevel::Level m_level = LogLevel::DEBUG;
     bool m_hasFormatter = false;
     LogFormatter::ptr m_formatter;
     MutexType m_mutex;
@@ -183,8 +390,8 @@ public:
     
     void addAppender(LogAppender::ptr appender);
     void delAppender(LogAppender::ptr appender);
-    LogLevel::Level getLevel() const {return m_level;};
-    void setLevel(LogLevel::Level level) {m_level = level;};
+    LogLevel::Level getLevel() const {return m_level.load(std::memory_order_relaxed);};
+    void setLevel(LogLevel::Level level) {m_level.store(level, std::memory_order_relaxed);};
 
     const std::string& getName() const {return m_name;};
 
@@ -200,7 +407,7 @@ public:
 
 private:
     std::string m_name;                         //log name
-    LogLevel::Level m_level;                    //log level   
+    std::atomic<LogLevel::Level> m_level;       //log level, read without the lock   
     MutexType m_mutex;
     std::list<LogAppender::ptr> m_appenders;    //appender list
     LogFormatter::ptr m_formatter;              //formatter
@@ -215,20 +422,285 @@ public:
     virtual std::string toYamlString() override;
 };
 
-//appender of log output to file
+/**
+ * @brief appender writing formatted records to a file
+ * the file is rotated by size and/or by time window. writers only append and raise a flag,
+ * a background thread shared by all file appenders renames the file to
+ * filename.YYYYmmdd-HHMMSS, swaps a new descriptor in, then gzips and prunes old segments.
+ * records written before the swap land in the renamed segment, no writer waits for it.
+ * the same thread reopens the file every 3s when it was moved away(external logrotate)
+ */
 class FileLogAppender : public LogAppender {
 public:
     using ptr = std::shared_ptr<FileLogAppender>;
-    FileLogAppender(const std::string& filename);
+    /**
+     * @param[in] max_size rotate once the file reaches this many bytes, 0 never
+     * @param[in] rotate_interval rotate at every multiple of this many seconds of local time,
+     *            3600 hourly, 86400 at midnight, 0 never
+     * @param[in] max_files rotated segments kept, older ones are removed, 0 keeps all
+     * @param[in] compress gzip rotated segments to segment.gz
+     */
+    FileLogAppender(const std::string& filename, uint64_t max_size = 0
+                    ,uint32_t rotate_interval = 0, uint32_t max_files = 0
+                    ,bool compress = false);
+    ~FileLogAppender();
     virtual void log(std::shared_ptr<Logger>logger, LogLevel::Level level, LogEvent::ptr event) override;
     virtual std::string toYamlString() override;
 
     bool reopen();
+    /**
+     * @brief ask the background thread to rotate the file, returns at once
+     */
+    void rotate();
+    //segments renamed so far
+    uint64_t getRotated() const { return m_rotated;}
+private:
+    friend class LogRotator;
+    //called by the rotator thread, returns the renamed segment or empty
+    std::string maintain(uint64_t now);
 private:
     std::string m_filename;
-    std::ofstream m_filestream;
-    //last open time
-    uint64_t m_lastTime = 0;
+    uint64_t m_maxSize;
+    uint32_t m_rotateInterval;
+    uint32_t m_maxFiles;
+    bool m_compress;
+    //guarded by m_mutex, only reopen closes a descriptor
+    int m_fd = -1;
+    uint64_t m_size = 0;
+    uint64_t m_nextRotate = 0;
+    bool m_rotateRequested = false;
+    //used by the rotator thread only
+    uint64_t m_lastCheck = 0;
+    std::string m_lastStamp;
+    uint32_t m_stampSeq = 0;
+    std::atomic<uint64_t> m_rotated{0};
+};
+
+/**
+ * @brief appender that formats on the calling thread and writes on a background thread
+ * each producer thread owns a lock-free single producer ring per appender,
+ * the writer thread drains all rings into one buffer and writes it with large write calls
+ */
+class AsyncLogAppender : public LogAppender {
+public:
+    using ptr = std::shared_ptr<AsyncLogAppender>;
+
+    //what a producer does when its ring is full
+    enum class Overflow {
+        //wait for the writer
+        BLOCK,
+        //drop the record
+        DROP,
+        //DEBUG and INFO are dropped once the ring is 3/4 full, others wait
+        DROP_DEBUG
+    };
+    static const char* OverflowToString(Overflow v);
+    //unknown strings are BLOCK
+    static Overflow OverflowFromString(const std::string& str);
+
+    /**
+     * @param[in] filename empty writes to stdout
+     * @param[in] buffer_size ring bytes per producer thread, rounded up to a power of 2
+     */
+    AsyncLogAppender(const std::string& filename, Overflow overflow = Overflow::BLOCK
+                    ,uint32_t buffer_size = 1024 * 1024);
+    //records already queued are written before return
+    ~AsyncLogAppender();
+
+    virtual void log(std::shared_ptr<Logger>logger, LogLevel::Level level, LogEvent::ptr event) override;
+    virtual std::string toYamlString() override;
+
+    /**
+     * @brief wait until every record queued before the call is written
+     */
+    void flush();
+
+    Overflow getOverflow() const { return m_overflow;}
+    uint64_t getDropped() const { return m_dropped;}
+    //records longer than a quarter of the ring, written cut with a "...(truncated)" tail
+    uint64_t getTruncated() const { return m_truncated;}
+    uint64_t getWritten() const { return m_written;}
+    //ring bytes held by all async appenders
+    static uint64_t GetRingBytes();
+private:
+    class Ring;
+    std::shared_ptr<Ring> getRing();
+    void run();
+    void write(std::string& batch);
+    void reopen();
+private:
+    std::string m_filename;
+    Overflow m_overflow;
+    uint32_t m_bufferSize;
+    uint64_t m_id;
+    //used by the writer thread only
+    int m_fd = -1;
+
+    Mutex m_ringMutex;
+    std::vector<std::shared_ptr<Ring> > m_rings;
+
+    std::mutex m_waitMutex;
+    std::condition_variable m_cond;
+    std::condition_variable m_flushCond;
+    uint64_t m_flushRequest = 0;
+    uint64_t m_flushDone = 0;
+    bool m_stop = false;
+
+    std::atomic<uint64_t> m_dropped{0};
+    std::atomic<uint64_t> m_truncated{0};
+    std::atomic<uint64_t> m_written{0};
+    Thread::ptr m_thread;
+};
+
+/**
+ * @brief appender writing compact binary records to a memory mapped file
+ * a record is a call site id, a context(thread and logger) id, varints and the raw
+ * TAO_LOG_FMT_* arguments instead of formatted text. call sites, contexts and short
+ * string arguments are written once per file and referenced by id afterwards.
+ * a full file is renamed to filename.1, filename.2 ... and read back with BinaryLogReader
+ * or the tao_log_decode tool
+ */
+class BinaryLogAppender : public LogAppender {
+public:
+    using ptr = std::shared_ptr<BinaryLogAppender>;
+    //magic at the start of every file
+    static const char* MAGIC;
+
+    //entry type bytes, 0 is the unused tail of the file
+    enum Entry {
+        END = 0,
+        SITE = 1,
+        CONTEXT = 2,
+        STRING = 3,
+        RECORD = 4
+    };
+
+    /**
+     * @param[in] filename file being written, an existing one is rotated first
+     * @param[in] max_size bytes per file
+     */
+    BinaryLogAppender(const std::string& filename, uint64_t max_size = 64 * 1024 * 1024);
+    ~BinaryLogAppender();
+
+    virtual void log(std::shared_ptr<Logger>logger, LogLevel::Level level, LogEvent::ptr event) override;
+    virtual std::string toYamlString() override;
+
+    //close the current file and start the next one
+    bool rotate();
+
+    const std::string& getFilename() const { return m_filename;}
+    uint64_t getMaxSize() const { return m_maxSize;}
+    //index of the last rotated file, 0 if none
+    uint32_t getIndex() const { return m_index;}
+private:
+    struct SiteKey {
+        const char* file;
+        int32_t line;
+        const char* fmt;
+        const char* types;
+        LogLevel::Level level;
+
+        bool operator==(const SiteKey& o) const {
+            return file == o.file && line == o.line && fmt == o.fmt
+                && types == o.types && level == o.level;
+        }
+    };
+    struct SiteKeyHash {
+        size_t operator()(const SiteKey& k) const {
+            return std::hash<const void*>()(k.file) ^ ((size_t)k.line * 2654435761u)
+                ^ std::hash<const void*>()(k.fmt) ^ k.level;
+        }
+    };
+    struct ContextKey {
+        uint32_t thread_id;
+        const Logger* logger;
+
+        bool operator==(const ContextKey& o) const {
+            return thread_id == o.thread_id && logger == o.logger;
+        }
+    };
+    struct ContextKeyHash {
+        size_t operator()(const ContextKey& k) const {
+            return std::hash<const void*>()(k.logger) ^ ((size_t)k.thread_id * 2654435761u);
+        }
+    };
+    struct Context {
+        uint64_t id;
+        std::string thread_name;
+        std::string logger_name;
+    };
+
+    bool open();
+    void close();
+    bool doRotate();
+    //state of an empty file
+    void resetDictionaries();
+    uint64_t getSite(const LogEvent::ptr& event, LogLevel::Level level);
+    uint64_t getContext(const std::shared_ptr<Logger>& logger, const LogEvent::ptr& event);
+    //re-encode the arguments into m_payload with strings replaced by ids
+    bool encodeArgs(const LogEvent::ptr& event);
+    //dictionary entries the record needs and the record itself into m_record
+    void encode(const std::shared_ptr<Logger>& logger, LogLevel::Level level, const LogEvent::ptr& event);
+private:
+    std::string m_filename;
+    uint64_t m_maxSize;
+    uint32_t m_index = 0;
+    int m_fd = -1;
+    char* m_data = nullptr;
+    uint64_t m_offset = 0;
+    //time of the previous record, times are stored as deltas
+    int64_t m_lastTime = 0;
+    //dictionaries of the current file
+    std::unordered_map<SiteKey, uint64_t, SiteKeyHash> m_sites;
+    std::unordered_map<ContextKey, Context, ContextKeyHash> m_contexts;
+    uint64_t m_contextCount = 0;
+    std::unordered_map<std::string_view, uint64_t> m_strings;
+    std::deque<std::string> m_stringData;
+    std::string m_record;
+    std::string m_payload;
+};
+
+/**
+ * @brief reads the files of BinaryLogAppender back as events
+ */
+class BinaryLogReader {
+public:
+    using ptr = std::shared_ptr<BinaryLogReader>;
+    BinaryLogReader(const std::string& filename);
+
+    //false if the file could not be read or is not a binary log
+    bool isValid() const { return m_valid;}
+
+    /**
+     * @brief decode the next record
+     * @return false at the end of the file, or at the first corrupted entry
+     */
+    bool next(std::shared_ptr<Logger>& logger, LogEvent::ptr& event);
+private:
+    struct Site {
+        std::string file;
+        int32_t line;
+        LogLevel::Level level;
+        bool has_fmt;
+        std::string fmt;
+        std::string types;
+    };
+    struct Context {
+        uint32_t thread_id;
+        std::string thread_name;
+        std::shared_ptr<Logger> logger;
+    };
+    //arguments of the file back to the LogEvent encoding
+    bool decodeArgs(const Site& site, const std::string& payload, std::string& args);
+private:
+    bool m_valid = false;
+    ByteArray m_ba;
+    int64_t m_lastTime = 0;
+    //node based, events point at the strings
+    std::unordered_map<uint64_t, Site> m_sites;
+    std::unordered_map<uint64_t, Context> m_contexts;
+    std::unordered_map<uint64_t, std::string> m_strings;
+    std::unordered_map<std::string, std::shared_ptr<Logger> > m_loggers;
 };
 
 class LoggerManager {
@@ -253,8 +725,8 @@ private:
 
 template<typename... Args>
 inline void tao_fmt_log_print(std::shared_ptr<Logger> logger, LogLevel::Level level, const char* fmt, Args... args) {
-    if (logger->getLevel() <= level) {
-        tao::LogEventWrap(std::make_shared<tao::LogEvent>(logger, level, 
+    if (level >= TAO_LOG_MIN_LEVEL && logger->getLevel() <= level) {
+        tao::LogEventWrap(tao::LogEvent::Create(logger, level, 
                         __FILE__, __LINE__, 0, GetThreadId(), GetFiberId(), 
                         time(0), tao::Thread::GetName())).getEvent()->format(fmt, std::forward<Args>(args)...);
     }
@@ -0,0 +1,45 @@
+#include "src/log.h"
+#include <stdio.h>
+#include <string.h>
+
+//renders BinaryLogAppender files as text
+//tao_log_decode [-p pattern] file...
+int main(int argc, char** argv) {
+    std::string pattern = "%d%T%t%T%N%T%F%T[%p]%T[%c]%T%f:%l%T%m%n";
+    std::vector<std::string> files;
+    for(int i = 1; i < argc; ++i) {
+        if(strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            pattern = argv[++i];
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+    if(files.empty()) {
+        fprintf(stderr, "usage: %s [-p pattern] file...\n", argv[0]);
+        return 1;
+    }
+    tao::LogFormatter formatter(pattern);
+    if(formatter.isError()) {
+        fprintf(stderr, "invalid pattern: %s\n", pattern.c_str());
+        return 1;
+    }
+
+    int rt = 0;
+    std::string out;
+    for(auto& file : files) {
+        tao::BinaryLogReader reader(file);
+        if(!reader.isValid()) {
+            fprintf(stderr, "%s is not a binary log\n", file.c_str());
+            rt = 1;
+            continue;
+        }
+        tao::Logger::ptr logger;
+        tao::LogEvent::ptr event;
+        while(reader.next(logger, event)) {
+            out.clear();
+            formatter.format(out, logger, event->getLevel(), event);
+            fwrite(out.c_str(), 1, out.size(), stdout);
+        }
+    }
+    return rt;
+}
@@ -88,6 +88,32 @@ void Module::registerService(const std::string &server_type, const std::string &
     //auto sd = Application::GetInstance()->
 }
 
+RockModule::RockModule(const std::string& name
+                       ,const std::string& version
+                       ,const std::string& filename)
+    :Module(name, version, filename, ROCK) {
+}
+
+bool RockModule::handleRequest(tao::Message::ptr req, tao::Message::ptr rsp, tao::Stream::ptr stream)
+{
+    auto rock_req = std::dynamic_pointer_cast<tao::RockRequest>(req);
+    auto rock_rsp = std::dynamic_pointer_cast<tao::RockResponse>(rsp);
+    auto rock_session = std::dynamic_pointer_cast<tao::RockSession>(stream);
+    if(!rock_req || !rock_rsp || !rock_session) {
+        return false;
+    }
+    return handleRockRequest(rock_req, rock_rsp, rock_session);
+}
+
+bool RockModule::handleNotify(tao::Message::ptr notify, tao::Stream::ptr stream)
+{
+    auto rock_nty = std::dynamic_pointer_cast<tao::RockNotify>(notify);
+    auto rock_session = std::dynamic_pointer_cast<tao::RockSession>(stream);
+    if(!rock_nty || !rock_session) {
+        return false;
+    }
+    return handleRockNotify(rock_nty, rock_session);
+}
 
 ModuleManager::ModuleManager() {
 }
@@ -5,6 +5,7 @@
 #include "src/singleton.h"
 #include "src/mutex.h"
 #include "src/protocol.h"
+#include "src/rock/rock_session.h"
 #include <map>
 #include <unordered_map>
 
@@ -63,6 +64,32 @@ protected:
     uint32_t m_type;
 };
 
+/**
+ * @brief module serving rock requests, handleRequest and handleNotify get rock messages
+ */
+class RockModule : public Module {
+public:
+    using ptr = std::shared_ptr<RockModule>;
+    RockModule(const std::string& name
+               ,const std::string& version
+               ,const std::string& filename);
+
+    /**
+     * @return true if req was handled, rsp is sent back either way
+     */
+    virtual bool handleRockRequest(tao::RockRequest::ptr req
+                                   ,tao::RockResponse::ptr rsp
+                                   ,tao::RockSession::ptr session) = 0;
+    virtual bool handleRockNotify(tao::RockNotify::ptr notify
+                                  ,tao::RockSession::ptr session) = 0;
+
+    virtual bool handleRequest(tao::Message::ptr req
+                               ,tao::Message::ptr rsp
+                               ,tao::Stream::ptr stream) override;
+    virtual bool handleNotify(tao::Message::ptr notify
+                              ,tao::Stream::ptr stream) override;
+};
+
 class ModuleManager {
 public:
     typedef RWMutex RWMutexType;
@@ -2,11 +2,21 @@
 
 namespace tao {
 
+//bytes a reused array keeps between messages
+static const size_t s_message_keep_size = 64 * 1024;
+
 ByteArray::ptr Message::toByteArray()
 {
-    ByteArray::ptr ba = std::make_shared<ByteArray>();
-    if (serializeToByteArray(ba)) {
-        return ba;
+    //the array of this thread is reused once the previous caller released it
+    static thread_local ByteArray::ptr t_ba;
+    if (!t_ba || t_ba.use_count() > 1) {
+        t_ba = std::make_shared<ByteArray>();
+    } else {
+        t_ba->reset(s_message_keep_size);
+        t_ba->setIsLittleEndian(false);
+    }
+    if (serializeToByteArray(t_ba)) {
+        return t_ba;
     }
     return nullptr;
 }
@@ -17,19 +27,6 @@ Request::Request()
     setType(MessageType::REQUEST);
 }
 
-bool Request::serializeToByteArray(ByteArray::ptr bytearray) {
-    bytearray->writeFuint8(getType());
-    bytearray->writeUint32(m_sn);
-    bytearray->writeUint32(m_cmd);
-    return true;
-}
-
-bool Request::parseFromByteArray(ByteArray::ptr bytearray) {
-    m_sn = bytearray->readUint32();
-    m_cmd = bytearray->readUint32();
-    return true;
-}
-
 Response::Response()
     :m_sn(0)
     ,m_cmd(0)
@@ -38,37 +35,9 @@ Response::Response()
     setType(MessageType::RESPONSE);
 }
 
-bool Response::serializeToByteArray(ByteArray::ptr bytearray) {
-    bytearray->writeFuint8(getType());
-    bytearray->writeUint32(m_sn);
-    bytearray->writeUint32(m_cmd);
-    bytearray->writeUint32(m_result);
-    bytearray->writeStringVint(m_resultStr);
-    return true;
-}
-
-bool Response::parseFromByteArray(ByteArray::ptr bytearray) {
-    m_sn = bytearray->readUint32();
-    m_cmd = bytearray->readUint32();
-    m_result = bytearray->readUint32();
-    m_resultStr = bytearray->readStringVint();
-    return true;
-}
-
 Notify::Notify()
     :m_notify(0) {
     setType(MessageType::NOTIFY);
 }
 
-bool Notify::serializeToByteArray(ByteArray::ptr bytearray) {
-    bytearray->writeFuint8(getType());
-    bytearray->writeUint32(m_notify);
-    return true;
-}
-
-bool Notify::parseFromByteArray(ByteArray::ptr bytearray) {
-    m_notify = bytearray->readUint32();
-    return true;
-}
-
 }
\ No newline at end of file
@@ -4,6 +4,27 @@
 #include <functional>
 #include <memory>
 #include "bytearray.h"
+#include "serialize.h"
+
+/**
+ * @brief fields of a Message subclass, generates serializeToByteArray(type byte and the fields),
+ * parseFromByteArray(the fields, the decoder reads the type) and getSerializedSize.
+ * a subclass lists the fields of its base too, it replaces their serialization
+ */
+#define TAO_MESSAGE_FIELDS(...) \
+    TAO_SERIALIZE_FIELDS(__VA_ARGS__) \
+    virtual bool serializeToByteArray(tao::ByteArray::ptr bytearray) override { \
+        bytearray->writeFuint8(getType()); \
+        tao::Serialize(*bytearray, *this); \
+        return true; \
+    } \
+    virtual bool parseFromByteArray(tao::ByteArray::ptr bytearray) override { \
+        tao::Deserialize(*bytearray, *this); \
+        return true; \
+    } \
+    virtual size_t getSerializedSize() const override { \
+        return 1 + tao::SerializedSize(*this); \
+    }
 
 namespace tao {
 
@@ -18,9 +39,12 @@ public:
     };
     virtual ~Message() {}
 
+    //the array is reused by a later call on the same thread once the caller releases it
     virtual ByteArray::ptr toByteArray();
     virtual bool serializeToByteArray(ByteArray::ptr bytearray) = 0;
     virtual bool parseFromByteArray(ByteArray::ptr bytearray) = 0;
+    //bytes serializeToByteArray writes, 0 when not known upfront
+    virtual size_t getSerializedSize() const { return 0;}
 
     virtual std::string toString() const = 0;
     //virtual const std::string& getName() const = 0;
@@ -43,8 +67,7 @@ public:
     void setSn(uint32_t v) { m_sn = v;}
     void setCmd(uint32_t v) { m_cmd = v;}
 
-    virtual bool serializeToByteArray(ByteArray::ptr bytearray) override;
-    virtual bool parseFromByteArray(ByteArray::ptr bytearray) override;
+    TAO_MESSAGE_FIELDS(m_sn, m_cmd)
 protected:
     uint32_t m_sn;
     uint32_t m_cmd;
@@ -67,8 +90,7 @@ public:
     void setResult(uint32_t v) { m_result = v;}
     void setResultStr(const std::string& v) { m_resultStr = v;}
 
-    virtual bool serializeToByteArray(ByteArray::ptr bytearray) override;
-    virtual bool parseFromByteArray(ByteArray::ptr bytearray) override;
+    TAO_MESSAGE_FIELDS(m_sn, m_cmd, m_result, m_resultStr)
 protected:
     uint32_t m_sn;
     uint32_t m_cmd;
@@ -85,8 +107,7 @@ public:
     uint32_t getNotify() const { return m_notify;}
     void setNotify(uint32_t v) { m_notify = v;}
 
-    virtual bool serializeToByteArray(ByteArray::ptr bytearray) override;
-    virtual bool parseFromByteArray(ByteArray::ptr bytearray) override;
+    TAO_MESSAGE_FIELDS(m_notify)
 protected:
     uint32_t m_notify;
 };
@@ -0,0 +1,139 @@
+#include "rock_connection.h"
+#include "src/log.h"
+
+namespace tao {
+
+static tao::Logger::ptr g_logger = TAO_LOG_NAME("system");
+
+RockConnection::RockConnection(Socket::ptr sock)
+    :RockSession(sock, true) {
+}
+
+RockConnection::ptr RockConnection::Connect(const std::string& host, uint64_t timeout_ms) {
+    Address::ptr addr = Address::LookupAnyIPAddress(host);
+    if(!addr) {
+        TAO_LOG_ERROR(g_logger) << "invalid host: " << host;
+        return nullptr;
+    }
+    return Connect(addr, timeout_ms);
+}
+
+RockConnection::ptr RockConnection::Connect(Address::ptr addr, uint64_t timeout_ms) {
+    Socket::ptr sock = Socket::CreateTCP(addr);
+    if(!sock) {
+        TAO_LOG_ERROR(g_logger) << "create socket fail: " << addr->toString()
+            << " errno=" << errno << " errstr=" << strerror(errno);
+        return nullptr;
+    }
+    if(!sock->connect(addr, timeout_ms)) {
+        TAO_LOG_ERROR(g_logger) << "connect fail: " << addr->toString();
+        return nullptr;
+    }
+    //no recv timeout, the reader fiber waits for responses of all requests
+    RockConnection::ptr conn = std::make_shared<RockConnection>(sock);
+    if(!conn->start()) {
+        return nullptr;
+    }
+    return conn;
+}
+
+RockConnectionPool::RockConnectionPool(const std::string& host, uint32_t size, uint64_t connect_timeout_ms)
+    :m_host(host)
+    ,m_connectTimeout(connect_timeout_ms)
+    ,m_conns(std::max(size, 1u))
+    ,m_connecting(m_conns.size(), false) {
+}
+
+RockConnection::ptr RockConnectionPool::getConnection() {
+    RockConnection::ptr best;
+    Address::ptr addr;
+    int slot = -1;
+    while(true) {
+        best = nullptr;
+        slot = -1;
+        {
+            MutexType::Lock lock(m_mutex);
+            for(size_t i = 0; i < m_conns.size(); ++i) {
+                auto& conn = m_conns[i];
+                if(!conn || conn->isClosed()) {
+                    if(slot < 0 && !m_connecting[i]) {
+                        slot = i;
+                    }
+                    continue;
+                }
+                if(!best || conn->getPendingCount() < best->getPendingCount()) {
+                    best = conn;
+                }
+            }
+            //an idle connection beats a new one
+            if(best && (slot < 0 || best->getPendingCount() == 0)) {
+                return best;
+            }
+            if(slot >= 0) {
+                m_connecting[slot] = true;
+                addr = m_addr;
+                break;
+            }
+            ++m_waiting;
+        }
+        //every slot is being connected by other fibers, sleep until one ends
+        m_connected.wait();
+    }
+    if(!addr) {
+        addr = Address::LookupAnyIPAddress(m_host);
+        if(!addr) {
+            TAO_LOG_ERROR(g_logger) << "invalid host: " << m_host;
+        }
+    }
+    RockConnection::ptr conn = addr ? RockConnection::Connect(addr, m_connectTimeout) : nullptr;
+    uint32_t waiting = 0;
+    {
+        MutexType::Lock lock(m_mutex);
+        m_connecting[slot] = false;
+        //resolve again next time, the host may have moved
+        m_addr = conn ? addr : nullptr;
+        if(conn) {
+            m_conns[slot] = conn;
+        }
+        std::swap(waiting, m_waiting);
+    }
+    for(uint32_t i = 0; i < waiting; ++i) {
+        m_connected.notify();
+    }
+    return conn ? conn : best;
+}
+
+RockResult::ptr RockConnectionPool::request(RockRequest::ptr req, uint64_t timeout_ms) {
+    RockConnection::ptr conn = getConnection();
+    if(!conn) {
+        return std::make_shared<RockResult>((int)RockResult::Error::CLOSED, 0, nullptr, req);
+    }
+    return conn->request(req, timeout_ms);
+}
+
+void RockConnectionPool::close() {
+    std::vector<RockConnection::ptr> conns;
+    {
+        MutexType::Lock lock(m_mutex);
+        conns.swap(m_conns);
+        m_conns.resize(conns.size());
+    }
+    for(auto& i : conns) {
+        if(i) {
+            i->close();
+        }
+    }
+}
+
+uint32_t RockConnectionPool::getPendingCount() {
+    uint32_t rt = 0;
+    MutexType::Lock lock(m_mutex);
+    for(auto& i : m_conns) {
+        if(i) {
+            rt += i->getPendingCount();
+        }
+    }
+    return rt;
+}
+
+}
@@ -0,0 +1,75 @@
+#ifndef __TAO_ROCK_CONNECTION_H__
+#define __TAO_ROCK_CONNECTION_H__
+
+#include "rock_session.h"
+#include "src/address.h"
+
+namespace tao {
+
+/**
+ * @brief rock client connection
+ * requests from many fibers are multiplexed on one socket
+ */
+class RockConnection : public RockSession {
+public:
+    using ptr = std::shared_ptr<RockConnection>;
+
+    RockConnection(Socket::ptr sock);
+
+    /**
+     * @brief connect and start reading, must be called in an IOManager
+     * @return nullptr on fail
+     */
+    static RockConnection::ptr Connect(Address::ptr addr, uint64_t timeout_ms);
+    //host:port
+    static RockConnection::ptr Connect(const std::string& host, uint64_t timeout_ms);
+};
+
+/**
+ * @brief fixed number of connections to one host
+ * each request goes to the connection with the fewest requests in flight,
+ * closed connections are reconnected when picked
+ */
+class RockConnectionPool {
+public:
+    using ptr = std::shared_ptr<RockConnectionPool>;
+    using MutexType = Mutex;
+
+    /**
+     * @param[in] host host:port
+     * @param[in] size connections kept
+     * @param[in] connect_timeout_ms timeout of each connect
+     */
+    RockConnectionPool(const std::string& host, uint32_t size, uint64_t connect_timeout_ms);
+
+    /**
+     * @brief least loaded open connection, parks on slots other fibers are connecting
+     * @return nullptr if none can be connected
+     */
+    RockConnection::ptr getConnection();
+
+    RockResult::ptr request(RockRequest::ptr req, uint64_t timeout_ms);
+
+    //closes all connections, the next request reconnects
+    void close();
+
+    //requests in flight on all connections
+    uint32_t getPendingCount();
+    const std::string& getHost() const { return m_host;}
+private:
+    std::string m_host;
+    uint64_t m_connectTimeout;
+    MutexType m_mutex;
+    std::vector<RockConnection::ptr> m_conns;
+    //slots being connected by some fiber
+    std::vector<bool> m_connecting;
+    //resolved m_host, cleared when a connect fails
+    Address::ptr m_addr;
+    //fibers parked until a connect ends
+    uint32_t m_waiting = 0;
+    FiberSemaphore m_connected;
+};
+
+}
+
+#endif
@@ -0,0 +1,155 @@
+#include "rock_protocol.h"
+#include "src/config.h"
+#include "src/log.h"
+#include <arpa/inet.h>
+#include <string.h>
+
+namespace tao {
+
+static tao::Logger::ptr g_logger = TAO_LOG_NAME("system");
+
+static tao::ConfigVar<uint32_t>::ptr g_rock_protocol_max_length
+    = tao::Config::Lookup("rock.protocol.max_length"
+            ,(uint32_t)(1024 * 1024 * 64), "rock protocol max message length");
+
+static const uint8_t s_rock_magic[2] = {0xab, 0xcd};
+static const uint8_t s_rock_version = 0x1;
+
+std::shared_ptr<RockResponse> RockRequest::createResponse() {
+    RockResponse::ptr rt = std::make_shared<RockResponse>();
+    rt->setSn(m_sn);
+    rt->setCmd(m_cmd);
+    return rt;
+}
+
+std::string RockRequest::toString() const {
+    std::stringstream ss;
+    ss << "[RockRequest sn=" << m_sn
+       << " cmd=" << m_cmd
+       << " body.length=" << m_body.size()
+       << "]";
+    return ss.str();
+}
+
+std::string RockResponse::toString() const {
+    std::stringstream ss;
+    ss << "[RockResponse sn=" << m_sn
+       << " cmd=" << m_cmd
+       << " result=" << m_result
+       << " result_msg=" << m_resultStr
+       << " body.length=" << m_body.size()
+       << "]";
+    return ss.str();
+}
+
+std::string RockNotify::toString() const {
+    std::stringstream ss;
+    ss << "[RockNotify notify=" << m_notify
+       << " body.length=" << m_body.size()
+       << "]";
+    return ss.str();
+}
+
+RockMsgHeader::RockMsgHeader()
+    :version(s_rock_version)
+    ,flag(0)
+    ,length(0) {
+    magic[0] = s_rock_magic[0];
+    magic[1] = s_rock_magic[1];
+}
+
+Message::ptr RockMessageDecoder::ParseFrom(Stream::ptr stream) {
+    return ParseFrom(stream.get());
+}
+
+Message::ptr RockMessageDecoder::ParseFrom(Stream* stream) {
+    RockMsgHeader header;
+    if(stream->readFixSize(&header, sizeof(header)) <= 0) {
+        TAO_LOG_DEBUG(g_logger) << "RockMessageDecoder recv header fail";
+        return nullptr;
+    }
+    if(memcmp(header.magic, s_rock_magic, sizeof(s_rock_magic))) {
+        TAO_LOG_ERROR(g_logger) << "RockMessageDecoder invalid magic "
+            << (int)header.magic[0] << "," << (int)header.magic[1];
+        return nullptr;
+    }
+    if(header.version != s_rock_version) {
+        TAO_LOG_ERROR(g_logger) << "RockMessageDecoder unsupported version "
+            << (int)header.version;
+        return nullptr;
+    }
+    uint32_t length = ntohl(header.length);
+    if(length == 0 || length > g_rock_protocol_max_length->getValue()) {
+        TAO_LOG_ERROR(g_logger) << "RockMessageDecoder invalid length " << length;
+        return nullptr;
+    }
+    //the frame in one node, fields are read in place
+    ByteArray::ptr ba = std::make_shared<ByteArray>(SingleNodeBaseSize(length));
+    if(stream->readFixSize(ba, length) <= 0) {
+        TAO_LOG_DEBUG(g_logger) << "RockMessageDecoder recv body fail length=" << length;
+        return nullptr;
+    }
+    ba->setPosition(0);
+
+    Message::ptr msg;
+    try {
+        uint8_t type = ba->readFuint8();
+        switch(type) {
+            case Message::REQUEST:
+                msg = std::make_shared<RockRequest>();
+                break;
+            case Message::RESPONSE:
+                msg = std::make_shared<RockResponse>();
+                break;
+            case Message::NOTIFY:
+                msg = std::make_shared<RockNotify>();
+                break;
+            default:
+                TAO_LOG_ERROR(g_logger) << "RockMessageDecoder invalid type " << (int)type;
+                return nullptr;
+        }
+        if(!msg->parseFromByteArray(ba)) {
+            TAO_LOG_ERROR(g_logger) << "RockMessageDecoder parse fail type=" << (int)type;
+            return nullptr;
+        }
+    } catch(std::exception& e) {
+        //a field runs past the frame
+        TAO_LOG_ERROR(g_logger) << "RockMessageDecoder parse error: " << e.what();
+        return nullptr;
+    }
+    return msg;
+}
+
+ByteArray::ptr RockMessageDecoder::Encode(Message::ptr msg, RockMsgHeader& header) {
+    //the array lives until a writer sends it, the thread_local one of toByteArray does not fit.
+    //sized upfront when the message knows its size
+    ByteArray::ptr ba = std::make_shared<ByteArray>(SingleNodeBaseSize(msg->getSerializedSize()));
+    ba->setIsLittleEndian(false);
+    if(!msg->serializeToByteArray(ba)) {
+        return nullptr;
+    }
+    ba->setPosition(0);
+    header.length = htonl(ba->getSize());
+    return ba;
+}
+
+int32_t RockMessageDecoder::SerializeTo(Stream::ptr stream, Message::ptr msg) {
+    return SerializeTo(stream.get(), msg);
+}
+
+int32_t RockMessageDecoder::SerializeTo(Stream* stream, Message::ptr msg) {
+    ByteArray::ptr ba = msg->toByteArray();
+    if(!ba) {
+        return -1;
+    }
+    RockMsgHeader header;
+    header.length = htonl(ba->getSize());
+    std::vector<iovec> iovs(1);
+    iovs[0].iov_base = &header;
+    iovs[0].iov_len = sizeof(header);
+    ba->setPosition(0);
+    ba->getReadableBuffers(iovs);
+    return stream->writevFixSize(&iovs[0], iovs.size());
+}
+
+}
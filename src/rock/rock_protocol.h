@@ -0,0 +1,95 @@
+#ifndef __TAO_ROCK_PROTOCOL_H__
+#define __TAO_ROCK_PROTOCOL_H__
+
+#include "src/protocol.h"
+#include "src/stream.h"
+
+namespace tao {
+
+/**
+ * @brief opaque payload shared by rock messages, written after the message fields
+ */
+class RockBody {
+public:
+    using ptr = std::shared_ptr<RockBody>;
+    virtual ~RockBody() {}
+
+    const std::string& getBody() const { return m_body;}
+    std::string& getBody() { return m_body;}
+    void setBody(const std::string& v) { m_body = v;}
+    void setBody(std::string&& v) { m_body = std::move(v);}
+protected:
+    std::string m_body;
+};
+
+class RockResponse;
+class RockRequest : public Request, public RockBody {
+public:
+    using ptr = std::shared_ptr<RockRequest>;
+
+    //response with the sn and cmd of this request
+    std::shared_ptr<RockResponse> createResponse();
+
+    virtual std::string toString() const override;
+
+    TAO_MESSAGE_FIELDS(m_sn, m_cmd, m_body)
+};
+
+class RockResponse : public Response, public RockBody {
+public:
+    using ptr = std::shared_ptr<RockResponse>;
+
+    virtual std::string toString() const override;
+
+    TAO_MESSAGE_FIELDS(m_sn, m_cmd, m_result, m_resultStr, m_body)
+};
+
+class RockNotify : public Notify, public RockBody {
+public:
+    using ptr = std::shared_ptr<RockNotify>;
+
+    virtual std::string toString() const override;
+
+    TAO_MESSAGE_FIELDS(m_notify, m_body)
+};
+
+#pragma pack(1)
+/**
+ * @brief frame header, length is the size of the serialized message in network order
+ */
+struct RockMsgHeader {
+    RockMsgHeader();
+    uint8_t magic[2];
+    uint8_t version;
+    uint8_t flag;
+    uint32_t length;
+};
+#pragma pack()
+
+/**
+ * @brief length prefixed frames of rock messages
+ */
+class RockMessageDecoder {
+public:
+    /**
+     * @brief read one frame
+     * @return nullptr on a closed stream or an invalid frame
+     */
+    static Message::ptr ParseFrom(Stream::ptr stream);
+    static Message::ptr ParseFrom(Stream* stream);
+    /**
+     * @brief serialize msg into a new array and fill the header of its frame
+     * @return nullptr on fail
+     */
+    static ByteArray::ptr Encode(Message::ptr msg, RockMsgHeader& header);
+    /**
+     * @brief write msg as one frame, header and message with a single writev
+     * @return bytes written, <= 0 on error
+     */
+    static int32_t SerializeTo(Stream::ptr stream, Message::ptr msg);
+    static int32_t SerializeTo(Stream* stream, Message::ptr msg);
+};
+
+}
+
+#endif
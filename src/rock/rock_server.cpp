@@ -0,0 +1,71 @@
+#include "rock_server.h"
+#include "src/log.h"
+
+namespace tao {
+
+static tao::Logger::ptr g_logger = TAO_LOG_NAME("system");
+
+RockServer::RockServer(tao::IOManager* worker, tao::IOManager* accept_worker)
+    :TcpServer(worker, accept_worker) {
+    m_type = "rock";
+}
+
+void RockServer::addModule(uint32_t cmd, Module::ptr module) {
+    RWMutexType::WriteLock lock(m_mutex);
+    m_modules[cmd] = module;
+}
+
+void RockServer::delModule(uint32_t cmd) {
+    RWMutexType::WriteLock lock(m_mutex);
+    m_modules.erase(cmd);
+}
+
+Module::ptr RockServer::getModule(uint32_t cmd) {
+    RWMutexType::ReadLock lock(m_mutex);
+    auto it = m_modules.find(cmd);
+    return it == m_modules.end() ? nullptr : it->second;
+}
+
+void RockServer::handleClient(Socket::ptr client) {
+    TAO_LOG_DEBUG(g_logger) << "handleClient " << *client;
+    RockSession::ptr session = std::make_shared<RockSession>(client, false);
+    //request fibers may outlive this call, they keep the server alive
+    RockServer::ptr self = std::static_pointer_cast<RockServer>(shared_from_this());
+    session->setRequestHandler(std::bind(&RockServer::handleRequest, self
+                    , std::placeholders::_1, std::placeholders::_2, std::placeholders::_3)
+                    , m_worker);
+    session->setNotifyHandler(std::bind(&RockServer::handleNotify, self
+                    , std::placeholders::_1, std::placeholders::_2));
+    ModuleMgr::GetInstance()->onConnect(session);
+    session->run();
+    ModuleMgr::GetInstance()->onDisconnect(session);
+}
+
+bool RockServer::handleRequest(RockRequest::ptr req, RockResponse::ptr rsp, RockSession::ptr session) {
+    Module::ptr module = getModule(req->getCmd());
+    if(module) {
+        return module->handleRequest(req, rsp, session);
+    }
+    std::vector<Module::ptr> ms;
+    ModuleMgr::GetInstance()->listByType(Module::ROCK, ms);
+    for(auto& i : ms) {
+        if(i->handleRequest(req, rsp, session)) {
+            return true;
+        }
+    }
+    TAO_LOG_DEBUG(g_logger) << "unhandled " << req->toString();
+    return false;
+}
+
+bool RockServer::handleNotify(RockNotify::ptr nty, RockSession::ptr session) {
+    std::vector<Module::ptr> ms;
+    ModuleMgr::GetInstance()->listByType(Module::ROCK, ms);
+    for(auto& i : ms) {
+        if(i->handleNotify(nty, session)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+}
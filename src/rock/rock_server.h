@@ -0,0 +1,37 @@
+#ifndef __TAO_ROCK_SERVER_H__
+#define __TAO_ROCK_SERVER_H__
+
+#include "src/tcpserver.h"
+#include "src/module.h"
+#include "rock_session.h"
+
+namespace tao {
+
+/**
+ * @brief serves rock connections, requests are dispatched by cmd to modules
+ * a cmd without a module of its own is offered to every ROCK module until one handles it
+ */
+class RockServer : public TcpServer {
+public:
+    using ptr = std::shared_ptr<RockServer>;
+    using RWMutexType = RWMutex;
+
+    RockServer(tao::IOManager* worker = tao::IOManager::GetThis()
+               ,tao::IOManager* accept_worker = tao::IOManager::GetThis());
+
+    //requests of cmd go to module, usually called from Module::onServerReady
+    void addModule(uint32_t cmd, Module::ptr module);
+    void delModule(uint32_t cmd);
+    Module::ptr getModule(uint32_t cmd);
+protected:
+    virtual void handleClient(Socket::ptr client) override;
+    bool handleRequest(RockRequest::ptr req, RockResponse::ptr rsp, RockSession::ptr session);
+    bool handleNotify(RockNotify::ptr nty, RockSession::ptr session);
+protected:
+    RWMutexType m_mutex;
+    std::unordered_map<uint32_t, Module::ptr> m_modules;
+};
+
+}
+
+#endif
@@ -0,0 +1,382 @@
+#include "rock_session.h"
+#include "src/log.h"
+#include "src/util.h"
+#include <limits.h>
+#include <sys/socket.h>
+#include <string.h>
+
+namespace tao {
+
+static tao::Logger::ptr g_logger = TAO_LOG_NAME("system");
+
+std::string RockResult::toString() const {
+    std::stringstream ss;
+    ss << "[RockResult result=" << result
+       << " used=" << used
+       << " response=" << (response ? response->toString() : "null")
+       << " request=" << (request ? request->toString() : "null")
+       << "]";
+    return ss.str();
+}
+
+bool RockSession::Ctx::wait(uint64_t timeout_ms) {
+    {
+        MutexType::Lock lock(mutex);
+        if(done) {
+            return true;
+        }
+        scheduler = Scheduler::GetThis();
+        waiter = Fiber::GetThis();
+    }
+    Timer::ptr timer;
+    if(timeout_ms != ~0ull) {
+        std::weak_ptr<Ctx> weak(shared_from_this());
+        timer = IOManager::GetThis()->addTimer(timeout_ms, [weak](){
+            auto self = weak.lock();
+            if(!self) {
+                return;
+            }
+            Scheduler* s = nullptr;
+            Fiber::ptr fiber;
+            {
+                MutexType::Lock lock(self->mutex);
+                if(!self->waiter) {
+                    return;
+                }
+                s = self->scheduler;
+                fiber.swap(self->waiter);
+            }
+            s->schedule(fiber);
+        });
+    }
+    Fiber::YieldToHold();
+    if(timer) {
+        timer->cancel();
+    }
+    MutexType::Lock lock(mutex);
+    waiter = nullptr;
+    return done;
+}
+
+void RockSession::Ctx::notify(RockResponse::ptr rsp) {
+    Scheduler* s = nullptr;
+    Fiber::ptr fiber;
+    {
+        MutexType::Lock lock(mutex);
+        if(done) {
+            return;
+        }
+        done = true;
+        response = rsp;
+        if(!waiter) {
+            return;
+        }
+        s = scheduler;
+        fiber.swap(waiter);
+    }
+    s->schedule(fiber);
+}
+
+//bytes read from the socket at once, many small frames come with one recv
+static const size_t s_read_buffer_size = 64 * 1024;
+
+RockSession::RockSession(Socket::ptr sock, bool is_client)
+    :SocketStream(sock, true)
+    ,m_isClient(is_client)
+    ,m_closed(false)
+    ,m_sn(0)
+    ,m_pending(0)
+    ,m_sendHead(nullptr)
+    ,m_writerStarted(false)
+    ,m_writerStop(false)
+    ,m_loopExits(0)
+    ,m_sendFrames(0)
+    ,m_sendWrites(0)
+    ,m_readPos(0)
+    ,m_worker(nullptr) {
+}
+
+RockSession::~RockSession() {
+    TAO_LOG_DEBUG(g_logger) << "RockSession::~RockSession";
+    //queued after the writer stopped
+    SendItem* item = m_sendHead.exchange(nullptr);
+    while(item) {
+        SendItem* next = item->next;
+        delete item;
+        item = next;
+    }
+}
+
+void RockSession::setRequestHandler(RequestHandler cb, IOManager* worker) {
+    m_requestHandler = cb;
+    m_worker = worker;
+}
+
+int RockSession::fillReadBuffer() {
+    m_readBuf.resize(s_read_buffer_size);
+    m_readPos = 0;
+    int rt = SocketStream::read(&m_readBuf[0], m_readBuf.size());
+    m_readBuf.resize(rt > 0 ? rt : 0);
+    return rt;
+}
+
+int RockSession::read(void* buffer, size_t length) {
+    if(m_readPos >= m_readBuf.size()) {
+        int rt = fillReadBuffer();
+        if(rt <= 0) {
+            return rt;
+        }
+    }
+    size_t n = std::min(length, m_readBuf.size() - m_readPos);
+    memcpy(buffer, &m_readBuf[m_readPos], n);
+    m_readPos += n;
+    return n;
+}
+
+int RockSession::read(ByteArray::ptr ba, size_t length) {
+    if(m_readPos >= m_readBuf.size()) {
+        if(length >= s_read_buffer_size) {
+            //a large body goes straight into the array
+            return SocketStream::read(ba, length);
+        }
+        int rt = fillReadBuffer();
+        if(rt <= 0) {
+            return rt;
+        }
+    }
+    size_t n = std::min(length, m_readBuf.size() - m_readPos);
+    ba->write(&m_readBuf[m_readPos], n);
+    m_readPos += n;
+    return n;
+}
+
+bool RockSession::close() {
+    if(!m_writerStarted) {
+        return SocketStream::close();
+    }
+    //a fd closed here could be reused by another socket while the reader or the
+    //writer still waits on it. the reader sees eof and runs onClosed
+    return shutdownSocket();
+}
+
+void RockSession::exitLoop() {
+    //a hooked io retries on the fd number, it is closed only when neither loop uses it
+    if(++m_loopExits == 2) {
+        SocketStream::close();
+    }
+}
+
+bool RockSession::shutdownSocket() {
+    Socket::ptr sock = getSocket();
+    return sock && ::shutdown(sock->getSocket(), SHUT_RDWR) == 0;
+}
+
+bool RockSession::start() {
+    if(!isConnected()) {
+        return false;
+    }
+    startWriter();
+    IOManager::GetThis()->schedule(std::bind(&RockSession::run, shared_from_this()));
+    return true;
+}
+
+void RockSession::startWriter() {
+    if(m_writerStarted.exchange(true)) {
+        return;
+    }
+    IOManager::GetThis()->schedule(std::bind(&RockSession::writerLoop, shared_from_this()));
+}
+
+void RockSession::run() {
+    RockSession::ptr self = shared_from_this();
+    startWriter();
+    while(true) {
+        Message::ptr msg = RockMessageDecoder::ParseFrom(this);
+        if(!msg) {
+            break;
+        }
+        switch(msg->getType()) {
+            case Message::REQUEST:
+                handleRequest(std::static_pointer_cast<RockRequest>(msg));
+                break;
+            case Message::RESPONSE:
+                handleResponse(std::static_pointer_cast<RockResponse>(msg));
+                break;
+            case Message::NOTIFY:
+                handleNotify(std::static_pointer_cast<RockNotify>(msg));
+                break;
+        }
+    }
+    onClosed();
+}
+
+void RockSession::onClosed() {
+    std::unordered_map<uint32_t, Ctx::ptr> ctxs;
+    {
+        MutexType::Lock lock(m_mutex);
+        m_closed = true;
+        ctxs.swap(m_ctxs);
+    }
+    for(auto& i : ctxs) {
+        i.second->notify(nullptr);
+    }
+    m_writerStop = true;
+    m_sendSem.notify();
+    //the writer may still be in writev, it fails at once on a shut down socket
+    shutdownSocket();
+    exitLoop();
+}
+
+int32_t RockSession::sendMessage(Message::ptr msg) {
+    if(m_closed) {
+        return -1;
+    }
+    SendItem* item = new SendItem;
+    item->data = RockMessageDecoder::Encode(msg, item->header);
+    if(!item->data) {
+        delete item;
+        return -1;
+    }
+    int32_t size = sizeof(item->header) + item->data->getSize();
+    SendItem* head = m_sendHead.load(std::memory_order_relaxed);
+    do {
+        item->next = head;
+    } while(!m_sendHead.compare_exchange_weak(head, item
+                , std::memory_order_release, std::memory_order_relaxed));
+    //the writer takes the whole list, only the first push after that wakes it
+    if(!head) {
+        m_sendSem.notify();
+    }
+    return size;
+}
+
+RockSession::SendItem* RockSession::takeSendItems() {
+    SendItem* item = m_sendHead.exchange(nullptr, std::memory_order_acquire);
+    SendItem* rt = nullptr;
+    while(item) {
+        SendItem* next = item->next;
+        item->next = rt;
+        rt = item;
+        item = next;
+    }
+    return rt;
+}
+
+void RockSession::writerLoop() {
+    std::vector<iovec> iovs;
+    bool error = false;
+    while(!error) {
+        m_sendSem.wait();
+        SendItem* items = takeSendItems();
+        if(!items) {
+            if(m_writerStop) {
+                break;
+            }
+            continue;
+        }
+        //everything queued goes out together, IOV_MAX buffers per writev
+        iovs.clear();
+        uint64_t frames = 0;
+        for(SendItem* i = items; i; i = i->next, ++frames) {
+            iovec iov;
+            iov.iov_base = &i->header;
+            iov.iov_len = sizeof(i->header);
+            iovs.push_back(iov);
+            i->data->getReadableBuffers(iovs);
+        }
+        for(size_t pos = 0; pos < iovs.size(); pos += IOV_MAX) {
+            size_t n = std::min(iovs.size() - pos, (size_t)IOV_MAX);
+            if(writevFixSize(&iovs[pos], n) <= 0) {
+                error = true;
+                break;
+            }
+            ++m_sendWrites;
+        }
+        m_sendFrames += frames;
+        while(items) {
+            SendItem* next = items->next;
+            delete items;
+            items = next;
+        }
+    }
+    if(error) {
+        //wakes the reader blocked in recv, it fails the waiting requests
+        shutdownSocket();
+    }
+    exitLoop();
+}
+
+void RockSession::handleRequest(RockRequest::ptr req) {
+    if(!m_requestHandler) {
+        RockResponse::ptr rsp = req->createResponse();
+        rsp->setResultStr("no handler");
+        sendMessage(rsp);
+        return;
+    }
+    RockSession::ptr self = shared_from_this();
+    IOManager* worker = m_worker ? m_worker : IOManager::GetThis();
+    worker->schedule([self, req]() {
+        RockResponse::ptr rsp = req->createResponse();
+        self->m_requestHandler(req, rsp, self);
+        self->sendMessage(rsp);
+    });
+}
+
+void RockSession::handleResponse(RockResponse::ptr rsp) {
+    Ctx::ptr ctx;
+    {
+        MutexType::Lock lock(m_mutex);
+        auto it = m_ctxs.find(rsp->getSn());
+        if(it == m_ctxs.end()) {
+            //the request timed out already
+            TAO_LOG_DEBUG(g_logger) << "no request waits for " << rsp->toString();
+            return;
+        }
+        ctx = it->second;
+        m_ctxs.erase(it);
+    }
+    ctx->notify(rsp);
+}
+
+void RockSession::handleNotify(RockNotify::ptr nty) {
+    if(m_notifyHandler) {
+        m_notifyHandler(nty, shared_from_this());
+    }
+}
+
+RockResult::ptr RockSession::request(RockRequest::ptr req, uint64_t timeout_ms) {
+    uint64_t start = tao::GetCurrentMS();
+    Ctx::ptr ctx = std::make_shared<Ctx>();
+    {
+        MutexType::Lock lock(m_mutex);
+        if(m_closed) {
+            return std::make_shared<RockResult>((int)RockResult::Error::CLOSED, 0, nullptr, req);
+        }
+        req->setSn(++m_sn);
+        m_ctxs[req->getSn()] = ctx;
+    }
+    ++m_pending;
+    RockResult::ptr rt;
+    if(sendMessage(req) <= 0) {
+        {
+            MutexType::Lock lock(m_mutex);
+            m_ctxs.erase(req->getSn());
+        }
+        rt = std::make_shared<RockResult>((int)RockResult::Error::SEND_ERROR
+                    , tao::GetCurrentMS() - start, nullptr, req);
+    } else if(!ctx->wait(timeout_ms)) {
+        {
+            MutexType::Lock lock(m_mutex);
+            m_ctxs.erase(req->getSn());
+        }
+        rt = std::make_shared<RockResult>((int)RockResult::Error::TIMEOUT
+                    , tao::GetCurrentMS() - start, nullptr, req);
+    } else {
+        int32_t result = ctx->response ? (int)RockResult::Error::OK : (int)RockResult::Error::CLOSED;
+        rt = std::make_shared<RockResult>(result, tao::GetCurrentMS() - start, ctx->response, req);
+    }
+    --m_pending;
+    return rt;
+}
+
+}
@@ -0,0 +1,177 @@
+#ifndef __TAO_ROCK_SESSION_H__
+#define __TAO_ROCK_SESSION_H__
+
+#include "rock_protocol.h"
+#include "src/streams/socket_stream.h"
+#include "src/iomanager.h"
+#include "src/mutex.h"
+#include <atomic>
+#include <unordered_map>
+
+namespace tao {
+
+struct RockResult {
+    using ptr = std::shared_ptr<RockResult>;
+
+    enum class Error {
+        OK = 0,
+
+        //no response within the timeout
+        TIMEOUT = 1,
+
+        //socket error when send request
+        SEND_ERROR = 2,
+
+        //connection closed before the response arrived
+        CLOSED = 3
+    };
+
+    RockResult(int32_t _result, uint64_t _used, RockResponse::ptr _rsp, RockRequest::ptr _req)
+        :result(_result)
+        ,used(_used)
+        ,response(_rsp)
+        ,request(_req) {
+    }
+
+    int32_t result;
+    //ms from send to response
+    uint64_t used;
+    RockResponse::ptr response;
+    RockRequest::ptr request;
+
+    std::string toString() const;
+};
+
+/**
+ * @brief one rock connection, used by both server and client
+ * run() reads frames in the calling fiber. responses are matched to the waiting
+ * request by sn, so many fibers can have requests in flight on one connection.
+ * server requests are handled each in its own fiber.
+ * frames are encoded by the sending fiber and pushed to a lock-free list, a writer
+ * fiber takes everything queued at once and sends it with writev
+ */
+class RockSession : public SocketStream
+                  , public std::enable_shared_from_this<RockSession> {
+public:
+    using ptr = std::shared_ptr<RockSession>;
+    using MutexType = Mutex;
+    //fills rsp, the default result is 404 when nothing handled req
+    using RequestHandler = std::function<bool(RockRequest::ptr req
+                                , RockResponse::ptr rsp, RockSession::ptr session)>;
+    using NotifyHandler = std::function<bool(RockNotify::ptr nty, RockSession::ptr session)>;
+
+    RockSession(Socket::ptr sock, bool is_client);
+    ~RockSession();
+
+    /**
+     * @brief serve requests with cb
+     * @param[in] worker scheduler of request fibers, the reading one when nullptr
+     */
+    void setRequestHandler(RequestHandler cb, IOManager* worker = nullptr);
+    void setNotifyHandler(NotifyHandler cb) { m_notifyHandler = cb;}
+
+    /**
+     * @brief start reading in a new fiber of the current IOManager
+     */
+    bool start();
+
+    /**
+     * @brief read and dispatch frames until the connection closed, starts the writer
+     */
+    void run();
+
+    /**
+     * @brief send req with a new sn and wait for its response
+     */
+    RockResult::ptr request(RockRequest::ptr req, uint64_t timeout_ms);
+
+    /**
+     * @brief queue one frame for the writer fiber
+     * @return frame size, -1 when the connection is closed
+     */
+    int32_t sendMessage(Message::ptr msg);
+
+    bool isClient() const { return m_isClient;}
+    bool isClosed() const { return m_closed;}
+    //requests sent and not answered or timed out yet
+    uint32_t getPendingCount() const { return m_pending;}
+    //frames written and the writev calls they took
+    uint64_t getSendFrames() const { return m_sendFrames;}
+    uint64_t getSendWrites() const { return m_sendWrites;}
+
+    //served from a read buffer, frames are small
+    virtual int read(void* buffer, size_t length) override;
+    virtual int read(ByteArray::ptr ba, size_t length) override;
+    virtual bool close() override;
+private:
+    //an encoded frame waiting for the writer
+    struct SendItem {
+        SendItem* next = nullptr;
+        RockMsgHeader header;
+        ByteArray::ptr data;
+    };
+    /**
+     * @brief a request waiting for its response
+     */
+    struct Ctx : public std::enable_shared_from_this<Ctx> {
+        using ptr = std::shared_ptr<Ctx>;
+
+        //false on timeout
+        bool wait(uint64_t timeout_ms);
+        //wake the waiter, response is nullptr when the connection closed
+        void notify(RockResponse::ptr rsp);
+
+        MutexType mutex;
+        bool done = false;
+        RockResponse::ptr response;
+        Scheduler* scheduler = nullptr;
+        Fiber::ptr waiter;
+    };
+
+    //wake the reader with eof and fail the writer, the fd stays open
+    bool shutdownSocket();
+    //called once by the reader and once by the writer, the last one closes the fd
+    void exitLoop();
+    //refill the read buffer from the socket
+    int fillReadBuffer();
+    void startWriter();
+    void writerLoop();
+    //queued frames in send order
+    SendItem* takeSendItems();
+
+    void handleRequest(RockRequest::ptr req);
+    void handleResponse(RockResponse::ptr rsp);
+    void handleNotify(RockNotify::ptr nty);
+    void onClosed();
+private:
+    bool m_isClient;
+    std::atomic<bool> m_closed;
+
+    MutexType m_mutex;
+    //sn -> request waiting for the response
+    std::unordered_map<uint32_t, Ctx::ptr> m_ctxs;
+    std::atomic<uint32_t> m_sn;
+    std::atomic<uint32_t> m_pending;
+
+    //newest first, pushed with a cas
+    std::atomic<SendItem*> m_sendHead;
+    //notified when the list becomes non-empty and on close
+    FiberSemaphore m_sendSem;
+    std::atomic<bool> m_writerStarted;
+    std::atomic<bool> m_writerStop;
+    //reader and writer loops that exited
+    std::atomic<int> m_loopExits;
+    std::atomic<uint64_t> m_sendFrames;
+    std::atomic<uint64_t> m_sendWrites;
+
+    std::string m_readBuf;
+    size_t m_readPos;
+
+    RequestHandler m_requestHandler;
+    NotifyHandler m_notifyHandler;
+    IOManager* m_worker;
+};
+
+}
+
+#endif
@@ -2,6 +2,7 @@
 #include "log.h"
 #include "macro.h"
 #include "hook.h"
+#include <algorithm>
 
 namespace tao {
 
@@ -60,11 +61,8 @@ void Scheduler::start() {
 
     TAO_ASSERT(m_threads.empty());
 
-    m_threads.resize(m_threadCount);
     for (size_t i = 0; i < m_threadCount; ++i) {
-        m_threads[i] = std::make_shared<tao::Thread>(std::bind(&Scheduler::run, this)
-                                                            , m_name + "_" + std::to_string(i));
-        m_threadIds.push_back(m_threads[i]->getId());
+        addThreadNoLock();
     }
     lock.unlock();//unlock here, prevent deadlock from happening, because context switching will happen in call function
 
@@ -125,6 +123,8 @@ void Scheduler::stop() {
     {
         MutexType::Lock lock(m_mutex);
         thrs.swap(m_threads);
+        thrs.insert(thrs.end(), m_retiredThreads.begin(), m_retiredThreads.end());
+        m_retiredThreads.clear();
     }
 
     for(auto& i : thrs) {
@@ -132,12 +132,99 @@ void Scheduler::stop() {
     }
 }
 
+void Scheduler::addThreadNoLock() {
+    Thread::ptr thr = std::make_shared<tao::Thread>(std::bind(&Scheduler::run, this)
+                                        , m_name + "_" + std::to_string(m_nextThreadIndex++));
+    m_threads.push_back(thr);
+    m_threadIds.push_back(thr->getId());
+}
+
+void Scheduler::resize(size_t nthd) {
+    TAO_ASSERT(nthd > 0);
+    if (m_rootThread != -1) {
+        --nthd;
+    }
+    std::vector<Thread::ptr> retired;
+    size_t retire = 0;
+    {
+        MutexType::Lock lock(m_mutex);
+        retired.swap(m_retiredThreads);
+        if (m_stopping) {
+            //before start the threads are created by start
+            if (!m_autoStop) {
+                m_threadCount = nthd;
+            }
+        } else if (nthd > m_threadCount) {
+            //threads still waiting to retire are kept first
+            size_t keep = std::min((size_t)m_retireCount, nthd - m_threadCount);
+            m_retireCount -= keep;
+            m_threadCount += keep;
+            for (; m_threadCount < nthd; ++m_threadCount) {
+                addThreadNoLock();
+            }
+        } else if (nthd < m_threadCount) {
+            retire = m_threadCount - nthd;
+            m_retireCount += retire;
+            m_threadCount = nthd;
+        }
+    }
+    for (auto& i : retired) {
+        i->join();
+    }
+    //idle threads wake up to retire, busy ones retire when they go idle
+    for (size_t i = 0; i < retire; ++i) {
+        tickle();
+    }
+}
+
+size_t Scheduler::getThreadCount() {
+    MutexType::Lock lock(m_mutex);
+    return m_threadCount + (m_rootThread != -1 ? 1 : 0);
+}
+
+size_t Scheduler::getQueueSize() {
+    MutexType::Lock lock(m_mutex);
+    return m_fibers.size();
+}
+
+bool Scheduler::retiring() {
+    if (TAO_LIKELY(m_retireCount == 0) || tao::GetThreadId() == m_rootThread) {
+        return false;
+    }
+    MutexType::Lock lock(m_mutex);
+    if (m_retireCount == 0) {
+        return false;
+    }
+    --m_retireCount;
+    return true;
+}
+
+void Scheduler::onThreadExit() {
+    int id = tao::GetThreadId();
+    MutexType::Lock lock(m_mutex);
+    auto it = std::find_if(m_threads.begin(), m_threads.end(), [](const Thread::ptr& t) {
+        return t.get() == Thread::GetThis();
+    });
+    if (it != m_threads.end()) {
+        m_retiredThreads.push_back(*it);
+        m_threads.erase(it);
+    }
+    m_threadIds.erase(std::remove(m_threadIds.begin(), m_threadIds.end(), id), m_threadIds.end());
+    //nothing would run the tasks queued for this thread
+    for (auto& i : m_fibers) {
+        if (i.thread == id) {
+            i.thread = -1;
+        }
+    }
+}
+
 std::ostream &Scheduler::dump(std::ostream &os)
 {
     os << "[Scheduler name=" << m_name
        << " size=" << m_threadCount
        << " active_count=" << m_activeThreadCount
        << " idle_count=" << m_idleThreadCount
+       << " retiring=" << m_retireCount
        << " stopping=" << m_stopping
        << " ]" << std::endl << "    ";
     for(size_t i = 0; i < m_threadIds.size(); ++i) {
@@ -151,7 +238,7 @@ std::ostream &Scheduler::dump(std::ostream &os)
 
 void Scheduler::tickle()
 {
-    TAO_LOG_INFO(g_logger) << "tickle";
+    TAO_LOG_DEBUG(g_logger) << "tickle";
 }
 
 void Scheduler::run() {
@@ -245,6 +332,9 @@ void Scheduler::run() {
             if(idle_fiber->getState() == Fiber::TERM) {
                 TAO_LOG_INFO(g_logger) << "idle fiber term";
                 //idle_fiber.reset();
+                if(tao::GetThreadId() != m_rootThread) {
+                    onThreadExit();
+                }
                 break;
             }
 
@@ -267,8 +357,8 @@ bool Scheduler::stopping() {
 }
 
 void Scheduler::idle() {
-    TAO_LOG_INFO(g_logger) << "idle";
-    while(!stopping()) {
+    TAO_LOG_DEBUG(g_logger) << "idle";
+    while(!stopping() && !retiring()) {
         tao::Fiber::YieldToHold();
     }
 }
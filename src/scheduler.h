@@ -64,6 +64,18 @@ public:
         }
     }
 
+    /**
+     * @brief sets the number of threads at runtime, counted as in the constructor.
+     * threads are added at once and retire once they go idle,
+     * tasks queued for a retired thread run on any other
+     */
+    void resize(size_t nthd);
+    //threads as counted in the constructor, after pending retirements
+    size_t getThreadCount();
+    //tasks waiting to run
+    size_t getQueueSize();
+    size_t getIdleThreadCount() const { return m_idleThreadCount;}
+
     std::ostream& dump(std::ostream& os);
 protected:
     //wake up all
@@ -75,6 +87,15 @@ protected:
     void setThis();
 
     bool hasIdleThreads() { return m_idleThreadCount > 0;}
+    /**
+     * @brief called by idle, true once the thread should exit after resize shrank the pool
+     */
+    bool retiring();
+
+private:
+    void addThreadNoLock();
+    //a thread leaving run, its tasks go to the others
+    void onThreadExit();
 
 private:
     template<class FiberOrCb>
@@ -122,6 +143,9 @@ private:
 private:
     MutexType m_mutex;  
     std::vector<Thread::ptr> m_threads;
+    //exited after a resize, joined by the next resize or stop
+    std::vector<Thread::ptr> m_retiredThreads;
+    size_t m_nextThreadIndex = 0;
     std::list<FiberAndThread> m_fibers;
     Fiber::ptr m_rootFiber;//scheduler fiber of thread
     std::string m_name;
@@ -131,6 +155,8 @@ protected:
     size_t m_threadCount = 0;
     std::atomic<size_t> m_activeThreadCount = {0};
     std::atomic<size_t> m_idleThreadCount = 0;
+    //threads asked to retire and not exited yet
+    std::atomic<size_t> m_retireCount = {0};
     bool m_stopping = true;//
     bool m_autoStop = false;//subjecttively stop
     int m_rootThread = 0;//main thread 
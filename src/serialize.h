@@ -0,0 +1,430 @@
+#ifndef __TAO_SERIALIZE_H__
+#define __TAO_SERIALIZE_H__
+
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+#include <string.h>
+#include "bytearray.h"
+#include "endian.h"
+
+/**
+ * @brief declare the serialized fields of a struct once, in its public part
+ *
+ *   struct User {
+ *       uint32_t id = 0;
+ *       std::string name;
+ *       std::map<std::string, Address> addrs;
+ *       TAO_SERIALIZE_FIELDS(id, name, addrs)
+ *   };
+ *
+ * tao::Serialize, tao::Deserialize and tao::SerializedSize then handle User and
+ * anything holding it. fields are written one after another without tags,
+ * the declaration order is the wire format
+ */
+#define TAO_SERIALIZE_FIELDS(...) \
+    using tao_serialize_fields = void; \
+    template<class Visitor> \
+    void visitFields(Visitor&& visitor) { visitor(__VA_ARGS__);} \
+    template<class Visitor> \
+    void visitFields(Visitor&& visitor) const { visitor(__VA_ARGS__);}
+
+namespace tao {
+
+//bytes of the 7-bit varint of v
+inline size_t VarintSize(uint64_t v) {
+    return (64 - __builtin_clzll(v | 1) + 6) / 7;
+}
+
+//the 7-bit varint of v at p, as ByteArray::writeUint64
+inline char* EncodeVarint(char* p, uint64_t v) {
+    while(v >= 0x80) {
+        *p++ = (char)(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (char)v;
+    return p;
+}
+
+inline uint32_t EncodeZigzag32(int32_t v) {
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+inline uint64_t EncodeZigzag64(int64_t v) {
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+//fixed width v at p, in the byte order of a ByteArray left at its default
+template<class T>
+inline char* EncodeFixed(char* p, T v) {
+#if TAO_BYTE_ORDER != TAO_BIG_ENDIAN
+    v = byteswap(v);
+#endif
+    memcpy(p, &v, sizeof(v));
+    return p + sizeof(v);
+}
+
+/**
+ * @brief base size of a ByteArray that holds size bytes in one node
+ * powers of two keep the per-thread node pool to a few sizes
+ */
+inline size_t SingleNodeBaseSize(size_t size) {
+    size_t rt = 4096;
+    while(rt < size) {
+        rt <<= 1;
+    }
+    return rt;
+}
+
+/**
+ * @brief Size/Write/Read of one type, with the encodings of the ByteArray calls
+ * hand written messages use. Encode writes the same bytes to memory Size bytes long,
+ * without the bounds and node checks of ByteArray:
+ *  bool, int8_t, uint8_t: one byte
+ *  unsigned: varint, writeUint32 up to 32 bits and writeUint64 above
+ *  signed: zigzag varint, writeInt32 up to 32 bits and writeInt64 above
+ *  float, double: fixed 4/8 bytes
+ *  enum: as its underlying type
+ *  std::string, std::string_view: varint length and the bytes, as writeStringVint
+ *  vector, map, unordered_map: varint count then the elements, a map entry is key then value
+ *  struct with TAO_SERIALIZE_FIELDS: its fields in order
+ * Read throws std::out_of_range when the data ends inside a value
+ */
+template<class T, class Enable = void>
+class Serializer;
+
+template<class T>
+class Serializer<T, typename std::enable_if<std::is_integral<T>::value>::type> {
+public:
+    static size_t Size(T v) {
+        if constexpr (sizeof(T) == 1) {
+            return 1;
+        } else if constexpr (std::is_signed<T>::value && sizeof(T) <= 4) {
+            return VarintSize(EncodeZigzag32(v));
+        } else if constexpr (std::is_signed<T>::value) {
+            return VarintSize(EncodeZigzag64(v));
+        } else {
+            return VarintSize(v);
+        }
+    }
+
+    static char* Encode(char* p, T v) {
+        if constexpr (sizeof(T) == 1) {
+            *p = (char)v;
+            return p + 1;
+        } else if constexpr (std::is_signed<T>::value && sizeof(T) <= 4) {
+            return EncodeVarint(p, EncodeZigzag32(v));
+        } else if constexpr (std::is_signed<T>::value) {
+            return EncodeVarint(p, EncodeZigzag64(v));
+        } else {
+            return EncodeVarint(p, v);
+        }
+    }
+
+    static void Write(ByteArray& ba, T v) {
+        if constexpr (sizeof(T) == 1) {
+            ba.writeFuint8(v);
+        } else if constexpr (std::is_signed<T>::value && sizeof(T) <= 4) {
+            ba.writeInt32(v);
+        } else if constexpr (std::is_signed<T>::value) {
+            ba.writeInt64(v);
+        } else if constexpr (sizeof(T) <= 4) {
+            ba.writeUint32(v);
+        } else {
+            ba.writeUint64(v);
+        }
+    }
+
+    static void Read(ByteArray& ba, T& v) {
+        if constexpr (sizeof(T) == 1) {
+            v = (T)ba.readFuint8();
+        } else if constexpr (std::is_signed<T>::value && sizeof(T) <= 4) {
+            v = (T)ba.readInt32();
+        } else if constexpr (std::is_signed<T>::value) {
+            v = (T)ba.readInt64();
+        } else if constexpr (sizeof(T) <= 4) {
+            v = (T)ba.readUint32();
+        } else {
+            v = (T)ba.readUint64();
+        }
+    }
+};
+
+template<>
+class Serializer<float> {
+public:
+    static size_t Size(float v) { return sizeof(v);}
+    static char* Encode(char* p, float v) {
+        uint32_t u;
+        memcpy(&u, &v, sizeof(v));
+        return EncodeFixed(p, u);
+    }
+    static void Write(ByteArray& ba, float v) { ba.writeFloat(v);}
+    static void Read(ByteArray& ba, float& v) { v = ba.readFloat();}
+};
+
+template<>
+class Serializer<double> {
+public:
+    static size_t Size(double v) { return sizeof(v);}
+    static char* Encode(char* p, double v) {
+        uint64_t u;
+        memcpy(&u, &v, sizeof(v));
+        return EncodeFixed(p, u);
+    }
+    static void Write(ByteArray& ba, double v) { ba.writeDouble(v);}
+    static void Read(ByteArray& ba, double& v) { v = ba.readDouble();}
+};
+
+template<class T>
+class Serializer<T, typename std::enable_if<std::is_enum<T>::value>::type> {
+public:
+    using U = typename std::underlying_type<T>::type;
+
+    static size_t Size(T v) { return Serializer<U>::Size((U)v);}
+    static char* Encode(char* p, T v) { return Serializer<U>::Encode(p, (U)v);}
+    static void Write(ByteArray& ba, T v) { Serializer<U>::Write(ba, (U)v);}
+    static void Read(ByteArray& ba, T& v) {
+        U u;
+        Serializer<U>::Read(ba, u);
+        v = (T)u;
+    }
+};
+
+template<>
+class Serializer<std::string> {
+public:
+    static size_t Size(const std::string& v) { return VarintSize(v.size()) + v.size();}
+    static char* Encode(char* p, const std::string& v) {
+        p = EncodeVarint(p, v.size());
+        memcpy(p, v.data(), v.size());
+        return p + v.size();
+    }
+    static void Write(ByteArray& ba, const std::string& v) { ba.writeStringVint(v);}
+    static void Read(ByteArray& ba, std::string& v) { v = ba.readStringVint();}
+};
+
+/**
+ * @brief decoded without a copy, the view points into the array and lives as long as its data
+ * the string must lie in one node, arrays from SerializeToByteArray and the rock decoder do.
+ * Read throws std::logic_error when it crosses nodes
+ */
+template<>
+class Serializer<std::string_view> {
+public:
+    static size_t Size(std::string_view v) { return VarintSize(v.size()) + v.size();}
+    static char* Encode(char* p, std::string_view v) {
+        p = EncodeVarint(p, v.size());
+        memcpy(p, v.data(), v.size());
+        return p + v.size();
+    }
+    static void Write(ByteArray& ba, std::string_view v) {
+        ba.writeUint64(v.size());
+        ba.write(v.data(), v.size());
+    }
+    static void Read(ByteArray& ba, std::string_view& v) {
+        uint64_t len = ba.readUint64();
+        const char* data = ba.readView(len);
+        if(!data) {
+            throw std::logic_error("string_view crosses ByteArray nodes");
+        }
+        v = std::string_view(data, len);
+    }
+};
+
+template<class T, class A>
+class Serializer<std::vector<T, A> > {
+public:
+    static size_t Size(const std::vector<T, A>& v) {
+        size_t rt = VarintSize(v.size());
+        for(const auto& i : v) {
+            rt += Serializer<T>::Size(i);
+        }
+        return rt;
+    }
+
+    static char* Encode(char* p, const std::vector<T, A>& v) {
+        p = EncodeVarint(p, v.size());
+        for(const auto& i : v) {
+            p = Serializer<T>::Encode(p, i);
+        }
+        return p;
+    }
+
+    static void Write(ByteArray& ba, const std::vector<T, A>& v) {
+        ba.writeUint64(v.size());
+        for(const auto& i : v) {
+            Serializer<T>::Write(ba, i);
+        }
+    }
+
+    static void Read(ByteArray& ba, std::vector<T, A>& v) {
+        uint64_t count = ba.readUint64();
+        v.clear();
+        //a bad count runs out of data instead of reserving it all
+        v.reserve(std::min<uint64_t>(count, ba.getReadableSize()));
+        for(uint64_t i = 0; i < count; ++i) {
+            T item;
+            Serializer<T>::Read(ba, item);
+            v.push_back(std::move(item));
+        }
+    }
+};
+
+//map and unordered_map
+template<class M>
+class MapSerializer {
+public:
+    using K = typename M::key_type;
+    using V = typename M::mapped_type;
+
+    static size_t Size(const M& v) {
+        size_t rt = VarintSize(v.size());
+        for(const auto& i : v) {
+            rt += Serializer<K>::Size(i.first) + Serializer<V>::Size(i.second);
+        }
+        return rt;
+    }
+
+    static char* Encode(char* p, const M& v) {
+        p = EncodeVarint(p, v.size());
+        for(const auto& i : v) {
+            p = Serializer<K>::Encode(p, i.first);
+            p = Serializer<V>::Encode(p, i.second);
+        }
+        return p;
+    }
+
+    static void Write(ByteArray& ba, const M& v) {
+        ba.writeUint64(v.size());
+        for(const auto& i : v) {
+            Serializer<K>::Write(ba, i.first);
+            Serializer<V>::Write(ba, i.second);
+        }
+    }
+
+    static void Read(ByteArray& ba, M& v) {
+        uint64_t count = ba.readUint64();
+        v.clear();
+        for(uint64_t i = 0; i < count; ++i) {
+            K key;
+            V value;
+            Serializer<K>::Read(ba, key);
+            Serializer<V>::Read(ba, value);
+            v.emplace(std::move(key), std::move(value));
+        }
+    }
+};
+
+template<class K, class V, class C, class A>
+class Serializer<std::map<K, V, C, A> >
+    : public MapSerializer<std::map<K, V, C, A> > {
+};
+
+template<class K, class V, class H, class E, class A>
+class Serializer<std::unordered_map<K, V, H, E, A> >
+    : public MapSerializer<std::unordered_map<K, V, H, E, A> > {
+};
+
+template<class T>
+class Serializer<T, typename std::enable_if<
+                    std::is_void<typename T::tao_serialize_fields>::value>::type> {
+public:
+    static size_t Size(const T& v) {
+        SizeVisitor visitor;
+        v.visitFields(visitor);
+        return visitor.size;
+    }
+    static char* Encode(char* p, const T& v) {
+        EncodeVisitor visitor{p};
+        v.visitFields(visitor);
+        return visitor.p;
+    }
+    static void Write(ByteArray& ba, const T& v) { v.visitFields(WriteVisitor{ba});}
+    static void Read(ByteArray& ba, T& v) { v.visitFields(ReadVisitor{ba});}
+private:
+    //folds run left to right, in the order of the declaration
+    struct SizeVisitor {
+        template<class... Args>
+        void operator()(const Args&... args) {
+            ((size += Serializer<Args>::Size(args)), ...);
+        }
+        size_t size = 0;
+    };
+
+    struct EncodeVisitor {
+        template<class... Args>
+        void operator()(const Args&... args) {
+            ((p = Serializer<Args>::Encode(p, args)), ...);
+        }
+        char* p;
+    };
+
+    struct WriteVisitor {
+        template<class... Args>
+        void operator()(const Args&... args) {
+            (Serializer<Args>::Write(ba, args), ...);
+        }
+        ByteArray& ba;
+    };
+
+    struct ReadVisitor {
+        template<class... Args>
+        void operator()(Args&... args) {
+            (Serializer<Args>::Read(ba, args), ...);
+        }
+        ByteArray& ba;
+    };
+};
+
+//bytes Serialize writes for v
+template<class T>
+size_t SerializedSize(const T& v) {
+    return Serializer<T>::Size(v);
+}
+
+/**
+ * @brief write v at the position of ba
+ * encoded in place when it fits the current node, through the ByteArray calls otherwise.
+ * Encode only knows the default byte order, a little endian array always takes the calls
+ */
+template<class T>
+void Serialize(ByteArray& ba, const T& v) {
+    char* p = ba.isLittleEndian() ? nullptr : ba.writeView(Serializer<T>::Size(v));
+    if(p) {
+        Serializer<T>::Encode(p, v);
+    } else {
+        Serializer<T>::Write(ba, v);
+    }
+}
+
+//read v from the position of ba, throws std::out_of_range on short data
+template<class T>
+void Deserialize(ByteArray& ba, T& v) {
+    Serializer<T>::Read(ba, v);
+}
+
+/**
+ * @brief v in a new array sized upfront, encoded straight into its one node
+ * @return the array at position 0
+ */
+template<class T>
+ByteArray::ptr SerializeToByteArray(const T& v) {
+    size_t size = SerializedSize(v);
+    ByteArray::ptr ba = std::make_shared<ByteArray>(SingleNodeBaseSize(size));
+    char* p = ba->writeView(size);
+    if(p) {
+        Serializer<T>::Encode(p, v);
+    }
+    ba->setPosition(0);
+    return ba;
+}
+
+}
+
+#endif
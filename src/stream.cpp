@@ -53,6 +53,69 @@ int Stream::writeFixSize(ByteArray::ptr ba, size_t length)
     }
     return length;
 }
+int Stream::writevFixSize(const iovec* iov, size_t iovcnt)
+{
+    size_t total = 0;
+    for(size_t i = 0; i < iovcnt; ++i) {
+        if(iov[i].iov_len == 0) {
+            continue;
+        }
+        int len = writeFixSize(iov[i].iov_base, iov[i].iov_len);
+        if(len <= 0) {
+            return len;
+        }
+        total += len;
+    }
+    return total;
+}
+int Stream::read(BufferChain& buf, size_t length)
+{
+    std::vector<iovec> iovs;
+    if(buf.getWritableBuffers(iovs, length) == 0) {
+        return 0;
+    }
+    int rt = read(iovs[0].iov_base, iovs[0].iov_len);
+    if(rt > 0) {
+        buf.commit(rt);
+    }
+    return rt;
+}
+int Stream::readFixSize(BufferChain& buf, size_t length)
+{
+    int64_t left = length;
+    while(left > 0) {
+        int64_t len = read(buf, left);
+        if(len <= 0) {
+            return len;
+        }
+        left -= len;
+    }
+    return length;
+}
+int Stream::write(BufferChain& buf, size_t length)
+{
+    std::vector<iovec> iovs;
+    if(buf.getReadableBuffers(iovs, length) == 0) {
+        return 0;
+    }
+    int rt = write(iovs[0].iov_base, iovs[0].iov_len);
+    if(rt > 0) {
+        buf.consume(rt);
+    }
+    return rt;
+}
+int Stream::writeFixSize(BufferChain& buf, size_t length)
+{
+    int64_t left = length;
+    while(left > 0) {
+        int64_t len = write(buf, left);
+        if(len <= 0) {
+            return len;
+        }
+        left -= len;
+    }
+    return length;
+}
 
 
 }
\ No newline at end of file
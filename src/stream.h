@@ -2,7 +2,9 @@
 #define __TAO_STREAM_H__
 
 #include <memory>
+#include <sys/uio.h>
 #include "bytearray.h"
+#include "buffer_chain.h"
 
 namespace tao {
 
@@ -19,6 +21,21 @@ public:
     virtual int write(tao::ByteArray::ptr ba, size_t length) = 0;
     virtual int writeFixSize(const void* buffer, size_t length);
     virtual int writeFixSize(ByteArray::ptr ba, size_t length);
+    /**
+     * @brief write all buffers in order, streams with gather io send them in one call
+     * @return total length, <= 0 on error
+     */
+    virtual int writevFixSize(const iovec* iov, size_t iovcnt);
+    /**
+     * @brief append up to length bytes from the stream to buf
+     */
+    virtual int read(BufferChain& buf, size_t length);
+    virtual int readFixSize(BufferChain& buf, size_t length);
+    /**
+     * @brief write up to length bytes from the front of buf, the written bytes are consumed
+     */
+    virtual int write(BufferChain& buf, size_t length);
+    virtual int writeFixSize(BufferChain& buf, size_t length);
     virtual bool close() = 0;
 
 private:
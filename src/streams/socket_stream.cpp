@@ -54,6 +54,71 @@ int SocketStream::write(ByteArray::ptr ba, size_t length)
     }
     return rt;
 }
+int SocketStream::writevFixSize(const iovec* iov, size_t iovcnt)
+{
+    if(!isConnected()) {
+        return -1;
+    }
+    size_t total = 0;
+    for(size_t i = 0; i < iovcnt; ++i) {
+        total += iov[i].iov_len;
+    }
+    int rt = m_sock->send(iov, iovcnt);
+    if(rt <= 0 || (size_t)rt == total) {
+        return rt;
+    }
+    //short write, go on with a copy of what is left
+    std::vector<iovec> left(iov, iov + iovcnt);
+    size_t idx = 0;
+    size_t done = rt;
+    while(true) {
+        while(idx < left.size() && done >= left[idx].iov_len) {
+            done -= left[idx].iov_len;
+            ++idx;
+        }
+        if(idx == left.size()) {
+            break;
+        }
+        left[idx].iov_base = (char*)left[idx].iov_base + done;
+        left[idx].iov_len -= done;
+        rt = m_sock->send(&left[idx], left.size() - idx);
+        if(rt <= 0) {
+            return rt;
+        }
+        done = rt;
+    }
+    return total;
+}
+int SocketStream::read(BufferChain& buf, size_t length)
+{
+    if(!isConnected()) {
+        return -1;
+    }
+    std::vector<iovec> iovs;
+    if(buf.getWritableBuffers(iovs, length) == 0) {
+        return 0;
+    }
+    int rt = m_sock->recv(&iovs[0], iovs.size());
+    if(rt > 0) {
+        buf.commit(rt);
+    }
+    return rt;
+}
+int SocketStream::write(BufferChain& buf, size_t length)
+{
+    if(!isConnected()) {
+        return -1;
+    }
+    std::vector<iovec> iovs;
+    if(buf.getReadableBuffers(iovs, length) == 0) {
+        return 0;
+    }
+    int rt = m_sock->send(&iovs[0], iovs.size());
+    if(rt > 0) {
+        buf.consume(rt);
+    }
+    return rt;
+}
 bool SocketStream::close()
 {
     if(m_sock) {
@@ -24,6 +24,9 @@ public:
     virtual int read(ByteArray::ptr ba, size_t length) override;
     virtual int write(const void* buffer, size_t length) override;
     virtual int write(ByteArray::ptr ba, size_t length) override;
+    virtual int writevFixSize(const iovec* iov, size_t iovcnt) override;
+    virtual int read(BufferChain& buf, size_t length) override;
+    virtual int write(BufferChain& buf, size_t length) override;
     virtual bool close() override;
 
 
@@ -28,15 +28,13 @@ ZlibStream::ptr ZlibStream::Create(bool encode, uint32_t buff_size,
 ZlibStream::ZlibStream(bool encode, uint32_t buff_size)
     :m_buffSize(buff_size)
     ,m_encode(encode)
-    ,m_free(true) {
+    ,m_free(true)
+    ,m_type(DEFLATE)
+    ,m_level(DEFAULT_COMPRESSION) {
 }
 
 ZlibStream::~ZlibStream() {
-    if(m_free) {
-        for(auto& i : m_buffs) {
-            free(i.iov_base);
-        }
-    }
+    freeBuffers();
 
     if(m_encode) {
         deflateEnd(&m_zstream);
@@ -58,9 +56,9 @@ int ZlibStream::write(const void* buffer, size_t length) {
     ivc.iov_base = (void*)buffer;
     ivc.iov_len = length;
     if(m_encode) {
-        return encode(&ivc, 1, false);
+        return encode(&ivc, 1, Z_NO_FLUSH);
     } else {
-        return decode(&ivc, 1, false);
+        return decode(&ivc, 1, Z_NO_FLUSH);
     }
 }
 
@@ -68,9 +66,9 @@ int ZlibStream::write(ByteArray::ptr ba, size_t length) {
     std::vector<iovec> buffers;
     ba->getReadableBuffers(buffers, length);
     if(m_encode) {
-        return encode(&buffers[0], buffers.size(), false);
+        return encode(&buffers[0], buffers.size(), Z_NO_FLUSH);
     } else {
-        return decode(&buffers[0], buffers.size(), false);
+        return decode(&buffers[0], buffers.size(), Z_NO_FLUSH);
     }
 }
 
@@ -85,6 +83,8 @@ int ZlibStream::init(Type type, int level, int window_bits
     TAO_ASSERT((memlevel >= 1 && memlevel <= 9));
 
     memset(&m_zstream, 0, sizeof(m_zstream));
+    m_type = type;
+    m_level = level;
 
     m_zstream.zalloc = Z_NULL;
     m_zstream.zfree = Z_NULL;
@@ -110,14 +110,14 @@ int ZlibStream::init(Type type, int level, int window_bits
     }
 }
 
-int ZlibStream::encode(const iovec* v, const uint64_t& size, bool finish) {
+int ZlibStream::encode(const iovec* v, const uint64_t& size, int flush) {
     int ret = 0;
-    int flush = 0;
     for(uint64_t i = 0; i < size; ++i) {
         m_zstream.avail_in = v[i].iov_len;
         m_zstream.next_in = (Bytef*)v[i].iov_base;
 
-        flush = finish ? (i == size - 1 ? Z_FINISH : Z_NO_FLUSH) : Z_NO_FLUSH;
+        //only the last buffer carries the flush mode
+        int mode = i == size - 1 ? flush : Z_NO_FLUSH;
 
         iovec* ivc = nullptr;
         do {
@@ -134,27 +134,24 @@ int ZlibStream::encode(const iovec* v, const uint64_t& size, bool finish) {
             m_zstream.avail_out = m_buffSize - ivc->iov_len;
             m_zstream.next_out = (Bytef*)ivc->iov_base + ivc->iov_len;
 
-            ret = deflate(&m_zstream, flush);
+            ret = deflate(&m_zstream, mode);
             if(ret == Z_STREAM_ERROR) {
                 return ret;
             }
             ivc->iov_len = m_buffSize - m_zstream.avail_out;
         } while(m_zstream.avail_out == 0);
     }
-    if(flush == Z_FINISH) {
-        deflateEnd(&m_zstream);
-    }
     return Z_OK;
 }
 
-int ZlibStream::decode(const iovec* v, const uint64_t& size, bool finish) {
+int ZlibStream::decode(const iovec* v, const uint64_t& size, int flush) {
     int ret = 0;
-    int flush = 0;
     for(uint64_t i = 0; i < size; ++i) {
         m_zstream.avail_in = v[i].iov_len;
         m_zstream.next_in = (Bytef*)v[i].iov_base;
 
-        flush = finish ? (i == size - 1 ? Z_FINISH : Z_NO_FLUSH) : Z_NO_FLUSH;
+        //only the last buffer carries the flush mode
+        int mode = i == size - 1 ? flush : Z_NO_FLUSH;
 
         iovec* ivc = nullptr;
         do {
@@ -171,16 +168,17 @@ int ZlibStream::decode(const iovec* v, const uint64_t& size, bool finish) {
             m_zstream.avail_out = m_buffSize - ivc->iov_len;
             m_zstream.next_out = (Bytef*)ivc->iov_base + ivc->iov_len;
 
-            ret = inflate(&m_zstream, flush);
-            if(ret == Z_STREAM_ERROR) {
+            ret = inflate(&m_zstream, mode);
+            if(ret == Z_STREAM_ERROR || ret == Z_DATA_ERROR
+                    || ret == Z_NEED_DICT || ret == Z_MEM_ERROR) {
                 return ret;
             }
             ivc->iov_len = m_buffSize - m_zstream.avail_out;
         } while(m_zstream.avail_out == 0);
     }
-
-    if(flush == Z_FINISH) {
-        inflateEnd(&m_zstream);
+    //a finished inflate must have seen the end of the compressed data
+    if(flush == Z_FINISH && ret != Z_STREAM_END) {
+        return Z_DATA_ERROR;
     }
     return Z_OK;
 }
@@ -191,9 +189,44 @@ int ZlibStream::flush() {
     ivc.iov_len = 0;
 
     if(m_encode) {
-        return encode(&ivc, 1, true);
+        return encode(&ivc, 1, Z_FINISH);
     } else {
-        return decode(&ivc, 1, true);
+        return decode(&ivc, 1, Z_FINISH);
+    }
+}
+
+int ZlibStream::syncFlush() {
+    iovec ivc;
+    ivc.iov_base = nullptr;
+    ivc.iov_len = 0;
+
+    if(m_encode) {
+        return encode(&ivc, 1, Z_SYNC_FLUSH);
+    } else {
+        return decode(&ivc, 1, Z_SYNC_FLUSH);
+    }
+}
+
+int ZlibStream::reset() {
+    freeBuffers();
+    m_buffs.clear();
+    if(m_encode) {
+        return deflateReset(&m_zstream);
+    } else {
+        return inflateReset(&m_zstream);
+    }
+}
+
+void ZlibStream::clearBuffers() {
+    freeBuffers();
+    m_buffs.clear();
+}
+
+void ZlibStream::freeBuffers() {
+    if(m_free) {
+        for(auto& i : m_buffs) {
+            free(i.iov_base);
+        }
     }
 }
 
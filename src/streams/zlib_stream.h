@@ -56,6 +56,18 @@ public:
     virtual bool close() override;
 
     int flush();
+    /**
+     * @brief emit all pending output without ending the stream(Z_SYNC_FLUSH)
+     */
+    int syncFlush();
+    /**
+     * @brief reuse the initialized z_stream for a new input, output buffers are released
+     */
+    int reset();
+    /**
+     * @brief drop output buffers and keep the compress state(dictionary) for the next input
+     */
+    void clearBuffers();
 
     bool isFree() const { return m_free;}
     void setFree(bool v) { m_free = v;}
@@ -63,6 +75,9 @@ public:
     bool isEncode() const { return m_encode;}
     void setEndcode(bool v) { m_encode = v;}
 
+    Type getType() const { return m_type;}
+    int getLevel() const { return m_level;}
+
     std::vector<iovec>& getBuffers() { return m_buffs;}
     std::string getResult() const;
     tao::ByteArray::ptr getByteArray();
@@ -73,13 +88,16 @@ private:
             ,int memlevel = 8
             ,Strategy strategy = DEFAULT);
 
-    int encode(const iovec* v, const uint64_t& size, bool finish);
-    int decode(const iovec* v, const uint64_t& size, bool finish);
+    int encode(const iovec* v, const uint64_t& size, int flush);
+    int decode(const iovec* v, const uint64_t& size, int flush);
+    void freeBuffers();
 private:
     z_stream m_zstream;
     uint32_t m_buffSize;
     bool m_encode;
     bool m_free;
+    Type m_type;
+    int m_level;
     std::vector<iovec> m_buffs;
 
 };
@@ -13,13 +13,26 @@
 #include <ifaddrs.h>
 #include <signal.h>
 #include <stdarg.h>
+#include <pthread.h>
 
 namespace tao {
 
 tao::Logger::ptr g_logger = TAO_LOG_NAME("system");
 
+//cached per thread, a forked child starts from a copy of the forking thread
+static thread_local pid_t t_thread_id = 0;
+
+static void ResetThreadId() {
+    t_thread_id = 0;
+}
+
 pid_t GetThreadId() {
-    return syscall(SYS_gettid);
+    if(!t_thread_id) {
+        static int s_atfork = pthread_atfork(nullptr, nullptr, ResetThreadId);
+        (void)s_atfork;
+        t_thread_id = syscall(SYS_gettid);
+    }
+    return t_thread_id;
 }
 
 
@@ -1,9 +1,12 @@
 #include "worker.h"
 #include "config.h"
 #include "util.h"
+#include <algorithm>
 
 namespace tao {
 
+static tao::Logger::ptr g_logger = TAO_LOG_NAME("system");
+
 static tao::ConfigVar<std::map<std::string, std::map<std::string, std::string> > >::ptr g_worker_config
     = tao::Config::Lookup("workers", std::map<std::string, std::map<std::string, std::string> >(), "worker config");
 
@@ -41,16 +44,19 @@ void WorkerGroup::doWork(std::function<void()> cb)
 }
 
 WorkerManager::WorkerManager()
-    :m_stop(false){
+    :m_listenerId(0)
+    ,m_stop(false){
     
 }
 
 void WorkerManager::add(Scheduler::ptr s)
 {
+    RWMutexType::WriteLock lock(m_mutex);
     m_datas[s->getName()].push_back(s);
 }
 Scheduler::ptr WorkerManager::get(const std::string &name)
 {
+    RWMutexType::ReadLock lock(m_mutex);
     auto it = m_datas.find(name);
     if (it == m_datas.end()) {
         return nullptr;
@@ -73,32 +79,151 @@ bool WorkerManager::init()
 bool WorkerManager::init(const std::map<std::string, std::map<std::string, std::string>> &v)
 {
     for (auto& i : v) {
-        std::string name = i.first;
-        int32_t thread_num = tao::GetParamValue(i.second, "thread_num", 1);
-
-        Scheduler::ptr s;
-        s = std::make_shared<IOManager>(thread_num, false, name);
-        add(s);
+        setWorker(i.first, i.second);
+    }
+    {
+        RWMutexType::ReadLock lock(m_mutex);
+        m_stop = m_datas.empty();
+    }
+    if (!m_listenerId) {
+        m_listenerId = g_worker_config->addListener([this](
+                const std::map<std::string, std::map<std::string, std::string> >& old_value
+                ,const std::map<std::string, std::map<std::string, std::string> >& new_value) {
+            if (m_stop) {
+                return;
+            }
+            for (auto& i : new_value) {
+                setWorker(i.first, i.second);
+            }
+            for (auto& i : old_value) {
+                if (!new_value.count(i.first)) {
+                    //servers may hold it, it keeps running
+                    TAO_LOG_WARN(g_logger) << "worker name=" << i.first
+                        << " removed from config, still running";
+                }
+            }
+        });
     }
-    m_stop = m_datas.empty();
     return true;
 }
+
+void WorkerManager::setWorker(const std::string& name
+                              ,const std::map<std::string, std::string>& params)
+{
+    int32_t thread_num = tao::GetParamValue(params, "thread_num", 1);
+    int32_t min_thread_num = tao::GetParamValue(params, "min_thread_num", thread_num);
+    int32_t max_thread_num = tao::GetParamValue(params, "max_thread_num", thread_num);
+    uint64_t scale_interval = tao::GetParamValue(params, "scale_interval", 1000);
+    if (thread_num < 1 || min_thread_num < 1 || max_thread_num < min_thread_num) {
+        TAO_LOG_ERROR(g_logger) << "worker name=" << name << " invalid thread_num="
+            << thread_num << " min_thread_num=" << min_thread_num
+            << " max_thread_num=" << max_thread_num;
+        return;
+    }
+    if (thread_num < min_thread_num || thread_num > max_thread_num) {
+        int32_t n = std::max(min_thread_num, std::min(thread_num, max_thread_num));
+        TAO_LOG_WARN(g_logger) << "worker name=" << name << " thread_num=" << thread_num
+            << " out of [" << min_thread_num << ", " << max_thread_num << "], use " << n;
+        thread_num = n;
+    }
+
+    std::vector<Scheduler::ptr> workers;
+    std::vector<AutoScale::ptr> old_scales;
+    {
+        RWMutexType::WriteLock lock(m_mutex);
+        auto it = m_datas.find(name);
+        if (it == m_datas.end()) {
+            m_datas[name].push_back(std::make_shared<IOManager>(thread_num, false, name));
+        } else {
+            TAO_LOG_INFO(g_logger) << "worker name=" << name << " resize to " << thread_num;
+            for (auto& i : it->second) {
+                i->resize(thread_num);
+            }
+        }
+        workers = m_datas[name];
+        m_scales[name].swap(old_scales);
+    }
+    for (auto& i : old_scales) {
+        i->timer->cancel();
+    }
+    if (max_thread_num == min_thread_num) {
+        return;
+    }
+
+    //a worker busy with its tasks would not run its own scaler, the caller's iomanager does
+    IOManager* scaler = IOManager::GetThis();
+    std::vector<AutoScale::ptr> scales;
+    for (auto& i : workers) {
+        IOManager* iom = dynamic_cast<IOManager*>(i.get());
+        if (!iom) {
+            continue;
+        }
+        AutoScale::ptr as = std::make_shared<AutoScale>();
+        as->worker = iom;
+        as->min_threads = min_thread_num;
+        as->max_threads = max_thread_num;
+        //cancelled by setWorker or stop, those break the cycle through the callback
+        as->timer = (scaler ? scaler : iom)->addTimer(scale_interval
+                        , std::bind(&AutoScale::step, as), true);
+        scales.push_back(as);
+    }
+    RWMutexType::WriteLock lock(m_mutex);
+    m_scales[name].swap(scales);
+}
+
+void WorkerManager::AutoScale::step()
+{
+    size_t threads = worker->getThreadCount();
+    size_t queued = worker->getQueueSize();
+    size_t idle = worker->getIdleThreadCount();
+    if (queued > 0 && idle == 0 && threads < max_threads) {
+        //up to twice the threads, as many as the queued tasks
+        size_t n = std::min(max_threads, threads + std::min(threads, queued));
+        TAO_LOG_INFO(g_logger) << "worker name=" << worker->getName() << " queued=" << queued
+            << " scale up " << threads << " -> " << n;
+        worker->resize(n);
+        idle_rounds = 0;
+    } else if (queued == 0 && idle > 1 && threads > min_threads) {
+        //one thread at a time after a few idle rounds, a short lull keeps the threads
+        if (++idle_rounds >= 3) {
+            TAO_LOG_INFO(g_logger) << "worker name=" << worker->getName() << " idle=" << idle
+                << " scale down " << threads << " -> " << threads - 1;
+            worker->resize(threads - 1);
+            idle_rounds = 0;
+        }
+    } else {
+        idle_rounds = 0;
+    }
+}
+
 void WorkerManager::stop()
 {
-    if (m_stop) {
+    if (m_stop.exchange(true)) {
         return;
     }
-    for (auto& i : m_datas) {
+    std::map<std::string, std::vector<Scheduler::ptr> > datas;
+    std::map<std::string, std::vector<AutoScale::ptr> > scales;
+    {
+        RWMutexType::WriteLock lock(m_mutex);
+        datas.swap(m_datas);
+        scales.swap(m_scales);
+    }
+    //a recurring timer keeps the worker from stopping
+    for (auto& i : scales) {
+        for (auto& n : i.second) {
+            n->timer->cancel();
+        }
+    }
+    for (auto& i : datas) {
         for (auto& n : i.second) {
             n->schedule([](){});
             n->stop();
         }
     }
-    m_datas.clear();
-    m_stop = true;
 }
 std::ostream &WorkerManager::dump(std::ostream &os)
 {
+    RWMutexType::ReadLock lock(m_mutex);
     for(auto& i : m_datas) {
         for(auto& n : i.second) {
             n->dump(os) << std::endl;
@@ -108,6 +233,7 @@ std::ostream &WorkerManager::dump(std::ostream &os)
 }
 uint32_t WorkerManager::getCount()
 {
+    RWMutexType::ReadLock lock(m_mutex);
     return m_datas.size();
 }
 }
\ No newline at end of file
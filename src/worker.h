@@ -5,6 +5,7 @@
 #include "singleton.h"
 #include "log.h"
 #include "iomanager.h"
+#include <atomic>
 
 namespace tao {
 
@@ -31,6 +32,7 @@ private:
 
 class WorkerManager {
 public:
+    using RWMutexType = RWMutex;
     WorkerManager();
     void add(Scheduler::ptr s);
     Scheduler::ptr get(const std::string& name);
@@ -51,7 +53,12 @@ public:
     //init configuration from conf file
     bool init();
 
-    //init configuration from data structure
+    /**
+     * @brief init configuration from data structure. params of a worker:
+     * thread_num, and to scale with the load min_thread_num, max_thread_num, scale_interval(ms).
+     * the scalers run on the iomanager calling init until stop.
+     * after init, changes of the workers config resize the workers
+     */
     bool init(const std::map<std::string, std::map<std::string, std::string>>&v);
     void stop();
 
@@ -60,9 +67,29 @@ public:
 
     uint32_t getCount();
 private:
+    //grows a worker while tasks queue up and none of its threads idles, shrinks it while they idle
+    struct AutoScale {
+        using ptr = std::shared_ptr<AutoScale>;
+        IOManager* worker;
+        size_t min_threads;
+        size_t max_threads;
+        uint32_t idle_rounds = 0;
+        Timer::ptr timer;
+
+        void step();
+    };
+
+    //creates the worker or resizes it to the params
+    void setWorker(const std::string& name, const std::map<std::string, std::string>& params);
+private:
+    RWMutexType m_mutex;
     //name -> Schdulers
     std::map<std::string, std::vector<Scheduler::ptr> > m_datas;
-    bool m_stop;
+    //name -> auto scaler
+    std::map<std::string, std::vector<AutoScale::ptr> > m_scales;
+    uint64_t m_listenerId;
+    //written by init/stop, read by the config listener on any thread
+    std::atomic<bool> m_stop;
 };
 
 using WorkerMgr = tao::Singleton<WorkerManager>;
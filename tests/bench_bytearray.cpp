@@ -0,0 +1,124 @@
+#include "../src/bytearray.h"
+#include "../src/log.h"
+#include "../src/macro.h"
+#include "../src/util.h"
+
+static tao::Logger::ptr g_logger = TAO_LOG_ROOT();
+
+//the codecs before the in place fast paths: bytes through write/read one call at a time
+static void legacy_write_varint(tao::ByteArray& ba, uint64_t value) {
+    uint8_t compressed[10];
+    uint8_t i = 0;
+    while (value >= 0x80) {
+        compressed[i++] = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    compressed[i++] = value;
+    ba.write(compressed, i);
+}
+
+static uint64_t legacy_read_varint(tao::ByteArray& ba) {
+    uint64_t res = 0;
+    for (int i = 0; i < 64; i += 7) {
+        uint8_t b;
+        ba.read(&b, 1);
+        res |= ((uint64_t)(b & 0x7f)) << i;
+        if (b < 0x80) {
+            break;
+        }
+    }
+    return res;
+}
+
+static uint64_t legacy_zigzag(int64_t v) {
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static int64_t legacy_unzigzag(uint64_t v) {
+    return (v >> 1) ^ -(v & 1);
+}
+
+static void legacy_write_float(tao::ByteArray& ba, float value) {
+    uint32_t v;
+    memcpy(&v, &value, sizeof(v));
+    ba.write(&v, sizeof(v));
+}
+
+static float legacy_read_float(tao::ByteArray& ba) {
+    uint32_t v;
+    ba.read(&v, sizeof(v));
+    float value;
+    memcpy(&value, &v, sizeof(v));
+    return value;
+}
+
+//millions of values per second
+static double rate(int n, uint64_t us) {
+    return (double)n / (us ? us : 1);
+}
+
+template<class Write, class Read>
+static void run(const char* name, int n, Write&& w, Read&& r, double& enc, double& dec) {
+    tao::ByteArray ba(4096);
+    uint64_t start = tao::GetCurrentUS();
+    for(int i = 0; i < n; ++i) {
+        w(ba, i);
+    }
+    enc = rate(n, tao::GetCurrentUS() - start);
+    ba.setPosition(0);
+    start = tao::GetCurrentUS();
+    uint64_t sum = 0;
+    for(int i = 0; i < n; ++i) {
+        sum += r(ba, i);
+    }
+    dec = rate(n, tao::GetCurrentUS() - start);
+    TAO_ASSERT(ba.getReadableSize() == 0);
+    asm volatile("" : : "r"(sum));
+}
+
+//values spread over every varint length
+static uint64_t value_of(int i) {
+    return ((uint64_t)i * 0x9E3779B97F4A7C15ull) >> (i % 57);
+}
+
+int main(int argc, char** argv) {
+    const int n = 10000000;
+    struct Case {
+        const char* name;
+        double enc[2];
+        double dec[2];
+    };
+    std::vector<Case> cases;
+#define XX(label, legacy_w, legacy_r, fast_w, fast_r) { \
+        Case c; \
+        c.name = label; \
+        run(label, n, legacy_w, legacy_r, c.enc[0], c.dec[0]); \
+        run(label, n, fast_w, fast_r, c.enc[1], c.dec[1]); \
+        cases.push_back(c); \
+    }
+
+    XX("uint32", [](tao::ByteArray& ba, int i) { legacy_write_varint(ba, (uint32_t)value_of(i));}
+        ,[](tao::ByteArray& ba, int i) { return (uint32_t)legacy_read_varint(ba);}
+        ,[](tao::ByteArray& ba, int i) { ba.writeUint32(value_of(i));}
+        ,[](tao::ByteArray& ba, int i) { return ba.readUint32();});
+    XX("uint64", [](tao::ByteArray& ba, int i) { legacy_write_varint(ba, value_of(i));}
+        ,[](tao::ByteArray& ba, int i) { return legacy_read_varint(ba);}
+        ,[](tao::ByteArray& ba, int i) { ba.writeUint64(value_of(i));}
+        ,[](tao::ByteArray& ba, int i) { return ba.readUint64();});
+    XX("zigzag int64", [](tao::ByteArray& ba, int i) { legacy_write_varint(ba, legacy_zigzag((int64_t)value_of(i) >> 8));}
+        ,[](tao::ByteArray& ba, int i) { return legacy_unzigzag(legacy_read_varint(ba));}
+        ,[](tao::ByteArray& ba, int i) { ba.writeInt64((int64_t)value_of(i) >> 8);}
+        ,[](tao::ByteArray& ba, int i) { return ba.readInt64();});
+    XX("float", [](tao::ByteArray& ba, int i) { legacy_write_float(ba, i * 0.25f);}
+        ,[](tao::ByteArray& ba, int i) { return (uint64_t)legacy_read_float(ba);}
+        ,[](tao::ByteArray& ba, int i) { ba.writeFloat(i * 0.25f);}
+        ,[](tao::ByteArray& ba, int i) { return (uint64_t)ba.readFloat();});
+#undef XX
+
+    for(auto& c : cases) {
+        TAO_LOG_INFO(g_logger) << c.name
+            << " encode " << c.enc[0] << " -> " << c.enc[1] << " M/s"
+            << " decode " << c.dec[0] << " -> " << c.dec[1] << " M/s";
+    }
+    return 0;
+}
@@ -0,0 +1,140 @@
+#include "../src/config.h"
+#include "../src/thread.h"
+#include "../src/log.h"
+#include "../src/macro.h"
+#include "../src/util.h"
+#include <atomic>
+#include <unistd.h>
+#include <vector>
+
+static tao::Logger::ptr g_logger = TAO_LOG_ROOT();
+
+static tao::ConfigVar<uint64_t>::ptr g_bench_int =
+    tao::Config::Lookup("bench.config.int", (uint64_t)128 * 1024, "bench int");
+
+static tao::ConfigVar<std::vector<std::string> >::ptr g_bench_vec =
+    tao::Config::Lookup("bench.config.vec"
+        , std::vector<std::string>(8, "a config string longer than sso"), "bench vector");
+
+//getValue as it was: a read lock and a copy
+template<class T>
+class LockedVar {
+public:
+    LockedVar(const T& v) :m_val(v) {}
+    const T getValue() {
+        tao::RWMutex::ReadLock lock(m_mutex);
+        return m_val;
+    }
+private:
+    tao::RWMutex m_mutex;
+    T m_val;
+};
+
+//ns per read with threads reading at once
+static double run_threads(int threads, int reads, std::function<uint64_t(int)> reader) {
+    std::vector<tao::Thread::ptr> thrs;
+    std::atomic<uint64_t> sink(0);
+    uint64_t start = tao::GetCurrentUS();
+    for(int i = 0; i < threads; ++i) {
+        thrs.push_back(std::make_shared<tao::Thread>([&sink, reads, reader]() {
+            sink += reader(reads);
+        }, "reader_" + std::to_string(i)));
+    }
+    for(auto& i : thrs) {
+        i->join();
+    }
+    uint64_t used = tao::GetCurrentUS() - start;
+    TAO_ASSERT(sink > 0);
+    //wall time over all reads, threads beyond the cores share them
+    return used * 1000.0 / ((uint64_t)threads * reads);
+}
+
+void bench(int threads) {
+    const int n = 2000000;
+    LockedVar<uint64_t> locked_int(g_bench_int->getValue());
+    LockedVar<std::vector<std::string> > locked_vec(g_bench_vec->getValue());
+
+    double old_int = run_threads(threads, n, [&locked_int](int reads) {
+        uint64_t sum = 0;
+        for(int i = 0; i < reads; ++i) {
+            sum += locked_int.getValue();
+        }
+        return sum;
+    });
+    double new_int = run_threads(threads, n, [](int reads) {
+        uint64_t sum = 0;
+        for(int i = 0; i < reads; ++i) {
+            sum += g_bench_int->getValue();
+        }
+        return sum;
+    });
+    double old_vec = run_threads(threads, n / 10, [&locked_vec](int reads) {
+        uint64_t sum = 0;
+        for(int i = 0; i < reads; ++i) {
+            sum += locked_vec.getValue().size();
+        }
+        return sum;
+    });
+    double new_vec = run_threads(threads, n / 10, [](int reads) {
+        uint64_t sum = 0;
+        for(int i = 0; i < reads; ++i) {
+            sum += g_bench_vec->getValue().size();
+        }
+        return sum;
+    });
+    double ref_vec = run_threads(threads, n, [](int reads) {
+        uint64_t sum = 0;
+        for(int i = 0; i < reads; ++i) {
+            sum += g_bench_vec->getValueRef().size();
+        }
+        return sum;
+    });
+    TAO_LOG_INFO(g_logger) << threads << " threads on " << sysconf(_SC_NPROCESSORS_ONLN)
+        << " cores, ns per read:"
+        << " uint64 locked=" << old_int << " getValue=" << new_int
+        << " | vector<string> locked=" << old_vec << " getValue=" << new_vec
+        << " getValueRef=" << ref_vec;
+}
+
+//readers only ever see values that were set, listeners see every change once
+void test_concurrent_set() {
+    auto var = tao::Config::Lookup("bench.config.set", std::vector<std::string>{"0"}, "");
+    std::atomic<int> changes(0);
+    var->addListener([&changes](const std::vector<std::string>& ov
+                                , const std::vector<std::string>& nv) {
+        TAO_ASSERT(std::stoi(nv[0]) == std::stoi(ov[0]) + 1);
+        ++changes;
+    });
+    std::atomic<bool> stop(false);
+    std::vector<tao::Thread::ptr> thrs;
+    for(int i = 0; i < 8; ++i) {
+        thrs.push_back(std::make_shared<tao::Thread>([var, &stop]() {
+            int last = 0;
+            while(!stop) {
+                const std::vector<std::string>& v = var->getValueRef();
+                int cur = std::stoi(v[0]);
+                TAO_ASSERT(v.size() == (size_t)cur + 1 && cur >= last);
+                last = cur;
+            }
+        }, "set_reader_" + std::to_string(i)));
+    }
+    std::vector<std::string> v{"0"};
+    for(int i = 1; i <= 2000; ++i) {
+        v.insert(v.begin(), std::to_string(i));
+        var->setValue(v);
+    }
+    stop = true;
+    for(auto& i : thrs) {
+        i->join();
+    }
+    TAO_ASSERT(changes == 2000);
+    TAO_ASSERT(var->getValue() == v);
+}
+
+int main(int argc, char** argv) {
+    g_logger->setLevel(tao::LogLevel::INFO);
+    test_concurrent_set();
+    bench(1);
+    bench(16);
+    return 0;
+}
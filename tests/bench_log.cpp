@@ -0,0 +1,124 @@
+#include "../src/log.h"
+#include "../src/thread.h"
+#include "../src/macro.h"
+#include "../src/util.h"
+
+static tao::Logger::ptr g_logger = TAO_LOG_ROOT();
+
+static const char* s_pattern = "%d%T%t%T%N%T%F%T[%p]%T[%c]%T%f:%l%T%m%n";
+
+//formats every record and throws it away, so only the logging path is measured
+class NullLogAppender : public tao::LogAppender {
+public:
+    NullLogAppender(bool legacy)
+        :m_legacy(legacy) {
+    }
+
+    void log(std::shared_ptr<tao::Logger> logger, tao::LogLevel::Level level, tao::LogEvent::ptr event) override {
+        static thread_local std::string t_buf;
+        if(m_legacy) {
+            t_bytes += m_formatter->format(logger, level, event).size();
+        } else {
+            t_buf.clear();
+            m_formatter->format(t_buf, logger, level, event);
+            t_bytes += t_buf.size();
+        }
+    }
+
+    std::string toYamlString() override { return "";}
+
+    static thread_local uint64_t t_bytes;
+private:
+    bool m_legacy;
+};
+
+thread_local uint64_t NullLogAppender::t_bytes = 0;
+
+//the path before pooled events: a new event per record, formatted by the virtual items
+#define BENCH_LOG_LEGACY(logger) \
+    tao::LogEventWrap(tao::LogEvent::ptr(new tao::LogEvent(logger, tao::LogLevel::INFO, \
+                    __FILE__, __LINE__, 0, tao::GetThreadId(), \
+                    tao::GetFiberId(), time(0), tao::Thread::GetName()))).getSS()
+
+static void check_same_output() {
+    auto logger = std::make_shared<tao::Logger>("bench");
+    auto fmt = std::make_shared<tao::LogFormatter>(std::string(s_pattern) + "%r %d{%H:%M} %x %%");
+    auto event = tao::LogEvent::Create(logger, tao::LogLevel::WARN, __FILE__, __LINE__
+                    ,17, tao::GetThreadId(), tao::GetFiberId(), time(0), tao::Thread::GetName());
+    event->getSS() << "value=" << 42 << " pi=" << 3.14159265;
+    std::string fast;
+    fmt->format(fast, logger, tao::LogLevel::WARN, event);
+    TAO_ASSERT(fast == fmt->format(logger, tao::LogLevel::WARN, event));
+
+    //the pooled event starts empty with default stream flags
+    event->getSS() << std::hex;
+    event.reset();
+    event = tao::LogEvent::Create(logger, tao::LogLevel::INFO, __FILE__, __LINE__
+                    ,0, 0, 0, 0, tao::Thread::GetName());
+    event->getSS() << 255;
+    TAO_ASSERT(event->getContent() == "255");
+}
+
+static int s_evaluated = 0;
+static int side_effect() {
+    return ++s_evaluated;
+}
+
+//a disabled statement is one level check, its arguments are never evaluated
+static void bench_disabled() {
+    auto logger = std::make_shared<tao::Logger>("bench");
+    logger->setLevel(tao::LogLevel::INFO);
+    logger->addAppender(std::make_shared<NullLogAppender>(false));
+    const int n = 100000000;
+    uint64_t start = tao::GetCurrentUS();
+    for(int i = 0; i < n; ++i) {
+        TAO_LOG_DEBUG(logger) << "disabled " << side_effect();
+        asm volatile("" : : : "memory");
+    }
+    uint64_t used = tao::GetCurrentUS() - start;
+    TAO_ASSERT(s_evaluated == 0);
+    TAO_LOG_INFO(g_logger) << "disabled debug " << (double)used * 1000 / n << "ns/statement";
+}
+
+//records per second of threads logging n records each
+static uint64_t run(bool legacy, int threads, int n) {
+    auto logger = std::make_shared<tao::Logger>("bench");
+    auto appender = std::make_shared<NullLogAppender>(legacy);
+    appender->setFormatter(std::make_shared<tao::LogFormatter>(s_pattern));
+    logger->addAppender(appender);
+
+    std::vector<tao::Thread::ptr> thrs;
+    uint64_t start = tao::GetCurrentUS();
+    for(int i = 0; i < threads; ++i) {
+        thrs.push_back(std::make_shared<tao::Thread>([logger, legacy, n]() {
+            for(int j = 0; j < n; ++j) {
+                if(legacy) {
+                    BENCH_LOG_LEGACY(logger) << "request " << j << " done in " << 1.5 << "ms";
+                } else {
+                    TAO_LOG_INFO(logger) << "request " << j << " done in " << 1.5 << "ms";
+                }
+            }
+            TAO_ASSERT(NullLogAppender::t_bytes > 0);
+        }, "bench_" + std::to_string(i)));
+    }
+    for(auto& i : thrs) {
+        i->join();
+    }
+    uint64_t used = tao::GetCurrentUS() - start;
+    return (uint64_t)threads * n * 1000000 / (used ? used : 1);
+}
+
+int main(int argc, char** argv) {
+    check_same_output();
+    bench_disabled();
+    const int n = 800000;
+    for(int threads : {1, 4, 16}) {
+        uint64_t legacy = run(true, threads, n / threads);
+        uint64_t fast = run(false, threads, n / threads);
+        TAO_LOG_INFO(g_logger) << "threads=" << threads
+            << " legacy=" << legacy << " records/s"
+            << " fast=" << fast << " records/s"
+            << " speedup=" << (double)fast / (legacy ? legacy : 1);
+    }
+    return 0;
+}
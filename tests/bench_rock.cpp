@@ -0,0 +1,125 @@
+#include "../src/rock/rock_server.h"
+#include "../src/rock/rock_connection.h"
+#include "../src/iomanager.h"
+#include "../src/macro.h"
+#include "../src/log.h"
+#include "../src/util.h"
+#include <algorithm>
+#include <atomic>
+#include <unistd.h>
+#include <set>
+
+static tao::Logger::ptr g_logger = TAO_LOG_ROOT();
+
+class EchoModule : public tao::RockModule {
+public:
+    EchoModule()
+        :RockModule("bench_echo", "1.0", "") {
+    }
+
+    bool handleRockRequest(tao::RockRequest::ptr req
+                           ,tao::RockResponse::ptr rsp
+                           ,tao::RockSession::ptr session) override {
+        rsp->setResult(200);
+        rsp->setBody(req->getBody());
+        return true;
+    }
+
+    bool handleRockNotify(tao::RockNotify::ptr notify
+                          ,tao::RockSession::ptr session) override {
+        return false;
+    }
+};
+
+//concurrency fibers each call count times
+static void run_calls(tao::RockConnectionPool::ptr pool, uint32_t concurrency, uint32_t count
+                    , std::vector<std::vector<uint32_t> >& latencies
+                    , std::set<tao::RockConnection::ptr>& conns) {
+    latencies.assign(concurrency, std::vector<uint32_t>());
+    std::vector<tao::RockConnection::ptr> used(concurrency);
+    std::atomic<uint32_t> failed(0);
+    std::atomic<uint32_t> done(0);
+    std::string body(64, 'b');
+    for(uint32_t i = 0; i < concurrency; ++i) {
+        tao::IOManager::GetThis()->schedule([&, i]() {
+            for(uint32_t j = 0; j < count; ++j) {
+                tao::RockRequest::ptr req = std::make_shared<tao::RockRequest>();
+                req->setCmd(1);
+                req->setBody(body);
+                uint64_t t = tao::GetCurrentUS();
+                auto conn = pool->getConnection();
+                auto r = conn->request(req, 5000);
+                if(r->result != 0 || r->response->getBody() != body) {
+                    ++failed;
+                }
+                latencies[i].push_back(tao::GetCurrentUS() - t);
+                used[i] = conn;
+            }
+            ++done;
+        });
+    }
+    while(done < concurrency) {
+        usleep(1000);
+    }
+    TAO_ASSERT(failed == 0);
+    conns.insert(used.begin(), used.end());
+}
+
+/**
+ * @brief closed loop calls over a pool of conns connections,
+ * reports calls/s, latency percentiles and frames coalesced per writev
+ */
+static void bench_calls(uint32_t conns, uint32_t concurrency, uint32_t total) {
+    auto pool = std::make_shared<tao::RockConnectionPool>("127.0.0.1:8095", conns, 1000);
+    std::vector<std::vector<uint32_t> > latencies;
+    std::set<tao::RockConnection::ptr> used;
+    //opens the connections
+    run_calls(pool, concurrency, 2, latencies, used);
+    uint64_t frames = 0;
+    uint64_t writes = 0;
+    for(auto& i : used) {
+        frames -= i->getSendFrames();
+        writes -= i->getSendWrites();
+    }
+
+    uint64_t start = tao::GetCurrentUS();
+    run_calls(pool, concurrency, total / concurrency, latencies, used);
+    uint64_t elapsed = tao::GetCurrentUS() - start;
+
+    for(auto& i : used) {
+        frames += i->getSendFrames();
+        writes += i->getSendWrites();
+    }
+    std::vector<uint32_t> all;
+    for(auto& i : latencies) {
+        all.insert(all.end(), i.begin(), i.end());
+    }
+    std::sort(all.begin(), all.end());
+    TAO_LOG_INFO(g_logger) << "conns=" << used.size() << " concurrency=" << concurrency
+        << " calls=" << all.size()
+        << " calls/s=" << (uint64_t)(all.size() * 1e6 / elapsed)
+        << " p50=" << all[all.size() / 2] << "us"
+        << " p99=" << all[all.size() * 99 / 100] << "us"
+        << " frames/writev=" << (writes ? (double)frames / writes : 0);
+    pool->close();
+}
+
+int main(int argc, char** argv) {
+    g_logger->setLevel(tao::LogLevel::INFO);
+    TAO_LOG_NAME("system")->setLevel(tao::LogLevel::INFO);
+
+    tao::IOManager iom(4);
+    iom.schedule([]() {
+        auto server = std::make_shared<tao::RockServer>();
+        server->addModule(1, std::make_shared<EchoModule>());
+        TAO_ASSERT(server->bind(tao::Address::LookupAny("127.0.0.1:8095")));
+        server->start();
+
+        bench_calls(1, 1, 20000);
+        bench_calls(1, 64, 200000);
+        bench_calls(1, 1024, 200000);
+        bench_calls(4, 1024, 200000);
+        server->stop();
+    });
+    return 0;
+}
@@ -0,0 +1,107 @@
+#include "../src/http/ws_session.h"
+#include "../src/streams/socket_stream.h"
+#include "../src/iomanager.h"
+#include "../src/macro.h"
+#include "../src/log.h"
+#include "../src/util.h"
+
+static tao::Logger::ptr g_logger = TAO_LOG_ROOT();
+
+static void bench_mask() {
+    std::string data(64 * 1024, 'x');
+    for(size_t i = 0; i < data.size(); ++i) {
+        data[i] = (char)i;
+    }
+    const char mask[4] = {0x12, 0x34, 0x56, 0x78};
+    std::string a = data;
+    std::string b = data;
+    //odd lengths check the tail handling
+    for(size_t len : {0, 1, 3, 7, 15, 17, 31, 1000}) {
+        std::string x = data.substr(0, len);
+        std::string y = x;
+        tao::http::WSMask(&x[0], len, mask);
+        for(size_t i = 0; i < len; ++i) {
+            y[i] ^= mask[i % 4];
+        }
+        TAO_ASSERT(x == y);
+    }
+
+    const int n = 10000;
+    uint64_t t0 = tao::GetCurrentUS();
+    for(int i = 0; i < n; ++i) {
+        for(size_t j = 0; j < a.size(); ++j) {
+            a[j] ^= mask[j % 4];
+        }
+        asm volatile("" : : "r"(&a[0]) : "memory");
+    }
+    uint64_t t1 = tao::GetCurrentUS();
+    for(int i = 0; i < n; ++i) {
+        tao::http::WSMask(&b[0], b.size(), mask);
+        asm volatile("" : : "r"(&b[0]) : "memory");
+    }
+    uint64_t t2 = tao::GetCurrentUS();
+    TAO_ASSERT(a == b);
+    double mb = (double)n * data.size() / 1024 / 1024;
+    TAO_LOG_INFO(g_logger) << "mask bytewise " << mb / ((t1 - t0) / 1e6) << " MB/s, WSMask "
+        << mb / ((t2 - t1) / 1e6) << " MB/s";
+}
+
+//client sends count masked frames of size bytes over loopback, server decodes them
+static void bench_frames(size_t size, int count) {
+    auto addr = tao::Address::LookupAny("127.0.0.1:8099");
+    auto listener = tao::Socket::CreateTCP(addr);
+    int val = 1;
+    listener->setOption(SOL_SOCKET, SO_REUSEADDR, val);
+    TAO_ASSERT(listener->bind(addr) && listener->listen());
+
+    auto received = std::make_shared<int>(0);
+    auto done = std::make_shared<bool>(false);
+    tao::IOManager::GetThis()->schedule([listener, received, done, size, count]() {
+        auto stream = std::make_shared<tao::SocketStream>(listener->accept());
+        while(auto msg = tao::http::WSRecvMessage(stream.get(), false)) {
+            TAO_ASSERT(msg->getData().size() == size);
+            TAO_ASSERT(msg->getData()[size - 1] == 'w');
+            if(++*received == count) {
+                break;
+            }
+        }
+        *done = true;
+    });
+
+    auto sock = tao::Socket::CreateTCP(addr);
+    TAO_ASSERT(sock->connect(addr));
+    auto stream = std::make_shared<tao::SocketStream>(sock);
+    auto msg = std::make_shared<tao::http::WSFrameMessage>(tao::http::WSFrameHead::BIN_FRAME
+                    , std::string(size, 'w'));
+    uint64_t start = tao::GetCurrentUS();
+    for(int i = 0; i < count; ++i) {
+        TAO_ASSERT(tao::http::WSSendMessage(stream.get(), msg, true, true) > 0);
+    }
+    while(!*done) {
+        usleep(1000);
+    }
+    uint64_t used = tao::GetCurrentUS() - start;
+    TAO_ASSERT(*received == count);
+    //the message sent by a client is masked on a copy
+    TAO_ASSERT(msg->getData() == std::string(size, 'w'));
+    TAO_LOG_INFO(g_logger) << "frame size=" << size << " count=" << count
+        << " " << (uint64_t)(count / (used / 1e6)) << " frames/s "
+        << (uint64_t)(count * size / (used / 1e6) / 1024 / 1024) << " MB/s";
+    listener->close();
+}
+
+void run(int small, int large) {
+    g_logger->setLevel(tao::LogLevel::INFO);
+    TAO_LOG_NAME("system")->setLevel(tao::LogLevel::INFO);
+    bench_mask();
+    bench_frames(64, small);
+    bench_frames(64 * 1024, large);
+}
+
+int main(int argc, char** argv) {
+    int small = argc > 1 ? atoi(argv[1]) : 200000;
+    int large = argc > 2 ? atoi(argv[2]) : 5000;
+    tao::IOManager iom(2);
+    iom.schedule(std::bind(run, small, large));
+    return 0;
+}
@@ -0,0 +1,163 @@
+#include "../src/buffer_chain.h"
+#include "../src/stream.h"
+#include "../src/log.h"
+#include "../src/macro.h"
+#include "../src/util.h"
+#include <unistd.h>
+
+static tao::Logger::ptr g_logger = TAO_LOG_ROOT();
+
+//a stream over a pipe, uses the default BufferChain overloads of Stream
+class PipeStream : public tao::Stream {
+public:
+    PipeStream() {
+        TAO_ASSERT(pipe(m_fds) == 0);
+    }
+    ~PipeStream() {
+        close();
+    }
+    int read(void* buffer, size_t length) override {
+        return ::read(m_fds[0], buffer, length);
+    }
+    int read(tao::ByteArray::ptr ba, size_t length) override { return -1;}
+    int write(const void* buffer, size_t length) override {
+        return ::write(m_fds[1], buffer, length);
+    }
+    int write(tao::ByteArray::ptr ba, size_t length) override { return -1;}
+    using tao::Stream::read;
+    using tao::Stream::write;
+    bool close() override {
+        if(m_fds[0] >= 0) {
+            ::close(m_fds[0]);
+            ::close(m_fds[1]);
+            m_fds[0] = m_fds[1] = -1;
+        }
+        return true;
+    }
+private:
+    int m_fds[2];
+};
+
+void test_basic() {
+    tao::BufferChain buf;
+    std::string data;
+    for(int i = 0; i < 3000; ++i) {
+        data += std::to_string(i) + ",";
+    }
+    buf.append(data);
+    TAO_ASSERT(buf.size() == data.size());
+    TAO_ASSERT(buf.toString() == data);
+
+    //a slice shares the blocks and is not changed by later writes
+    tao::BufferChain part = buf.slice(100, 5000);
+    TAO_ASSERT(part.toString() == data.substr(100, 5000));
+    buf.append("tail", 4);
+    buf.consume(50);
+    TAO_ASSERT(buf.toString() == data.substr(50) + "tail");
+    TAO_ASSERT(part.toString() == data.substr(100, 5000));
+    buf.trimEnd(6);
+    TAO_ASSERT(buf.toString() == data.substr(50, data.size() - 52));
+
+    //appending a chain copies no bytes
+    tao::BufferChain joined;
+    joined.append("head:", 5);
+    joined.append(part);
+    joined.append(part.slice(0, 10));
+    TAO_ASSERT(joined.toString() == "head:" + data.substr(100, 5000) + data.substr(100, 10));
+    TAO_ASSERT(joined.getSliceCount() >= 3);
+
+    char tmp[16];
+    TAO_ASSERT(joined.copyTo(tmp, sizeof(tmp), 3) == sizeof(tmp));
+    TAO_ASSERT(std::string(tmp, sizeof(tmp)) == joined.toString().substr(3, 16));
+
+    std::vector<iovec> iovs;
+    TAO_ASSERT(joined.getReadableBuffers(iovs) == joined.size());
+    std::string gathered;
+    for(auto& i : iovs) {
+        gathered.append((const char*)i.iov_base, i.iov_len);
+    }
+    TAO_ASSERT(gathered == joined.toString());
+}
+
+void test_headroom() {
+    tao::BufferChain buf(16);
+    buf.append("payload", 7);
+    TAO_ASSERT(buf.getSliceCount() == 1);
+    buf.prepend("hdr:", 4);
+    TAO_ASSERT(buf.getSliceCount() == 1);
+    TAO_ASSERT(buf.toString() == "hdr:payload");
+
+    //no headroom left in a shared block, the header gets its own block
+    tao::BufferChain shared = buf.slice(0, buf.size());
+    buf.prepend("len=11 ", 7);
+    TAO_ASSERT(buf.getSliceCount() == 2);
+    TAO_ASSERT(buf.toString() == "len=11 hdr:payload");
+    TAO_ASSERT(shared.toString() == "hdr:payload");
+
+    tao::BufferChain empty(8);
+    empty.append(shared);
+    empty.prepend("x", 1);
+    TAO_ASSERT(empty.toString() == "xhdr:payload");
+    TAO_ASSERT(empty.getSliceCount() == 2);
+}
+
+void test_stream() {
+    PipeStream stream;
+    tao::BufferChain out;
+    std::string data(20000, 'a');
+    for(size_t i = 0; i < data.size(); ++i) {
+        data[i] = 'a' + i % 26;
+    }
+    out.append(data.substr(0, 10000));
+    tao::BufferChain body;
+    body.append(data.substr(10000));
+    out.append(body);
+    size_t size = out.size();
+
+    tao::BufferChain in;
+    size_t received = 0;
+    while(!out.empty()) {
+        int rt = stream.write(out, 4096);
+        TAO_ASSERT(rt > 0);
+        TAO_ASSERT(stream.readFixSize(in, rt) == rt);
+        received += rt;
+    }
+    TAO_ASSERT(received == size);
+    TAO_ASSERT(in.toString() == data);
+    TAO_ASSERT(body.toString() == data.substr(10000));
+}
+
+//forwarding a body: slicing and appending against copying into a new string
+void bench_forward() {
+    tao::BufferChain body;
+    body.append(std::string(256 * 1024, 'b'));
+    const int n = 100000;
+    uint64_t start = tao::GetCurrentUS();
+    size_t total = 0;
+    for(int i = 0; i < n; ++i) {
+        tao::BufferChain req(64);
+        req.append(body.slice(1024, body.size() - 1024));
+        req.prepend("POST /upload HTTP/1.1\r\n\r\n", 25);
+        total += req.size();
+    }
+    uint64_t chain = tao::GetCurrentUS() - start;
+    std::string src = body.toString();
+    start = tao::GetCurrentUS();
+    for(int i = 0; i < n / 100; ++i) {
+        std::string req = "POST /upload HTTP/1.1\r\n\r\n" + src.substr(1024);
+        total += req.size();
+    }
+    uint64_t copy = (tao::GetCurrentUS() - start) * 100;
+    TAO_ASSERT(total > 0);
+    TAO_LOG_INFO(g_logger) << "forward 255KB body: chain=" << chain * 1000 / n
+        << "ns copy=" << copy * 1000 / n << "ns";
+}
+
+int main(int argc, char** argv) {
+    test_basic();
+    test_headroom();
+    test_stream();
+    bench_forward();
+    TAO_LOG_INFO(g_logger) << "test_buffer_chain ok";
+    return 0;
+}
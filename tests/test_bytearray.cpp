@@ -1,7 +1,11 @@
 #include "../src/bytearray.h"
 #include "../src/log.h"
 #include "../src/macro.h"
+#include "../src/config.h"
+#include "../src/protocol.h"
+#include "../src/util.h"
 #include <memory>
+#include <unistd.h>
 
 static tao::Logger::ptr g_logger = TAO_LOG_ROOT();
 
@@ -98,7 +102,195 @@ base_len: size of memory block
 
 }
 
+//values around every varint length, written across node boundaries of any size
+void test_codec_boundaries() {
+    std::vector<uint64_t> values;
+    for(int bits = 0; bits <= 64; ++bits) {
+        uint64_t v = bits == 64 ? ~0ull : (1ull << bits);
+        values.push_back(v - 1);
+        values.push_back(v);
+        values.push_back(v + 1);
+    }
+    for(size_t base : {1, 3, 7, 8, 11, 64, 4096}) {
+        tao::ByteArray::ptr ba = std::make_shared<tao::ByteArray>(base);
+        for(auto v : values) {
+            ba->writeUint64(v);
+            ba->writeUint32(v);
+            ba->writeInt64(v);
+            ba->writeInt32(v);
+            ba->writeFuint16(v);
+            ba->writeFloat(v * 0.5f);
+            ba->writeFuint64(v);
+        }
+        ba->setPosition(0);
+        for(auto v : values) {
+            TAO_ASSERT(ba->readUint64() == v);
+            TAO_ASSERT(ba->readUint32() == (uint32_t)v);
+            TAO_ASSERT(ba->readInt64() == (int64_t)v);
+            TAO_ASSERT(ba->readInt32() == (int32_t)v);
+            TAO_ASSERT(ba->readFuint16() == (uint16_t)v);
+            TAO_ASSERT(ba->readFloat() == v * 0.5f);
+            TAO_ASSERT(ba->readFuint64() == v);
+        }
+        TAO_ASSERT(ba->getReadableSize() == 0);
+    }
+    //a truncated varint is still an error
+    tao::ByteArray::ptr ba = std::make_shared<tao::ByteArray>();
+    ba->writeFuint8(0x80);
+    ba->setPosition(0);
+    bool thrown = false;
+    try {
+        ba->readUint64();
+    } catch(std::out_of_range&) {
+        thrown = true;
+    }
+    TAO_ASSERT(thrown);
+}
+
+//a file streamed out in batches and mapped back
+void test_map() {
+    const std::string name = "/tmp/test_bytearray_map.dat";
+    const int batches = 8;
+    const int n = 100000;
+    tao::ByteArray::ptr ba = std::make_shared<tao::ByteArray>(4096);
+    for(int b = 0; b < batches; ++b) {
+        for(int i = 0; i < n; ++i) {
+            ba->writeUint64((uint64_t)b * n + i);
+        }
+        ba->setPosition(0);
+        TAO_ASSERT(ba->writeToFile(name, b > 0));
+        ba->clear();
+    }
+
+    uint64_t start = tao::GetCurrentUS();
+    tao::ByteArray::ptr copy = std::make_shared<tao::ByteArray>(4096);
+    TAO_ASSERT(copy->readFromFile(name));
+    uint64_t read_us = tao::GetCurrentUS() - start;
+
+    start = tao::GetCurrentUS();
+    tao::ByteArray::ptr mapped = std::make_shared<tao::ByteArray>(4096);
+    TAO_ASSERT(mapped->mapFile(name));
+    uint64_t map_us = tao::GetCurrentUS() - start;
+    TAO_ASSERT(mapped->isMapped());
+    TAO_ASSERT(mapped->getSize() == copy->getSize());
+    TAO_LOG_INFO(g_logger) << "open " << mapped->getSize() << " bytes: readFromFile="
+        << read_us << "us mapFile=" << map_us << "us";
+
+    for(uint64_t i = 0; i < (uint64_t)batches * n; ++i) {
+        TAO_ASSERT(mapped->readUint64() == i);
+    }
+    TAO_ASSERT(mapped->getReadableSize() == 0);
+
+    //the buffers point into the mapping
+    mapped->setPosition(0);
+    std::vector<iovec> iovs;
+    mapped->getReadableBuffers(iovs);
+    TAO_ASSERT(iovs.size() == 1 && iovs[0].iov_len == mapped->getSize());
+
+    //patches stay private, growing throws
+    mapped->writeFuint8(0xff);
+    mapped->setPosition(mapped->getSize());
+    bool thrown = false;
+    try {
+        mapped->writeFuint32(1);
+    } catch(std::logic_error&) {
+        thrown = true;
+    }
+    TAO_ASSERT(thrown);
+    tao::ByteArray check;
+    TAO_ASSERT(check.mapFile(name));
+    TAO_ASSERT(check.readFuint8() == 0);
+
+    //clear drops the mapping and the array is writable again
+    mapped->clear();
+    TAO_ASSERT(!mapped->isMapped() && mapped->getBaseSize() == 4096);
+    mapped->writeStringVint("again");
+    mapped->setPosition(0);
+    TAO_ASSERT(mapped->readStringVint() == "again");
+    unlink(name.c_str());
+}
+
+class TestRequest : public tao::Request {
+public:
+    std::string toString() const override { return "";}
+};
+
+//reset keeps the nodes, released nodes are reused by the next array
+void test_pool() {
+    tao::ByteArray::ptr ba = std::make_shared<tao::ByteArray>(64);
+    for(int i = 0; i < 100; ++i) {
+        ba->writeFuint64(i);
+    }
+    ba->reset();
+    TAO_ASSERT(ba->getSize() == 0 && ba->getPosition() == 0);
+    for(int i = 0; i < 100; ++i) {
+        ba->writeUint32(i * 7);
+    }
+    ba->setPosition(0);
+    for(int i = 0; i < 100; ++i) {
+        TAO_ASSERT(ba->readUint32() == (uint32_t)i * 7);
+    }
+    ba->reset(256);
+    ba->writeStringF32(std::string(1000, 'x'));
+    ba->setPosition(0);
+    TAO_ASSERT(ba->readStringF32() == std::string(1000, 'x'));
+
+    uint64_t before = tao::ByteArray::GetPooledBytes();
+    ba.reset();
+    TAO_ASSERT(tao::ByteArray::GetPooledBytes() > before);
+    ba = std::make_shared<tao::ByteArray>(64);
+    ba->write("abc", 3);
+    TAO_ASSERT(tao::ByteArray::GetPooledBytes() < before + 1024 + 64);
+
+    TestRequest req;
+    req.setSn(1);
+    req.setCmd(2);
+    tao::ByteArray::ptr out = req.toByteArray();
+    tao::ByteArray* raw = out.get();
+    out.reset();
+    out = req.toByteArray();
+    TAO_ASSERT(out.get() == raw);
+    //held by the caller, the next call gets its own array
+    tao::ByteArray::ptr other = req.toByteArray();
+    TAO_ASSERT(other.get() != raw);
+    out->setPosition(0);
+    TAO_ASSERT(out->readFuint8() == tao::Message::REQUEST);
+    TAO_ASSERT(out->readUint32() == 1 && out->readUint32() == 2);
+}
+
+//messages serialized per second, with and without the node pool
+static uint64_t bench_messages(int n) {
+    TestRequest req;
+    uint64_t start = tao::GetCurrentUS();
+    for(int i = 0; i < n; ++i) {
+        req.setSn(i);
+        tao::ByteArray::ptr ba = std::make_shared<tao::ByteArray>(4096);
+        req.serializeToByteArray(ba);
+        ba->writeStringVint("payload of a small rpc message");
+        ba->setPosition(0);
+        TAO_ASSERT(ba->getReadableSize() > 0);
+    }
+    uint64_t used = tao::GetCurrentUS() - start;
+    return (uint64_t)n * 1000000 / (used ? used : 1);
+}
+
+void bench_pool() {
+    auto max_bytes = tao::Config::Lookup<uint64_t>("bytearray.pool.max_bytes");
+    uint64_t old = max_bytes->getValue();
+    const int n = 1000000;
+    max_bytes->setValue(0);
+    uint64_t plain = bench_messages(n);
+    max_bytes->setValue(old);
+    uint64_t pooled = bench_messages(n);
+    TAO_LOG_INFO(g_logger) << "new ByteArray per message: plain=" << plain << "/s pooled="
+        << pooled << "/s speedup=" << (double)pooled / (plain ? plain : 1);
+}
+
 int main(int argc, char** argv) {
     test();
+    test_pool();
+    test_codec_boundaries();
+    test_map();
+    bench_pool();
     return 0;
 }
\ No newline at end of file
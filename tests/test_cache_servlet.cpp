@@ -0,0 +1,91 @@
+#include "../src/http/servlets/cache_servlet.h"
+#include "../src/http/servlets/status_servlet.h"
+#include "../src/iomanager.h"
+#include "../src/macro.h"
+#include "../src/log.h"
+#include <atomic>
+
+static tao::Logger::ptr g_logger = TAO_LOG_ROOT();
+
+static std::atomic<int> s_calls = {0};
+
+tao::http::HttpResponse::ptr get(tao::http::CacheServlet::ptr cache
+                    , const std::string& path
+                    , const std::string& lang = "") {
+    tao::http::HttpRequest::ptr req = std::make_shared<tao::http::HttpRequest>();
+    req->setPath(path);
+    if(!lang.empty()) {
+        req->setHeader("Accept-Language", lang);
+    }
+    tao::http::HttpResponse::ptr rsp = req->createResponse();
+    cache->handle(req, rsp, nullptr);
+    return rsp;
+}
+
+void run() {
+    auto slow = std::make_shared<tao::http::FunctionServlet>([](tao::http::HttpRequest::ptr req
+                ,tao::http::HttpResponse::ptr rsp
+                ,tao::http::HttpSession::ptr session) {
+        ++s_calls;
+        //keep the request in flight so concurrent misses coalesce
+        usleep(100 * 1000);
+        if(req->getPath() == "/private") {
+            rsp->setHeader("Cache-Control", "private");
+        } else if(req->getPath() == "/vary") {
+            rsp->setHeader("Vary", "Accept-Language");
+        }
+        rsp->setBody(req->getPath() + ":" + req->getHeader("Accept-Language"));
+        return 0;
+    });
+    auto cache = std::make_shared<tao::http::CacheServlet>(slow, 500);
+    auto stats = cache->getStats();
+
+    //concurrent misses run the servlet once
+    std::atomic<int> done = {0};
+    for(int i = 0; i < 10; ++i) {
+        tao::IOManager::GetThis()->schedule([cache, &done]() {
+            auto rsp = get(cache, "/a");
+            TAO_ASSERT(rsp->getBody() == "/a:");
+            ++done;
+        });
+    }
+    while(done != 10) {
+        usleep(10 * 1000);
+    }
+    TAO_ASSERT(s_calls == 1);
+    TAO_LOG_INFO(g_logger) << "coalesced=" << stats->coalesced;
+
+    //hit
+    auto rsp = get(cache, "/a");
+    TAO_ASSERT(s_calls == 1);
+    TAO_ASSERT(!rsp->getHeader("Age").empty());
+
+    //expired after ttl
+    usleep(600 * 1000);
+    get(cache, "/a");
+    TAO_ASSERT(s_calls == 2);
+
+    //not stored
+    get(cache, "/private");
+    get(cache, "/private");
+    TAO_ASSERT(s_calls == 4);
+
+    //keyed by Vary headers
+    get(cache, "/vary", "en");
+    get(cache, "/vary", "en");
+    TAO_ASSERT(s_calls == 5);
+    rsp = get(cache, "/vary", "fr");
+    TAO_ASSERT(s_calls == 6);
+    TAO_ASSERT(rsp->getBody() == "/vary:fr");
+
+    tao::http::HttpRequest::ptr req = std::make_shared<tao::http::HttpRequest>();
+    rsp = req->createResponse();
+    tao::http::StatusServlet().handle(req, rsp, nullptr);
+    TAO_LOG_INFO(g_logger) << rsp->getBody();
+}
+
+int main(int argc, char** argv) {
+    tao::IOManager iom(2);
+    iom.schedule(run);
+    return 0;
+}
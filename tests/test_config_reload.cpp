@@ -0,0 +1,118 @@
+#include "../src/config.h"
+#include "../src/iomanager.h"
+#include "../src/log.h"
+#include "../src/macro.h"
+#include <atomic>
+#include <fstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static tao::Logger::ptr g_logger = TAO_LOG_ROOT();
+
+static tao::ConfigVar<int>::ptr g_port =
+    tao::Config::Lookup("reload.port", (int)80, "reload port");
+static tao::ConfigVar<std::string>::ptr g_name =
+    tao::Config::Lookup("reload.name", std::string("default"), "reload name");
+static tao::ConfigVar<std::vector<int> >::ptr g_workers =
+    tao::Config::Lookup("reload.workers", std::vector<int>(), "reload workers");
+
+static std::atomic<int> s_port_changes(0);
+static std::atomic<int> s_name_changes(0);
+static std::atomic<int> s_workers_changes(0);
+
+static void write_conf(const std::string& file, int port, const std::string& workers) {
+    std::ofstream ofs(file);
+    ofs << "reload:\n"
+        << "  port: " << port << "\n"
+        << "  name: tao\n"
+        << "  workers: " << workers << "\n";
+}
+
+//waits for the watcher to load the file
+static void wait_reloads(uint64_t reloads) {
+    for(int i = 0; i < 300 && tao::Config::GetReloadStatus().reloads < reloads; ++i) {
+        usleep(10 * 1000);
+    }
+    TAO_ASSERT(tao::Config::GetReloadStatus().reloads == reloads);
+}
+
+int main(int argc, char** argv) {
+    //listeners run outside the loader's lock, they may read the config state
+    g_port->addListener([](const int& ov, const int& nv) {
+        tao::Config::GetReloadStatus();
+        ++s_port_changes;
+    });
+    g_name->addListener([](const std::string& ov, const std::string& nv) { ++s_name_changes; });
+    g_workers->addListener([](const std::vector<int>& ov, const std::vector<int>& nv) {
+        ++s_workers_changes;
+    });
+
+    char tmpl[] = "/tmp/tao_conf_XXXXXX";
+    std::string dir = mkdtemp(tmpl);
+    std::string file = dir + "/server.yml";
+    write_conf(file, 8080, "[1, 2]");
+    tao::Config::LoadFromConfDir(dir);
+    TAO_ASSERT(g_port->getValue() == 8080 && g_name->getValue() == "tao");
+    TAO_ASSERT(g_workers->getValue().size() == 2);
+    TAO_ASSERT(tao::Config::GetReloadStatus().reloads == 0);
+    s_port_changes = s_name_changes = s_workers_changes = 0;
+
+    {
+        tao::IOManager iom(1, false, "reload");
+        TAO_ASSERT(tao::Config::WatchConfDir(dir, &iom));
+        usleep(100 * 1000);
+
+        //saved by rename, only the changed key is applied
+        write_conf(dir + "/server.yml.tmp", 9090, "[1, 2]");
+        TAO_ASSERT(rename((dir + "/server.yml.tmp").c_str(), file.c_str()) == 0);
+        wait_reloads(1);
+        TAO_ASSERT(g_port->getValue() == 9090);
+        TAO_ASSERT(s_port_changes == 1 && s_name_changes == 0 && s_workers_changes == 0);
+
+        //written in place
+        write_conf(file, 9090, "[1, 2, 3]");
+        wait_reloads(2);
+        TAO_ASSERT(g_workers->getValue().size() == 3);
+        TAO_ASSERT(s_port_changes == 1 && s_name_changes == 0 && s_workers_changes == 1);
+
+        //the same content changes nothing
+        write_conf(file, 9090, "[1, 2, 3]");
+        wait_reloads(3);
+        TAO_ASSERT(s_port_changes == 1 && s_name_changes == 0 && s_workers_changes == 1);
+
+        //a value that fails to apply is not recorded, the next load tries it again
+        std::ofstream(file) << "reload:\n  port: abc\n  name: tao\n  workers: [1, 2, 3]\n";
+        wait_reloads(4);
+        TAO_ASSERT(g_port->getValue() == 9090 && s_port_changes == 1);
+        TAO_ASSERT(tao::Config::GetReloadStatus().key_changes["reload.port"] == 1);
+
+        tao::Config::ReloadStatus status = tao::Config::GetReloadStatus();
+        TAO_ASSERT(status.key_changes["reload.port"] == 1);
+        TAO_ASSERT(status.key_changes["reload.workers"] == 1);
+        TAO_ASSERT(status.key_changes.count("reload.name") == 0);
+        //the parent map is not a ConfigVar
+        TAO_ASSERT(status.key_changes.count("reload") == 0);
+        TAO_ASSERT(status.max_us >= status.last_us && status.total_us >= status.max_us);
+        TAO_LOG_INFO(g_logger) << "reloads=" << status.reloads
+            << " last_us=" << status.last_us << " max_us=" << status.max_us;
+
+        tao::Config::StopWatchConfDir();
+    }
+
+    //not watched anymore
+    write_conf(file, 7070, "[1]");
+    usleep(100 * 1000);
+    TAO_ASSERT(g_port->getValue() == 9090);
+
+    //a forced load applies every key again, values already set don't call listeners
+    tao::Config::LoadFromConfDir(dir, true);
+    TAO_ASSERT(g_port->getValue() == 7070 && s_port_changes == 2);
+    TAO_ASSERT(s_name_changes == 0);
+    TAO_ASSERT(tao::Config::GetReloadStatus().reloads == 4);
+
+    unlink(file.c_str());
+    rmdir(dir.c_str());
+    TAO_LOG_INFO(g_logger) << "test_config_reload ok";
+    return 0;
+}
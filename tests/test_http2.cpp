@@ -0,0 +1,178 @@
+#include "../src/http2/http2_server.h"
+#include "../src/http2/http2_connection.h"
+#include "../src/http2/huffman.h"
+#include "../src/iomanager.h"
+#include "../src/macro.h"
+#include "../src/log.h"
+
+static tao::Logger::ptr g_logger = TAO_LOG_ROOT();
+
+using namespace tao::http2;
+
+static std::string FromHex(const std::string& hex) {
+    std::string rt;
+    for(size_t i = 0; i + 1 < hex.size(); i += 2) {
+        rt.push_back((char)strtol(hex.substr(i, 2).c_str(), nullptr, 16));
+    }
+    return rt;
+}
+
+void test_huffman() {
+    //rfc7541 C.4.1
+    std::string out;
+    Huffman::Encode("www.example.com", out);
+    TAO_ASSERT(out == FromHex("f1e3c2e5f23a6ba0ab90f4ff"));
+    TAO_ASSERT(Huffman::EncodedLength("www.example.com") == out.size());
+    std::string str;
+    TAO_ASSERT(Huffman::Decode(out.c_str(), out.size(), str));
+    TAO_ASSERT(str == "www.example.com");
+    //padding longer than 7 bits is invalid
+    out.push_back((char)0xff);
+    TAO_ASSERT(!Huffman::Decode(out.c_str(), out.size(), str));
+}
+
+void test_hpack() {
+    //rfc7541 C.1.2
+    std::string out;
+    HPackEncodeInteger(out, 5, 0, 1337);
+    TAO_ASSERT(out == FromHex("1f9a0a"));
+    uint64_t v = 0;
+    TAO_ASSERT(HPackDecodeInteger(out.c_str(), out.size(), 5, v) == 3 && v == 1337);
+
+    //rfc7541 C.4, three requests sharing the dynamic table
+    HPackDecoder decoder;
+    HeaderList headers;
+    TAO_ASSERT(decoder.decode(FromHex("828684418cf1e3c2e5f23a6ba0ab90f4ff"), headers) == 0);
+    TAO_ASSERT(headers.size() == 4);
+    TAO_ASSERT(headers[3].first == ":authority" && headers[3].second == "www.example.com");
+    headers.clear();
+    TAO_ASSERT(decoder.decode(FromHex("828684be5886a8eb10649cbf"), headers) == 0);
+    TAO_ASSERT(headers.size() == 5);
+    TAO_ASSERT(headers[3].second == "www.example.com");
+    TAO_ASSERT(headers[4].first == "cache-control" && headers[4].second == "no-cache");
+    headers.clear();
+    TAO_ASSERT(decoder.decode(FromHex("828785bf408825a849e95ba97d7f8925a849e95bb8e8b4bf"), headers) == 0);
+    TAO_ASSERT(headers.size() == 5);
+    TAO_ASSERT(headers[4].first == "custom-key" && headers[4].second == "custom-value");
+    //index out of range
+    TAO_ASSERT(decoder.decode(FromHex("ff00"), headers) != 0);
+
+    //rfc7541 C.6, three responses with a 256 byte table, entries are evicted
+    HPackDecoder small(256);
+    headers.clear();
+    TAO_ASSERT(small.decode(FromHex("488264025885aec3771a4b6196d07abe941054d444a8200595040b8166e082a62d1bff"
+                    "6e919d29ad171863c78f0b97c8e9ae82ae43d3"), headers) == 0);
+    TAO_ASSERT(headers == HeaderList({{":status", "302"}, {"cache-control", "private"}
+                    ,{"date", "Mon, 21 Oct 2013 20:13:21 GMT"}, {"location", "https://www.example.com"}}));
+    TAO_ASSERT(small.getTable().getSize() == 222);
+    headers.clear();
+    TAO_ASSERT(small.decode(FromHex("4883640effc1c0bf"), headers) == 0);
+    TAO_ASSERT(headers[0].second == "307" && headers[3].second == "https://www.example.com");
+    TAO_ASSERT(small.getTable().getSize() == 222);
+    headers.clear();
+    TAO_ASSERT(small.decode(FromHex("88c16196d07abe941054d444a8200595040b8166e084a62d1bffc05a839bd9ab77ad94e7"
+                    "821dd7f2e6c7b335dfdfcd5b3960d5af27087f3672c1ab270fb5291f9587316065c003ed4ee5b1063d5007")
+                    , headers) == 0);
+    TAO_ASSERT(headers == HeaderList({{":status", "200"}, {"cache-control", "private"}
+                    ,{"date", "Mon, 21 Oct 2013 20:13:22 GMT"}, {"location", "https://www.example.com"}
+                    ,{"content-encoding", "gzip"}
+                    ,{"set-cookie", "foo=ASDJKHQKBZXOQWEOPIUAXQWEOIU; max-age=3600; version=1"}}));
+    TAO_ASSERT(small.getTable().getSize() == 215 && small.getTable().getCount() == 3);
+
+    HPackEncoder encoder;
+    HPackDecoder decoder2;
+    HeaderList in = {{":method", "GET"}, {":path", "/index.html"}
+                    ,{"user-agent", "tao"}, {"authorization", "secret"}};
+    for(int i = 0; i < 3; ++i) {
+        std::string block;
+        encoder.encode(in, block);
+        HeaderList rt;
+        TAO_ASSERT(decoder2.decode(block, rt) == 0);
+        TAO_ASSERT(rt == in);
+        TAO_LOG_INFO(g_logger) << "hpack round " << i << " block size=" << block.size();
+    }
+    encoder.setMaxTableSize(0);
+    std::string block;
+    encoder.encode(in, block);
+    HeaderList rt;
+    TAO_ASSERT(decoder2.decode(block, rt) == 0);
+    TAO_ASSERT(rt == in);
+}
+
+void test_server() {
+    auto addr = tao::Address::LookupAny("127.0.0.1:8093");
+    Http2Server::ptr server = std::make_shared<Http2Server>(true);
+    auto dispatch = server->getServletDispatch();
+    dispatch->addServlet("/echo", [](tao::http::HttpRequest::ptr req
+                , tao::http::HttpResponse::ptr rsp
+                , tao::http::HttpSession::ptr session) {
+        rsp->setHeader("Content-Type", "text/plain");
+        rsp->setBody(req->getQuery() + ":" + req->getBody());
+        return 0;
+    });
+    dispatch->addServlet("/big", [](tao::http::HttpRequest::ptr req
+                , tao::http::HttpResponse::ptr rsp
+                , tao::http::HttpSession::ptr session) {
+        //larger than the default 64k window
+        rsp->setHeader("Content-Type", "image/png");
+        rsp->setBody(std::string(300 * 1024, 'x'));
+        return 0;
+    });
+    TAO_ASSERT(server->bind(addr));
+    server->start();
+
+    Http2Connection::ptr conn = Http2Connection::Connect("http://127.0.0.1:8093/", 1000);
+    TAO_ASSERT(conn);
+
+    auto r = conn->doGet("/echo?a=1", 1000);
+    TAO_ASSERT(r->result == 0);
+    TAO_ASSERT(r->response->getStatus() == tao::http::HttpStatus::OK);
+    TAO_ASSERT(r->response->getBody() == "a=1:");
+
+    r = conn->doPost("/echo?b=2", 1000, {}, std::string(100000, 'p'));
+    TAO_ASSERT(r->result == 0);
+    TAO_ASSERT(r->response->getBody() == "b=2:" + std::string(100000, 'p'));
+
+    r = conn->doGet("/big", 1000);
+    TAO_ASSERT(r->result == 0);
+    TAO_ASSERT(r->response->getBody().size() == 300 * 1024);
+
+    r = conn->doGet("/not_found", 1000);
+    TAO_ASSERT(r->result == 0);
+    TAO_ASSERT(r->response->getStatus() == tao::http::HttpStatus::NOT_FOUND);
+
+    //many streams on one connection
+    const int n = 50;
+    auto ok = std::make_shared<int>(0);
+    auto done = std::make_shared<int>(0);
+    for(int i = 0; i < n; ++i) {
+        tao::IOManager::GetThis()->schedule([conn, i, ok, done]() {
+            auto r = conn->doGet("/echo?i=" + std::to_string(i), 3000);
+            if(r->result == 0 && r->response->getBody() == "i=" + std::to_string(i) + ":") {
+                ++*ok;
+            }
+            ++*done;
+        });
+    }
+    while(*done < n) {
+        usleep(10 * 1000);
+    }
+    TAO_ASSERT(*ok == n);
+    TAO_LOG_INFO(g_logger) << "streams=" << conn->getStreamCount()
+        << " peer " << conn->getPeerSettings().toString();
+
+    conn->close();
+    usleep(50 * 1000);
+    r = conn->doGet("/echo", 1000);
+    TAO_ASSERT(r->result != 0);
+    server->stop();
+    TAO_LOG_INFO(g_logger) << "test_http2 ok";
+}
+
+int main(int argc, char** argv) {
+    test_huffman();
+    test_hpack();
+    tao::IOManager iom(2);
+    iom.schedule(test_server);
+    return 0;
+}
@@ -0,0 +1,82 @@
+#include "../src/http/http_compress.h"
+#include "../src/macro.h"
+#include "../src/log.h"
+
+static tao::Logger::ptr g_logger = TAO_LOG_ROOT();
+
+using tao::http::HttpCompress;
+
+void test_negotiate() {
+    TAO_ASSERT(HttpCompress::Negotiate("") == HttpCompress::Encoding::IDENTITY);
+    TAO_ASSERT(HttpCompress::Negotiate("gzip, deflate, br") == HttpCompress::Encoding::GZIP);
+    TAO_ASSERT(HttpCompress::Negotiate("gzip;q=0.5, deflate") == HttpCompress::Encoding::DEFLATE);
+    TAO_ASSERT(HttpCompress::Negotiate("gzip;q=0, deflate;q=0") == HttpCompress::Encoding::IDENTITY);
+    TAO_ASSERT(HttpCompress::Negotiate("*") == HttpCompress::Encoding::GZIP);
+    TAO_ASSERT(HttpCompress::Negotiate("*;q=0.3, gzip;q=0") == HttpCompress::Encoding::DEFLATE);
+}
+
+void test_roundtrip() {
+    std::string data;
+    for(int i = 0; i < 10000; ++i) {
+        data += "{\"id\":" + std::to_string(i) + ",\"name\":\"tao\"},";
+    }
+    for(auto e : {HttpCompress::Encoding::GZIP, HttpCompress::Encoding::DEFLATE}) {
+        //second round reuses the thread local stream
+        for(int i = 0; i < 2; ++i) {
+            std::string z;
+            TAO_ASSERT(HttpCompress::Compress(e, data, z));
+            std::string out;
+            TAO_ASSERT(HttpCompress::Decompress(e, z, out, data.size()) == 0);
+            TAO_ASSERT(out == data);
+            TAO_ASSERT(HttpCompress::Decompress(e, z, out, data.size() - 1) == -2);
+            TAO_ASSERT(HttpCompress::Decompress(e, z.substr(0, z.size() / 2), out, ~0ull) == -1);
+            TAO_LOG_INFO(g_logger) << HttpCompress::EncodingToString(e)
+                << " " << data.size() << " -> " << z.size();
+        }
+    }
+}
+
+void test_response() {
+    auto req = std::make_shared<tao::http::HttpRequest>();
+    req->setHeader("Accept-Encoding", "gzip");
+    auto rsp = req->createResponse();
+    rsp->setHeader("Content-Type", "application/json");
+    rsp->setBody(std::string(4096, 'a'));
+    TAO_ASSERT(HttpCompress::CompressResponse(req, rsp));
+    TAO_ASSERT(rsp->getHeader("Content-Encoding") == "gzip");
+    TAO_ASSERT(rsp->getHeader("Vary") == "Accept-Encoding");
+
+    //too small
+    rsp = req->createResponse();
+    rsp->setBody("small");
+    TAO_ASSERT(!HttpCompress::CompressResponse(req, rsp));
+
+    //already compressed media
+    rsp = req->createResponse();
+    rsp->setHeader("Content-Type", "image/png");
+    rsp->setBody(std::string(4096, 'a'));
+    TAO_ASSERT(!HttpCompress::CompressResponse(req, rsp));
+
+    //gzip request body
+    std::string z;
+    HttpCompress::Compress(HttpCompress::Encoding::GZIP, "hello tao", z);
+    req = std::make_shared<tao::http::HttpRequest>();
+    req->setHeader("Content-Encoding", "gzip");
+    req->setBody(z);
+    rsp = req->createResponse();
+    TAO_ASSERT(HttpCompress::DecompressRequest(req, rsp));
+    TAO_ASSERT(req->getBody() == "hello tao");
+    TAO_ASSERT(req->getHeader("Content-Encoding").empty());
+
+    req->setHeader("Content-Encoding", "br");
+    TAO_ASSERT(!HttpCompress::DecompressRequest(req, rsp));
+    TAO_ASSERT(rsp->getStatus() == tao::http::HttpStatus::UNSUPPORTED_MEDIA_TYPE);
+}
+
+int main(int argc, char** argv) {
+    test_negotiate();
+    test_roundtrip();
+    test_response();
+    TAO_LOG_INFO(g_logger) << "test_http_compress ok";
+    return 0;
+}
@@ -0,0 +1,152 @@
+#include "../src/http/http_fanout.h"
+#include "../src/http/http_server.h"
+#include "../src/iomanager.h"
+#include "../src/macro.h"
+#include "../src/log.h"
+#include "../src/config.h"
+
+static tao::Logger::ptr g_logger = TAO_LOG_ROOT();
+
+using tao::http::HttpFanout;
+using tao::http::HttpResult;
+
+void test_future() {
+    tao::Promise<int> promise;
+    auto future = promise.getFuture();
+    TAO_ASSERT(!future.isReady());
+    tao::IOManager::GetThis()->schedule([promise]() {
+        usleep(10 * 1000);
+        promise.setValue(1);
+    });
+    TAO_ASSERT(future.get() == 1);
+    TAO_ASSERT(!promise.setValue(2) && future.get() == 1);
+
+    std::vector<tao::Future<int> > futures;
+    std::vector<tao::Promise<int> > promises(3);
+    for(auto& i : promises) {
+        futures.push_back(i.getFuture());
+    }
+    auto any = tao::WhenAny(futures);
+    auto all = tao::WhenAll(futures);
+    promises[2].setValue(2);
+    TAO_ASSERT(any.get() == 2 && !all.isReady());
+    promises[0].setValue(0);
+    promises[1].setValue(1);
+    TAO_ASSERT(all.get() == std::vector<int>({0, 1, 2}));
+}
+
+void test_fanout() {
+    const int n = 30;
+    uint64_t start = tao::GetCurrentMS();
+    HttpFanout fanout(3000);
+    for(int i = 0; i < n; ++i) {
+        fanout.doGet("http://127.0.0.1:8097/echo?i=" + std::to_string(i));
+    }
+    auto rts = fanout.whenAll().get();
+    TAO_ASSERT(rts.size() == n);
+    for(int i = 0; i < n; ++i) {
+        TAO_ASSERT(rts[i]->result == 0);
+        TAO_ASSERT(rts[i]->response->getBody() == "i=" + std::to_string(i));
+    }
+    //each request sleeps 50ms, run concurrently they finish far below n * 50ms
+    uint64_t used = tao::GetCurrentMS() - start;
+    TAO_LOG_INFO(g_logger) << n << " requests used " << used << "ms";
+    TAO_ASSERT(used < 1000);
+    TAO_ASSERT(fanout.getOutstanding() == 0);
+}
+
+void test_deadline() {
+    uint64_t start = tao::GetCurrentMS();
+    HttpFanout fanout(300);
+    auto slow1 = fanout.doGet("http://127.0.0.1:8097/slow");
+    auto fast = fanout.doGet("http://127.0.0.1:8097/echo?a=1");
+    auto slow2 = fanout.doGet("http://127.0.0.1:8097/slow");
+    TAO_ASSERT(fanout.whenAny().get() == 1);
+    TAO_ASSERT(fast.get()->response->getBody() == "a=1");
+
+    auto rts = fanout.whenAll().get();
+    uint64_t used = tao::GetCurrentMS() - start;
+    TAO_LOG_INFO(g_logger) << "deadline used " << used << "ms " << rts[0]->toString();
+    TAO_ASSERT(used >= 290 && used < 800);
+    TAO_ASSERT(rts[0]->result == (int)HttpResult::Error::TIMEOUT);
+    TAO_ASSERT(rts[2]->result == (int)HttpResult::Error::TIMEOUT);
+    TAO_ASSERT(rts[1]->result == 0);
+
+    //requests after the deadline fail at once
+    auto late = fanout.doGet("http://127.0.0.1:8097/echo");
+    TAO_ASSERT(late.isReady() && late.get()->result == (int)HttpResult::Error::TIMEOUT);
+    //cancelled connections are never reused
+    usleep(50 * 1000);
+    auto stats = tao::http::HttpConnectionPoolMgr::GetInstance()->get("127.0.0.1", 8097)->getStats();
+    TAO_LOG_INFO(g_logger) << stats.toString();
+    auto rt = tao::http::HttpConnection::DoGet("http://127.0.0.1:8097/echo?b=2", 1000);
+    TAO_ASSERT(rt->result == 0 && rt->response->getBody() == "b=2");
+}
+
+void test_pool_deadline() {
+    //a pool of one connection, the second request waits for the first
+    auto max_size = tao::Config::Lookup<uint32_t>("http.pool.max_size");
+    uint32_t old_size = max_size->getValue();
+    max_size->setValue(1);
+    uint64_t start = tao::GetCurrentMS();
+    HttpFanout fanout(200);
+    fanout.doGet("http://localhost:8097/slow");
+    fanout.doGet("http://localhost:8097/slow");
+    fanout.whenAll().get();
+    max_size->setValue(old_size);
+
+    //the pool wait ends with the deadline, not after the pool's wait timeout
+    usleep(100 * 1000);
+    auto stats = tao::http::HttpConnectionPoolMgr::GetInstance()->get("localhost", 8097)->getStats();
+    TAO_LOG_INFO(g_logger) << "pool deadline used " << tao::GetCurrentMS() - start
+        << "ms " << stats.toString();
+    TAO_ASSERT(stats.wait_timeouts == 1);
+}
+
+void test_cancel() {
+    auto fanout = std::make_shared<HttpFanout>(3000);
+    auto f = fanout->doGet("http://127.0.0.1:8097/slow");
+    auto bad = fanout->doGet("not a url");
+    TAO_ASSERT(bad.get()->result == (int)HttpResult::Error::INVALID_URL);
+    usleep(50 * 1000);
+    fanout->cancel();
+    TAO_ASSERT(f.get()->result == (int)HttpResult::Error::CANCELLED);
+    TAO_ASSERT(fanout->getOutstanding() == 0);
+}
+
+void run() {
+    auto server = std::make_shared<tao::http::HttpServer>(true);
+    server->getServletDispatch()->addServlet("/echo", [](tao::http::HttpRequest::ptr req
+                , tao::http::HttpResponse::ptr rsp
+                , tao::http::HttpSession::ptr session) {
+        usleep(50 * 1000);
+        rsp->setBody(req->getQuery());
+        return 0;
+    });
+    server->getServletDispatch()->addServlet("/slow", [](tao::http::HttpRequest::ptr req
+                , tao::http::HttpResponse::ptr rsp
+                , tao::http::HttpSession::ptr session) {
+        usleep(1000 * 1000);
+        rsp->setBody("slow");
+        return 0;
+    });
+    TAO_ASSERT(server->bind(tao::Address::LookupAny("127.0.0.1:8097")));
+    server->start();
+    //short idle time so the pool timer ends and iom can stop
+    tao::Config::Lookup<uint32_t>("http.pool.max_idle_time")->setValue(200);
+
+    test_future();
+    test_fanout();
+    test_deadline();
+    test_pool_deadline();
+    test_cancel();
+
+    server->stop();
+    TAO_LOG_INFO(g_logger) << "test_http_fanout ok";
+}
+
+int main(int argc, char** argv) {
+    tao::IOManager iom(2);
+    iom.schedule(run);
+    return 0;
+}
@@ -0,0 +1,296 @@
+#include "../src/http/http_connection.h"
+#include "../src/http/http_server.h"
+#include "../src/http/http_session.h"
+#include "../src/iomanager.h"
+#include "../src/macro.h"
+#include "../src/log.h"
+#include "../src/config.h"
+#include <set>
+
+static tao::Logger::ptr g_logger = TAO_LOG_ROOT();
+
+using tao::http::HttpConnectionPool;
+
+static void wait_all(std::shared_ptr<int> done, int n) {
+    while(*done < n) {
+        usleep(10 * 1000);
+    }
+}
+
+void test_limit(HttpConnectionPool::ptr pool) {
+    const int n = 20;
+    auto ok = std::make_shared<int>(0);
+    auto done = std::make_shared<int>(0);
+    for(int i = 0; i < n; ++i) {
+        tao::IOManager::GetThis()->schedule([pool, ok, done]() {
+            auto r = pool->doGet("/slow", 1000);
+            if(r->result == 0 && r->response->getBody() == "ok") {
+                ++*ok;
+            }
+            ++*done;
+        });
+    }
+    wait_all(done, n);
+    auto stats = pool->getStats();
+    TAO_LOG_INFO(g_logger) << stats.toString();
+    TAO_ASSERT(*ok == n);
+    TAO_ASSERT(stats.creates <= 4);
+    TAO_ASSERT(stats.waits > 0);
+    TAO_ASSERT(stats.reuses + stats.creates == stats.gets);
+}
+
+void test_wait_timeout() {
+    auto pool = std::make_shared<HttpConnectionPool>("127.0.0.1", "", 8095
+                    , 1, 30 * 1000, 100, 30 * 1000, 1, 10);
+    auto results = std::make_shared<std::vector<int> >();
+    auto done = std::make_shared<int>(0);
+    for(int i = 0; i < 2; ++i) {
+        tao::IOManager::GetThis()->schedule([pool, results, done]() {
+            results->push_back(pool->doGet("/slow", 1000)->result);
+            ++*done;
+        });
+    }
+    wait_all(done, 2);
+    std::sort(results->begin(), results->end());
+    TAO_ASSERT((*results)[0] == 0);
+    TAO_ASSERT((*results)[1] == (int)tao::http::HttpResult::Error::POOL_GET_CONNECTION);
+    TAO_ASSERT(pool->getStats().wait_timeouts == 1);
+}
+
+void test_idle_evict() {
+    auto pool = std::make_shared<HttpConnectionPool>("127.0.0.1", "", 8095
+                    , 4, 30 * 1000, 100, 200, 4, 1000);
+    TAO_ASSERT(pool->doGet("/slow", 1000)->result == 0);
+    TAO_ASSERT(pool->getStats().idle == 1);
+    usleep(500 * 1000);
+    auto stats = pool->getStats();
+    TAO_LOG_INFO(g_logger) << stats.toString();
+    TAO_ASSERT(stats.idle == 0 && stats.total == 0 && stats.evicts == 1);
+
+    //the armed evict timer fires after its pool is gone
+    pool = std::make_shared<HttpConnectionPool>("127.0.0.1", "", 8095
+                    , 4, 30 * 1000, 100, 200, 4, 1000);
+    TAO_ASSERT(pool->doGet("/slow", 1000)->result == 0);
+    pool.reset();
+    usleep(300 * 1000);
+}
+
+//replies every request with a chunked body
+class ChunkServer : public tao::TcpServer {
+protected:
+    virtual void handleClient(tao::Socket::ptr client) override {
+        auto session = std::make_shared<tao::http::HttpSession>(client);
+        while(session->recvRequest()) {
+            static const char rsp[] = "HTTP/1.1 200 OK\r\n"
+                "Transfer-Encoding: chunked\r\n\r\n"
+                "5\r\nhello\r\n"
+                "6;ext=1\r\n world\r\n"
+                "0\r\nX-Trailer: 1\r\n\r\n";
+            if(session->writeFixSize(rsp, sizeof(rsp) - 1) <= 0) {
+                break;
+            }
+        }
+        session->close();
+    }
+};
+
+void test_stream() {
+    auto req = std::make_shared<tao::http::HttpRequest>();
+    req->setPath("/big");
+    req->setClose(false);
+    auto r = tao::http::HttpConnection::DoRequestStream(req
+                , tao::Uri::Create("http://127.0.0.1:8095/big"), 1000);
+    TAO_ASSERT(r->result == 0 && r->body);
+    TAO_ASSERT(r->response->getBody().empty());
+    size_t total = 0;
+    char buf[1000];
+    int rt = 0;
+    while((rt = r->body->read(buf, sizeof(buf))) > 0) {
+        TAO_ASSERT(buf[0] == 'b');
+        total += rt;
+    }
+    TAO_ASSERT(rt == 0 && total == 1024 * 1024);
+    TAO_ASSERT(r->body->isFinished());
+
+    auto server = std::make_shared<ChunkServer>();
+    TAO_ASSERT(server->bind(tao::Address::LookupAny("127.0.0.1:8096")));
+    server->start();
+    auto uri = tao::Uri::Create("http://127.0.0.1:8096/");
+    for(int i = 0; i < 2; ++i) {
+        auto req = std::make_shared<tao::http::HttpRequest>();
+        req->setClose(false);
+        r = tao::http::HttpConnection::DoRequestStream(req, uri, 1000);
+        TAO_ASSERT(r->result == 0);
+        std::string body;
+        TAO_ASSERT(r->body->readAll(body));
+        TAO_ASSERT(body == "hello world");
+    }
+    TAO_ASSERT(tao::http::HttpConnectionPoolMgr::GetInstance()
+                ->get("127.0.0.1", 8096)->getStats().reuses == 1);
+
+    //abandoned body closes the connection instead of returning it
+    r = tao::http::HttpConnection::DoRequestStream(req
+                , tao::Uri::Create("http://127.0.0.1:8095/big"), 1000);
+    TAO_ASSERT(r->body->read(buf, sizeof(buf)) > 0);
+    r.reset();
+    TAO_ASSERT(tao::http::HttpConnectionPoolMgr::GetInstance()
+                ->get("127.0.0.1", 8095)->getStats().idle == 0);
+    server->stop();
+}
+
+//drops the connection on the first request of each query, answers it the second time
+class FlakyServer : public tao::TcpServer {
+protected:
+    virtual void handleClient(tao::Socket::ptr client) override {
+        auto session = std::make_shared<tao::http::HttpSession>(client);
+        while(auto req = session->recvRequest()) {
+            tao::Mutex::Lock lock(m_mutex);
+            if(m_seen.insert(req->getQuery()).second) {
+                break;
+            }
+            lock.unlock();
+            static const char rsp[] = "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok";
+            if(session->writeFixSize(rsp, sizeof(rsp) - 1) <= 0) {
+                break;
+            }
+        }
+        session->close();
+    }
+private:
+    tao::Mutex m_mutex;
+    std::set<std::string> m_seen;
+};
+
+void test_retry() {
+    auto server = std::make_shared<FlakyServer>();
+    TAO_ASSERT(server->bind(tao::Address::LookupAny("127.0.0.1:8098")));
+    server->start();
+    auto pool = std::make_shared<HttpConnectionPool>("127.0.0.1", "", 8098
+                    , 4, 30 * 1000, 100, 200, 4, 1000);
+    pool->setMaxRetries(1);
+    //idempotent GET is retried on a new connection
+    auto r = pool->doGet("/?id=1", 1000);
+    TAO_ASSERT(r->result == 0 && r->response->getBody() == "ok");
+    TAO_ASSERT(pool->getStats().retries == 1);
+    //POST is not
+    r = pool->doPost("/?id=2", 1000);
+    TAO_ASSERT(r->result != 0 && pool->getStats().retries == 1);
+    //a POST with an idempotency key is
+    r = pool->doPost("/?id=3", 1000, {{"Idempotency-Key", "3"}});
+    TAO_ASSERT(r->result == 0 && pool->getStats().retries == 2);
+    //no tokens left, no retry
+    pool->setRetryBudget(std::make_shared<tao::http::RetryBudget>(0, 0, 0));
+    r = pool->doGet("/?id=4", 1000);
+    auto stats = pool->getStats();
+    TAO_LOG_INFO(g_logger) << stats.toString();
+    TAO_ASSERT(r->result != 0 && stats.retries == 2 && stats.budget_exhausted == 1);
+    server->stop();
+}
+
+void test_hedge(std::shared_ptr<std::atomic<int> > tail) {
+    auto pool = std::make_shared<HttpConnectionPool>("127.0.0.1", "", 8095
+                    , 4, 30 * 1000, 100, 200, 4, 1000);
+    pool->setHedge(0.95, 50);
+    for(int i = 0; i < 30; ++i) {
+        TAO_ASSERT(pool->doGet("/slow", 1000)->result == 0);
+    }
+    TAO_ASSERT(pool->getStats().hedges == 0);
+    TAO_ASSERT(pool->getLatencyPercentile(0.95) >= 20);
+
+    //first /tail call stalls, the hedge answers
+    *tail = 0;
+    uint64_t start = tao::GetCurrentMS();
+    auto r = pool->doGet("/tail", 3000);
+    uint64_t used = tao::GetCurrentMS() - start;
+    auto stats = pool->getStats();
+    TAO_LOG_INFO(g_logger) << "hedged used " << used << "ms " << stats.toString();
+    TAO_ASSERT(r->result == 0 && r->response->getBody() == "fast");
+    TAO_ASSERT(used < 500);
+    TAO_ASSERT(stats.hedges == 1 && stats.hedge_wins == 1);
+
+    //without budget the request just waits
+    pool->setRetryBudget(std::make_shared<tao::http::RetryBudget>(0, 0, 0));
+    *tail = 0;
+    r = pool->doGet("/tail", 3000);
+    TAO_ASSERT(r->result == 0 && r->response->getBody() == "slow");
+    TAO_ASSERT(pool->getStats().budget_exhausted == 1);
+}
+
+void test_budget() {
+    tao::http::RetryBudget budget(0.5, 0, 10);
+    TAO_ASSERT(!budget.tryWithdraw());
+    budget.deposit();
+    budget.deposit();
+    TAO_ASSERT(budget.tryWithdraw() && !budget.tryWithdraw());
+    for(int i = 0; i < 100; ++i) {
+        budget.deposit();
+    }
+    TAO_ASSERT(budget.getTokens() == 10);
+}
+
+void run() {
+    auto server = std::make_shared<tao::http::HttpServer>(true);
+    server->getServletDispatch()->addServlet("/big", [](tao::http::HttpRequest::ptr req
+                , tao::http::HttpResponse::ptr rsp
+                , tao::http::HttpSession::ptr session) {
+        rsp->setBody(std::string(1024 * 1024, 'b'));
+        return 0;
+    });
+    server->getServletDispatch()->addServlet("/slow", [](tao::http::HttpRequest::ptr req
+                , tao::http::HttpResponse::ptr rsp
+                , tao::http::HttpSession::ptr session) {
+        usleep(20 * 1000);
+        rsp->setBody("ok");
+        return 0;
+    });
+    auto tail = std::make_shared<std::atomic<int> >(0);
+    server->getServletDispatch()->addServlet("/tail", [tail](tao::http::HttpRequest::ptr req
+                , tao::http::HttpResponse::ptr rsp
+                , tao::http::HttpSession::ptr session) {
+        if((*tail)++ == 0) {
+            usleep(1000 * 1000);
+            rsp->setBody("slow");
+        } else {
+            rsp->setBody("fast");
+        }
+        return 0;
+    });
+    TAO_ASSERT(server->bind(tao::Address::LookupAny("127.0.0.1:8095")));
+    server->start();
+
+    auto pool = std::make_shared<HttpConnectionPool>("127.0.0.1", "", 8095
+                    , 4, 30 * 1000, 100, 30 * 1000, 2, 3000);
+    test_limit(pool);
+    test_wait_timeout();
+    test_idle_evict();
+    test_budget();
+    test_retry();
+    test_hedge(tail);
+
+    //short idle time so the pool timer ends and iom can stop
+    tao::Config::Lookup<uint32_t>("http.pool.max_idle_time")->setValue(200);
+    //static api reuses keep-alive connections
+    auto r = tao::http::HttpConnection::DoGet("http://127.0.0.1:8095/slow", 1000);
+    TAO_ASSERT(r->result == 0);
+    r = tao::http::HttpConnection::DoGet("http://127.0.0.1:8095/slow", 1000);
+    TAO_ASSERT(r->result == 0 && r->response->getBody() == "ok");
+    TAO_ASSERT(tao::http::HttpConnectionPoolMgr::GetInstance()
+                ->get("127.0.0.1", 8095)->getStats().reuses == 1);
+    //connection: close is honored
+    r = tao::http::HttpConnection::DoGet("http://127.0.0.1:8095/slow", 1000, {{"Connection", "close"}});
+    TAO_ASSERT(r->result == 0);
+    TAO_ASSERT(tao::http::HttpConnectionPoolMgr::GetInstance()
+                ->get("127.0.0.1", 8095)->getStats().idle == 0);
+
+    test_stream();
+    TAO_LOG_INFO(g_logger) << tao::http::HttpConnectionPoolMgr::GetInstance()->toString();
+
+    server->stop();
+    TAO_LOG_INFO(g_logger) << "test_http_pool ok";
+}
+
+int main(int argc, char** argv) {
+    tao::IOManager iom(2);
+    iom.schedule(run);
+    return 0;
+}
@@ -0,0 +1,141 @@
+#include "../src/log.h"
+#include "../src/thread.h"
+#include "../src/macro.h"
+#include "../src/util.h"
+#include <fstream>
+
+static tao::Logger::ptr g_logger = TAO_LOG_ROOT();
+
+static size_t count_lines(const std::string& file, const std::string& word = "") {
+    std::ifstream ifs(file);
+    std::string line;
+    size_t n = 0;
+    while(std::getline(ifs, line)) {
+        if(word.empty() || line.find(word) != std::string::npos) {
+            ++n;
+        }
+    }
+    return n;
+}
+
+static tao::Logger::ptr make_logger(tao::LogAppender::ptr appender) {
+    auto logger = std::make_shared<tao::Logger>("async");
+    logger->setLevel(tao::LogLevel::DEBUG);
+    appender->setFormatter(std::make_shared<tao::LogFormatter>("%d%T%t%T[%p]%T%f:%l%T%m%n"));
+    logger->addAppender(appender);
+    return logger;
+}
+
+//threads x n records, returns used ms
+static uint64_t write_records(tao::Logger::ptr logger, int threads, int n) {
+    uint64_t start = tao::GetCurrentMS();
+    std::vector<tao::Thread::ptr> thrs;
+    for(int i = 0; i < threads; ++i) {
+        thrs.push_back(std::make_shared<tao::Thread>([logger, n]() {
+            for(int j = 0; j < n; ++j) {
+                TAO_LOG_INFO(logger) << "record " << j << " of a benchmark line";
+            }
+        }, "log_" + std::to_string(i)));
+    }
+    for(auto& i : thrs) {
+        i->join();
+    }
+    return tao::GetCurrentMS() - start;
+}
+
+void test_block() {
+    const int threads = 4;
+    const int n = 100000;
+    tao::FSUtil::Unlink("./log_sync.txt");
+    tao::FSUtil::Unlink("./log_async.txt");
+    {
+        auto logger = make_logger(std::make_shared<tao::FileLogAppender>("./log_sync.txt"));
+        uint64_t used = write_records(logger, threads, n);
+        TAO_LOG_INFO(g_logger) << "FileLogAppender " << threads * n << " records " << used << "ms";
+    }
+    auto appender = std::make_shared<tao::AsyncLogAppender>("./log_async.txt");
+    auto logger = make_logger(appender);
+    uint64_t used = write_records(logger, threads, n);
+    appender->flush();
+    TAO_LOG_INFO(g_logger) << "AsyncLogAppender " << threads * n << " records " << used << "ms";
+    TAO_ASSERT(appender->getDropped() == 0);
+    TAO_ASSERT(appender->getWritten() == threads * n);
+    TAO_ASSERT(count_lines("./log_async.txt") == threads * n);
+    TAO_LOG_INFO(g_logger) << appender->toYamlString();
+}
+
+void test_drop() {
+    tao::FSUtil::Unlink("./log_drop.txt");
+    const int n = 20000;
+    {
+        auto appender = std::make_shared<tao::AsyncLogAppender>("./log_drop.txt"
+                    , tao::AsyncLogAppender::Overflow::DROP, 4096);
+        auto logger = make_logger(appender);
+        for(int i = 0; i < n; ++i) {
+            TAO_LOG_INFO(logger) << "drop " << i;
+        }
+        appender->flush();
+        TAO_LOG_INFO(g_logger) << "drop policy written=" << appender->getWritten()
+            << " dropped=" << appender->getDropped();
+        TAO_ASSERT(appender->getWritten() + appender->getDropped() == n);
+        TAO_ASSERT(count_lines("./log_drop.txt") == appender->getWritten());
+    }
+
+    tao::FSUtil::Unlink("./log_drop.txt");
+    auto appender = std::make_shared<tao::AsyncLogAppender>("./log_drop.txt"
+                , tao::AsyncLogAppender::Overflow::DROP_DEBUG, 4096);
+    auto logger = make_logger(appender);
+    for(int i = 0; i < n; ++i) {
+        TAO_LOG_DEBUG(logger) << "debug " << i;
+        if(i % 10 == 0) {
+            TAO_LOG_ERROR(logger) << "error " << i;
+        }
+    }
+    appender->flush();
+    TAO_LOG_INFO(g_logger) << "drop_debug policy written=" << appender->getWritten()
+        << " dropped=" << appender->getDropped();
+    //errors wait for space, only debug records are dropped
+    TAO_ASSERT(count_lines("./log_drop.txt", "[ERROR]") == n / 10);
+    TAO_ASSERT(appender->getWritten() + appender->getDropped() == n + n / 10);
+}
+
+void test_truncate() {
+    tao::FSUtil::Unlink("./log_truncate.txt");
+    auto appender = std::make_shared<tao::AsyncLogAppender>("./log_truncate.txt"
+                , tao::AsyncLogAppender::Overflow::BLOCK, 4096);
+    auto logger = make_logger(appender);
+    TAO_LOG_INFO(logger) << "short";
+    TAO_LOG_INFO(logger) << "long " << std::string(2000, 'x');
+    TAO_LOG_INFO(logger) << "after";
+    appender->flush();
+    //the long record is cut to a quarter of the ring but keeps its line
+    TAO_ASSERT(appender->getTruncated() == 1 && appender->getWritten() == 3);
+    TAO_ASSERT(count_lines("./log_truncate.txt") == 3);
+    TAO_ASSERT(count_lines("./log_truncate.txt", "...(truncated)") == 1);
+    TAO_ASSERT(count_lines("./log_truncate.txt", "after") == 1);
+}
+
+void test_reload() {
+    //like LogIniter on every config reload, the rings of an old appender go with it
+    uint64_t base = tao::AsyncLogAppender::GetRingBytes();
+    tao::FSUtil::Unlink("./log_reload.txt");
+    for(int i = 0; i < 50; ++i) {
+        auto appender = std::make_shared<tao::AsyncLogAppender>("./log_reload.txt");
+        auto logger = make_logger(appender);
+        TAO_LOG_INFO(logger) << "reload " << i;
+        //the last event may still hold the previous logger, so at most one more ring
+        TAO_ASSERT(tao::AsyncLogAppender::GetRingBytes() <= base + 2 * 1024 * 1024);
+        appender->flush();
+    }
+    TAO_ASSERT(tao::AsyncLogAppender::GetRingBytes() <= base + 1024 * 1024);
+    TAO_ASSERT(count_lines("./log_reload.txt", "reload") == 50);
+}
+
+int main(int argc, char** argv) {
+    test_block();
+    test_drop();
+    test_truncate();
+    test_reload();
+    TAO_LOG_INFO(g_logger) << "test_log_async ok";
+    return 0;
+}
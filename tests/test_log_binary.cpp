@@ -0,0 +1,152 @@
+#include "../src/log.h"
+#include "../src/thread.h"
+#include "../src/macro.h"
+#include "../src/util.h"
+#include <sys/stat.h>
+
+static tao::Logger::ptr g_logger = TAO_LOG_ROOT();
+
+static const char* s_pattern = "%d%T%t%T%N%T%F%T[%p]%T[%c]%T%f:%l%T%m%n";
+
+//keeps the text of every record, in the order the logger calls its appenders
+class CaptureLogAppender : public tao::LogAppender {
+public:
+    void log(std::shared_ptr<tao::Logger> logger, tao::LogLevel::Level level, tao::LogEvent::ptr event) override {
+        std::string str;
+        m_formatter->format(str, logger, level, event);
+        lines.push_back(str);
+    }
+    std::string toYamlString() override { return "";}
+
+    std::vector<std::string> lines;
+};
+
+static uint64_t file_size(const std::string& name) {
+    struct stat st;
+    return stat(name.c_str(), &st) == 0 ? st.st_size : 0;
+}
+
+static std::vector<std::string> decode(const std::string& name, uint32_t rotated) {
+    std::vector<std::string> lines;
+    tao::LogFormatter fmt(s_pattern);
+    for(uint32_t i = 1; i <= rotated + 1; ++i) {
+        tao::BinaryLogReader reader(i <= rotated ? name + "." + std::to_string(i) : name);
+        TAO_ASSERT(reader.isValid());
+        tao::Logger::ptr logger;
+        tao::LogEvent::ptr event;
+        while(reader.next(logger, event)) {
+            std::string str;
+            fmt.format(str, logger, event->getLevel(), event);
+            lines.push_back(str);
+        }
+    }
+    return lines;
+}
+
+void test_args() {
+    auto logger = std::make_shared<tao::Logger>("args");
+    auto check = [logger](tao::LogEvent::ptr e, const std::string& expect) {
+        if(e->getContent() != expect) {
+            TAO_LOG_ERROR(g_logger) << "got [" << e->getContent() << "] expect [" << expect << "]";
+        }
+        TAO_ASSERT(e->getContent() == expect);
+    };
+    auto e = std::make_shared<tao::LogEvent>(logger, tao::LogLevel::INFO, __FILE__, __LINE__
+                    ,0, 0, 0, 0, "t");
+    const char* null_str = nullptr;
+    e->setArgs("{} {} {} {} {} {} {}", -5, (uint64_t)1 << 60, 2.5, true, 'x', null_str
+                , std::string("str"));
+    check(e, "-5 1152921504606846976 2.5 1 x (null) str");
+
+    e = std::make_shared<tao::LogEvent>(logger, tao::LogLevel::INFO, __FILE__, __LINE__
+                    ,0, 0, 0, 0, "t");
+    e->setArgs("a={} b={} c={}", INT64_MIN, "lit");
+    check(e, "a=-9223372036854775808 b=lit c={}");
+
+    e = std::make_shared<tao::LogEvent>(logger, tao::LogLevel::INFO, __FILE__, __LINE__
+                    ,0, 0, 0, 0, "t");
+    e->setArgs("", 1, 2);
+    check(e, " 1 2");
+}
+
+void test_roundtrip() {
+    const std::string name = "./binlog/roundtrip.bin";
+    auto logger = std::make_shared<tao::Logger>("access");
+    auto capture = std::make_shared<CaptureLogAppender>();
+    capture->setFormatter(std::make_shared<tao::LogFormatter>(s_pattern));
+    auto binary = std::make_shared<tao::BinaryLogAppender>(name, 64 * 1024);
+    logger->addAppender(capture);
+    logger->addAppender(binary);
+
+    std::vector<tao::Thread::ptr> thrs;
+    for(int i = 0; i < 4; ++i) {
+        thrs.push_back(std::make_shared<tao::Thread>([logger]() {
+            for(int j = 0; j < 5000; ++j) {
+                if(j % 3) {
+                    TAO_LOG_FMT_INFO(logger, "GET /api/item/{} {} {}us", j, 200, j * 1.5);
+                } else {
+                    TAO_LOG_WARN(logger) << "stream record " << j;
+                }
+            }
+        }, "bin_" + std::to_string(i)));
+    }
+    for(auto& i : thrs) {
+        i->join();
+    }
+    TAO_ASSERT(binary->getIndex() > 1);
+    //the current file is still mapped, it reads up to the unused tail
+    auto lines = decode(name, binary->getIndex());
+    TAO_LOG_INFO(g_logger) << "roundtrip files=" << binary->getIndex() + 1
+        << " records=" << lines.size();
+    TAO_ASSERT(lines.size() == capture->lines.size());
+    TAO_ASSERT(lines == capture->lines);
+
+    uint32_t rotated = binary->getIndex();
+    binary.reset();
+    logger->clearAppenders();
+    TAO_ASSERT(decode(name, rotated) == capture->lines);
+}
+
+//bytes and time per record of a typical access log line
+void test_compare() {
+    const int n = 200000;
+    const std::string text_name = "./binlog/compare.log";
+    const std::string bin_name = "./binlog/compare.bin";
+
+    uint64_t used[2];
+    for(int k = 0; k < 2; ++k) {
+        auto logger = std::make_shared<tao::Logger>("access");
+        tao::BinaryLogAppender::ptr binary;
+        if(k == 0) {
+            logger->addAppender(std::make_shared<tao::FileLogAppender>(text_name));
+        } else {
+            binary = std::make_shared<tao::BinaryLogAppender>(bin_name, 256 * 1024 * 1024);
+            logger->addAppender(binary);
+        }
+        uint64_t start = tao::GetCurrentUS();
+        for(int i = 0; i < n; ++i) {
+            TAO_LOG_FMT_INFO(logger, "{} {} {} {} {}us", "GET", "/api/v1/item", i % 1000, 200, i % 5000);
+        }
+        used[k] = tao::GetCurrentUS() - start;
+        logger->clearAppenders();
+    }
+    uint64_t text_bytes = file_size(text_name);
+    uint64_t bin_bytes = file_size(bin_name);
+    TAO_LOG_INFO(g_logger) << "FileLogAppender " << (double)text_bytes / n << " bytes "
+        << used[0] * 1000 / n << "ns per record";
+    TAO_LOG_INFO(g_logger) << "BinaryLogAppender " << (double)bin_bytes / n << " bytes "
+        << used[1] * 1000 / n << "ns per record";
+    TAO_LOG_INFO(g_logger) << "ratio bytes=" << (double)text_bytes / bin_bytes
+        << " time=" << (double)used[0] / used[1];
+    TAO_ASSERT(bin_bytes * 3 < text_bytes);
+    TAO_ASSERT(decode(bin_name, 0).size() == n);
+}
+
+int main(int argc, char** argv) {
+    tao::FSUtil::Rm("./binlog");
+    test_args();
+    test_roundtrip();
+    test_compare();
+    TAO_LOG_INFO(g_logger) << "test_log_binary ok";
+    return 0;
+}
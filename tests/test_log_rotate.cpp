@@ -0,0 +1,154 @@
+#include "../src/log.h"
+#include "../src/thread.h"
+#include "../src/macro.h"
+#include "../src/util.h"
+#include "../src/streams/zlib_stream.h"
+#include <dirent.h>
+#include <algorithm>
+#include <unistd.h>
+#include <fstream>
+#include <sstream>
+
+static tao::Logger::ptr g_logger = TAO_LOG_ROOT();
+
+static std::string read_file(const std::string& name) {
+    std::ifstream ifs(name, std::ios::binary);
+    std::stringstream ss;
+    ss << ifs.rdbuf();
+    return ss.str();
+}
+
+static size_t count_lines(const std::string& data) {
+    return std::count(data.begin(), data.end(), '\n');
+}
+
+//rotated segments of ./rotate/name, sorted
+static std::vector<std::string> list_segments(const std::string& name) {
+    std::vector<std::string> rt;
+    DIR* d = opendir("./rotate");
+    struct dirent* dp = nullptr;
+    while(d && (dp = readdir(d))) {
+        std::string file = dp->d_name;
+        if(file.size() > name.size() && file.compare(0, name.size() + 1, name + ".") == 0) {
+            rt.push_back("./rotate/" + file);
+        }
+    }
+    if(d) {
+        closedir(d);
+    }
+    std::sort(rt.begin(), rt.end());
+    return rt;
+}
+
+//lines in the file and every segment, -1 while a segment is not compressed yet
+static int64_t total_lines(const std::string& name) {
+    int64_t n = count_lines(read_file("./rotate/" + name));
+    for(auto& i : list_segments(name)) {
+        if(i.size() < 3 || i.compare(i.size() - 3, 3, ".gz") != 0) {
+            return -1;
+        }
+        auto zs = tao::ZlibStream::CreateGzip(false);
+        std::string data = read_file(i);
+        TAO_ASSERT(zs->write(data.c_str(), data.size()) == Z_OK);
+        TAO_ASSERT(zs->flush() == Z_OK);
+        n += count_lines(zs->getResult());
+    }
+    return n;
+}
+
+static tao::Logger::ptr make_logger(tao::LogAppender::ptr appender) {
+    auto logger = std::make_shared<tao::Logger>("rotate");
+    appender->setFormatter(std::make_shared<tao::LogFormatter>("%d%T%t%T[%p]%T%f:%l%T%m%n"));
+    logger->addAppender(appender);
+    return logger;
+}
+
+//size rotation while 4 threads write, every record ends up in exactly one segment
+void test_size() {
+    const int threads = 4;
+    const int n = 50000;
+    auto appender = std::make_shared<tao::FileLogAppender>("./rotate/size.log"
+                    ,256 * 1024, 0, 0, true);
+    auto logger = make_logger(appender);
+    uint64_t start = tao::GetCurrentMS();
+    std::vector<tao::Thread::ptr> thrs;
+    for(int i = 0; i < threads; ++i) {
+        thrs.push_back(std::make_shared<tao::Thread>([logger, n]() {
+            for(int j = 0; j < n; ++j) {
+                TAO_LOG_INFO(logger) << "record " << j << " of a rotated log";
+            }
+        }, "rotate_" + std::to_string(i)));
+    }
+    for(auto& i : thrs) {
+        i->join();
+    }
+    uint64_t used = tao::GetCurrentMS() - start;
+
+    int64_t lines = -1;
+    for(int i = 0; i < 100 && lines != threads * n; ++i) {
+        usleep(100 * 1000);
+        lines = total_lines("size.log");
+    }
+    TAO_LOG_INFO(g_logger) << "size rotation " << threads * n << " records " << used << "ms"
+        << " rotated=" << appender->getRotated()
+        << " segments=" << list_segments("size.log").size();
+    TAO_ASSERT(appender->getRotated() > 1);
+    TAO_ASSERT(lines == threads * n);
+}
+
+//only the newest max_files segments are kept
+void test_prune() {
+    auto appender = std::make_shared<tao::FileLogAppender>("./rotate/prune.log", 0, 0, 3);
+    auto logger = make_logger(appender);
+    for(int i = 0; i < 6; ++i) {
+        TAO_LOG_INFO(logger) << "segment " << i;
+        uint64_t rotated = appender->getRotated();
+        appender->rotate();
+        for(int j = 0; j < 50 && appender->getRotated() == rotated; ++j) {
+            usleep(20 * 1000);
+        }
+        TAO_ASSERT(appender->getRotated() == rotated + 1);
+    }
+    usleep(200 * 1000);
+    auto segments = list_segments("prune.log");
+    TAO_ASSERT(segments.size() == 3);
+    //the oldest were removed
+    TAO_ASSERT(read_file(segments.back()).find("segment 5") != std::string::npos);
+    TAO_ASSERT(read_file(segments.front()).find("segment 3") != std::string::npos);
+}
+
+//a time window rotates on the first record after it ends, an empty file is left alone
+void test_interval() {
+    auto appender = std::make_shared<tao::FileLogAppender>("./rotate/interval.log", 0, 1);
+    auto logger = make_logger(appender);
+    TAO_LOG_INFO(logger) << "first window";
+    sleep(2);
+    TAO_ASSERT(appender->getRotated() == 1);
+    sleep(2);
+    TAO_ASSERT(appender->getRotated() == 1);
+    TAO_LOG_INFO(logger) << "second window";
+    TAO_ASSERT(list_segments("interval.log").size() == 1);
+    TAO_LOG_INFO(g_logger) << appender->toYamlString();
+}
+
+//the file is reopened after an external logrotate moved it away
+void test_reopen() {
+    auto appender = std::make_shared<tao::FileLogAppender>("./rotate/moved.log");
+    auto logger = make_logger(appender);
+    TAO_LOG_INFO(logger) << "before move";
+    TAO_ASSERT(rename("./rotate/moved.log", "./rotate/moved.old") == 0);
+    sleep(4);
+    TAO_LOG_INFO(logger) << "after move";
+    TAO_ASSERT(read_file("./rotate/moved.old").find("after move") == std::string::npos);
+    TAO_ASSERT(read_file("./rotate/moved.log").find("after move") != std::string::npos);
+}
+
+int main(int argc, char** argv) {
+    tao::FSUtil::Rm("./rotate");
+    test_size();
+    test_prune();
+    test_interval();
+    test_reopen();
+    TAO_LOG_INFO(g_logger) << "test_log_rotate ok";
+    return 0;
+}
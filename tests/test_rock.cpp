@@ -0,0 +1,261 @@
+#include "../src/rock/rock_server.h"
+#include "../src/rock/rock_connection.h"
+#include "../src/iomanager.h"
+#include "../src/macro.h"
+#include "../src/log.h"
+#include <unistd.h>
+#include <set>
+#include <atomic>
+
+static tao::Logger::ptr g_logger = TAO_LOG_ROOT();
+
+enum Cmd {
+    ECHO = 1,
+    SLOW = 2,
+    UPPER = 3,
+    UNKNOWN = 100
+};
+
+class EchoModule : public tao::RockModule {
+public:
+    EchoModule()
+        :RockModule("echo", "1.0", "") {
+    }
+
+    bool handleRockRequest(tao::RockRequest::ptr req
+                           ,tao::RockResponse::ptr rsp
+                           ,tao::RockSession::ptr session) override {
+        if(req->getCmd() != ECHO && req->getCmd() != SLOW) {
+            return false;
+        }
+        if(req->getCmd() == SLOW) {
+            usleep(300 * 1000);
+        }
+        rsp->setResult(200);
+        rsp->setResultStr("ok");
+        rsp->setBody(req->getBody());
+        return true;
+    }
+
+    bool handleRockNotify(tao::RockNotify::ptr notify
+                          ,tao::RockSession::ptr session) override {
+        //answer a notify with a notify
+        tao::RockNotify::ptr nty = std::make_shared<tao::RockNotify>();
+        nty->setNotify(notify->getNotify() + 1);
+        nty->setBody(notify->getBody());
+        session->sendMessage(nty);
+        return true;
+    }
+};
+
+//has no cmd of its own, asked for cmds nobody registered
+class UpperModule : public tao::RockModule {
+public:
+    UpperModule()
+        :RockModule("upper", "1.0", "") {
+    }
+
+    bool handleRockRequest(tao::RockRequest::ptr req
+                           ,tao::RockResponse::ptr rsp
+                           ,tao::RockSession::ptr session) override {
+        if(req->getCmd() != UPPER) {
+            return false;
+        }
+        std::string body = req->getBody();
+        for(auto& c : body) {
+            c = toupper(c);
+        }
+        rsp->setResult(200);
+        rsp->setBody(body);
+        return true;
+    }
+
+    bool handleRockNotify(tao::RockNotify::ptr notify
+                          ,tao::RockSession::ptr session) override {
+        return false;
+    }
+};
+
+void test_codec() {
+    tao::RockRequest::ptr req = std::make_shared<tao::RockRequest>();
+    req->setSn(7);
+    req->setCmd(ECHO);
+    req->setBody(std::string(10000, 'r'));
+    tao::ByteArray::ptr ba = req->toByteArray();
+    ba->setPosition(0);
+    TAO_ASSERT(ba->readFuint8() == tao::Message::REQUEST);
+    tao::RockRequest::ptr parsed = std::make_shared<tao::RockRequest>();
+    TAO_ASSERT(parsed->parseFromByteArray(ba));
+    TAO_ASSERT(parsed->getSn() == 7 && parsed->getCmd() == ECHO);
+    TAO_ASSERT(parsed->getBody() == req->getBody());
+
+    tao::RockResponse::ptr rsp = parsed->createResponse();
+    TAO_ASSERT(rsp->getSn() == 7 && rsp->getCmd() == ECHO && rsp->getResult() == 404);
+}
+
+//slow requests pile up on one connection, new ones go to the others
+void test_pool() {
+    tao::RockConnectionPool::ptr pool = std::make_shared<tao::RockConnectionPool>("127.0.0.1:8094", 3, 1000);
+    auto first = pool->getConnection();
+    TAO_ASSERT(first);
+    //idle, no second connection is made
+    TAO_ASSERT(pool->getConnection() == first);
+
+    const int n = 30;
+    auto ok = std::make_shared<std::atomic<int> >(0);
+    auto done = std::make_shared<std::atomic<int> >(0);
+    auto conns = std::make_shared<std::set<tao::RockConnection::ptr> >();
+    auto mutex = std::make_shared<tao::Mutex>();
+    for(int i = 0; i < n; ++i) {
+        tao::IOManager::GetThis()->schedule([pool, ok, done, conns, mutex]() {
+            auto conn = pool->getConnection();
+            {
+                tao::Mutex::Lock lock(*mutex);
+                conns->insert(conn);
+            }
+            tao::RockRequest::ptr req = std::make_shared<tao::RockRequest>();
+            req->setCmd(SLOW);
+            req->setBody("pool");
+            auto r = conn->request(req, 3000);
+            if(r->result == 0 && r->response->getBody() == "pool") {
+                ++*ok;
+            }
+            ++*done;
+        });
+    }
+    while(*done < n) {
+        usleep(10 * 1000);
+    }
+    TAO_ASSERT(*ok == n);
+    TAO_ASSERT(conns->size() == 3);
+    TAO_ASSERT(pool->getPendingCount() == 0);
+
+    //a closed connection is replaced
+    first->close();
+    usleep(50 * 1000);
+    tao::RockRequest::ptr req = std::make_shared<tao::RockRequest>();
+    req->setCmd(ECHO);
+    req->setBody("again");
+    for(int i = 0; i < 4; ++i) {
+        auto r = pool->request(req, 1000);
+        TAO_ASSERT(r->result == 0 && r->response->getBody() == "again");
+    }
+    pool->close();
+    TAO_ASSERT(pool->getPendingCount() == 0);
+
+    //fibers racing for the only slot park until the connect ends, then share it
+    tao::RockConnectionPool::ptr one = std::make_shared<tao::RockConnectionPool>("127.0.0.1:8094", 1, 1000);
+    conns->clear();
+    *done = 0;
+    for(int i = 0; i < 10; ++i) {
+        tao::IOManager::GetThis()->schedule([one, done, conns, mutex]() {
+            auto conn = one->getConnection();
+            tao::Mutex::Lock lock(*mutex);
+            conns->insert(conn);
+            ++*done;
+        });
+    }
+    while(*done < 10) {
+        usleep(10 * 1000);
+    }
+    TAO_ASSERT(conns->size() == 1 && *conns->begin());
+    one->close();
+}
+
+void test_server() {
+    auto addr = tao::Address::LookupAny("127.0.0.1:8094");
+    tao::RockServer::ptr server = std::make_shared<tao::RockServer>();
+    auto echo = std::make_shared<EchoModule>();
+    tao::ModuleMgr::GetInstance()->add(echo);
+    tao::ModuleMgr::GetInstance()->add(std::make_shared<UpperModule>());
+    server->addModule(ECHO, echo);
+    server->addModule(SLOW, echo);
+    TAO_ASSERT(server->bind(addr));
+    server->start();
+
+    tao::RockConnection::ptr conn = tao::RockConnection::Connect("127.0.0.1:8094", 1000);
+    TAO_ASSERT(conn);
+
+    tao::RockRequest::ptr req = std::make_shared<tao::RockRequest>();
+    req->setCmd(ECHO);
+    req->setBody("hello rock");
+    auto r = conn->request(req, 1000);
+    TAO_ASSERT(r->result == 0);
+    TAO_ASSERT(r->response->getResult() == 200);
+    TAO_ASSERT(r->response->getSn() == req->getSn());
+    TAO_ASSERT(r->response->getBody() == "hello rock");
+
+    req = std::make_shared<tao::RockRequest>();
+    req->setCmd(UPPER);
+    req->setBody("upper");
+    r = conn->request(req, 1000);
+    TAO_ASSERT(r->result == 0 && r->response->getBody() == "UPPER");
+
+    req = std::make_shared<tao::RockRequest>();
+    req->setCmd(UNKNOWN);
+    r = conn->request(req, 1000);
+    TAO_ASSERT(r->result == 0 && r->response->getResult() == 404);
+
+    //the late response is dropped, the connection keeps working
+    req = std::make_shared<tao::RockRequest>();
+    req->setCmd(SLOW);
+    r = conn->request(req, 100);
+    TAO_ASSERT(r->result == (int)tao::RockResult::Error::TIMEOUT);
+    TAO_ASSERT(conn->getPendingCount() == 0);
+
+    //responses of concurrent requests come back out of order
+    const int n = 200;
+    auto ok = std::make_shared<std::atomic<int> >(0);
+    auto done = std::make_shared<std::atomic<int> >(0);
+    for(int i = 0; i < n; ++i) {
+        tao::IOManager::GetThis()->schedule([conn, i, ok, done]() {
+            tao::RockRequest::ptr req = std::make_shared<tao::RockRequest>();
+            req->setCmd(i % 10 ? ECHO : SLOW);
+            req->setBody(std::to_string(i) + std::string(i * 100, 'x'));
+            auto r = conn->request(req, 3000);
+            if(r->result == 0 && r->response->getBody() == req->getBody()) {
+                ++*ok;
+            }
+            ++*done;
+        });
+    }
+    while(*done < n) {
+        usleep(10 * 1000);
+    }
+    TAO_ASSERT(*ok == n);
+
+    auto notified = std::make_shared<std::atomic<int> >(0);
+    conn->setNotifyHandler([notified](tao::RockNotify::ptr nty, tao::RockSession::ptr session) {
+        TAO_ASSERT(nty->getNotify() == 11 && nty->getBody() == "ping");
+        ++*notified;
+        return true;
+    });
+    tao::RockNotify::ptr nty = std::make_shared<tao::RockNotify>();
+    nty->setNotify(10);
+    nty->setBody("ping");
+    TAO_ASSERT(conn->sendMessage(nty) > 0);
+    while(*notified == 0) {
+        usleep(10 * 1000);
+    }
+
+    conn->close();
+    usleep(50 * 1000);
+    TAO_ASSERT(conn->isClosed());
+    req = std::make_shared<tao::RockRequest>();
+    req->setCmd(ECHO);
+    r = conn->request(req, 1000);
+    TAO_ASSERT(r->result == (int)tao::RockResult::Error::CLOSED);
+
+    test_pool();
+
+    server->stop();
+    tao::ModuleMgr::GetInstance()->delAll();
+    TAO_LOG_INFO(g_logger) << "test_rock ok";
+}
+
+int main(int argc, char** argv) {
+    test_codec();
+    tao::IOManager iom(2);
+    iom.schedule(test_server);
+    return 0;
+}
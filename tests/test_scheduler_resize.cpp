@@ -0,0 +1,130 @@
+#include "../src/iomanager.h"
+#include "../src/worker.h"
+#include "../src/config.h"
+#include "../src/log.h"
+#include "../src/macro.h"
+#include "../src/util.h"
+#include <atomic>
+#include <sched.h>
+#include <unistd.h>
+
+static tao::Logger::ptr g_logger = TAO_LOG_ROOT();
+
+using WorkersConf = std::map<std::string, std::map<std::string, std::string> >;
+
+//true when n tasks that block their thread all ran at the same time
+static bool run_together(tao::Scheduler* s, int n, uint64_t timeout_ms) {
+    auto arrived = std::make_shared<std::atomic<int> >(0);
+    auto together = std::make_shared<std::atomic<int> >(0);
+    auto done = std::make_shared<std::atomic<int> >(0);
+    uint64_t deadline = tao::GetCurrentMS() + timeout_ms;
+    for(int i = 0; i < n; ++i) {
+        s->schedule([=]() {
+            ++*arrived;
+            while(*arrived < n && tao::GetCurrentMS() < deadline) {
+                sched_yield();
+            }
+            if(*arrived >= n) {
+                ++*together;
+            }
+            ++*done;
+        });
+    }
+    while(*done < n) {
+        usleep(1000);
+    }
+    return *together == n;
+}
+
+//retirement waits for the threads to go idle
+static bool wait_shrunk(tao::Scheduler* s, int n) {
+    for(int i = 0; i < 100; ++i) {
+        if(!run_together(s, n, 100)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void test_resize() {
+    tao::IOManager iom(2, false, "resize");
+    TAO_ASSERT(run_together(&iom, 2, 3000));
+
+    iom.resize(4);
+    TAO_ASSERT(iom.getThreadCount() == 4);
+    TAO_ASSERT(run_together(&iom, 4, 3000));
+
+    iom.resize(1);
+    TAO_ASSERT(iom.getThreadCount() == 1);
+    TAO_ASSERT(wait_shrunk(&iom, 2));
+    TAO_ASSERT(run_together(&iom, 1, 3000));
+
+    //growing takes back threads not retired yet
+    iom.resize(3);
+    iom.resize(2);
+    iom.resize(3);
+    TAO_ASSERT(iom.getThreadCount() == 3);
+    TAO_ASSERT(run_together(&iom, 3, 3000));
+
+    //no task is lost while threads come and go
+    std::atomic<int> count(0);
+    const int total = 20000;
+    for(int i = 0; i < total; ++i) {
+        iom.schedule([&count]() { ++count; });
+        if(i % 1000 == 0) {
+            iom.resize(1 + (i / 1000) % 4);
+        }
+    }
+    while(count < total) {
+        usleep(1000);
+    }
+    TAO_LOG_INFO(g_logger) << "resize ok";
+}
+
+void test_worker_config() {
+    auto workers = tao::Config::Lookup("workers", WorkersConf(), "worker config");
+    auto wm = tao::WorkerMgr::GetInstance();
+    tao::IOManager main(1, false, "main");
+    std::atomic<bool> done(false);
+    main.schedule([&]() {
+        wm->init(WorkersConf{{"resize_w", {{"thread_num", "2"}}}});
+        //the listener resizes a worker in place
+        workers->setValue(WorkersConf{{"resize_w", {{"thread_num", "3"}}}});
+        //scales between 1 and 4 threads, checked every 50ms
+        workers->setValue(WorkersConf{{"resize_w", {{"thread_num", "1"}
+                        , {"min_thread_num", "1"}, {"max_thread_num", "4"}
+                        , {"scale_interval", "50"}}}});
+        done = true;
+    });
+    while(!done) {
+        usleep(1000);
+    }
+    tao::Scheduler::ptr w = wm->get("resize_w");
+    TAO_ASSERT(w && w->getThreadCount() == 1);
+
+    //queued tasks with no idle thread grow it
+    TAO_ASSERT(run_together(w.get(), 4, 5000));
+    TAO_ASSERT(w->getThreadCount() == 4);
+    //idle threads shrink it back one at a time
+    for(int i = 0; i < 300 && w->getThreadCount() > 1; ++i) {
+        usleep(10 * 1000);
+    }
+    TAO_ASSERT(w->getThreadCount() == 1);
+
+    //thread_num out of range is clamped
+    workers->setValue(WorkersConf{{"resize_w", {{"thread_num", "64"}
+                    , {"min_thread_num", "1"}, {"max_thread_num", "2"}}}});
+    TAO_ASSERT(w->getThreadCount() == 2);
+
+    wm->stop();
+    TAO_LOG_INFO(g_logger) << "worker config ok";
+}
+
+int main(int argc, char** argv) {
+    g_logger->setLevel(tao::LogLevel::INFO);
+    TAO_LOG_NAME("system")->setLevel(tao::LogLevel::INFO);
+    test_resize();
+    test_worker_config();
+    TAO_LOG_INFO(g_logger) << "test_scheduler_resize ok";
+    return 0;
+}
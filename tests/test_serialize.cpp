@@ -0,0 +1,279 @@
+#include "../src/serialize.h"
+#include "../src/protocol.h"
+#include "../src/rock/rock_protocol.h"
+#include "../src/log.h"
+#include "../src/macro.h"
+#include "../src/util.h"
+#include <limits>
+#include <string.h>
+
+static tao::Logger::ptr g_logger = TAO_LOG_ROOT();
+
+enum class Color : uint8_t {
+    RED = 1,
+    BLUE = 200
+};
+
+struct Point {
+    int32_t x = 0;
+    int32_t y = 0;
+    TAO_SERIALIZE_FIELDS(x, y)
+
+    bool operator==(const Point& o) const { return x == o.x && y == o.y;}
+};
+
+struct Shape {
+    std::string name;
+    Color color = Color::RED;
+    bool filled = false;
+    uint16_t layer = 0;
+    int64_t offset = 0;
+    uint64_t id = 0;
+    double scale = 0;
+    float alpha = 0;
+    std::vector<Point> points;
+    std::map<std::string, Point> anchors;
+    std::unordered_map<uint32_t, std::vector<std::string> > labels;
+    TAO_SERIALIZE_FIELDS(name, color, filled, layer, offset, id, scale, alpha
+                         , points, anchors, labels)
+
+    bool operator==(const Shape& o) const {
+        return name == o.name && color == o.color && filled == o.filled
+            && layer == o.layer && offset == o.offset && id == o.id
+            && scale == o.scale && alpha == o.alpha && points == o.points
+            && anchors == o.anchors && labels == o.labels;
+    }
+};
+
+//the body of a message decoded without copying its strings
+struct ShapeView {
+    std::string_view name;
+    std::vector<std::string_view> tags;
+    TAO_SERIALIZE_FIELDS(name, tags)
+};
+
+static Shape make_shape() {
+    Shape s;
+    s.name = "triangle";
+    s.color = Color::BLUE;
+    s.filled = true;
+    s.layer = 65535;
+    s.offset = std::numeric_limits<int64_t>::min();
+    s.id = std::numeric_limits<uint64_t>::max();
+    s.scale = 1.5;
+    s.alpha = 0.25f;
+    s.points = {{0, 0}, {-1, 100000}, {std::numeric_limits<int32_t>::min(), 7}};
+    s.anchors["top"] = {-64, 64};
+    s.anchors["bottom"] = {1, -1};
+    s.labels[1] = {"a", "", std::string(300, 'x')};
+    s.labels[70000] = {};
+    return s;
+}
+
+void test_roundtrip() {
+    Shape s = make_shape();
+    tao::ByteArray::ptr ba = tao::SerializeToByteArray(s);
+    //the precomputed size is exact and fits one node
+    TAO_ASSERT(ba->getSize() == tao::SerializedSize(s));
+    TAO_ASSERT((size_t)ba->getBaseSize() >= ba->getSize());
+    std::string data = ba->toString();
+
+    Shape out;
+    tao::Deserialize(*ba, out);
+    TAO_ASSERT(out == s);
+    TAO_ASSERT(ba->getReadableSize() == 0);
+
+    //the ByteArray calls write the same bytes across small nodes
+    tao::ByteArray::ptr small = std::make_shared<tao::ByteArray>(7);
+    tao::Serialize(*small, s);
+    TAO_ASSERT(small->getSize() == ba->getSize());
+    small->setPosition(0);
+    TAO_ASSERT(small->toString() == data);
+    Shape out2;
+    tao::Deserialize(*small, out2);
+    TAO_ASSERT(out2 == s);
+
+    //a little endian array swaps the fixed width fields, wherever the nodes end
+    for(size_t base_size : {(size_t)7, (size_t)4096}) {
+        tao::ByteArray::ptr le = std::make_shared<tao::ByteArray>(base_size);
+        le->setIsLittleEndian(true);
+        tao::Serialize(*le, s);
+        TAO_ASSERT(le->getSize() == ba->getSize());
+        le->setPosition(0);
+        Shape out3;
+        tao::Deserialize(*le, out3);
+        TAO_ASSERT(out3 == s);
+        le->setPosition(0);
+        TAO_ASSERT(le->toString() != data);
+    }
+
+    //every truncation is detected
+    for(size_t len = 0; len < ba->getSize(); len += 5) {
+        tao::ByteArray::ptr part = std::make_shared<tao::ByteArray>();
+        part->write(data.c_str(), len);
+        part->setPosition(0);
+        bool thrown = false;
+        try {
+            Shape t;
+            tao::Deserialize(*part, t);
+        } catch(std::out_of_range& e) {
+            thrown = true;
+        }
+        TAO_ASSERT(thrown);
+    }
+}
+
+//generated fields write the same bytes as the hand written ByteArray calls
+void test_wire() {
+    tao::RockResponse rsp;
+    rsp.setSn(300);
+    rsp.setCmd(7);
+    rsp.setResult(200);
+    rsp.setResultStr("ok");
+    rsp.setBody(std::string(1000, 'b'));
+
+    tao::ByteArray::ptr hand = std::make_shared<tao::ByteArray>();
+    hand->writeFuint8(tao::Message::RESPONSE);
+    hand->writeUint32(300);
+    hand->writeUint32(7);
+    hand->writeUint32(200);
+    hand->writeStringVint("ok");
+    hand->writeStringVint(std::string(1000, 'b'));
+
+    tao::ByteArray::ptr ba = rsp.toByteArray();
+    ba->setPosition(0);
+    hand->setPosition(0);
+    TAO_ASSERT(ba->toString() == hand->toString());
+    TAO_ASSERT(rsp.getSerializedSize() == hand->getSize());
+
+    hand->setPosition(1);
+    tao::RockResponse parsed;
+    TAO_ASSERT(parsed.parseFromByteArray(hand));
+    TAO_ASSERT(parsed.getSn() == 300 && parsed.getCmd() == 7 && parsed.getResult() == 200);
+    TAO_ASSERT(parsed.getResultStr() == "ok" && parsed.getBody() == rsp.getBody());
+}
+
+void test_view() {
+    ShapeView v;
+    std::string name = "square";
+    std::vector<std::string> tags = {"red", "", std::string(5000, 't')};
+    v.name = name;
+    v.tags.assign(tags.begin(), tags.end());
+
+    tao::ByteArray::ptr ba = tao::SerializeToByteArray(v);
+    std::vector<iovec> iovs;
+    ba->getReadableBuffers(iovs);
+    TAO_ASSERT(iovs.size() == 1);
+    const char* begin = (const char*)iovs[0].iov_base;
+
+    ShapeView out;
+    tao::Deserialize(*ba, out);
+    TAO_ASSERT(out.name == name);
+    TAO_ASSERT(out.tags.size() == 3 && out.tags[2] == tags[2]);
+    //the views point into the array
+    TAO_ASSERT(out.name.data() > begin && out.name.data() < begin + ba->getSize());
+    TAO_ASSERT(out.tags[2].data() > begin && out.tags[2].data() < begin + ba->getSize());
+
+    //a view across nodes can not be made
+    tao::ByteArray::ptr small = std::make_shared<tao::ByteArray>(16);
+    tao::Serialize(*small, v);
+    small->setPosition(0);
+    bool thrown = false;
+    try {
+        tao::Deserialize(*small, out);
+    } catch(std::logic_error& e) {
+        thrown = true;
+    }
+    TAO_ASSERT(thrown);
+}
+
+//the struct of bench written with ByteArray calls
+static void hand_write(tao::ByteArray& ba, const Shape& s) {
+    ba.writeStringVint(s.name);
+    ba.writeFuint8((uint8_t)s.color);
+    ba.writeFuint8(s.filled);
+    ba.writeUint32(s.layer);
+    ba.writeInt64(s.offset);
+    ba.writeUint64(s.id);
+    ba.writeDouble(s.scale);
+    ba.writeFloat(s.alpha);
+    ba.writeUint64(s.points.size());
+    for(auto& i : s.points) {
+        ba.writeInt32(i.x);
+        ba.writeInt32(i.y);
+    }
+    ba.writeUint64(s.anchors.size());
+    for(auto& i : s.anchors) {
+        ba.writeStringVint(i.first);
+        ba.writeInt32(i.second.x);
+        ba.writeInt32(i.second.y);
+    }
+    ba.writeUint64(s.labels.size());
+    for(auto& i : s.labels) {
+        ba.writeUint32(i.first);
+        ba.writeUint64(i.second.size());
+        for(auto& j : i.second) {
+            ba.writeStringVint(j);
+        }
+    }
+}
+
+//encodes per second: hand written, generated into a default array, generated into a sized one
+static void bench_encode(const Shape& s, int n) {
+    uint64_t start = tao::GetCurrentUS();
+    for(int i = 0; i < n; ++i) {
+        tao::ByteArray::ptr ba = std::make_shared<tao::ByteArray>();
+        hand_write(*ba, s);
+    }
+    uint64_t hand = tao::GetCurrentUS() - start;
+
+    start = tao::GetCurrentUS();
+    for(int i = 0; i < n; ++i) {
+        tao::ByteArray::ptr ba = std::make_shared<tao::ByteArray>();
+        tao::Serialize(*ba, s);
+    }
+    uint64_t generated = tao::GetCurrentUS() - start;
+
+    start = tao::GetCurrentUS();
+    for(int i = 0; i < n; ++i) {
+        tao::ByteArray::ptr ba = tao::SerializeToByteArray(s);
+    }
+    uint64_t sized = tao::GetCurrentUS() - start;
+
+    tao::ByteArray::ptr ba = tao::SerializeToByteArray(s);
+    start = tao::GetCurrentUS();
+    for(int i = 0; i < n; ++i) {
+        ba->setPosition(0);
+        Shape out;
+        tao::Deserialize(*ba, out);
+    }
+    uint64_t decode = tao::GetCurrentUS() - start;
+    TAO_LOG_INFO(g_logger) << "shape of " << ba->getSize() << " bytes, encode/s hand="
+        << (uint64_t)n * 1000000 / (hand ? hand : 1)
+        << " generated=" << (uint64_t)n * 1000000 / (generated ? generated : 1)
+        << " sized=" << (uint64_t)n * 1000000 / (sized ? sized : 1)
+        << " decode/s=" << (uint64_t)n * 1000000 / (decode ? decode : 1);
+}
+
+void bench() {
+    Shape s = make_shape();
+    s.labels.clear();
+    for(int i = 0; i < 32; ++i) {
+        s.points.push_back({i * 1000, -i});
+    }
+    bench_encode(s, 200000);
+    //many nodes when the array grows
+    for(int i = 0; i < 20000; ++i) {
+        s.points.push_back({i * 1000, -i});
+    }
+    bench_encode(s, 2000);
+}
+
+int main(int argc, char** argv) {
+    test_roundtrip();
+    test_wire();
+    test_view();
+    bench();
+    TAO_LOG_INFO(g_logger) << "test_serialize ok";
+    return 0;
+}
@@ -0,0 +1,147 @@
+#include "../src/http/ws_session.h"
+#include "../src/http/ws_deflate.h"
+#include "../src/streams/socket_stream.h"
+#include "../src/iomanager.h"
+#include "../src/macro.h"
+#include "../src/log.h"
+
+static tao::Logger::ptr g_logger = TAO_LOG_ROOT();
+
+using tao::http::WSDeflate;
+
+void test_negotiate() {
+    std::string rsp;
+    TAO_ASSERT(!WSDeflate::Negotiate("x-webkit-deflate-frame", rsp));
+    //defaults drop the state of both sides after each message
+    auto d = WSDeflate::Negotiate("permessage-deflate; client_max_window_bits", rsp);
+    TAO_ASSERT(d);
+    TAO_ASSERT(rsp == "permessage-deflate; server_no_context_takeover; client_no_context_takeover");
+
+    //invalid first offer falls back to the second one
+    d = WSDeflate::Negotiate("permessage-deflate; server_max_window_bits=16"
+                ", permessage-deflate; server_max_window_bits=10; client_max_window_bits=\"12\"", rsp);
+    TAO_ASSERT(d);
+    TAO_ASSERT(d->getParams().server_max_window_bits == 10);
+    TAO_ASSERT(d->getParams().client_max_window_bits == 12);
+
+    TAO_ASSERT(!WSDeflate::Negotiate("permessage-deflate; server_max_window_bits=8", rsp));
+    TAO_ASSERT(!WSDeflate::Negotiate("permessage-deflate; foo", rsp));
+    TAO_ASSERT(!WSDeflate::Negotiate("permessage-deflate; client_no_context_takeover; client_no_context_takeover", rsp));
+
+    TAO_ASSERT(WSDeflate::ClientAccept("permessage-deflate; client_max_window_bits=10"));
+    TAO_ASSERT(!WSDeflate::ClientAccept("permessage-deflate; client_max_window_bits"));
+}
+
+void test_roundtrip(bool takeover) {
+    WSDeflate::Params p;
+    p.server_no_context_takeover = !takeover;
+    p.client_no_context_takeover = !takeover;
+    p.server_max_window_bits = 12;
+    WSDeflate server(p, false);
+    WSDeflate client(p, true);
+
+    std::string msg;
+    for(int i = 0; i < 100; ++i) {
+        msg += "{\"user\":\"tao\",\"text\":\"hello " + std::to_string(i % 7) + "\"},";
+    }
+    size_t last = 0;
+    for(int i = 0; i < 3; ++i) {
+        TAO_ASSERT(server.beginFrame(tao::http::WSFrameHead::TEXT_FRAME, msg.size()));
+        std::string z;
+        TAO_ASSERT(server.compress(msg.c_str(), msg.size(), true, z));
+        TAO_ASSERT(client.decompress(z, msg.size()) == 0);
+        TAO_ASSERT(z == msg);
+        //with context takeover repeated messages refer back to the previous ones
+        std::string z2;
+        server.beginFrame(tao::http::WSFrameHead::TEXT_FRAME, msg.size());
+        TAO_ASSERT(server.compress(msg.c_str(), msg.size(), true, z2));
+        if(takeover) {
+            TAO_ASSERT(z2.size() < z.size() / 10);
+        } else if(last) {
+            TAO_ASSERT(z2.size() == last);
+        }
+        last = z2.size();
+        TAO_ASSERT(client.decompress(z2, msg.size()) == 0);
+        TAO_ASSERT(z2 == msg);
+    }
+
+    //fragments are compressed as one message
+    std::string a, b;
+    TAO_ASSERT(client.beginFrame(tao::http::WSFrameHead::BIN_FRAME, msg.size()));
+    TAO_ASSERT(client.compress(msg.c_str(), msg.size() / 2, false, a));
+    TAO_ASSERT(client.beginFrame(tao::http::WSFrameHead::CONTINUE, msg.size()));
+    TAO_ASSERT(client.compress(msg.c_str() + msg.size() / 2, msg.size() - msg.size() / 2, true, b));
+    a += b;
+    TAO_ASSERT(server.decompress(a, msg.size() - 1) == -2);
+
+    std::string bad = "not deflate data";
+    WSDeflate other(p, false);
+    TAO_ASSERT(other.decompress(bad, 1024) == -1);
+    TAO_ASSERT(!server.beginFrame(tao::http::WSFrameHead::TEXT_FRAME, 10));
+}
+
+//handshake over loopback, server echoes compressed messages back
+void test_session() {
+    auto addr = tao::Address::LookupAny("127.0.0.1:8098");
+    auto listener = tao::Socket::CreateTCP(addr);
+    int val = 1;
+    listener->setOption(SOL_SOCKET, SO_REUSEADDR, val);
+    TAO_ASSERT(listener->bind(addr) && listener->listen());
+    tao::IOManager::GetThis()->schedule([listener]() {
+        auto session = std::make_shared<tao::http::WSSession>(listener->accept());
+        TAO_ASSERT(session->handleShake());
+        TAO_ASSERT(session->getDeflate());
+        while(auto msg = session->recvMessage()) {
+            session->sendMessage(msg);
+        }
+        listener->close();
+    });
+
+    auto sock = tao::Socket::CreateTCP(addr);
+    TAO_ASSERT(sock->connect(addr));
+    auto stream = std::make_shared<tao::SocketStream>(sock);
+    std::string req = "GET /chat HTTP/1.1\r\nHost: 127.0.0.1\r\nUpgrade: websocket\r\n"
+        "Connection: Upgrade\r\nSec-WebSocket-Version: 13\r\n"
+        "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+        "Sec-WebSocket-Extensions: " + WSDeflate::ClientOffer() + "\r\n\r\n";
+    TAO_ASSERT(stream->writeFixSize(req.c_str(), req.size()) > 0);
+    std::string rsp;
+    char c;
+    while(rsp.size() < 4 || rsp.substr(rsp.size() - 4) != "\r\n\r\n") {
+        TAO_ASSERT(stream->read(&c, 1) == 1);
+        rsp.push_back(c);
+    }
+    std::string key = "Sec-WebSocket-Extensions: ";
+    size_t pos = rsp.find(key);
+    TAO_ASSERT(pos != std::string::npos);
+    std::string ext = rsp.substr(pos + key.size(), rsp.find("\r\n", pos) - pos - key.size());
+    auto deflate = WSDeflate::ClientAccept(ext);
+    TAO_ASSERT(deflate);
+
+    for(auto& data : {std::string(10, 'a'), std::string(100000, 'b')}) {
+        auto msg = std::make_shared<tao::http::WSFrameMessage>(tao::http::WSFrameHead::TEXT_FRAME, data);
+        int rt = tao::http::WSSendMessage(stream.get(), msg, true, true, deflate.get());
+        TAO_ASSERT(rt > 0);
+        if(data.size() > 10) {
+            TAO_ASSERT(rt < 1000);
+        }
+        auto echo = tao::http::WSRecvMessage(stream.get(), true, deflate.get());
+        TAO_ASSERT(echo && echo->getData() == data);
+    }
+    TAO_LOG_INFO(g_logger) << "extensions: " << ext;
+    stream->close();
+}
+
+void run() {
+    test_negotiate();
+    test_roundtrip(false);
+    test_roundtrip(true);
+    test_session();
+    TAO_LOG_INFO(g_logger) << "test_ws_deflate ok";
+}
+
+int main(int argc, char** argv) {
+    tao::IOManager iom(1);
+    iom.schedule(run);
+    return 0;
+}
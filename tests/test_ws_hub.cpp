@@ -0,0 +1,128 @@
+#include "../src/http/ws_server.h"
+#include "../src/http/ws_hub.h"
+#include "../src/streams/socket_stream.h"
+#include "../src/config.h"
+#include "../src/macro.h"
+#include "../src/log.h"
+
+static tao::Logger::ptr g_logger = TAO_LOG_ROOT();
+
+static const int s_clients = 20;
+static const int s_messages = 300;
+static const size_t s_message_size = 64 * 1024;
+
+static std::atomic<int> s_finished{0};
+
+static std::string make_message(int i) {
+    std::string data(s_message_size, 0);
+    uint32_t v = i * 2654435761u;
+    for(auto& c : data) {
+        v = v * 1103515245 + 12345;
+        c = (char)(v >> 16);
+    }
+    return data;
+}
+
+//raw upgrade request, returns the stream after the 101 response
+static std::shared_ptr<tao::SocketStream> connect_ws(tao::Address::ptr addr, bool deflate
+                                , tao::http::WSDeflate::ptr& ws_deflate, int rcvbuf = 0) {
+    auto sock = tao::Socket::CreateTCP(addr);
+    if(rcvbuf) {
+        sock->setOption(SOL_SOCKET, SO_RCVBUF, rcvbuf);
+    }
+    TAO_ASSERT(sock->connect(addr));
+    auto stream = std::make_shared<tao::SocketStream>(sock);
+    std::string req = "GET /hub HTTP/1.1\r\nHost: 127.0.0.1\r\nUpgrade: websocket\r\n"
+        "Connection: Upgrade\r\nSec-WebSocket-Version: 13\r\n"
+        "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n";
+    if(deflate) {
+        req += "Sec-WebSocket-Extensions: " + tao::http::WSDeflate::ClientOffer() + "\r\n";
+    }
+    req += "\r\n";
+    TAO_ASSERT(stream->writeFixSize(req.c_str(), req.size()) > 0);
+    std::string rsp;
+    char c;
+    while(rsp.size() < 4 || rsp.substr(rsp.size() - 4) != "\r\n\r\n") {
+        TAO_ASSERT(stream->read(&c, 1) == 1);
+        rsp.push_back(c);
+    }
+    TAO_ASSERT(rsp.find(" 101 ") != std::string::npos);
+    std::string key = "Sec-WebSocket-Extensions: ";
+    size_t pos = rsp.find(key);
+    if(deflate) {
+        TAO_ASSERT(pos != std::string::npos);
+        ws_deflate = tao::http::WSDeflate::ClientAccept(rsp.substr(pos + key.size()
+                        , rsp.find("\r\n", pos) - pos - key.size()));
+        TAO_ASSERT(ws_deflate);
+    }
+    return stream;
+}
+
+static void client(tao::Address::ptr addr, bool deflate) {
+    tao::http::WSDeflate::ptr ws_deflate;
+    auto stream = connect_ws(addr, deflate, ws_deflate);
+    for(int i = 0; i < s_messages; ++i) {
+        auto msg = tao::http::WSRecvMessage(stream.get(), true, ws_deflate.get());
+        TAO_ASSERT(msg);
+        TAO_ASSERT(msg->getData() == make_message(i));
+    }
+    stream->close();
+    ++s_finished;
+}
+
+void run() {
+    tao::Config::Lookup<uint32_t>("websocket.hub.max_queue")->setValue(64);
+    tao::Config::Lookup<uint64_t>("websocket.hub.max_queue_bytes")->setValue(2 * 1024 * 1024);
+
+    auto hub = std::make_shared<tao::http::WSHub>();
+    tao::http::WSServer::ptr server(new tao::http::WSServer);
+    auto addr = tao::Address::LookupAnyIPAddress("127.0.0.1:8097");
+    TAO_ASSERT(server->bind(addr));
+    server->getWSServletDispatch()->addServlet("/hub"
+        ,[](tao::http::HttpRequest::ptr header, tao::http::WSFrameMessage::ptr msg
+                , tao::http::WSSession::ptr session) {
+            return 0;
+        }
+        ,[hub](tao::http::HttpRequest::ptr header, tao::http::WSSession::ptr session) {
+            hub->subscribe("news", session);
+            return 0;
+        }
+        ,[hub](tao::http::HttpRequest::ptr header, tao::http::WSSession::ptr session) {
+            hub->unsubscribeAll(session);
+            return 0;
+        });
+    server->start();
+
+    for(int i = 0; i < s_clients; ++i) {
+        tao::IOManager::GetThis()->schedule(std::bind(client, addr, i % 2 == 0));
+    }
+    //never reads, with a tiny receive buffer
+    tao::http::WSDeflate::ptr none;
+    auto slow = connect_ws(addr, false, none, 4096);
+
+    while(hub->getStats().subscribers < s_clients + 1) {
+        usleep(1000);
+    }
+    uint64_t start = tao::GetCurrentMS();
+    for(int i = 0; i < s_messages; ++i) {
+        hub->publish("news", make_message(i), tao::http::WSFrameHead::BIN_FRAME);
+        hub->publish("sports", "nobody listens");
+        usleep(1000);
+    }
+    while(s_finished < s_clients) {
+        usleep(1000);
+    }
+    auto stats = hub->getStats();
+    TAO_LOG_INFO(g_logger) << stats.toString() << " used " << (tao::GetCurrentMS() - start) << "ms";
+    TAO_ASSERT(stats.dropped == 1);
+    TAO_ASSERT(stats.published == s_messages * 2);
+    slow->close();
+    server->stop();
+    TAO_LOG_INFO(g_logger) << "test_ws_hub ok";
+}
+
+int main(int argc, char** argv) {
+    tao::IOManager iom(4);
+    iom.schedule(run);
+    return 0;
+}